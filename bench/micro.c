@@ -0,0 +1,995 @@
+/*
+ *  Microbenchmarks for the primitives of Med over synthetic corpora. Each result is printed as one JSON
+ *  object per line with the time and the number of heap allocations per operation, so runs can be diffed.
+ *
+ *  Corpora and the suites run on them:
+ *    - tiny_lines: 100k lines of 16 characters, all the same. Line and editor edits, saving and loading,
+ *      shrinking and interning.
+ *    - 1mb_line: a single 1 MB line. Line edits, saving and loading.
+ *    - 64mb_line: a single 64 MB line stored in chunks. Line edits and copying the columns on screen.
+ *    - c_source_100k: 100k lines of C. Highlighting, decorations, the job system and wrapping.
+ *    - log_200k: 200k lines of a web server log. Packing cold lines and filtering.
+ *    - nested_1m: a block of 1M indented lines. Folding.
+ *    - N_lines: 10M lines (100k with --quick, N with --many-lines). Editor edits, saving and loading.
+ *
+ *  Suites on threads run with 1, 2, 4... workers, up to the number of CPUs.
+ *
+ *  Usage: ./med_microbench [--quick] [--many-lines N] [--filter NAME]
+ *
+ *  Allocations are counted by wrapping malloc, calloc and realloc at link time (see the Makefile),
+ *  so only the ones made by Med's own code are seen, not those made inside libc or SDL.
+ */
+#define _POSIX_C_SOURCE 200809L // mkstemp
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "editor.h"
+#include "line.h"
+#include "utils.h"
+#include "highlight.h"
+#include "decoration.h"
+#include "jobs.h"
+#include "diff.h"
+#include "cold.h"
+#include "intern.h"
+#include "mem.h"
+#include "wrap.h"
+#include "fold.h"
+#include "filter.h"
+#include "SDL.h"
+
+#define TINY_LINES 100000
+#define TINY_LINE_SIZE 16
+#define LONG_LINE_SIZE (1024 * 1024)
+#define GIANT_LINE_SIZE (64 * 1024 * 1024)
+#define VISIBLE_COLS 160
+#define MANY_LINES 10000000
+#define MANY_LINES_QUICK 100000
+#define FILE_BENCH_RUNS 3
+#define C_SOURCE_LINES 100000
+#define HIGHLIGHT_VISIBLE_ROWS 40
+#define DECORATIONS_PER_LINE 10
+#define JOB_BENCH_LINES 1024
+#define JOB_BENCH_PASSES 8
+#define LOG_LINES 200000
+#define WRAP_BENCH_WIDTH 40
+#define FOLD_BENCH_LINES 1000000
+#define FOLD_GROUP_LINES 4
+#define FOLD_BENCH_EDIT_RATIO 100
+#define FILTER_BENCH_PATTERN "ERROR"
+#define FILTER_BENCH_EDIT_RATIO 100
+
+typedef struct {
+    const char* name;
+    const char* corpus;
+    size_t ops;
+    Uint64 start_counter;
+    unsigned start_allocs;
+} Bench;
+
+// Counted from the worker threads of the job system too, differences are taken modulo 2^32
+static SDL_atomic_t num_allocs;
+static const char* filter = NULL;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+/*
+ *  Purpose: Count the allocation and forward it to the real allocator. The linker resolves
+ *           malloc, calloc and realloc to these wrappers with '-Wl,--wrap=...'.
+ *
+ *  Parameters: The same as the wrapped function.
+ *
+ *  Returns: The same as the wrapped function.
+ */
+void* __wrap_malloc(size_t size)
+{
+    SDL_AtomicAdd(&num_allocs, 1);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t n, size_t size)
+{
+    SDL_AtomicAdd(&num_allocs, 1);
+    return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+    SDL_AtomicAdd(&num_allocs, 1);
+    return __real_realloc(ptr, size);
+}
+
+/*
+ *  Purpose: Check whether a benchmark was selected with --filter.
+ *
+ *  Parameters:
+ *    - name: The name of the benchmark.
+ *
+ *  Returns:
+ *    - true if the benchmark should run.
+ *    - false otherwise.
+ */
+static bool bench_enabled(const char* name)
+{
+    return filter == NULL || strstr(name, filter) != NULL;
+}
+
+/*
+ *  Purpose: Start timing a benchmark and counting its allocations.
+ *
+ *  Parameters:
+ *    - name: The name of the benchmark, usually the function being measured.
+ *    - corpus: The name of the corpus the benchmark runs on.
+ *
+ *  Returns: The running Bench, to be finished with 'bench_stop'.
+ */
+static Bench bench_start(const char* name, const char* corpus)
+{
+    return (Bench) {
+        .name = name,
+        .corpus = corpus,
+        .start_counter = SDL_GetPerformanceCounter(),
+        .start_allocs = (unsigned)SDL_AtomicGet(&num_allocs),
+    };
+}
+
+/*
+ *  Purpose: Stop timing a benchmark and print its result as a JSON object on its own line.
+ *
+ *  Parameters:
+ *    - bench: Pointer to the running Bench.
+ *    - ops: The number of operations performed since 'bench_start'.
+ *
+ *  Returns: None.
+ */
+static void bench_stop(Bench* bench, size_t ops)
+{
+    Uint64 ticks = SDL_GetPerformanceCounter() - bench->start_counter;
+    size_t allocs = (unsigned)SDL_AtomicGet(&num_allocs) - bench->start_allocs;
+    double ns = (double)ticks * 1e9 / SDL_GetPerformanceFrequency();
+
+    printf("{\"bench\":\"%s\",\"corpus\":\"%s\",\"ops\":%zu,\"ns_per_op\":%.1f,\"allocs_per_op\":%.4f}\n",
+           bench->name, bench->corpus, ops, ns / ops, (double)allocs / ops);
+    fflush(stdout);
+}
+
+/*
+ *  Purpose: Fill an Editor with lines of the same size, filled with lowercase letters.
+ *
+ *  Parameters:
+ *    - editor: Pointer to an empty Editor structure.
+ *    - num_lines: The number of lines to add.
+ *    - line_size: The number of characters on each line.
+ *
+ *  Returns: None.
+ */
+static void corpus_fill(Editor* editor, size_t num_lines, size_t line_size)
+{
+    // Go through a file so the lines are built the same way they are when the editor opens one
+    FILE* fp = utils_cp(tmpfile());
+    char* line = utils_cp(malloc(line_size + 1));
+    for (size_t i = 0; i < line_size; i++)
+        line[i] = 'a' + i % 26;
+    line[line_size] = '\n';
+
+    for (size_t i = 0; i < num_lines; i++)
+        fwrite(line, 1, line_size + (i + 1 < num_lines), fp);
+
+    rewind(fp);
+    editor_load_from_file(editor, fp);
+    fclose(fp);
+    free(line);
+}
+
+/*
+ *  Purpose: Benchmark inserting, backspacing and deleting single characters in the middle of lines.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor holding the corpus, its lines are restored afterwards.
+ *    - corpus: The name of the corpus.
+ *    - ops: The number of operations for each benchmark.
+ *
+ *  Returns: None.
+ */
+static void bench_line_ops(Editor* editor, const char* corpus, size_t ops)
+{
+    char text[] = "x";
+
+    if (bench_enabled("line_insert_text_segment_before_cursor")) {
+        Bench bench = bench_start("line_insert_text_segment_before_cursor", corpus);
+        for (size_t i = 0; i < ops; i++) {
+            Line* line = editor->lines + i % editor->size;
+            size_t col = line->size / 2;
+            line_insert_text_segment_before_cursor(line, text, 1, &col);
+        }
+        bench_stop(&bench, ops);
+    }
+
+    // Removes the characters inserted above, in the same place
+    if (bench_enabled("line_backspace")) {
+        Bench bench = bench_start("line_backspace", corpus);
+        for (size_t i = 0; i < ops; i++) {
+            Line* line = editor->lines + i % editor->size;
+            size_t col = line->size / 2;
+            line_backspace(line, &col);
+        }
+        bench_stop(&bench, ops);
+    }
+
+    // Deletes from the middle of the restored lines, so stop while they are at least half full
+    size_t delete_ops = ops < editor->size * (editor->lines[0].size / 2) ? ops : editor->size * (editor->lines[0].size / 2);
+    if (bench_enabled("line_delete")) {
+        Bench bench = bench_start("line_delete", corpus);
+        for (size_t i = 0; i < delete_ops; i++) {
+            Line* line = editor->lines + i % editor->size;
+            size_t col = line->size / 2;
+            line_delete(line, &col);
+        }
+        bench_stop(&bench, delete_ops);
+    }
+}
+
+/*
+ *  Purpose: Benchmark splitting lines in the middle of the file with 'editor_return' and joining them
+ *           back with 'editor_backspace' at the start of the new lines. Both shift every line below the cursor.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor holding the corpus, its lines are restored afterwards.
+ *    - corpus: The name of the corpus.
+ *    - ops: The number of operations for each benchmark.
+ *
+ *  Returns: None.
+ */
+static void bench_editor_line_ops(Editor* editor, const char* corpus, size_t ops)
+{
+    size_t row = editor->size / 2;
+    size_t col = editor->lines[row].size / 2;
+
+    if (bench_enabled("editor_return")) {
+        editor->cursor_row = row;
+        editor->cursor_col = col;
+        Bench bench = bench_start("editor_return", corpus);
+        for (size_t i = 0; i < ops; i++)
+            editor_return(editor); // leaves the cursor at the start of the new line
+        bench_stop(&bench, ops);
+    }
+
+    if (bench_enabled("editor_backspace_line_start")) {
+        if (editor->cursor_row == 0)
+            editor->cursor_row = row;
+
+        Bench bench = bench_start("editor_backspace_line_start", corpus);
+        for (size_t i = 0; i < ops; i++) {
+            editor->cursor_col = 0;
+            editor_backspace(editor); // joins the line into the one above and moves the cursor up
+        }
+        bench_stop(&bench, ops);
+    }
+}
+
+/*
+ *  Purpose: Benchmark saving an Editor to a file and loading the file back into a new Editor.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor holding the corpus.
+ *    - corpus: The name of the corpus.
+ *
+ *  Returns: None.
+ */
+static void bench_file_ops(Editor* editor, const char* corpus)
+{
+    char file_path[] = "/tmp/med_microbench_XXXXXX";
+    int fd = mkstemp(file_path);
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: could not create a temporary file: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+
+    if (bench_enabled("editor_save_to_file")) {
+        Bench bench = bench_start("editor_save_to_file", corpus);
+        for (size_t i = 0; i < FILE_BENCH_RUNS; i++)
+            editor_save_to_file(editor, file_path);
+        bench_stop(&bench, FILE_BENCH_RUNS);
+    } else
+        editor_save_to_file(editor, file_path);
+
+    if (bench_enabled("editor_load_from_file")) {
+        Bench bench = bench_start("editor_load_from_file", corpus);
+        for (size_t i = 0; i < FILE_BENCH_RUNS; i++) {
+            FILE* fp = utils_cp(fopen(file_path, "r"));
+            Editor loaded = {0};
+            editor_load_from_file(&loaded, fp);
+            fclose(fp);
+
+            // Freeing is part of the cost of a load that has to be undone before the next one
+            editor_free(&loaded);
+        }
+        bench_stop(&bench, FILE_BENCH_RUNS);
+    }
+
+    remove(file_path);
+}
+
+/*
+ *  Purpose: Fill an Editor with C code, a short function with comments, strings and a directive repeated.
+ *
+ *  Parameters:
+ *    - editor: Pointer to an empty Editor structure.
+ *    - num_lines: The number of lines to add (rounded up to a whole function).
+ *
+ *  Returns: None.
+ */
+static void corpus_fill_c_source(Editor* editor, size_t num_lines)
+{
+    static const char* function[] = {
+        "/*",
+        " *  Purpose: Count the characters of a string.",
+        " */",
+        "#define LIMIT \\",
+        "    (1024 * 4)",
+        "static size_t count(const char* text, int limit)",
+        "{",
+        "    size_t size = 0; // the result",
+        "    while (text[size] != '\\0' && size < LIMIT)",
+        "        size++;",
+        "    printf(\"%zu characters\\n\", size);",
+        "    return size;",
+        "}",
+        "",
+    };
+    const size_t function_lines = sizeof(function) / sizeof(function[0]);
+
+    FILE* fp = utils_cp(tmpfile());
+    for (size_t i = 0; i < num_lines; i += function_lines)
+        for (size_t j = 0; j < function_lines; j++)
+            fprintf(fp, "%s\n", function[j]);
+
+    rewind(fp);
+    editor_load_from_file(editor, fp);
+    fclose(fp);
+}
+
+/*
+ *  Purpose: Benchmark highlighting a whole file, then typing in its middle with the rows around the cursor
+ *           drawn after every keystroke. The number of lines lexed per keystroke is printed as well.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor holding the corpus.
+ *    - corpus: The name of the corpus.
+ *    - ops: The number of keystrokes.
+ *
+ *  Returns: None.
+ */
+static void bench_highlight(Editor* editor, const char* corpus, size_t ops)
+{
+    Highlighter* highlighter = highlight_create(editor);
+    size_t num_runs;
+
+    if (bench_enabled("highlight_full")) {
+        Bench bench = bench_start("highlight_full", corpus);
+        for (size_t row = 0; row < editor->size; row++)
+            highlight_get_runs(highlighter, row, &num_runs);
+        bench_stop(&bench, editor->size);
+    }
+
+    if (bench_enabled("highlight_type")) {
+        editor->cursor_row = editor->size / 2;
+        editor->cursor_col = 0;
+        size_t first_row = editor->cursor_row - HIGHLIGHT_VISIBLE_ROWS / 2;
+        size_t lines_lexed = highlighter->lines_lexed;
+
+        Bench bench = bench_start("highlight_type", corpus);
+        for (size_t i = 0; i < ops; i++) {
+            char text[] = {"x/*\"*"[i % 5], '\0'};
+            editor_insert_text_before_cursor(editor, text);
+            for (size_t row = first_row; row < first_row + HIGHLIGHT_VISIBLE_ROWS; row++)
+                highlight_get_runs(highlighter, row, &num_runs);
+        }
+        bench_stop(&bench, ops);
+
+        printf("{\"bench\":\"highlight_type\",\"corpus\":\"%s\",\"lines_lexed_per_op\":%.2f}\n",
+               corpus, (double)(highlighter->lines_lexed - lines_lexed) / ops);
+        fflush(stdout);
+    }
+
+    highlight_free(highlighter);
+}
+
+/*
+ *  Purpose: Benchmark the first highlighting pass over a whole file with 1, 2, 4... worker threads, up to the
+ *           number of CPUs, to show how it scales.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor holding the corpus.
+ *    - corpus: The name of the corpus.
+ *
+ *  Returns: None.
+ */
+static void bench_highlight_pass(Editor* editor, const char* corpus)
+{
+    size_t max_threads = SDL_GetCPUCount() < HIGHLIGHT_PASS_MAX_THREADS ? SDL_GetCPUCount() : HIGHLIGHT_PASS_MAX_THREADS;
+
+    for (size_t num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+        char name[64];
+        snprintf(name, sizeof(name), "highlight_pass_%zu_threads", num_threads);
+        if (!bench_enabled(name))
+            continue;
+
+        Highlighter* highlighter = highlight_create(editor);
+        Bench bench = bench_start(name, corpus);
+        highlight_start_pass(highlighter, 0, num_threads);
+        highlight_finish_pass(highlighter);
+        bench_stop(&bench, editor->size);
+        highlight_free(highlighter);
+    }
+}
+
+/*
+ *  Purpose: Benchmark adding DECORATIONS_PER_LINE search hits to every line, querying the visible ones and
+ *           splitting and joining lines above them, which moves all the hits after the edit.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor holding the corpus, its lines are the same afterwards.
+ *    - corpus: The name of the corpus.
+ *    - ops: The number of queries and edits.
+ *
+ *  Returns: None.
+ */
+static void bench_decorations(Editor* editor, const char* corpus, size_t ops)
+{
+    if (!bench_enabled("decoration"))
+        return;
+
+    DecorationStore* decorations = decoration_create(editor);
+    Bench bench = bench_start("decoration_add", corpus);
+    for (size_t row = 0; row < editor->size; row++)
+        for (size_t i = 0; i < DECORATIONS_PER_LINE; i++)
+            decoration_add(decorations, (Decoration) {row, i, row, i + 1, DECORATION_SEARCH_HIT});
+    bench_stop(&bench, editor->size * DECORATIONS_PER_LINE);
+
+    size_t count, found = 0;
+    bench = bench_start("decoration_query", corpus);
+    for (size_t i = 0; i < ops; i++) {
+        size_t first_row = i * 7919 % (editor->size - HIGHLIGHT_VISIBLE_ROWS);
+        decoration_query(decorations, first_row, first_row + HIGHLIGHT_VISIBLE_ROWS - 1, &count);
+        found += count;
+    }
+    bench_stop(&bench, ops);
+
+    editor->cursor_row = editor->size / 2;
+    editor->cursor_col = 0;
+    bench = bench_start("decoration_return_backspace", corpus);
+    for (size_t i = 0; i < ops; i++) {
+        editor_return(editor);
+        editor_backspace(editor);
+    }
+    bench_stop(&bench, ops * 2);
+
+    printf("{\"bench\":\"decoration_query\",\"corpus\":\"%s\",\"decorations\":%zu,\"found_per_op\":%.1f}\n",
+           corpus, decorations->count, (double)found / ops);
+    fflush(stdout);
+    decoration_free(decorations);
+}
+
+// The lines one job of 'bench_jobs' hashes
+typedef struct {
+    Editor* editor;
+    size_t first_row;
+    uint64_t hash;
+} JobBenchChunk;
+
+/*
+ *  Purpose: Hash the lines of a chunk JOB_BENCH_PASSES times. Run by a worker.
+ *
+ *  Parameters:
+ *    - data: Pointer to the JobBenchChunk.
+ *    - token: Pointer to the JobToken of the benchmark.
+ *
+ *  Returns: None.
+ */
+static void bench_job_run(void* data, JobToken* token)
+{
+    (void)token;
+    JobBenchChunk* chunk = data;
+    for (size_t pass = 0; pass < JOB_BENCH_PASSES; pass++) {
+        for (size_t row = chunk->first_row; row < chunk->first_row + JOB_BENCH_LINES && row < chunk->editor->size; row++) {
+            const Line* line = editor_get_line(chunk->editor, row);
+            chunk->hash ^= diff_hash_line(line->chars, line->size);
+        }
+    }
+}
+
+/*
+ *  Purpose: Benchmark running one job per JOB_BENCH_LINES lines of the corpus with 1, 2, 4... workers, up to
+ *           the number of CPUs, to show how the job system scales. Each op is a job, from its submission
+ *           until it was completed on the main thread.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor holding the corpus.
+ *    - corpus: The name of the corpus.
+ *
+ *  Returns: None.
+ */
+static void bench_jobs(Editor* editor, const char* corpus)
+{
+    size_t max_workers = SDL_GetCPUCount() < JOBS_MAX_WORKERS ? SDL_GetCPUCount() : JOBS_MAX_WORKERS;
+    size_t num_jobs = (editor->size + JOB_BENCH_LINES - 1) / JOB_BENCH_LINES;
+    JobBenchChunk* chunks = utils_cp(calloc(num_jobs, sizeof(chunks[0])));
+
+    for (size_t num_workers = 1; num_workers <= max_workers; num_workers *= 2) {
+        char name[64];
+        snprintf(name, sizeof(name), "jobs_%zu_workers", num_workers);
+        if (!bench_enabled(name))
+            continue;
+
+        JobSystem* jobs = jobs_create(num_workers);
+        JobToken* token = jobs_token_create();
+        Bench bench = bench_start(name, corpus);
+        for (size_t i = 0; i < num_jobs; i++) {
+            chunks[i] = (JobBenchChunk) {.editor = editor, .first_row = i * JOB_BENCH_LINES};
+            jobs_submit(jobs, JOB_PRIORITY_NORMAL, bench_job_run, NULL, chunks + i, token);
+        }
+        jobs_wait(jobs, token);
+        jobs_drain(jobs);
+        bench_stop(&bench, num_jobs);
+
+        jobs_token_release(token);
+        jobs_free(jobs);
+    }
+    free(chunks);
+}
+
+/*
+ *  Purpose: Fill an Editor with lines of a web server log, whose timestamps, ids and paths vary.
+ *
+ *  Parameters:
+ *    - editor: Pointer to an empty Editor structure.
+ *    - num_lines: The number of lines to add.
+ *
+ *  Returns: None.
+ */
+static void corpus_fill_log(Editor* editor, size_t num_lines)
+{
+    static const char* levels[] = {"INFO", "INFO", "INFO", "DEBUG", "WARN", "ERROR"};
+    static const char* paths[] = {"/api/v1/items", "/api/v1/users", "/static/app.js", "/health", "/api/v1/orders"};
+
+    FILE* fp = utils_cp(tmpfile());
+    for (size_t i = 0; i < num_lines; i++) {
+        fprintf(fp, "2024-03-%02zu %02zu:%02zu:%02zu.%03zu %s [worker-%zu] GET %s?id=%zu status=%d duration=%zums\n",
+                1 + i / 86400 % 28, i / 3600 % 24, i / 60 % 60, i % 60, i * 7 % 1000, levels[i % 6], i % 8,
+                paths[i * 31 % 5], i * 7919 % 100000, i % 17 == 0 ? 500 : 200, i * 13 % 250);
+    }
+
+    rewind(fp);
+    editor_load_from_file(editor, fp);
+    fclose(fp);
+}
+
+/*
+ *  Purpose: Benchmark filtering a log: building the bitmap of the lines that match with 1, 2, 4... workers,
+ *           finding the line of a row on screen (select) and the row of a line (rank), and following lines
+ *           appended at the end, as from a followed file, and lines broken in the middle.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor holding the corpus, which is edited.
+ *    - corpus: The name of the corpus.
+ *    - ops: The number of lookups and appended lines, there are FILTER_BENCH_EDIT_RATIO times fewer lines broken.
+ *
+ *  Returns: None.
+ */
+static void bench_filter(Editor* editor, const char* corpus, size_t ops)
+{
+    size_t max_workers = SDL_GetCPUCount() < JOBS_MAX_WORKERS ? SDL_GetCPUCount() : JOBS_MAX_WORKERS;
+    for (size_t num_workers = 1; num_workers <= max_workers; num_workers *= 2) {
+        char name[64];
+        snprintf(name, sizeof(name), "filter_build_%zu_workers", num_workers);
+        if (!bench_enabled(name))
+            continue;
+
+        JobSystem* jobs = jobs_create(num_workers);
+        Bench bench = bench_start(name, corpus);
+        FilterView* filter = filter_create(jobs, editor, FILTER_BENCH_PATTERN, strlen(FILTER_BENCH_PATTERN), 0);
+        filter_finish(filter);
+        bench_stop(&bench, editor->size);
+        filter_free(filter);
+        jobs_free(jobs);
+    }
+    if (!bench_enabled("filter_"))
+        return;
+
+    JobSystem* jobs = jobs_create(max_workers);
+    FilterView* filter = filter_create(jobs, editor, FILTER_BENCH_PATTERN, strlen(FILTER_BENCH_PATTERN), 0);
+    filter_finish(filter);
+    size_t num_matches = filter_num_rows(filter);
+
+    size_t found = 0;
+    Bench bench = bench_start("filter_line_at", corpus);
+    for (size_t i = 0; i < ops; i++)
+        found += filter_line_at(filter, i * 7919 % num_matches);
+    bench_stop(&bench, ops);
+
+    bench = bench_start("filter_row_of", corpus);
+    for (size_t i = 0; i < ops; i++)
+        found += filter_row_of(filter, i * 7919 % editor->size);
+    bench_stop(&bench, ops);
+
+    bench = bench_start("filter_append", corpus);
+    for (size_t i = 0; i < ops; i++) {
+        editor->cursor_row = editor->size - 1;
+        editor->cursor_col = editor->lines[editor->size - 1].size;
+        editor_return(editor);
+        editor_insert_text_before_cursor(editor, i % 6 == 0 ? "ERROR appended" : "INFO appended");
+        found += filter_num_rows(filter);
+    }
+    bench_stop(&bench, ops);
+
+    // Breaking lines moves every line below in the Editor too, so there are fewer edits
+    size_t num_edits = ops / FILTER_BENCH_EDIT_RATIO;
+    bench = bench_start("filter_edit", corpus);
+    for (size_t i = 0; i < num_edits; i++) {
+        editor->cursor_row = i * 7919 % editor->size;
+        editor->cursor_col = 0;
+        editor_return(editor);
+        found += filter_num_rows(filter);
+    }
+    bench_stop(&bench, num_edits);
+
+    printf("{\"bench\":\"filter\",\"corpus\":\"%s\",\"lines\":%zu,\"matches\":%zu,\"found\":%zu}\n",
+           corpus, editor->size, filter_num_rows(filter), found);
+    fflush(stdout);
+    filter_free(filter);
+    jobs_free(jobs);
+}
+
+/*
+ *  Purpose: Benchmark packing every line of a log far from the camera into compressed blocks, reading screens
+ *           of them back through the cache and reading all of them in order as a worker does. The size of the
+ *           lines packed and unpacked is printed as well.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor holding the corpus, whose lines are packed afterwards.
+ *    - corpus: The name of the corpus.
+ *    - ops: The number of screens read.
+ *
+ *  Returns: None.
+ */
+static void bench_cold(Editor* editor, const char* corpus, size_t ops)
+{
+    if (!bench_enabled("cold"))
+        return;
+
+    Bench bench = bench_start("cold_pack", corpus);
+    while (editor_pack_cold_lines(editor, 0, SDL_MAX_UINT32)) {}
+    bench_stop(&bench, editor->size);
+
+    const ColdStore* cold = editor->cold;
+    printf("{\"bench\":\"cold_pack\",\"corpus\":\"%s\",\"blocks\":%zu,\"raw_bytes\":%zu,\"packed_bytes\":%zu,\"ratio\":%.2f}\n",
+           corpus, cold->size, cold->raw_bytes, cold->packed_bytes, (double)cold->raw_bytes / cold->packed_bytes);
+    fflush(stdout);
+
+    size_t screen_chars = 0;
+    bench = bench_start("cold_get_line_screen", corpus);
+    for (size_t i = 0; i < ops; i++) {
+        size_t first_row = i * 7919 % (editor->size - HIGHLIGHT_VISIBLE_ROWS);
+        for (size_t row = first_row; row < first_row + HIGHLIGHT_VISIBLE_ROWS; row++)
+            screen_chars += editor_get_line(editor, row)->size;
+    }
+    bench_stop(&bench, ops);
+
+    size_t read_chars = 0;
+    ColdReader reader = {0};
+    bench = bench_start("cold_read_line", corpus);
+    for (size_t row = 0; row < editor->size; row++)
+        read_chars += editor_read_line(editor, row, &reader)->size;
+    bench_stop(&bench, editor->size);
+    cold_reader_free(&reader);
+
+    printf("{\"bench\":\"cold_read_line\",\"corpus\":\"%s\",\"chars_per_screen\":%.1f,\"chars_read\":%zu}\n",
+           corpus, (double)screen_chars / ops, read_chars);
+    fflush(stdout);
+}
+
+/*
+ *  Purpose: Benchmark shrinking every line of an Editor to its size, as is done while the window is idle. The
+ *           bytes held by the lines and their slack before and after are printed as well.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor holding the corpus, whose lines are shrunk afterwards.
+ *    - corpus: The name of the corpus.
+ *
+ *  Returns: None.
+ */
+static void bench_compact(Editor* editor, const char* corpus)
+{
+    if (!bench_enabled("compact"))
+        return;
+
+    MemUsage before[MEM_NUM_SUBSYSTEMS];
+    mem_get_usage(before);
+    editor_memory_usage(editor, before);
+
+    Bench bench = bench_start("editor_compact", corpus);
+    while (editor_compact(editor, SDL_MAX_UINT32)) {}
+    bench_stop(&bench, editor->size);
+
+    MemUsage after[MEM_NUM_SUBSYSTEMS];
+    mem_get_usage(after);
+    editor_memory_usage(editor, after);
+    printf("{\"bench\":\"editor_compact\",\"corpus\":\"%s\",\"line_bytes\":[%zu,%zu],\"line_slack\":[%zu,%zu]}\n", corpus,
+           before[MEM_LINES].live_bytes, after[MEM_LINES].live_bytes, before[MEM_LINES].slack_bytes, after[MEM_LINES].slack_bytes);
+    fflush(stdout);
+}
+
+/*
+ *  Purpose: Benchmark interning every line of an Editor, as the loader does for '--intern'. The bytes held by
+ *           the lines and by the pool are printed as well.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor holding the corpus, whose lines borrow from the pool afterwards.
+ *    - corpus: The name of the corpus.
+ *
+ *  Returns: None.
+ */
+static void bench_intern(Editor* editor, const char* corpus)
+{
+    if (!bench_enabled("intern"))
+        return;
+
+    size_t owned_bytes = 0;
+    for (size_t row = 0; row < editor->size; row++)
+        owned_bytes += editor->lines[row].capacity;
+
+    editor->intern = intern_create();
+    Bench bench = bench_start("intern_line", corpus);
+    for (size_t row = 0; row < editor->size; row++)
+        intern_line(editor->intern, editor->lines + row);
+    bench_stop(&bench, editor->size);
+
+    const InternPool* pool = editor->intern;
+    printf("{\"bench\":\"intern_line\",\"corpus\":\"%s\",\"strings\":%zu,\"owned_bytes\":%zu,\"pool_bytes\":%zu,\"dedupe_ratio\":%.1f}\n",
+           corpus, pool->size, owned_bytes, pool->block_bytes + pool->capacity * sizeof(pool->entries[0]), intern_dedupe_ratio(pool));
+    fflush(stdout);
+}
+
+/*
+ *  Purpose: Benchmark soft wrapping: measuring every line, finding the line of a visual row, moving the
+ *           cursor down by visual rows and typing with the layout following the edits.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor holding the corpus, which is edited.
+ *    - corpus: The name of the corpus.
+ *    - ops: The number of lookups, moves and edits.
+ *
+ *  Returns: None.
+ */
+static void bench_wrap(Editor* editor, const char* corpus, size_t ops)
+{
+    if (!bench_enabled("wrap"))
+        return;
+
+    WrapLayout* wrap = wrap_create(editor, WRAP_BENCH_WIDTH);
+    Bench bench = bench_start("wrap_measure", corpus);
+    wrap_update_visible(wrap, 0, editor->size * WRAP_BENCH_WIDTH, 0);
+    bench_stop(&bench, editor->size);
+
+    size_t found = 0;
+    bench = bench_start("wrap_locate", corpus);
+    for (size_t i = 0; i < ops; i++)
+        found += wrap_locate(wrap, i * 7919 % wrap->total_rows, NULL);
+    bench_stop(&bench, ops);
+
+    editor->cursor_row = 0;
+    editor->cursor_col = 0;
+    bench = bench_start("wrap_down_arrow", corpus);
+    for (size_t i = 0; i < ops; i++)
+        wrap_down_arrow(wrap);
+    bench_stop(&bench, ops);
+
+    bench = bench_start("wrap_edit", corpus);
+    for (size_t i = 0; i < ops; i++) {
+        editor->cursor_row = i * 7919 % editor->size;
+        editor->cursor_col = 0;
+        editor_insert_text_before_cursor(editor, "x");
+    }
+    bench_stop(&bench, ops);
+
+    printf("{\"bench\":\"wrap\",\"corpus\":\"%s\",\"lines\":%zu,\"visual_rows\":%zu,\"found\":%zu}\n",
+           corpus, editor->size, wrap->total_rows, found);
+    fflush(stdout);
+    wrap_free(wrap);
+}
+
+/*
+ *  Purpose: Benchmark copying the columns on screen out of a line, as a frame does without wrapping, from
+ *           places spread over the whole line.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor whose first line is copied from, longer than VISIBLE_COLS.
+ *    - corpus: The name of the corpus.
+ *    - ops: The number of copies.
+ *
+ *  Returns: None.
+ */
+static void bench_visible_cols(Editor* editor, const char* corpus, size_t ops)
+{
+    if (!bench_enabled("line_copy_range"))
+        return;
+
+    const Line* line = editor->lines;
+    char cols[VISIBLE_COLS];
+    size_t checksum = 0;
+    Bench bench = bench_start("line_copy_range", corpus);
+    for (size_t i = 0; i < ops; i++) {
+        size_t start = i * 7919 * 7919 % (line->size - VISIBLE_COLS);
+        line_copy_range(line, start, start + VISIBLE_COLS, cols);
+        checksum += cols[i % VISIBLE_COLS];
+    }
+    bench_stop(&bench, ops);
+
+    printf("{\"bench\":\"line_copy_range\",\"corpus\":\"%s\",\"chunks\":%zu,\"checksum\":%zu}\n",
+           corpus, line_is_chunked(line) ? line->chunks->size : 0, checksum);
+    fflush(stdout);
+}
+
+/*
+ *  Purpose: Fill an Editor with one block of indented lines, made of groups of a line and the deeper lines under it.
+ *
+ *  Parameters:
+ *    - editor: Pointer to an empty Editor structure.
+ *    - num_lines: The number of lines in the block, under the line opening it.
+ *
+ *  Returns: None.
+ */
+static void corpus_fill_nested(Editor* editor, size_t num_lines)
+{
+    FILE* fp = utils_cp(tmpfile());
+    fprintf(fp, "root:\n");
+    for (size_t i = 0; i < num_lines; i++)
+        fprintf(fp, i % FOLD_GROUP_LINES == 0 ? "    group %zu:\n" : "        item %zu\n", i);
+
+    rewind(fp);
+    editor_load_from_file(editor, fp);
+    fclose(fp);
+}
+
+/*
+ *  Purpose: Benchmark folding: folding and opening the whole block, folding every group, finding the line
+ *           of a row on screen, moving the cursor down over the folds and breaking lines with the folds following
+ *           the edits.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor holding the corpus, which is edited.
+ *    - corpus: The name of the corpus.
+ *    - ops: The number of lookups and moves, there are FOLD_BENCH_EDIT_RATIO times fewer edits.
+ *
+ *  Returns: None.
+ */
+static void bench_fold(Editor* editor, const char* corpus, size_t ops)
+{
+    if (!bench_enabled("fold"))
+        return;
+
+    FoldStore* folds = fold_create(editor);
+    editor->cursor_row = 0;
+    editor->cursor_col = 0;
+    Bench bench = bench_start("fold_block", corpus);
+    fold_toggle(folds);
+    bench_stop(&bench, 1);
+
+    bench = bench_start("fold_open_block", corpus);
+    fold_toggle(folds);
+    bench_stop(&bench, 1);
+
+    size_t num_groups = 0;
+    bench = bench_start("fold_groups", corpus);
+    for (size_t row = 1; row < editor->size; row += FOLD_GROUP_LINES) {
+        editor->cursor_row = row;
+        num_groups += fold_toggle(folds);
+    }
+    bench_stop(&bench, num_groups);
+
+    size_t found = 0;
+    bench = bench_start("fold_line_at", corpus);
+    for (size_t i = 0; i < ops; i++)
+        found += fold_line_at(folds, i * 7919 % fold_num_rows(folds));
+    bench_stop(&bench, ops);
+
+    editor->cursor_row = 0;
+    editor->cursor_col = 0;
+    bench = bench_start("fold_down_arrow", corpus);
+    for (size_t i = 0; i < ops; i++)
+        fold_down_arrow(folds);
+    bench_stop(&bench, ops);
+
+    // Breaking lines moves every line below in the Editor too, so there are fewer edits
+    size_t num_edits = ops / FOLD_BENCH_EDIT_RATIO;
+    bench = bench_start("fold_edit", corpus);
+    for (size_t i = 0; i < num_edits; i++) {
+        editor->cursor_row = fold_line_at(folds, i * 7919 % fold_num_rows(folds));
+        editor->cursor_col = 0;
+        editor_return(editor);
+    }
+    bench_stop(&bench, num_edits);
+
+    printf("{\"bench\":\"fold\",\"corpus\":\"%s\",\"lines\":%zu,\"folds\":%zu,\"visible_rows\":%zu,\"found\":%zu}\n",
+           corpus, editor->size, folds->count, fold_num_rows(folds), found);
+    fflush(stdout);
+    fold_free(folds);
+}
+
+int main(int argc, const char* argv[])
+{
+    size_t many_lines = MANY_LINES;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0)
+            many_lines = MANY_LINES_QUICK;
+        else if (strcmp(argv[i], "--many-lines") == 0 && i + 1 < argc)
+            many_lines = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+            filter = argv[++i];
+        else {
+            fprintf(stderr, "Usage: ./med_microbench [--quick] [--many-lines N] [--filter NAME]\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    Editor tiny = {0};
+    corpus_fill(&tiny, TINY_LINES, TINY_LINE_SIZE);
+    bench_line_ops(&tiny, "tiny_lines", 1000000);
+    bench_editor_line_ops(&tiny, "tiny_lines", 1000);
+    bench_file_ops(&tiny, "tiny_lines");
+    bench_compact(&tiny, "tiny_lines");
+    bench_intern(&tiny, "tiny_lines");
+    editor_free(&tiny);
+
+    Editor long_line = {0};
+    corpus_fill(&long_line, 1, LONG_LINE_SIZE);
+    bench_line_ops(&long_line, "1mb_line", 10000);
+    bench_file_ops(&long_line, "1mb_line");
+    editor_free(&long_line);
+
+    Editor giant_line = {0};
+    corpus_fill(&giant_line, 1, GIANT_LINE_SIZE);
+    bench_line_ops(&giant_line, "64mb_line", 10000);
+    bench_visible_cols(&giant_line, "64mb_line", 100000);
+    editor_free(&giant_line);
+
+    Editor c_source = {0};
+    corpus_fill_c_source(&c_source, C_SOURCE_LINES);
+    bench_highlight_pass(&c_source, "c_source_100k");
+    bench_highlight(&c_source, "c_source_100k", 1000);
+    bench_decorations(&c_source, "c_source_100k", 10000);
+    bench_jobs(&c_source, "c_source_100k");
+    bench_wrap(&c_source, "c_source_100k", 100000);
+    editor_free(&c_source);
+
+    Editor log = {0};
+    corpus_fill_log(&log, LOG_LINES);
+    bench_cold(&log, "log_200k", 10000);
+    bench_filter(&log, "log_200k", 100000);
+    editor_free(&log);
+
+    Editor nested = {0};
+    corpus_fill_nested(&nested, FOLD_BENCH_LINES);
+    bench_fold(&nested, "nested_1m", 100000);
+    editor_free(&nested);
+
+    char many_corpus[32];
+    snprintf(many_corpus, sizeof(many_corpus), "%zu_lines", many_lines);
+    Editor many = {0};
+    corpus_fill(&many, many_lines, TINY_LINE_SIZE / 2);
+    bench_editor_line_ops(&many, many_corpus, 20);
+    bench_file_ops(&many, many_corpus);
+    editor_free(&many);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,303 @@
+/*
+ *  Headless keystroke replay benchmark. Loads a file, replays a recorded (./med --record) or scripted
+ *  keystroke trace through the editor_* functions and renders every frame with SDL's dummy video
+ *  driver, then reports throughput and per-operation latency percentiles.
+ *
+ *  Usage: ./med_bench FILE-PATH [TRACE-PATH] [--ops N] [--no-render]
+ *
+ *  Without a trace, N operations (default 100000) of a scripted typing session are replayed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+
+#include "editor.h"
+#include "keylog.h"
+#include "render.h"
+#include "frame.h"
+#include "camera.h"
+#include "font.h"
+#include "utils.h"
+#include "vec.h"
+#include "SDL.h"
+#include "SDL_ttf.h"
+
+#define BENCH_WINDOW_WIDTH 800
+#define BENCH_WINDOW_HEIGHT 600
+#define BENCH_DEFAULT_OPS 100000
+
+typedef struct {
+    size_t capacity;
+    size_t size;
+    double* us;
+} Samples;
+
+typedef struct {
+    size_t capacity;
+    size_t size;
+    KeylogEntry* entries;
+} Trace;
+
+/*
+ *  Purpose: Append a latency sample, growing the buffer as needed.
+ *
+ *  Parameters:
+ *    - samples: Pointer to the Samples structure to append to.
+ *    - us: The latency in microseconds.
+ *
+ *  Returns: None.
+ */
+static void samples_push(Samples* samples, double us)
+{
+    if (samples->size == samples->capacity) {
+        samples->capacity = samples->capacity == 0 ? 1024 : samples->capacity * 2;
+        samples->us = utils_cp(realloc(samples->us, samples->capacity * sizeof(samples->us[0])));
+    }
+    samples->us[samples->size++] = us;
+}
+
+/*
+ *  Purpose: qsort comparison function for doubles in ascending order.
+ *
+ *  Parameters:
+ *    - a: Pointer to the first double.
+ *    - b: Pointer to the second double.
+ *
+ *  Returns: A negative, zero or positive value if a is less than, equal to or greater than b.
+ */
+static int compare_doubles(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ *  Purpose: Get a percentile of sorted samples using the nearest rank.
+ *
+ *  Parameters:
+ *    - sorted: Pointer to the Samples structure, sorted in ascending order.
+ *    - p: The percentile to get, between 0 and 100.
+ *
+ *  Returns: The sample at the given percentile, or 0 if there are no samples.
+ */
+static double percentile(const Samples* sorted, double p)
+{
+    if (sorted->size == 0)
+        return 0.0;
+    size_t index = (size_t)(p / 100.0 * (sorted->size - 1) + 0.5);
+    return sorted->us[index];
+}
+
+/*
+ *  Purpose: Sort the samples and print a row of the latency table for them.
+ *
+ *  Parameters:
+ *    - name: The name of the row.
+ *    - samples: Pointer to the Samples structure to report (sorted in place).
+ *
+ *  Returns: None.
+ */
+static void print_samples(const char* name, Samples* samples)
+{
+    if (samples->size == 0)
+        return;
+    qsort(samples->us, samples->size, sizeof(samples->us[0]), compare_doubles);
+    printf("%-10s %9zu %10.2f %10.2f %10.2f %10.2f\n", name, samples->size,
+           percentile(samples, 50), percentile(samples, 90), percentile(samples, 99), samples->us[samples->size - 1]);
+}
+
+/*
+ *  Purpose: Append an operation to the trace, growing the buffer as needed.
+ *
+ *  Parameters:
+ *    - trace: Pointer to the Trace structure to append to.
+ *    - entry: The operation to append.
+ *
+ *  Returns: None.
+ */
+static void trace_push(Trace* trace, KeylogEntry entry)
+{
+    if (trace->size == trace->capacity) {
+        trace->capacity = trace->capacity == 0 ? 1024 : trace->capacity * 2;
+        trace->entries = utils_cp(realloc(trace->entries, trace->capacity * sizeof(trace->entries[0])));
+    }
+    trace->entries[trace->size++] = entry;
+}
+
+/*
+ *  Purpose: Generate a deterministic typing session: C-like lines typed one character at a time,
+ *           with the odd typo corrected by backspace and some vertical navigation.
+ *
+ *  Parameters:
+ *    - trace: Pointer to the Trace to append the operations to.
+ *    - num_ops: The number of operations to generate.
+ *
+ *  Returns: None.
+ */
+static void trace_generate(Trace* trace, size_t num_ops)
+{
+    static const char* snippets[] = {
+        "for (size_t i = 0; i < editor->size; i++) {",
+        "    line_append_text(line, text);",
+        "if (cursor_visible)",
+        "}",
+        "// TODO: handle the empty editor",
+        "return EXIT_SUCCESS;",
+    };
+    const size_t num_snippets = sizeof(snippets) / sizeof(snippets[0]);
+    Uint32 seed = 42;
+
+    for (size_t ops = 0, s = 0; ops < num_ops; s = (s + 1) % num_snippets) {
+        for (const char* c = snippets[s]; *c != '\0' && ops < num_ops; c++, ops++) {
+            seed = seed * 1103515245 + 12345;
+            KeylogEntry entry = {.op = KEYLOG_INSERT, .count = 1, .text = {*c}};
+            trace_push(trace, entry);
+
+            if ((seed >> 16) % 20 == 0 && ops + 2 < num_ops) { // typo and correction
+                trace_push(trace, (KeylogEntry) {.op = KEYLOG_INSERT, .count = 1, .text = "x"});
+                trace_push(trace, (KeylogEntry) {.op = KEYLOG_BACKSPACE, .count = 1});
+                ops += 2;
+            }
+        }
+
+        if (ops < num_ops) {
+            trace_push(trace, (KeylogEntry) {.op = KEYLOG_RETURN, .count = 1});
+            ops++;
+        }
+
+        seed = seed * 1103515245 + 12345;
+        if ((seed >> 16) % 8 == 0 && ops + 2 < num_ops) { // look back up and come back down
+            trace_push(trace, (KeylogEntry) {.op = KEYLOG_UP, .count = 1});
+            trace_push(trace, (KeylogEntry) {.op = KEYLOG_DOWN, .count = 1});
+            ops += 2;
+        }
+    }
+}
+
+/*
+ *  Purpose: Convert a performance counter interval to microseconds.
+ *
+ *  Parameters:
+ *    - counter: The number of performance counter ticks.
+ *
+ *  Returns: The interval in microseconds.
+ */
+static double counter_to_us(Uint64 counter)
+{
+    return (double)counter * 1000000.0 / SDL_GetPerformanceFrequency();
+}
+
+int main(int argc, const char* argv[])
+{
+    const char* file_path = NULL;
+    const char* trace_path = NULL;
+    size_t num_ops = BENCH_DEFAULT_OPS;
+    bool render = true;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ops") == 0 && i + 1 < argc)
+            num_ops = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--no-render") == 0)
+            render = false;
+        else if (file_path == NULL)
+            file_path = argv[i];
+        else
+            trace_path = argv[i];
+    }
+
+    if (file_path == NULL) {
+        fprintf(stderr, "Usage: ./med_bench FILE-PATH [TRACE-PATH] [--ops N] [--no-render]\n");
+        return EXIT_FAILURE;
+    }
+
+    // Render offscreen so the benchmark runs without a display
+    SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+    utils_scc(SDL_Init(SDL_INIT_VIDEO));
+    utils_scc(TTF_Init());
+
+    SDL_Window* window =
+        utils_scp(SDL_CreateWindow("med_bench", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, BENCH_WINDOW_WIDTH, BENCH_WINDOW_HEIGHT, SDL_WINDOW_HIDDEN));
+    SDL_Renderer* renderer = utils_scp(SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE));
+    Font* font = font_load_ttf(renderer, "./font/VictorMono-Regular.ttf");
+
+    Editor editor = {0};
+    Camera camera = {0};
+    // Drawn on this thread through the same snapshots the editor's render thread draws
+    FrameSnapshot frame = {.cursor_visible = true, .cursor_shape = CURSOR_BAR};
+
+    FILE* fp = fopen(file_path, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "Error: Unable to load file '%s': %s\n", file_path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    Uint64 load_start = SDL_GetPerformanceCounter();
+    editor_load_from_file(&editor, fp);
+    Uint64 load_end = SDL_GetPerformanceCounter();
+    fclose(fp);
+
+    // Read the whole trace up front so file IO is not part of the measurements
+    Trace trace = {0};
+    if (trace_path != NULL) {
+        FILE* trace_fp = fopen(trace_path, "r");
+        if (trace_fp == NULL) {
+            fprintf(stderr, "Error: Unable to read trace '%s': %s\n", trace_path, strerror(errno));
+            return EXIT_FAILURE;
+        }
+        KeylogEntry entry;
+        while (keylog_read(trace_fp, &entry))
+            trace_push(&trace, entry);
+        fclose(trace_fp);
+    } else
+        trace_generate(&trace, num_ops);
+
+    Samples op_samples[KEYLOG_OP_COUNT] = {0};
+    Samples all_samples = {0};
+    Samples frame_samples = {0};
+
+    Uint64 replay_start = SDL_GetPerformanceCounter();
+    for (size_t i = 0; i < trace.size; i++) {
+        const KeylogEntry* entry = trace.entries + i;
+
+        for (size_t n = 0; n < entry->count; n++) {
+            Uint64 op_start = SDL_GetPerformanceCounter();
+            keylog_apply(&editor, entry);
+
+            Uint64 frame_start = SDL_GetPerformanceCounter();
+            if (render) {
+                camera_update(&camera, &editor, NULL, FRAME_TARGET_TIME_S);
+                frame_capture(&frame, &editor, NULL, NULL, NULL, NULL, NULL, window, &camera);
+                frame_render(renderer, font, window, &frame);
+            }
+            Uint64 op_end = SDL_GetPerformanceCounter();
+
+            samples_push(op_samples + entry->op, counter_to_us(op_end - op_start));
+            samples_push(&all_samples, counter_to_us(op_end - op_start));
+            if (render)
+                samples_push(&frame_samples, counter_to_us(op_end - frame_start));
+        }
+    }
+    Uint64 replay_end = SDL_GetPerformanceCounter();
+
+    double replay_s = counter_to_us(replay_end - replay_start) / 1000000.0;
+    printf("file: %s (%zu lines, loaded in %.2f ms)\n", file_path, editor.size, counter_to_us(load_end - load_start) / 1000.0);
+    printf("trace: %s, render: %s\n", trace_path != NULL ? trace_path : "scripted", render ? "on" : "off");
+    printf("ops: %zu in %.3f s, throughput: %.0f ops/s\n\n", all_samples.size, replay_s, replay_s > 0 ? all_samples.size / replay_s : 0.0);
+
+    printf("%-10s %9s %10s %10s %10s %10s\n", "op (us)", "count", "p50", "p90", "p99", "max");
+    for (KeylogOp op = KEYLOG_INSERT; op < KEYLOG_OP_COUNT; op++)
+        print_samples(keylog_op_name(op), op_samples + op);
+    print_samples("all", &all_samples);
+    print_samples("frame", &frame_samples);
+
+    for (KeylogOp op = 0; op < KEYLOG_OP_COUNT; op++)
+        free(op_samples[op].us);
+    free(all_samples.us);
+    free(frame_samples.us);
+    free(trace.entries);
+    frame_free(&frame);
+    utils_clean_up(window, renderer, font, &editor);
+
+    return EXIT_SUCCESS;
+}
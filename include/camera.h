@@ -8,38 +8,51 @@
 #define FPS 60
 #define FRAME_TARGET_TIME_S (1.0f / FPS)
 
+// Exponential decay rate (per second) of the distance between the camera and the cursor
 #define DEFAULT_CAMERA_SPEED 2
+// Distance in pixels under which the camera snaps onto the cursor and is considered at rest
+#define CAMERA_SNAP_DISTANCE 0.5f
 
+#include <stdbool.h>
 #include "vec.h"
 #include "editor.h"
+#include "fold.h"
 #include "SDL.h" // Uint32
 
 typedef struct {
-    Vec2f pos, vel;
+    Vec2f pos;
 } Camera;
 
 /*
- *  Purpose: Update the camera's position to smoothly follow the cursor in a text editor.
+ *  Purpose: Move the camera smoothly towards a target. The remaining distance decays exponentially with the
+ *           measured frame time, so the motion is the same at any FPS.
  *
  *  Parameters:
  *    - camera: Pointer to the Camera structure to be updated.
- *    - editor: Pointer to the Editor structure containing cursor position information.
+ *    - target: The position the camera should end up at.
+ *    - delta_time_s: Time in seconds since the previous update.
  *
- *  Returns: None.
+ *  Returns:
+ *    - true if the camera has converged on the target and no further updates are needed.
+ *    - false otherwise.
  */
-void camera_update(Camera* camera, Editor* editor);
+bool camera_follow(Camera* camera, Vec2f target, float delta_time_s);
 
 /*
- *  Purpose: Scale the camera's velocity to adjust its movement speed. A larger scale value 
- *           increases the speed, while a smaller scale value decreases it.
+ *  Purpose: Update the camera's position to smoothly follow the cursor in a text editor. The remaining
+ *           distance decays exponentially with the measured frame time, so the motion is the same at any FPS.
  *
  *  Parameters:
- *    - camera: Pointer to the Camera structure to be modified.
- *    - scale: Scaling factor to adjust the camera's speed (1.0 maintains the current speed).
+ *    - camera: Pointer to the Camera structure to be updated.
+ *    - editor: Pointer to the Editor structure containing cursor position information.
+ *    - folds: Pointer to the FoldStore hiding lines, which the cursor is placed without (can be NULL).
+ *    - delta_time_s: Time in seconds since the previous update.
  *
- *  Returns: None.
+ *  Returns:
+ *    - true if the camera has converged on the cursor and no further updates are needed.
+ *    - false otherwise.
  */
-void camera_scale_speed(Camera* camera, float scale);
+bool camera_update(Camera* camera, Editor* editor, FoldStore* folds, float delta_time_s);
 
 /*
  *  Purpose: Cap the frame rate to ensure consistent timing between frames.
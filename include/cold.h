@@ -0,0 +1,194 @@
+/*
+ *  Compression of the lines far from the camera and the cursor. Runs of lines are packed into blocks of
+ *  about COLD_BLOCK_SIZE characters with the built-in LZ codec and the lines' own characters are freed:
+ *  a cold line keeps its size but has no characters. Blocks are unpacked again when their lines are read,
+ *  into a small cache that evicts the least recently used block first, and are given back to their lines
+ *  for good when one of them is edited.
+ */
+#ifndef COLD_H_
+#define COLD_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "line.h"
+#include "SDL.h"
+
+#define COLD_BLOCK_SIZE (64 * 1024)
+#define COLD_CACHE_BLOCKS 16
+#define COLD_INIT_CAPACITY 64
+
+// Lines this close to the camera or the cursor stay as they are
+#define COLD_KEEP_LINES 4096
+
+// Longer lines are left alone, unpacking one would hold up a frame
+#define COLD_MAX_LINE_SIZE (16 * COLD_BLOCK_SIZE)
+
+// Time in milliseconds 'cold_pack' may spend per call, so packing never causes a visible stutter
+#define COLD_PACK_BUDGET_MS 4
+
+// The packed characters of the lines [first_row, first_row + num_lines)
+typedef struct ColdBlock {
+    size_t first_row;
+    size_t num_lines;
+    size_t raw_size;
+    size_t packed_size;
+    char* packed;
+    char* chars;            // Unpacked characters while the block is cached, NULL otherwise
+    Line* lines;            // Its lines, pointing into 'chars', while the block is cached
+    struct ColdBlock* prev; // Towards the most recently used cached block
+    struct ColdBlock* next; // Towards the least recently used cached block
+} ColdBlock;
+
+typedef struct {
+    // Blocks in the order of their rows, which do not overlap
+    size_t capacity;
+    size_t size;
+    ColdBlock** blocks;
+
+    size_t num_cached;
+    ColdBlock* most_recent;
+    ColdBlock* least_recent;
+
+    size_t raw_bytes;       // Characters of the cold lines
+    size_t packed_bytes;    // What they take packed
+
+    // Where 'cold_pack' continues, and what it saw when it last found nothing left to pack
+    size_t scan_row;
+    size_t swept;           // Rows passed since a block was last packed
+    bool settled;
+    size_t settled_num_lines;
+    size_t settled_camera_row;
+    size_t settled_cursor_row;
+
+    size_t scratch_capacity;
+    char* scratch;          // The characters of the block being packed
+    char* packed;           // Room for them packed
+    uint32_t* table;        // Scratch space of the codec
+} ColdStore;
+
+// Unpacks blocks for one thread, for reading cold lines while the main thread uses the cache
+typedef struct {
+    const ColdBlock* block; // The block in 'chars'
+    size_t capacity;
+    char* chars;
+    size_t row;             // A row of the block and where its characters start, for reading the lines in order
+    size_t offset;
+    Line line;
+} ColdReader;
+
+/*
+ *  Purpose: Create an empty store. It should be released with 'cold_free'.
+ *
+ *  Parameters: None.
+ *
+ *  Returns:
+ *    - Pointer to the new ColdStore.
+ */
+ColdStore* cold_create(void);
+
+/*
+ *  Purpose: Check whether a line is cold, i.e. its characters are only in a block.
+ *
+ *  Parameters:
+ *    - line: Pointer to the line.
+ *
+ *  Returns:
+ *    - true if the line has characters but does not hold them.
+ *    - false otherwise.
+ */
+bool cold_is_cold(const Line* line);
+
+/*
+ *  Purpose: Pack runs of lines far from the camera and the cursor into blocks, continuing where the last call
+ *           stopped. The last line is never packed since text is appended to it. Runs next to the kept lines
+ *           or the last line are only packed once they fill a block, as they may still grow.
+ *
+ *  Parameters:
+ *    - store: Pointer to the ColdStore.
+ *    - lines: Pointer to the lines, whose packed characters are freed.
+ *    - num_lines: The number of lines.
+ *    - camera_row: The first line on screen.
+ *    - cursor_row: The line of the cursor.
+ *    - budget_ms: Time in milliseconds the call may take.
+ *
+ *  Returns:
+ *    - true if there may be more to pack.
+ *    - false if a whole sweep over the lines found nothing to pack.
+ */
+bool cold_pack(ColdStore* store, Line* lines, size_t num_lines, size_t camera_row, size_t cursor_row, Uint32 budget_ms);
+
+/*
+ *  Purpose: Get a cold line, unpacking its block into the cache if it is not there. Main thread only.
+ *
+ *  Parameters:
+ *    - store: Pointer to the ColdStore.
+ *    - lines: Pointer to the lines.
+ *    - row: The index of a cold line.
+ *
+ *  Returns:
+ *    - Pointer to the line. It stays valid until the next call, which may evict its block.
+ */
+const Line* cold_get_line(ColdStore* store, const Line* lines, size_t row);
+
+/*
+ *  Purpose: Get a cold line without the cache, so it can be used by any thread while the lines do not change.
+ *
+ *  Parameters:
+ *    - store: Pointer to the ColdStore.
+ *    - lines: Pointer to the lines.
+ *    - row: The index of a cold line.
+ *    - reader: Pointer to a zero-initialized ColdReader of the calling thread, freed with 'cold_reader_free'.
+ *
+ *  Returns:
+ *    - Pointer to the line. It stays valid until the next call with the same reader.
+ */
+const Line* cold_read_line(const ColdStore* store, const Line* lines, size_t row, ColdReader* reader);
+
+/*
+ *  Purpose: Free the characters of a ColdReader.
+ *
+ *  Parameters:
+ *    - reader: Pointer to the ColdReader.
+ *
+ *  Returns: None.
+ */
+void cold_reader_free(ColdReader* reader);
+
+/*
+ *  Purpose: Give the lines of the blocks holding lines [first_row, last_row] their characters back, before the
+ *           lines are edited.
+ *
+ *  Parameters:
+ *    - store: Pointer to the ColdStore.
+ *    - lines: Pointer to the lines.
+ *    - first_row: The index of the first line.
+ *    - last_row: The index of the last line.
+ *
+ *  Returns: None.
+ */
+void cold_thaw(ColdStore* store, Line* lines, size_t first_row, size_t last_row);
+
+/*
+ *  Purpose: Move the blocks from a row on, after lines were inserted or removed before them.
+ *
+ *  Parameters:
+ *    - store: Pointer to the ColdStore.
+ *    - row: The first row of the blocks to move. No block may hold both this line and the one before it.
+ *    - delta: The number of lines inserted (removed if negative).
+ *
+ *  Returns: None.
+ */
+void cold_shift(ColdStore* store, size_t row, ptrdiff_t delta);
+
+/*
+ *  Purpose: Free the blocks and the ColdStore. The cold lines are left without characters.
+ *
+ *  Parameters:
+ *    - store: Pointer to the ColdStore to free.
+ *
+ *  Returns: None.
+ */
+void cold_free(ColdStore* store);
+
+#endif /* COLD_H_ */
@@ -0,0 +1,129 @@
+/*
+ *  Decorations are ranges of text drawn with a background, like selections, search hits and
+ *  diagnostics. They are kept in a treap ordered by start position, where every node also holds the
+ *  furthest end in its subtree, so the decorations touching a range of rows are found in
+ *  O(log n + k). The store follows the changes to the Editor: the decorations after an edit that
+ *  added or removed lines are moved with a lazy row offset on a subtree, only those on the edited
+ *  lines are visited one by one.
+ */
+#ifndef DECORATION_H_
+#define DECORATION_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "editor.h"
+
+#define DECORATION_INIT_CAPACITY 64
+
+typedef enum {
+    DECORATION_SELECTION = 0,
+    DECORATION_SEARCH_HIT,
+    DECORATION_DIAGNOSTIC,
+    DECORATION_KIND_COUNT,
+} DecorationKind;
+
+// The text from (start_row, start_col) up to, but not including, (end_row, end_col)
+typedef struct {
+    size_t start_row;
+    size_t start_col;
+    size_t end_row;
+    size_t end_col;
+    uint8_t kind;
+} Decoration;
+
+// Index 0 of the node pool stands for no node
+typedef struct {
+    Decoration decoration;
+    size_t max_end_row;     // The furthest end of the decorations in the subtree
+    size_t max_end_col;
+    int64_t row_offset;     // Still to be added to the rows of the subtrees below
+    uint32_t left;
+    uint32_t right;
+    uint32_t priority;
+} DecorationNode;
+
+typedef struct {
+    size_t capacity;
+    size_t size;
+    Decoration* decorations;
+} DecorationBuffer;
+
+typedef struct {
+    size_t capacity;
+    size_t size;
+    uint32_t* nodes;
+} DecorationNodeList;
+
+typedef struct {
+    Editor* editor;
+    size_t capacity;
+    size_t size;            // Nodes in the pool, used or free
+    DecorationNode* nodes;
+    uint32_t root;
+    uint32_t free_list;     // Free nodes, chained through 'left'
+    size_t count;
+    uint32_t seed;
+    DecorationBuffer results;
+    DecorationNodeList scratch;
+} DecorationStore;
+
+/*
+ *  Purpose: Create an empty store following the changes to an Editor. The store should be released with
+ *           'decoration_free'.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *
+ *  Returns:
+ *    - Pointer to the new DecorationStore.
+ */
+DecorationStore* decoration_create(Editor* editor);
+
+/*
+ *  Purpose: Add a decoration.
+ *
+ *  Parameters:
+ *    - store: Pointer to the DecorationStore.
+ *    - decoration: The decoration, which must not end before it starts.
+ *
+ *  Returns: None.
+ */
+void decoration_add(DecorationStore* store, Decoration decoration);
+
+/*
+ *  Purpose: Remove every decoration of a kind.
+ *
+ *  Parameters:
+ *    - store: Pointer to the DecorationStore.
+ *    - kind: The DecorationKind to remove.
+ *
+ *  Returns: None.
+ */
+void decoration_clear(DecorationStore* store, DecorationKind kind);
+
+/*
+ *  Purpose: Find the decorations that touch a range of rows.
+ *
+ *  Parameters:
+ *    - store: Pointer to the DecorationStore.
+ *    - first_row: The first row.
+ *    - last_row: The last row (included).
+ *    - count: Pointer set to the number of decorations found.
+ *
+ *  Returns:
+ *    - Pointer to the decorations in order of their start, valid until the next query.
+ */
+const Decoration* decoration_query(DecorationStore* store, size_t first_row, size_t last_row, size_t* count);
+
+/*
+ *  Purpose: Stop following the Editor and free the store.
+ *
+ *  Parameters:
+ *    - store: Pointer to the DecorationStore to free.
+ *
+ *  Returns: None.
+ */
+void decoration_free(DecorationStore* store);
+
+#endif /* DECORATION_H_ */
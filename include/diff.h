@@ -0,0 +1,51 @@
+/*
+ *  Line-level diff between two versions of a text. Lines are compared by a 64-bit hash, the common
+ *  prefix and suffix are skipped and the rest is diffed with Myers' O(ND) algorithm, so the cost is
+ *  small when few lines changed however long the text is.
+ */
+#ifndef DIFF_H_
+#define DIFF_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Past this many inserted plus deleted lines the changed region is reported as a single hunk
+#define DIFF_MAX_EDITS 2048
+// Entries of the Myers trace reserved up front, it grows with the number of edits
+#define DIFF_TRACE_INIT_CAPACITY 1024
+
+// Lines [a_start, a_start + a_count) of the old text are replaced by [b_start, b_start + b_count) of the new one
+typedef struct {
+    size_t a_start;
+    size_t a_count;
+    size_t b_start;
+    size_t b_count;
+} DiffHunk;
+
+/*
+ *  Purpose: Hash a line for 'diff_lines'.
+ *
+ *  Parameters:
+ *    - chars: Pointer to the characters of the line.
+ *    - size: The number of characters.
+ *
+ *  Returns: The 64-bit FNV-1a hash of the characters.
+ */
+uint64_t diff_hash_line(const char* chars, size_t size);
+
+/*
+ *  Purpose: Find the hunks that turn the old lines into the new ones.
+ *
+ *  Parameters:
+ *    - a: Pointer to the hashes of the old lines.
+ *    - a_size: The number of old lines.
+ *    - b: Pointer to the hashes of the new lines.
+ *    - b_size: The number of new lines.
+ *    - num_hunks: Pointer set to the number of hunks.
+ *
+ *  Returns:
+ *    - Pointer to the hunks, in order and not overlapping, to be freed by the caller (NULL if there are none).
+ */
+DiffHunk* diff_lines(const uint64_t* a, size_t a_size, const uint64_t* b, size_t b_size, size_t* num_hunks);
+
+#endif /* DIFF_H_ */
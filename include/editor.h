@@ -7,12 +7,38 @@
 #define EDITOR_H_
 
 #include <stdio.h>
+#include <stdbool.h>
 #include "line.h"
+#include "pager.h"
+#include "cold.h"
+#include "intern.h"
+#include "mem.h"
 
 #define EDITOR_INIT_CAPACITY 128
+#define EDITOR_MAX_LISTENERS 8
+
+// Time in milliseconds 'editor_compact' may spend per call while the window is idle
+#define EDITOR_COMPACT_BUDGET_MS 2
+// Lines shrunk between checks of the clock
+#define EDITOR_COMPACT_CHECK_LINES 4096
 
 // TODO: when saving files, convert TAB_STOP spaces into  a '\t' char to save space, then fix the save file function to correct for this
 
+// The text from (row, col) to (old_end_row, old_end_col) was replaced by text ending at (new_end_row, new_end_col).
+// Lines row..old_end_row became lines row..new_end_row and the lines after them moved. An Editor without
+// lines counts as one empty line, so it gets its first line without a change.
+typedef struct {
+    size_t row;
+    size_t col;
+    size_t old_end_row;
+    size_t old_end_col;
+    size_t new_end_row;
+    size_t new_end_col;
+} EditorChange;
+
+// Called after every change to the text, with the data it was added with
+typedef void (*EditorListener)(void* data, const EditorChange* change);
+
 // Sequence of lines but actually a stretchy buffer as it
 // reallocates as you push more lines onto it
 typedef struct {
@@ -21,8 +47,124 @@ typedef struct {
     Line* lines;
     size_t cursor_row;
     size_t cursor_col;
+    Pager* pager; // Set for read-only files paged from disk, 'lines' is unused then
+    void* mapping; // Set when lines borrow their characters from a mapped snapshot, unmapped by 'editor_free'
+    size_t mapping_size;
+    ColdStore* cold; // Set once lines far from the camera and the cursor were packed, see 'editor_pack_cold_lines'
+    InternPool* intern; // Set when lines share the characters of identical lines, freed by 'editor_free'
+    size_t compact_row; // Where 'editor_compact' continues
+    bool compacted;     // No line was changed since the last full pass of 'editor_compact'
+    Line flat;          // A chunked line joined by 'editor_get_line', until the next change
+    size_t flat_row;
+    EditorListener listeners[EDITOR_MAX_LISTENERS];
+    void* listener_data[EDITOR_MAX_LISTENERS];
+    size_t num_listeners;
 } Editor;
 
+/*
+ *  Purpose: Get a line of the Editor, whether it is in memory or paged from disk.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *    - row: The index of the line, below the size of the Editor.
+ *
+ *  Returns:
+ *    - Pointer to the line. For a paged Editor, a cold line or a chunked line it stays valid until the next call.
+ */
+const Line* editor_get_line(Editor* editor, size_t row);
+
+/*
+ *  Purpose: Get a line of the Editor like 'editor_get_line', leaving a chunked line as it is. Its characters
+ *           are then read with 'line_copy_range', which is how a long line is read without joining it.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *    - row: The index of the line, below the size of the Editor.
+ *
+ *  Returns:
+ *    - Pointer to the line. For a paged Editor or a cold line it stays valid until the next call.
+ */
+const Line* editor_peek_line(Editor* editor, size_t row);
+
+/*
+ *  Purpose: Get a line of an Editor in memory from any thread, while its lines do not change.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *    - row: The index of the line, below the size of the Editor.
+ *    - reader: Pointer to a zero-initialized ColdReader of the calling thread, freed with 'cold_reader_free'.
+ *
+ *  Returns:
+ *    - Pointer to the line. For a cold or a chunked line it stays valid until the next call with the same reader.
+ */
+const Line* editor_read_line(const Editor* editor, size_t row, ColdReader* reader);
+
+/*
+ *  Purpose: Pack a share of the lines far from the camera and the cursor into compressed blocks. Their
+ *           characters are unpacked again when they are read or edited. The lines must not be read by other
+ *           threads while this runs.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *    - camera_row: The first line on screen.
+ *    - budget_ms: Time in milliseconds the call may take.
+ *
+ *  Returns:
+ *    - true if there may be more to pack.
+ *    - false if every line that can be packed is.
+ */
+bool editor_pack_cold_lines(Editor* editor, size_t camera_row, Uint32 budget_ms);
+
+/*
+ *  Purpose: Shrink a share of the lines, and then the array of lines, that have much more room than they use.
+ *           The line of the cursor is left alone as it is likely to grow again. The lines must not be read by
+ *           other threads while this runs.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *    - budget_ms: Time in milliseconds the call may take.
+ *
+ *  Returns:
+ *    - true if there is more to shrink.
+ *    - false if no line was changed since the last full pass.
+ */
+bool editor_compact(Editor* editor, Uint32 budget_ms);
+
+/*
+ *  Purpose: Fill in the slack of the lines and of the array of lines, which are only known to the Editor.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *    - usage: The usage of each subsystem, from 'mem_get_usage'.
+ *
+ *  Returns: None.
+ */
+void editor_memory_usage(const Editor* editor, MemUsage usage[MEM_NUM_SUBSYSTEMS]);
+
+/*
+ *  Purpose: Have a function called after every change to the text of the Editor.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *    - listener: The function to call.
+ *    - data: Pointer passed to the function.
+ *
+ *  Returns: None.
+ */
+void editor_add_listener(Editor* editor, EditorListener listener, void* data);
+
+/*
+ *  Purpose: Stop calling a function added with 'editor_add_listener'.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *    - listener: The function.
+ *    - data: The pointer it was added with.
+ *
+ *  Returns: None.
+ */
+void editor_remove_listener(Editor* editor, EditorListener listener, void* data);
+
 /*
  *  Purpose: Insert a null-terminated string before the cursor position in the Editor's current line.
  *
@@ -124,6 +266,34 @@ void editor_tab(Editor* editor);
  */
 void editor_save_to_file(const Editor* editor, const char* file_path);
 
+/*
+ *  Purpose: Split a chunk of text on newlines and append it to the end of the Editor. Chunks can split lines
+ *           anywhere, the text before the first newline of a chunk continues the last line if the previous
+ *           chunk did not end with one.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure to append to.
+ *    - chunk: Pointer to the text to append (not null-terminated).
+ *    - chunk_size: The number of characters in the chunk.
+ *    - new_line: Pointer to whether the chunk starts a new line. Set to true before the first chunk, it is
+ *                updated to whether the next chunk starts a new line.
+ *
+ *  Returns: None.
+ */
+void editor_append_chunk(Editor* editor, char* chunk, size_t chunk_size, bool* new_line);
+
+/*
+ *  Purpose: Move lines to the end of the Editor. The Editor takes ownership of their characters.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure to append to.
+ *    - lines: Pointer to the lines to move.
+ *    - num_lines: The number of lines to move.
+ *
+ *  Returns: None.
+ */
+void editor_append_lines(Editor* editor, const Line* lines, size_t num_lines);
+
 /*
  *  Purpose: Load text data from a file and populate the Editor with its contents.
  *
@@ -135,6 +305,18 @@ void editor_save_to_file(const Editor* editor, const char* file_path);
  */
 void editor_load_from_file(Editor* editor, FILE* fp);
 
+/*
+ *  Purpose: Bring the Editor up to date with a new version of its file. Only the lines that differ are
+ *           replaced, the others (and what is attached to them) are kept and the cursor stays on its line.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure holding the old version.
+ *    - fp: File pointer to the file from which to read the new version.
+ *
+ *  Returns: The number of lines that were replaced, inserted or removed.
+ */
+size_t editor_reload_from_file(Editor* editor, FILE* fp);
+
 /*
  *  Purpose: Free the memory allocated for the Editor's lines and associated data.
  *
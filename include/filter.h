@@ -0,0 +1,161 @@
+/*
+ *  Filtered view, showing only the lines that contain a pattern while the whole text stays in the
+ *  Editor. Which lines match is kept in a bitmap with one bit per line, and the number of matches before
+ *  every block of the bitmap, so a row on screen is mapped to its line (select) and a line to its row
+ *  (rank) without copying any line. The bitmap is built on the job system, chunk by chunk with the one on
+ *  screen first, and then follows the changes to the Editor: the lines of a change are matched again and
+ *  the bits after it are moved a word at a time. The Editor must not change while the bitmap is built,
+ *  'filter_finish' waits for it before an edit.
+ */
+#ifndef FILTER_H_
+#define FILTER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "editor.h"
+#include "jobs.h"
+
+#define FILTER_PATTERN_CAPACITY 256
+#define FILTER_CHUNK_LINES 16384            // A multiple of 64, so every chunk fills whole words
+#define FILTER_CANCEL_CHECK_LINES 1024
+#define FILTER_BLOCK_WORDS 8                // Words of the bitmap counted by one entry of the rank directory
+#define FILTER_BLOCK_LINES (FILTER_BLOCK_WORDS * 64)
+
+typedef struct {
+    Editor* editor;
+    JobSystem* jobs;
+    char pattern[FILTER_PATTERN_CAPACITY];
+    size_t pattern_size;
+
+    // One bit per line, set for the lines that match. The bits past the last line are 0.
+    size_t capacity;        // In words, a multiple of FILTER_BLOCK_WORDS
+    size_t num_lines;
+    uint64_t* bits;
+
+    // The matches before each block ('capacity' / FILTER_BLOCK_WORDS + 1 entries), right up to 'ranks_valid'
+    size_t* ranks;
+    size_t ranks_valid;
+
+    // The build on the workers
+    JobToken* token;
+    size_t num_chunks;
+    size_t chunks_left;     // Chunks not completed yet
+} FilterView;
+
+/*
+ *  Purpose: Start filtering the lines of an Editor, which is followed through its changes. The view should be
+ *           released with 'filter_free'. Main thread only.
+ *
+ *  Parameters:
+ *    - jobs: Pointer to the JobSystem building the bitmap.
+ *    - editor: Pointer to the Editor, which must not be paged.
+ *    - pattern: Pointer to the characters a line must contain to be shown (not null-terminated).
+ *    - size: The number of characters, from 1 to FILTER_PATTERN_CAPACITY.
+ *    - first_row: The first line on screen, whose chunk is matched first.
+ *
+ *  Returns:
+ *    - Pointer to the new FilterView.
+ */
+FilterView* filter_create(JobSystem* jobs, Editor* editor, const char* pattern, size_t size, size_t first_row);
+
+/*
+ *  Purpose: Check whether chunks of the bitmap are still to be built. The lines of chunks not completed yet
+ *           are not shown.
+ *
+ *  Parameters:
+ *    - view: Pointer to the FilterView.
+ *
+ *  Returns:
+ *    - true while the bitmap is built.
+ *    - false once every chunk was completed.
+ */
+bool filter_building(const FilterView* view);
+
+/*
+ *  Purpose: Wait until the whole bitmap is built, so the Editor can change.
+ *
+ *  Parameters:
+ *    - view: Pointer to the FilterView.
+ *
+ *  Returns: None.
+ */
+void filter_finish(FilterView* view);
+
+/*
+ *  Purpose: Check whether a line is shown.
+ *
+ *  Parameters:
+ *    - view: Pointer to the FilterView.
+ *    - row: The index of the line.
+ *
+ *  Returns:
+ *    - true if the line contains the pattern.
+ *    - false otherwise.
+ */
+bool filter_matches(const FilterView* view, size_t row);
+
+/*
+ *  Purpose: Get how many rows the lines shown take on screen.
+ *
+ *  Parameters:
+ *    - view: Pointer to the FilterView.
+ *
+ *  Returns: The number of lines that match.
+ */
+size_t filter_num_rows(FilterView* view);
+
+/*
+ *  Purpose: Find the line shown on a row of the screen (select).
+ *
+ *  Parameters:
+ *    - view: Pointer to the FilterView.
+ *    - visible_row: The row, counted over the lines that match.
+ *
+ *  Returns: The index of the line, the size of the Editor for a row past the last match.
+ */
+size_t filter_line_at(FilterView* view, size_t visible_row);
+
+/*
+ *  Purpose: Find the row of the screen a line is shown on (rank). A line that does not match is on the row
+ *           of the next one that does.
+ *
+ *  Parameters:
+ *    - view: Pointer to the FilterView.
+ *    - row: The index of the line.
+ *
+ *  Returns: The number of lines that match before it.
+ */
+size_t filter_row_of(FilterView* view, size_t row);
+
+/*
+ *  Purpose: Move the cursor up to the line above that matches, like 'editor_up_arrow'.
+ *
+ *  Parameters:
+ *    - view: Pointer to the FilterView.
+ *
+ *  Returns: None.
+ */
+void filter_up_arrow(FilterView* view);
+
+/*
+ *  Purpose: Move the cursor down to the line below that matches, like 'editor_down_arrow'.
+ *
+ *  Parameters:
+ *    - view: Pointer to the FilterView.
+ *
+ *  Returns: None.
+ */
+void filter_down_arrow(FilterView* view);
+
+/*
+ *  Purpose: Stop the build and following the Editor, and free the view.
+ *
+ *  Parameters:
+ *    - view: Pointer to the FilterView to free.
+ *
+ *  Returns: None.
+ */
+void filter_free(FilterView* view);
+
+#endif /* FILTER_H_ */
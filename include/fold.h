@@ -0,0 +1,189 @@
+/*
+ *  Code folding. A fold hides the lines of an indented block under the line that opens it. The folds
+ *  are kept in a treap ordered by their first hidden line, where every node also holds how many lines
+ *  its subtree hides, so a row on screen is mapped to its line, and a line to its row on screen, in
+ *  O(log n) however many lines are folded. The store follows the changes to the Editor: the folds after
+ *  an edit that added or removed lines are moved with a lazy row offset on a subtree, and a fold whose
+ *  hidden lines were edited is opened. Blocks are found in a cache of the indentation of every line, kept
+ *  through the same changes, with the least indentation of every FOLD_INDENT_BLOCK_LINES lines, so the
+ *  runs of lines deeper than a block are skipped without reading them.
+ */
+#ifndef FOLD_H_
+#define FOLD_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "editor.h"
+
+#define FOLD_INIT_CAPACITY 64
+#define FOLD_INDENT_BLOCK_LINES 64          // Lines summed up by one entry of the block index
+#define FOLD_BLANK UINT16_MAX               // The indentation cached for a blank line, deeper than any other
+
+// Index 0 of the node pool stands for no node
+typedef struct {
+    size_t first_row;       // The first hidden line, the one above it opens the fold
+    size_t last_row;        // The last hidden line
+    size_t hidden_rows;     // The lines hidden by the folds in the subtree
+    int64_t row_offset;     // Still to be added to the rows of the subtrees below
+    uint32_t left;
+    uint32_t right;
+    uint32_t priority;
+} FoldNode;
+
+typedef struct {
+    Editor* editor;
+    size_t capacity;
+    size_t size;            // Nodes in the pool, used or free
+    FoldNode* nodes;
+    uint32_t root;
+    uint32_t free_list;     // Free nodes, chained through 'left'
+    size_t count;
+    uint32_t seed;
+
+    // The indentation of every line in memory, FOLD_BLANK for a blank one and at most FOLD_BLANK - 1
+    size_t indent_capacity;
+    size_t num_indents;
+    uint16_t* indents;
+
+    // The least indentation of each block of FOLD_INDENT_BLOCK_LINES lines, right up to 'blocks_valid'
+    uint16_t* block_mins;
+    size_t blocks_valid;
+} FoldStore;
+
+/*
+ *  Purpose: Create an empty store following the changes to an Editor. The store should be released with
+ *           'fold_free'. Main thread only.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *
+ *  Returns:
+ *    - Pointer to the new FoldStore.
+ */
+FoldStore* fold_create(Editor* editor);
+
+/*
+ *  Purpose: Hide a range of lines. Folds it overlaps are merged into it.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *    - first_row: The first line to hide, above 0 since the line above opens the fold.
+ *    - last_row: The last line to hide, below the size of the Editor.
+ *
+ *  Returns: None.
+ */
+void fold_add(FoldStore* store, size_t first_row, size_t last_row);
+
+/*
+ *  Purpose: Fold the indented block at the cursor, or open the fold under the line of the cursor. The
+ *           block is the lines under the cursor's line indented deeper than it, or the block the cursor is
+ *           in when there are none. Blank lines count as part of a block unless they end it. The cursor
+ *           moves to the line opening the fold if it would be hidden.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *
+ *  Returns:
+ *    - true if a fold was added or opened.
+ *    - false if the cursor is in no block.
+ */
+bool fold_toggle(FoldStore* store);
+
+/*
+ *  Purpose: Open the fold hiding a line, if there is one.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *    - row: The index of the line.
+ *
+ *  Returns:
+ *    - true if a fold was opened.
+ *    - false otherwise.
+ */
+bool fold_reveal(FoldStore* store, size_t row);
+
+/*
+ *  Purpose: Open every fold.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *
+ *  Returns: None.
+ */
+void fold_clear(FoldStore* store);
+
+/*
+ *  Purpose: Get how many rows the lines of the Editor take on screen.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *
+ *  Returns: The number of lines that are not hidden.
+ */
+size_t fold_num_rows(const FoldStore* store);
+
+/*
+ *  Purpose: Find the line shown on a row of the screen.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *    - visible_row: The row, counted without the hidden lines.
+ *
+ *  Returns: The index of the line, past the last one for a row past the end of the text.
+ */
+size_t fold_line_at(FoldStore* store, size_t visible_row);
+
+/*
+ *  Purpose: Find the row of the screen a line is shown on. A hidden line is on the row of the line opening its fold.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *    - row: The index of the line.
+ *
+ *  Returns: The row, counted without the hidden lines.
+ */
+size_t fold_row_of(FoldStore* store, size_t row);
+
+/*
+ *  Purpose: Get how many lines are folded under a line.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *    - row: The index of the line.
+ *
+ *  Returns: The number of lines hidden right under it, 0 if it opens no fold.
+ */
+size_t fold_hidden_after(FoldStore* store, size_t row);
+
+/*
+ *  Purpose: Move the cursor up to the line above that is not hidden, like 'editor_up_arrow'.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *
+ *  Returns: None.
+ */
+void fold_up_arrow(FoldStore* store);
+
+/*
+ *  Purpose: Move the cursor down to the line below that is not hidden, like 'editor_down_arrow'.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *
+ *  Returns: None.
+ */
+void fold_down_arrow(FoldStore* store);
+
+/*
+ *  Purpose: Stop following the Editor and free the store.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore to free.
+ *
+ *  Returns: None.
+ */
+void fold_free(FoldStore* store);
+
+#endif /* FOLD_H_ */
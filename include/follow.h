@@ -0,0 +1,60 @@
+/*
+ *  Follow mode, like 'tail -f'. Bytes appended to the open file by another process are read from the
+ *  offset where the last read stopped and added to the end of the Editor, so an update costs time in
+ *  proportion to the bytes appended and the lines already in the Editor are not touched.
+ */
+#ifndef FOLLOW_H_
+#define FOLLOW_H_
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "editor.h"
+#include "watch.h"
+
+#define FOLLOW_CHUNK_SIZE (64 * 1024)
+
+typedef struct {
+    FILE* fp;
+    Watch* watch;
+    unsigned long long inode; // The file being read, a different one at the path means it was rotated
+    size_t offset;            // Bytes of the file already in the Editor
+    bool new_line;            // Whether the next byte starts a new line
+} Follower;
+
+/*
+ *  Purpose: Start following a file whose first bytes are already in the Editor. The follower should be
+ *           released with 'follow_free'.
+ *
+ *  Parameters:
+ *    - file_path: Null-terminated path to the file.
+ *    - offset: The number of bytes of the file already loaded into the Editor.
+ *
+ *  Returns:
+ *    - Pointer to the new Follower.
+ *    - NULL if the file cannot be opened (the reason is printed to stderr).
+ */
+Follower* follow_start(const char* file_path, size_t offset);
+
+/*
+ *  Purpose: Append what was written to the file since the last call to the Editor, without blocking on the watch.
+ *           If the file was truncated or replaced, it is followed again from its start.
+ *
+ *  Parameters:
+ *    - follower: Pointer to the Follower.
+ *    - editor: Pointer to the Editor structure the file is loaded into.
+ *
+ *  Returns: The number of bytes appended.
+ */
+size_t follow_poll(Follower* follower, Editor* editor);
+
+/*
+ *  Purpose: Stop following the file and free the Follower.
+ *
+ *  Parameters:
+ *    - follower: Pointer to the Follower to free.
+ *
+ *  Returns: None.
+ */
+void follow_free(Follower* follower);
+
+#endif /* FOLLOW_H_ */
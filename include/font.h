@@ -4,6 +4,7 @@
 #ifndef FONT_H_
 #define FONT_H_
 
+#include <stdbool.h>
 #include "SDL.h"
 
 // The displayable characters
@@ -17,11 +18,52 @@
 #define POINT_SIZE 32
 
 #define FONT_SCALE 1.0f
+
+// Rasterized atlases are cached in $XDG_CACHE_HOME/med (or ~/.cache/med)
+#define FONT_CACHE_MAGIC "MEDATLS1"
+
 typedef struct {
   SDL_Texture* spritesheet;
   SDL_Rect glyphs[NUM_GLYPHS];
 } Font;
 
+// The CPU side of a font, before it is uploaded to a renderer
+typedef struct {
+  SDL_Surface* surface;         // BGRA32 pixels of the atlas
+  SDL_Rect glyphs[NUM_GLYPHS];
+  void* mapping;                // The mapped cache file the pixels live in (NULL if rasterized)
+  size_t mapping_size;
+  bool from_cache;
+} FontAtlas;
+
+/*
+ *  Purpose: Produce the CPU side of a font: the pixels of its atlas and the glyph positions. This does not touch
+ *           the renderer, so it can run on a worker thread (after 'TTF_Init') while the window is created.
+ *
+ *  Parameters:
+ *    - file_path: Path to the TrueType Font (TTF) file.
+ *    - use_cache: Whether to take the atlas from the on-disk cache when it matches the font file (path,
+ *                 modification time, point size and scale). On a miss the font is rasterized and the cache
+ *                 is written for the next start.
+ *
+ *  Returns:
+ *    - A FontAtlas structure, to be turned into a Font with 'font_create'.
+ */
+FontAtlas* font_atlas_load(const char* file_path, bool use_cache);
+
+/*
+ *  Purpose: Upload an atlas into a texture on the renderer. The atlas is freed. The font should be released
+ *           with 'font_free_ttf' when no longer needed.
+ *
+ *  Parameters:
+ *    - renderer: The SDL renderer to create the font texture on.
+ *    - atlas: Pointer to the FontAtlas made by 'font_atlas_load'.
+ *
+ *  Returns:
+ *    - A Font structure containing the font texture and glyphs position.
+ */
+Font* font_create(SDL_Renderer* renderer, FontAtlas* atlas);
+
 /*
  *  Purpose: Load a font from a TrueType Font (TTF) file. The font should be released
  *           with 'font_free_ttf' when no longer needed.
@@ -0,0 +1,187 @@
+/*
+ *  Render thread. The main thread handles the input and edits, then captures what is on screen (the
+ *  visible lines with their colors and decorations, the cursor and the camera) into an immutable
+ *  snapshot published through a lock-free single-producer single-consumer ring. The render thread owns
+ *  the SDL renderer and draws the newest snapshot, so a slow frame never holds up the edits and the
+ *  edits never hold up a frame. When the ring is full the main thread keeps editing and captures again
+ *  on its next pass, and frames the render thread fell behind on are skipped.
+ */
+#ifndef FRAME_H_
+#define FRAME_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "SDL.h"
+#include "editor.h"
+#include "line.h"
+#include "highlight.h"
+#include "decoration.h"
+#include "camera.h"
+#include "font.h"
+#include "render.h"
+#include "wrap.h"
+#include "fold.h"
+#include "filter.h"
+#include "vec.h"
+
+// A power of two, so the slot of a frame counter stays the same when the counter wraps around
+#define FRAME_RING_SIZE 4
+#define FRAME_INIT_CAPACITY 64
+#define FRAME_STATUS_CAPACITY 64
+
+// A visual row on screen, the columns of a line in view unless lines are wrapped. Its characters and runs are
+// stored in the FrameSnapshot, the runs start from its first column.
+typedef struct {
+    size_t line;            // The index of its line
+    size_t start_col;       // The column of the line it starts at
+    size_t screen_col;      // The column on screen it is drawn from, 0 for wrapped rows
+    bool ends_line;         // Whether it is the last row of its line
+    bool folded;            // Whether lines are folded under its line
+    size_t text_offset;
+    size_t size;
+    size_t first_run;
+    size_t num_runs;
+} FrameRow;
+
+typedef struct {
+    // The visual rows on screen, from 'first_row'
+    size_t first_row;
+    size_t rows_capacity;
+    size_t num_rows;
+    FrameRow* rows;
+    size_t text_capacity;
+    size_t text_size;
+    char* text;
+    size_t runs_capacity;
+    size_t num_runs;
+    HighlightRun* runs;
+    size_t decorations_capacity;
+    size_t num_decorations;
+    Decoration* decorations;
+
+    size_t cursor_row;      // The visual row of the cursor and its column on it
+    size_t cursor_col;
+    bool cursor_visible;
+    CursorShape cursor_shape;
+    Vec2f camera_pos;
+    char status[FRAME_STATUS_CAPACITY];     // Empty when there is no status to show
+
+    // Time spent by the main thread on the input and the camera for this frame
+    Uint64 events_start;
+    Uint64 events_end;
+    Uint64 camera_start;
+    Uint64 camera_end;
+
+    // Done by the render thread, even if the frame itself is skipped
+    bool toggle_overlay;
+    const char* trace_path;                 // Where to export the frame trace (NULL for none)
+    bool print_startup_trace;
+} FrameSnapshot;
+
+typedef struct {
+    SDL_Window* window;
+    SDL_Thread* font_loader;
+    FontAtlas** atlas;
+    SDL_Thread* thread;
+
+    // Frames are counted from the start, frames [read, write) are published and each is in slot counter % FRAME_RING_SIZE
+    FrameSnapshot slots[FRAME_RING_SIZE];
+    SDL_atomic_t read;      // Written by the render thread
+    SDL_atomic_t write;     // Written by the main thread
+    SDL_sem* published;     // Wakes the render thread, the ring itself takes no lock
+    SDL_atomic_t quit;
+} FrameThread;
+
+/*
+ *  Purpose: Capture the lines on screen and the cursor into a snapshot. The other fields are left as they are.
+ *
+ *  Parameters:
+ *    - frame: Pointer to the FrameSnapshot, whose buffers are reused.
+ *    - editor: Pointer to the Editor structure.
+ *    - highlighter: Pointer to the Highlighter coloring the text (can be NULL).
+ *    - decorations: Pointer to the DecorationStore (can be NULL).
+ *    - wrap: Pointer to the WrapLayout when lines are wrapped, the camera is then placed in visual rows (NULL otherwise).
+ *    - folds: Pointer to the FoldStore hiding lines, the camera is then placed in rows without them (can be
+ *             NULL, and is not used when lines are wrapped or filtered).
+ *    - filter: Pointer to the FilterView when only matching lines are shown, the camera is then placed in rows
+ *              of those (NULL otherwise, and not used when lines are wrapped).
+ *    - window: Pointer to the SDL window to determine screen dimensions.
+ *    - camera: Pointer to the Camera, already updated for this frame.
+ *
+ *  Returns: None.
+ */
+void frame_capture(FrameSnapshot* frame, Editor* editor, Highlighter* highlighter, DecorationStore* decorations, WrapLayout* wrap, FoldStore* folds, FilterView* filter, SDL_Window* window, const Camera* camera);
+
+/*
+ *  Purpose: Draw a snapshot and present it. Called by the thread that owns the renderer, the render thread
+ *           when there is one.
+ *
+ *  Parameters:
+ *    - renderer: Pointer to the SDL renderer.
+ *    - font: Pointer to the Font.
+ *    - window: Pointer to the SDL window.
+ *    - frame: Pointer to the FrameSnapshot.
+ *
+ *  Returns: None.
+ */
+void frame_render(SDL_Renderer* renderer, const Font* font, SDL_Window* window, const FrameSnapshot* frame);
+
+/*
+ *  Purpose: Free the buffers of a snapshot.
+ *
+ *  Parameters:
+ *    - frame: Pointer to the FrameSnapshot, which can be captured into again afterwards.
+ *
+ *  Returns: None.
+ */
+void frame_free(FrameSnapshot* frame);
+
+/*
+ *  Purpose: Start the render thread, which creates the renderer for the window and uploads the font once it is
+ *           loaded. The thread should be stopped with 'frame_thread_stop'.
+ *
+ *  Parameters:
+ *    - window: Pointer to the SDL window.
+ *    - font_loader: Pointer to the thread loading the font atlas.
+ *    - atlas: Pointer set to the FontAtlas by the font loader before it finishes.
+ *
+ *  Returns:
+ *    - Pointer to the new FrameThread.
+ */
+FrameThread* frame_thread_start(SDL_Window* window, SDL_Thread* font_loader, FontAtlas** atlas);
+
+/*
+ *  Purpose: Get the next free slot of the ring, to be filled and published with 'frame_thread_publish'.
+ *           Called by the main thread only.
+ *
+ *  Parameters:
+ *    - frames: Pointer to the FrameThread.
+ *
+ *  Returns:
+ *    - Pointer to the FrameSnapshot to fill.
+ *    - NULL if the render thread has not caught up with the ring yet.
+ */
+FrameSnapshot* frame_thread_acquire(FrameThread* frames);
+
+/*
+ *  Purpose: Hand the slot returned by 'frame_thread_acquire' over to the render thread.
+ *
+ *  Parameters:
+ *    - frames: Pointer to the FrameThread.
+ *
+ *  Returns: None.
+ */
+void frame_thread_publish(FrameThread* frames);
+
+/*
+ *  Purpose: Stop the render thread once it has drawn the published frames, destroy the renderer and free the
+ *           FrameThread.
+ *
+ *  Parameters:
+ *    - frames: Pointer to the FrameThread to stop.
+ *
+ *  Returns: None.
+ */
+void frame_thread_stop(FrameThread* frames);
+
+#endif /* FRAME_H_ */
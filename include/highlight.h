@@ -0,0 +1,182 @@
+/*
+ *  Incremental syntax highlighting for C-like sources. The lexer state at the end of every line is
+ *  kept, so a line can be lexed on its own from the state of the line above. After an edit only the
+ *  changed lines are lexed again, then the lines after them until one ends in the state it ended in
+ *  before the edit. The color runs of a line are cached until its text or incoming state changes.
+ *  The first pass over a large file is split into chunks lexed by worker threads, each from a guessed
+ *  state, and the chunks whose guess was wrong are lexed again from their first line until they agree.
+ */
+#ifndef HIGHLIGHT_H_
+#define HIGHLIGHT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "editor.h"
+#include "line.h"
+#include "SDL.h"
+
+// Smaller files are lexed as they are drawn, which is fast enough without a pass
+#define HIGHLIGHT_PASS_MIN_LINES 65536
+#define HIGHLIGHT_PASS_MIN_CHUNK_LINES 4096
+#define HIGHLIGHT_PASS_CHUNKS_PER_THREAD 8
+#define HIGHLIGHT_PASS_MAX_THREADS 64
+
+// Longer lines are left uncolored, they would be lexed whole again on every edit
+#define HIGHLIGHT_MAX_LINE_SIZE LINE_CHUNK_THRESHOLD
+
+// What a run of text is colored as
+typedef enum {
+    HIGHLIGHT_NORMAL = 0,
+    HIGHLIGHT_KEYWORD,
+    HIGHLIGHT_TYPE,
+    HIGHLIGHT_STRING,
+    HIGHLIGHT_NUMBER,
+    HIGHLIGHT_COMMENT,
+    HIGHLIGHT_PREPROCESSOR,
+    HIGHLIGHT_KIND_COUNT,
+} HighlightKind;
+
+// The lexer state between two lines
+typedef enum {
+    HIGHLIGHT_STATE_NORMAL = 0,
+    HIGHLIGHT_STATE_COMMENT,      // Inside a block comment
+    HIGHLIGHT_STATE_STRING,       // Inside a string continued with a backslash
+    HIGHLIGHT_STATE_PREPROCESSOR, // Inside a directive continued with a backslash
+} HighlightState;
+
+// Characters [start, start + size) of a line, text outside of runs is HIGHLIGHT_NORMAL
+typedef struct {
+    uint32_t start;
+    uint32_t size;
+    uint8_t kind;
+} HighlightRun;
+
+typedef struct {
+    HighlightRun* runs;   // Cached runs, valid if 'has_runs'
+    uint32_t num_runs;
+    uint8_t state;        // The HighlightState at the end of the line
+    bool has_runs;
+} HighlightLine;
+
+typedef struct {
+    size_t capacity;
+    size_t size;
+    HighlightRun* runs;
+} HighlightRunBuffer;
+
+// A first pass over the lines, lexed by worker threads chunk by chunk. The lines must not change while it runs.
+typedef struct {
+    const Editor* editor;
+    SDL_Thread* threads[HIGHLIGHT_PASS_MAX_THREADS];
+    size_t num_threads;
+    uint8_t* states;            // The state at the end of each line, lexed from HIGHLIGHT_STATE_NORMAL at the start of its chunk
+    size_t num_lines;
+    size_t chunk_lines;
+    size_t num_chunks;
+    size_t first_chunk;         // Chunks are taken from this one on, wrapping around, so the visible lines come first
+    SDL_atomic_t next;          // The number of chunks taken
+    SDL_atomic_t* chunk_done;   // Set once the states of a chunk are written
+    SDL_atomic_t chunks_done;
+    SDL_atomic_t lines_lexed;
+    int chunks_seen;            // By 'highlight_poll'
+} HighlightPass;
+
+typedef struct {
+    Editor* editor;
+    size_t capacity;
+    size_t size;                // One entry per line of the Editor (at least 1)
+    HighlightLine* lines;
+    size_t valid_end;           // The states of lines [0, valid_end) are up to date
+    size_t resume_start;        // The states of lines [resume_start, resume_end) date from before the last edit and
+    size_t resume_end;          // still hold if the line above them ends as it did, which stops the lexing there
+    HighlightRunBuffer scratch;
+    size_t lines_lexed;         // Since the Highlighter was created
+    HighlightPass* pass;        // Set while a first pass runs, the lines after 'valid_end' are drawn from its chunks
+} Highlighter;
+
+/*
+ *  Purpose: Check whether a file is a source the highlighter understands, by its extension.
+ *
+ *  Parameters:
+ *    - file_path: Null-terminated path to the file.
+ *
+ *  Returns:
+ *    - true for C and C++ sources and headers.
+ *    - false otherwise.
+ */
+bool highlight_supports(const char* file_path);
+
+/*
+ *  Purpose: Start highlighting the lines of an Editor, which is followed through its changes. Nothing is lexed
+ *           until runs are asked for. The highlighter should be released with 'highlight_free'.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure, which must not be paged.
+ *
+ *  Returns:
+ *    - Pointer to the new Highlighter.
+ */
+Highlighter* highlight_create(Editor* editor);
+
+/*
+ *  Purpose: Get the color runs of a line, lexing the lines above it whose state is out of date first.
+ *
+ *  Parameters:
+ *    - highlighter: Pointer to the Highlighter.
+ *    - row: The index of the line, below the size of the Editor.
+ *    - num_runs: Pointer set to the number of runs.
+ *
+ *  Returns:
+ *    - Pointer to the runs, in order and not overlapping, valid until the next call or change to the Editor.
+ */
+const HighlightRun* highlight_get_runs(Highlighter* highlighter, size_t row, size_t* num_runs);
+
+/*
+ *  Purpose: Start lexing every line of a large file on worker threads. The lines of the Editor must not change
+ *           until the pass is finished by 'highlight_poll' or 'highlight_finish_pass'. Does nothing for files
+ *           under HIGHLIGHT_PASS_MIN_LINES lines or whose lines are already up to date.
+ *
+ *  Parameters:
+ *    - highlighter: Pointer to the Highlighter.
+ *    - first_row: The first visible line, whose chunk is lexed first.
+ *    - num_threads: The number of worker threads (at most HIGHLIGHT_PASS_MAX_THREADS).
+ *
+ *  Returns: None.
+ */
+void highlight_start_pass(Highlighter* highlighter, size_t first_row, size_t num_threads);
+
+/*
+ *  Purpose: Check on the first pass without blocking, and finish it once every chunk is lexed.
+ *
+ *  Parameters:
+ *    - highlighter: Pointer to the Highlighter.
+ *
+ *  Returns:
+ *    - true if chunks were lexed since the last call, so the colors on screen may change.
+ *    - false otherwise.
+ */
+bool highlight_poll(Highlighter* highlighter);
+
+/*
+ *  Purpose: Wait for the first pass, if one runs, and correct the chunks lexed from a wrong state.
+ *           Must be called before the lines of the Editor change.
+ *
+ *  Parameters:
+ *    - highlighter: Pointer to the Highlighter.
+ *
+ *  Returns: None.
+ */
+void highlight_finish_pass(Highlighter* highlighter);
+
+/*
+ *  Purpose: Stop following the Editor and free the Highlighter.
+ *
+ *  Parameters:
+ *    - highlighter: Pointer to the Highlighter to free.
+ *
+ *  Returns: None.
+ */
+void highlight_free(Highlighter* highlighter);
+
+#endif /* HIGHLIGHT_H_ */
@@ -0,0 +1,106 @@
+/*
+ *  Interning of lines, for files with many identical lines such as logs and generated code. Every distinct
+ *  line is stored once in a pool of immutable strings, found again through a hash table, and the lines
+ *  borrow their characters from it. A borrowed line copies its characters before it is edited, so the
+ *  shared string never changes and the lines are read and drawn like any other.
+ */
+#ifndef INTERN_H_
+#define INTERN_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "line.h"
+
+// Slots of the hash table, a power of two
+#define INTERN_INIT_CAPACITY 1024
+#define INTERN_INIT_BLOCKS 16
+
+// Strings are stored back to back in blocks, longer ones get a block of their own
+#define INTERN_BLOCK_SIZE (64 * 1024)
+#define INTERN_MAX_PACKED_SIZE (INTERN_BLOCK_SIZE / 4)
+
+typedef struct {
+    uint64_t hash;
+    size_t size;
+    const char* chars; // NULL for an empty slot
+} InternEntry;
+
+typedef struct {
+    // Open addressing with linear probing, kept at most half full
+    size_t capacity;
+    size_t size;
+    InternEntry* entries;
+
+    size_t blocks_capacity;
+    size_t num_blocks;
+    char** blocks;
+    size_t block_used;      // Characters used in the last packed block
+    char* block;            // The last packed block, NULL before the first string
+
+    size_t num_lines;       // Lines interned
+    size_t line_bytes;      // Their characters
+    size_t string_bytes;    // Characters of the distinct strings
+    size_t block_bytes;     // Allocated for the strings
+} InternPool;
+
+/*
+ *  Purpose: Create an empty pool. It should be released with 'intern_free', once no line borrows from it.
+ *           A pool is used by one thread at a time.
+ *
+ *  Parameters: None.
+ *
+ *  Returns:
+ *    - Pointer to the new InternPool.
+ */
+InternPool* intern_create(void);
+
+/*
+ *  Purpose: Get the shared copy of a string, storing it in the pool the first time it is seen.
+ *
+ *  Parameters:
+ *    - pool: Pointer to the InternPool.
+ *    - chars: Pointer to the characters (not null-terminated).
+ *    - size: The number of characters.
+ *
+ *  Returns:
+ *    - Pointer to the shared characters, which stay valid and unchanged until the pool is freed.
+ */
+const char* intern_string(InternPool* pool, const char* chars, size_t size);
+
+/*
+ *  Purpose: Replace the characters of a line with their shared copy. Empty, borrowed, cold and chunked lines
+ *           are left as they are.
+ *
+ *  Parameters:
+ *    - pool: Pointer to the InternPool.
+ *    - line: Pointer to the line, whose own characters are freed.
+ *
+ *  Returns:
+ *    - true if the line now borrows from the pool.
+ *    - false otherwise.
+ */
+bool intern_line(InternPool* pool, Line* line);
+
+/*
+ *  Purpose: Get how many times over the interned lines are held by the pool's strings.
+ *
+ *  Parameters:
+ *    - pool: Pointer to the InternPool.
+ *
+ *  Returns:
+ *    - The characters of the interned lines over those of the distinct strings, 1 for an empty pool.
+ */
+double intern_dedupe_ratio(const InternPool* pool);
+
+/*
+ *  Purpose: Free the strings and the InternPool. No line may borrow from it any more.
+ *
+ *  Parameters:
+ *    - pool: Pointer to the InternPool to free.
+ *
+ *  Returns: None.
+ */
+void intern_free(InternPool* pool);
+
+#endif /* INTERN_H_ */
@@ -0,0 +1,182 @@
+/*
+ *  Job system for background work. Each worker thread has a deque per priority: it takes its newest job
+ *  from the bottom of its own and, when that is empty, steals the oldest one from the top of another
+ *  worker's, so the work spreads over the threads without a shared queue. Every worker drains the higher
+ *  priorities of all deques before the lower ones, so the work for what is on screen goes first.
+ *  Finished jobs are pushed onto a lock-free stack that the main thread drains each frame, which is
+ *  where their results are handed over to the rest of the editor.
+ */
+#ifndef JOBS_H_
+#define JOBS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "SDL.h"
+
+#define JOBS_MAX_WORKERS 64
+#define JOBS_DEQUE_INIT_CAPACITY 64
+
+typedef enum {
+    JOB_PRIORITY_VISIBLE = 0, // Work for the lines on screen
+    JOB_PRIORITY_NORMAL,
+    JOB_PRIORITY_IDLE,
+    JOB_PRIORITY_COUNT,
+} JobPriority;
+
+// Shared by the jobs of one task, so it can be cancelled as a whole
+typedef struct {
+    SDL_atomic_t cancelled;
+    SDL_atomic_t pending;   // Jobs submitted that have not finished running yet
+    SDL_atomic_t refs;      // The owner, and the jobs not completed on the main thread yet
+} JobToken;
+
+// Runs on a worker, should return early once 'jobs_cancelled' is true for the token
+typedef void (*JobRun)(void* data, JobToken* token);
+
+// Runs on the main thread in 'jobs_drain', also for jobs that were skipped because they were cancelled
+typedef void (*JobComplete)(void* data, bool cancelled);
+
+typedef struct Job {
+    JobRun run;
+    JobComplete complete;
+    void* data;
+    JobToken* token;
+    bool skipped;           // Cancelled before it started
+    struct Job* next;       // In the stack of finished jobs
+} Job;
+
+// Ring of jobs, taken from the bottom by its worker and from the top by thieves
+typedef struct {
+    SDL_mutex* mutex;
+    size_t capacity;
+    size_t head;
+    size_t size;
+    Job** jobs;
+} JobDeque;
+
+typedef struct JobSystem JobSystem;
+
+typedef struct {
+    JobSystem* system;
+    size_t index;
+} JobWorker;
+
+struct JobSystem {
+    SDL_Thread* threads[JOBS_MAX_WORKERS];
+    JobWorker workers[JOBS_MAX_WORKERS];
+    size_t num_workers;
+    JobDeque deques[JOBS_MAX_WORKERS][JOB_PRIORITY_COUNT];
+    SDL_atomic_t next_worker;   // Deque the next job is submitted to, round-robin
+    SDL_atomic_t queued;        // Jobs in the deques
+
+    // Idle workers sleep on work_cond and 'jobs_wait' on done_cond
+    SDL_mutex* mutex;
+    SDL_cond* work_cond;
+    SDL_cond* done_cond;
+    SDL_atomic_t quit;
+
+    void* finished;             // Lock-free stack of finished Jobs, newest first
+};
+
+/*
+ *  Purpose: Start the worker threads. The system should be released with 'jobs_free'.
+ *
+ *  Parameters:
+ *    - num_workers: The number of worker threads, from 1 to JOBS_MAX_WORKERS.
+ *
+ *  Returns:
+ *    - Pointer to the new JobSystem.
+ */
+JobSystem* jobs_create(size_t num_workers);
+
+/*
+ *  Purpose: Create a cancellation token. It should be released with 'jobs_token_release' by its owner, and
+ *           is freed once its jobs are completed too.
+ *
+ *  Parameters: None.
+ *
+ *  Returns:
+ *    - Pointer to the new JobToken.
+ */
+JobToken* jobs_token_create(void);
+
+/*
+ *  Purpose: Give up the owner's reference to a token.
+ *
+ *  Parameters:
+ *    - token: Pointer to the JobToken.
+ *
+ *  Returns: None.
+ */
+void jobs_token_release(JobToken* token);
+
+/*
+ *  Purpose: Cancel the jobs of a token. Those not started are skipped, running ones see 'jobs_cancelled'.
+ *
+ *  Parameters:
+ *    - token: Pointer to the JobToken.
+ *
+ *  Returns: None.
+ */
+void jobs_cancel(JobToken* token);
+
+/*
+ *  Purpose: Check whether the jobs of a token were cancelled.
+ *
+ *  Parameters:
+ *    - token: Pointer to the JobToken (NULL for jobs that cannot be cancelled).
+ *
+ *  Returns:
+ *    - true if 'jobs_cancel' was called on the token.
+ *    - false otherwise.
+ */
+bool jobs_cancelled(JobToken* token);
+
+/*
+ *  Purpose: Queue a job for the workers.
+ *
+ *  Parameters:
+ *    - system: Pointer to the JobSystem.
+ *    - priority: The JobPriority of the job.
+ *    - run: The function run on a worker.
+ *    - complete: The function run on the main thread once it finished (can be NULL).
+ *    - data: Pointer passed to both functions.
+ *    - token: Pointer to the JobToken the job belongs to (can be NULL).
+ *
+ *  Returns: None.
+ */
+void jobs_submit(JobSystem* system, JobPriority priority, JobRun run, JobComplete complete, void* data, JobToken* token);
+
+/*
+ *  Purpose: Complete the jobs that finished since the last call, in the order they finished. Called by the
+ *           main thread only.
+ *
+ *  Parameters:
+ *    - system: Pointer to the JobSystem.
+ *
+ *  Returns: The number of jobs completed.
+ */
+size_t jobs_drain(JobSystem* system);
+
+/*
+ *  Purpose: Wait until no job of a token is queued or running. They are completed by the next 'jobs_drain'.
+ *
+ *  Parameters:
+ *    - system: Pointer to the JobSystem.
+ *    - token: Pointer to the JobToken.
+ *
+ *  Returns: None.
+ */
+void jobs_wait(JobSystem* system, JobToken* token);
+
+/*
+ *  Purpose: Stop the workers, complete the queued jobs as cancelled and free the system.
+ *
+ *  Parameters:
+ *    - system: Pointer to the JobSystem to free.
+ *
+ *  Returns: None.
+ */
+void jobs_free(JobSystem* system);
+
+#endif /* JOBS_H_ */
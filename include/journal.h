@@ -0,0 +1,129 @@
+/*
+ *  Crash-recovery journal. Every edit is appended as a small binary record to a journal next to the
+ *  file (".NAME.med-journal"), relative to the version of the file that was last loaded or saved.
+ *  Records are collected in memory and written with one fdatasync per JOURNAL_COMMIT_INTERVAL_MS by a
+ *  background thread, so typing never waits on the disk. After a crash the journal is replayed onto the
+ *  file the next time it is opened.
+ */
+#ifndef JOURNAL_H_
+#define JOURNAL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "editor.h"
+#include "keylog.h"
+#include "SDL.h"
+
+#define JOURNAL_SUFFIX ".med-journal"
+#define JOURNAL_STALE_SUFFIX ".old"
+#define JOURNAL_MAGIC "MEDJRNL1"
+#define JOURNAL_COMMIT_INTERVAL_MS 200
+
+// Identifies the version of the file the records apply to
+typedef struct {
+    char magic[8];
+    uint64_t base_size;
+    int64_t base_mtime_s;
+    int64_t base_mtime_ns;
+} JournalHeader;
+
+// Followed by 'text_size' bytes of text for KEYLOG_INSERT
+typedef struct {
+    uint8_t op;           // A KeylogOp for which 'keylog_op_is_edit' is true
+    uint8_t padding[3];
+    uint32_t text_size;
+    uint64_t row;         // The cursor before the edit
+    uint64_t col;
+} JournalRecord;
+
+typedef struct {
+    char* path;
+    char* file_path;
+    SDL_Thread* thread;
+
+    // Guarded by the mutex
+    SDL_mutex* mutex;
+    SDL_cond* cond;
+    char* pending;          // Records not written yet
+    size_t pending_size;
+    size_t pending_capacity;
+    bool reset;             // The file was saved, start the journal over with a new header
+    bool quit;
+
+    // Only used by the thread
+    int fd;                 // -1 until the first record is written
+    bool append;            // Continue the journal found on disk instead of starting a new one
+} Journal;
+
+/*
+ *  Purpose: Get the path of the journal of a file.
+ *
+ *  Parameters:
+ *    - file_path: Null-terminated path to the file being edited.
+ *
+ *  Returns:
+ *    - Pointer to the null-terminated path, to be freed by the caller.
+ */
+char* journal_path(const char* file_path);
+
+/*
+ *  Purpose: Replay the journal left behind by a crash onto a freshly loaded file. A journal made for another
+ *           version of the file is not replayed but renamed with JOURNAL_STALE_SUFFIX, so it is not lost.
+ *
+ *  Parameters:
+ *    - file_path: Null-terminated path to the file.
+ *    - editor: Pointer to the Editor structure the file was loaded into.
+ *
+ *  Returns:
+ *    - The number of edits replayed (0 if there was no usable journal).
+ */
+size_t journal_replay(const char* file_path, Editor* editor);
+
+/*
+ *  Purpose: Start journaling the edits of a file. The journal should be released with 'journal_close'.
+ *
+ *  Parameters:
+ *    - file_path: Null-terminated path to the file being edited.
+ *    - append: Whether to continue the journal on disk, after it was replayed with 'journal_replay'.
+ *
+ *  Returns:
+ *    - Pointer to the new Journal.
+ */
+Journal* journal_open(const char* file_path, bool append);
+
+/*
+ *  Purpose: Record an edit that is about to be applied to the Editor. Does not block on the disk.
+ *
+ *  Parameters:
+ *    - journal: Pointer to the Journal.
+ *    - editor: Pointer to the Editor, with the cursor where the edit happens.
+ *    - op: The edit.
+ *    - text: Null-terminated text for KEYLOG_INSERT (ignored otherwise, can be NULL).
+ *
+ *  Returns: None.
+ */
+void journal_record(Journal* journal, const Editor* editor, KeylogOp op, const char* text);
+
+/*
+ *  Purpose: Start the journal over after the file was saved, which makes the saved version the new base.
+ *
+ *  Parameters:
+ *    - journal: Pointer to the Journal.
+ *
+ *  Returns: None.
+ */
+void journal_reset(Journal* journal);
+
+/*
+ *  Purpose: Write the remaining records, stop the thread and free the Journal.
+ *
+ *  Parameters:
+ *    - journal: Pointer to the Journal to close.
+ *    - keep: Whether to keep the journal on disk, for edits that were not saved.
+ *
+ *  Returns: None.
+ */
+void journal_close(Journal* journal, bool keep);
+
+#endif /* JOURNAL_H_ */
@@ -0,0 +1,108 @@
+/*
+ *  Recording and replaying of editor keystroke traces.
+ *
+ *  A trace is a text file with one operation per line: the name of the operation, optionally
+ *  followed by a repeat count ("backspace 20"), or "insert " followed by the inserted text up
+ *  to the end of the line.
+ */
+#ifndef KEYLOG_H_
+#define KEYLOG_H_
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "editor.h"
+#include "SDL.h"
+
+// Large enough for any SDL text input event
+#define KEYLOG_TEXT_CAPACITY 64
+
+typedef enum {
+    KEYLOG_NONE,
+    KEYLOG_INSERT,
+    KEYLOG_BACKSPACE,
+    KEYLOG_DELETE,
+    KEYLOG_LEFT,
+    KEYLOG_RIGHT,
+    KEYLOG_UP,
+    KEYLOG_DOWN,
+    KEYLOG_RETURN,
+    KEYLOG_TAB,
+    KEYLOG_OP_COUNT,
+} KeylogOp;
+
+typedef struct {
+    KeylogOp op;
+    size_t count;                     // How many times the operation is repeated
+    char text[KEYLOG_TEXT_CAPACITY];  // Null-terminated text for KEYLOG_INSERT
+} KeylogEntry;
+
+/*
+ *  Purpose: Map a key to the editing operation main.c dispatches it to.
+ *
+ *  Parameters:
+ *    - key: The SDL keycode of the pressed key.
+ *
+ *  Returns: The matching operation, or KEYLOG_NONE if the key does not edit the buffer or move the cursor.
+ */
+KeylogOp keylog_op_from_key(SDL_Keycode key);
+
+/*
+ *  Purpose: Get the name an operation is written as in a trace.
+ *
+ *  Parameters:
+ *    - op: The operation.
+ *
+ *  Returns: A null-terminated string naming the operation.
+ */
+const char* keylog_op_name(KeylogOp op);
+
+/*
+ *  Purpose: Check whether an operation changes the text, as opposed to moving the cursor.
+ *
+ *  Parameters:
+ *    - op: The operation.
+ *
+ *  Returns:
+ *    - true if the operation edits the buffer.
+ *    - false otherwise.
+ */
+bool keylog_op_is_edit(KeylogOp op);
+
+/*
+ *  Purpose: Append an operation to a trace.
+ *
+ *  Parameters:
+ *    - fp: File pointer to the trace being recorded.
+ *    - op: The operation to record.
+ *    - text: Null-terminated text for KEYLOG_INSERT (ignored otherwise, can be NULL).
+ *
+ *  Returns: None.
+ */
+void keylog_write(FILE* fp, KeylogOp op, const char* text);
+
+/*
+ *  Purpose: Read the next operation from a trace, skipping blank lines and lines starting with '#'.
+ *
+ *  Parameters:
+ *    - fp: File pointer to the trace being replayed.
+ *    - entry: Pointer to the KeylogEntry to fill in.
+ *
+ *  Returns:
+ *    - true if an operation was read.
+ *    - false at the end of the trace (unknown operations are reported on stderr and skipped).
+ */
+bool keylog_read(FILE* fp, KeylogEntry* entry);
+
+/*
+ *  Purpose: Apply one repetition of an operation to the Editor through the same editor_* function
+ *           main.c calls for the corresponding key.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *    - entry: Pointer to the operation to apply.
+ *
+ *  Returns: None.
+ */
+void keylog_apply(Editor* editor, const KeylogEntry* entry);
+
+#endif /* KEYLOG_H_ */
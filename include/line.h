@@ -7,19 +7,51 @@
 #define LINE_H_
 
 #include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include "line.h"
 
 #define LINE_INIT_CAPACITY 1024
 #define TAB_STOP 4
 
+// Lines with less room to spare than this are not shrunk, it saves a reallocation on their next edit
+#define LINE_SHRINK_MIN_SLACK 64
+
+// Lines growing past this are stored in chunks of at most LINE_CHUNK_SIZE characters, so an edit moves no
+// more than a chunk and a range of columns is found without going through the whole line
+#define LINE_CHUNK_THRESHOLD (1024 * 1024)
+#define LINE_CHUNK_SIZE (64 * 1024)
+#define LINE_INIT_CHUNKS 16
+
+// The capacity of a chunked line, whose 'chunks' are set in place of 'chars'
+#define LINE_CHUNKED SIZE_MAX
+
+typedef struct {
+    size_t size;
+    char* chars;            // Room for LINE_CHUNK_SIZE characters
+} LineChunk;
+
+// The chunks of a line in order, none of them empty
+typedef struct {
+    size_t capacity;
+    size_t size;
+    LineChunk* chunks;
+} LineChunks;
+
+// A capacity of 0 with non-NULL chars means the characters are borrowed (e.g. from a mapped file or
+// shared with identical lines) and are copied before the line changes. A capacity of LINE_CHUNKED means
+// the characters are in chunks, which are read with 'line_copy_range' or joined by the Editor.
 typedef struct {
     size_t capacity;
     size_t size;
-    char* chars;
+    union {
+        char* chars;
+        LineChunks* chunks;
+    };
 } Line;
 
 /*
- *  Purpose: Expand the capacity of a Line structure to accommodate additional characters.
+ *  Purpose: Expand the capacity of a Line structure, which is not chunked, to accommodate additional characters.
  *
  *  Parameters:
  *    - line: Pointer to the Line structure to expand.
@@ -29,6 +61,29 @@ typedef struct {
  */
 void line_expand(Line* line, size_t n);
 
+/*
+ *  Purpose: Free the characters of a Line structure, unless they are borrowed (capacity of 0).
+ *
+ *  Parameters:
+ *    - line: Pointer to the Line structure to free.
+ *
+ *  Returns: None.
+ */
+void line_free(Line* line);
+
+/*
+ *  Purpose: Give back the room a Line structure has beyond its characters, if it is at least
+ *           LINE_SHRINK_MIN_SLACK. Borrowed and chunked characters are left as they are.
+ *
+ *  Parameters:
+ *    - line: Pointer to the Line structure to shrink.
+ *
+ *  Returns:
+ *    - true if the line was shrunk.
+ *    - false otherwise.
+ */
+bool line_shrink_to_fit(Line* line);
+
 /*
  *  Purpose: Insert a null-terminated string before the cursor position in a Line structure.
  *
@@ -102,4 +157,75 @@ void line_append_text(Line* line, char* text);
  */
 void line_append_text_segment(Line* line, char* text, size_t text_size);
 
+/*
+ *  Purpose: Check whether the characters of a Line structure are stored in chunks.
+ *
+ *  Parameters:
+ *    - line: Pointer to the Line structure.
+ *
+ *  Returns:
+ *    - true if the line is chunked.
+ *    - false if its characters are contiguous.
+ */
+bool line_is_chunked(const Line* line);
+
+/*
+ *  Purpose: Copy a range of the characters of a Line structure, whether it is chunked or not.
+ *
+ *  Parameters:
+ *    - line: Pointer to the Line structure.
+ *    - start: The first column to copy.
+ *    - end: The column after the last one to copy, at most the size of the line.
+ *    - dst: Pointer to room for 'end - start' characters.
+ *
+ *  Returns: None.
+ */
+void line_copy_range(const Line* line, size_t start, size_t end, char* dst);
+
+/*
+ *  Purpose: Get the character at a column of a Line structure, whether it is chunked or not.
+ *
+ *  Parameters:
+ *    - line: Pointer to the Line structure.
+ *    - col: The column, below the size of the line.
+ *
+ *  Returns: The character.
+ */
+char line_char_at(const Line* line, size_t col);
+
+/*
+ *  Purpose: Append a range of the characters of another Line structure to the end of a Line structure.
+ *
+ *  Parameters:
+ *    - line: Pointer to the Line structure to append text to.
+ *    - src: Pointer to the other Line structure.
+ *    - start: The first column of 'src' to append.
+ *    - end: The column after the last one to append, at most the size of 'src'.
+ *
+ *  Returns: None.
+ */
+void line_append_range(Line* line, const Line* src, size_t start, size_t end);
+
+/*
+ *  Purpose: Drop the characters of a Line structure from a column on.
+ *
+ *  Parameters:
+ *    - line: Pointer to the Line structure.
+ *    - size: The number of characters to keep, at most the size of the line.
+ *
+ *  Returns: None.
+ */
+void line_truncate(Line* line, size_t size);
+
+/*
+ *  Purpose: Measure the whitespace a Line structure starts with, a tab counting as TAB_STOP spaces.
+ *
+ *  Parameters:
+ *    - line: Pointer to the Line structure, chunked or not.
+ *    - text_col: Pointer set to the column of its first other character, its size for a blank line (can be NULL).
+ *
+ *  Returns: The indentation in columns.
+ */
+size_t line_indentation(const Line* line, size_t* text_col);
+
 #endif /* LINE_H_ */
\ No newline at end of file
@@ -0,0 +1,107 @@
+/*
+ *  Background loading of files and pipes into an Editor. A worker thread reads and splits the input into lines
+ *  and hands complete lines over in batches, which the main thread moves into the Editor between
+ *  frames, so the window is responsive and shows the first lines while the rest is still being read.
+ */
+#ifndef LOADER_H_
+#define LOADER_H_
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "editor.h"
+#include "intern.h"
+#include "SDL.h"
+
+#define LOADER_CHUNK_SIZE (EDITOR_INIT_CAPACITY * LINE_INIT_CAPACITY)
+
+// How long the worker waits for a pipe to have data before checking whether it was cancelled
+#define LOADER_WAIT_MS 100
+
+// Time in milliseconds 'loader_poll' may spend moving lines per call, so a frame is never held up by a large file
+#define LOADER_POLL_BUDGET_MS 4
+
+// Complete lines read by the worker, waiting to be moved into the Editor
+typedef struct LoaderBatch {
+    size_t size;
+    Line* lines;
+    size_t bytes_read;        // Bytes of the file read once this batch is in
+    struct LoaderBatch* next;
+} LoaderBatch;
+
+typedef struct {
+    FILE* fp;
+    SDL_Thread* thread;
+    SDL_mutex* mutex;       // Guards the batch queue
+    LoaderBatch* head;
+    LoaderBatch* tail;
+    SDL_atomic_t finished;  // Set by the worker once the whole file is queued
+    SDL_atomic_t cancelled; // Set by the main thread to stop the worker early
+    size_t file_size;       // 0 if the size is not known up front
+    size_t bytes_loaded;    // Bytes of the file moved into the Editor (main thread only)
+    InternPool* intern;     // Where the worker interns the lines (NULL for none), the Editor's own pool
+} Loader;
+
+/*
+ *  Purpose: Start loading a file on a worker thread. The loader should be released with 'loader_free'.
+ *
+ *  Parameters:
+ *    - fp: File pointer to the file to load, which can also be a pipe or stdin. Lines are handed
+ *          over as soon as they are read. The loader takes ownership and closes it.
+ *    - intern: Pointer to the InternPool the lines share their characters through (NULL to keep every line's
+ *              own). Only the worker uses it until the loader is done.
+ *
+ *  Returns:
+ *    - Pointer to the new Loader.
+ */
+Loader* loader_start(FILE* fp, InternPool* intern);
+
+/*
+ *  Purpose: Move the lines read so far to the end of the Editor, for up to LOADER_POLL_BUDGET_MS. Call from
+ *           the thread that owns the Editor.
+ *
+ *  Parameters:
+ *    - loader: Pointer to the Loader.
+ *    - editor: Pointer to the Editor structure being loaded into.
+ *
+ *  Returns:
+ *    - true if lines were added to the Editor.
+ *    - false otherwise.
+ */
+bool loader_poll(Loader* loader, Editor* editor);
+
+/*
+ *  Purpose: Check whether the whole file has been read and moved into the Editor.
+ *
+ *  Parameters:
+ *    - loader: Pointer to the Loader.
+ *
+ *  Returns:
+ *    - true if loading is complete.
+ *    - false otherwise.
+ */
+bool loader_done(Loader* loader);
+
+/*
+ *  Purpose: Get how much of the file has been moved into the Editor.
+ *
+ *  Parameters:
+ *    - loader: Pointer to the Loader.
+ *
+ *  Returns:
+ *    - The loaded fraction of the file, between 0 and 1.
+ *    - A negative value if the size of the file is not known.
+ */
+float loader_progress(const Loader* loader);
+
+/*
+ *  Purpose: Stop the worker if it is still running and free the Loader, including lines not yet moved
+ *           into an Editor.
+ *
+ *  Parameters:
+ *    - loader: Pointer to the Loader to free.
+ *
+ *  Returns: None.
+ */
+void loader_free(Loader* loader);
+
+#endif /* LOADER_H_ */
@@ -0,0 +1,51 @@
+/*
+ *  A small LZ77 codec for text, in the spirit of LZ4. The input is encoded as sequences of a token byte
+ *  (4 bits of literal length and 4 bits of match length), the literals, and a 2-byte offset back to
+ *  where the match is copied from. Lengths that do not fit in 4 bits continue in extra bytes of up to 255.
+ *  Matches are found with a hash table of the positions of recent 4-byte strings, so compression is fast
+ *  and decompression is a loop of copies.
+ */
+#ifndef LZ_H_
+#define LZ_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LZ_HASH_BITS 14
+#define LZ_HASH_SIZE (1 << LZ_HASH_BITS)
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+
+// The largest size 'lz_compress' can produce for an input of n bytes, for text that does not compress
+#define LZ_BOUND(n) ((n) + (n) / 255 + 16)
+
+/*
+ *  Purpose: Compress a buffer.
+ *
+ *  Parameters:
+ *    - src: Pointer to the bytes to compress.
+ *    - size: The number of bytes to compress (below 4 GB).
+ *    - dst: Pointer to where the compressed bytes are written, with room for LZ_BOUND(size) bytes.
+ *    - table: Pointer to LZ_HASH_SIZE entries of scratch space, so the codec can be used from any thread.
+ *
+ *  Returns: The number of compressed bytes written.
+ */
+size_t lz_compress(const char* src, size_t size, char* dst, uint32_t* table);
+
+/*
+ *  Purpose: Decompress a buffer made by 'lz_compress'.
+ *
+ *  Parameters:
+ *    - src: Pointer to the compressed bytes.
+ *    - src_size: The number of compressed bytes.
+ *    - dst: Pointer to where the bytes are written.
+ *    - size: The number of bytes that were compressed.
+ *
+ *  Returns:
+ *    - true if exactly 'size' bytes were decompressed.
+ *    - false if the compressed bytes are corrupt, without writing out of bounds.
+ */
+bool lz_decompress(const char* src, size_t src_size, char* dst, size_t size);
+
+#endif /* LZ_H_ */
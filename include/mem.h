@@ -0,0 +1,124 @@
+/*
+ *  Memory accounting. Med's own allocations go through these wrappers of 'utils_cp', which count the live
+ *  bytes and the allocations of every subsystem so a report can show where the memory goes. The sizes
+ *  are the ones the allocator reports, rounding included. The counters are atomic since the worker
+ *  threads allocate too. Slack, room that is allocated but not used yet, is only known to the owner of a
+ *  buffer and is filled in by it (see 'editor_memory_usage').
+ */
+#ifndef MEM_H_
+#define MEM_H_
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef enum {
+    MEM_LINES,          // Characters of the lines
+    MEM_EDITOR,         // Arrays of lines
+    MEM_COLD,
+    MEM_INTERN,
+    MEM_LOADER,
+    MEM_PAGER,
+    MEM_HIGHLIGHT,
+    MEM_DECORATIONS,
+    MEM_SEARCH,
+    MEM_JOBS,
+    MEM_FRAMES,
+    MEM_WRAP,
+    MEM_FOLDS,
+    MEM_FILTER,
+    MEM_OTHER,
+    MEM_NUM_SUBSYSTEMS
+} MemSubsystem;
+
+typedef struct {
+    size_t live_bytes;
+    size_t live_allocs;
+    size_t total_allocs;    // Including the ones freed since
+    size_t slack_bytes;     // Part of the live bytes that is not used, if 'has_slack'
+    bool has_slack;
+} MemUsage;
+
+/*
+ *  Purpose: Allocate memory for a subsystem, exiting on failure.
+ *
+ *  Parameters:
+ *    - subsystem: The subsystem the memory is counted for.
+ *    - size: The number of bytes, above 0.
+ *
+ *  Returns:
+ *    - Pointer to the memory, to be freed with 'mem_free'.
+ */
+void* mem_malloc(MemSubsystem subsystem, size_t size);
+
+/*
+ *  Purpose: Allocate zeroed memory for a subsystem, exiting on failure.
+ *
+ *  Parameters:
+ *    - subsystem: The subsystem the memory is counted for.
+ *    - n: The number of items, above 0.
+ *    - size: The size of an item, above 0.
+ *
+ *  Returns:
+ *    - Pointer to the memory, to be freed with 'mem_free'.
+ */
+void* mem_calloc(MemSubsystem subsystem, size_t n, size_t size);
+
+/*
+ *  Purpose: Resize memory of a subsystem, exiting on failure.
+ *
+ *  Parameters:
+ *    - subsystem: The subsystem the memory is counted for.
+ *    - ptr: Pointer to the memory (can be NULL).
+ *    - size: The new number of bytes, above 0.
+ *
+ *  Returns:
+ *    - Pointer to the resized memory, to be freed with 'mem_free'.
+ */
+void* mem_realloc(MemSubsystem subsystem, void* ptr, size_t size);
+
+/*
+ *  Purpose: Copy a null-terminated string for a subsystem, exiting on failure.
+ *
+ *  Parameters:
+ *    - subsystem: The subsystem the memory is counted for.
+ *    - string: The null-terminated string.
+ *
+ *  Returns:
+ *    - Pointer to the copy, to be freed with 'mem_free'.
+ */
+char* mem_strdup(MemSubsystem subsystem, const char* string);
+
+/*
+ *  Purpose: Free memory of a subsystem.
+ *
+ *  Parameters:
+ *    - subsystem: The subsystem the memory was allocated for.
+ *    - ptr: Pointer to the memory (can be NULL).
+ *
+ *  Returns: None.
+ */
+void mem_free(MemSubsystem subsystem, void* ptr);
+
+/*
+ *  Purpose: Get the counters of every subsystem. The slack is left unknown.
+ *
+ *  Parameters:
+ *    - usage: Array receiving the usage of each subsystem.
+ *
+ *  Returns: None.
+ */
+void mem_get_usage(MemUsage usage[MEM_NUM_SUBSYSTEMS]);
+
+/*
+ *  Purpose: Print a table of the memory used by every subsystem and the totals.
+ *
+ *  Parameters:
+ *    - fp: File pointer to print to.
+ *    - usage: The usage of each subsystem.
+ *
+ *  Returns: None.
+ */
+void mem_print_report(FILE* fp, const MemUsage usage[MEM_NUM_SUBSYSTEMS]);
+
+#endif /* MEM_H_ */
@@ -0,0 +1,143 @@
+/*
+ *  Read-only paging of files larger than memory. A worker thread scans the file once and splits it into
+ *  pages of PAGER_PAGE_LINES lines, or fewer once they reach a size taken from the memory budget, and
+ *  keeps where every page starts. The lines themselves are read back from disk a page at a time when
+ *  they are needed, and a line longer than a page is shown cut, so no page is larger than twice that
+ *  size. Decoded pages are kept in a cache that is bounded by the budget and evicts the least recently
+ *  used page first.
+ */
+#ifndef PAGER_H_
+#define PAGER_H_
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "line.h"
+#include "SDL.h"
+
+#define PAGER_PAGE_LINES 1024
+#define PAGER_SCAN_CHUNK_SIZE (1024 * 1024)
+#define PAGER_BUDGET_PAGES 16               // The page size is the budget over this, at least PAGER_MIN_PAGE_SIZE
+#define PAGER_MIN_PAGE_SIZE (64 * 1024)
+
+// Files larger than the budget are paged instead of loaded, unless another budget is given
+#define PAGER_DEFAULT_BUDGET_MB 1024
+
+// A run of at most PAGER_PAGE_LINES lines, whose lines point into 'chars'
+typedef struct PagerPage {
+    size_t index;
+    size_t first_line;
+    size_t num_lines;
+    Line* lines;
+    char* chars;
+    size_t memory;          // Bytes charged to the budget for this page
+    struct PagerPage* prev; // Towards the most recently used page
+    struct PagerPage* next; // Towards the least recently used page
+} PagerPage;
+
+typedef struct {
+    FILE* fp;
+    SDL_Thread* thread;
+    SDL_atomic_t finished;   // Set by the worker once the whole file is indexed
+    SDL_atomic_t cancelled;  // Set by the main thread to stop the worker early
+
+    // The sparse index, written by the worker and guarded by the mutex
+    SDL_mutex* mutex;
+    size_t* page_offsets;    // File offset of the first line of every page
+    size_t* page_lines;      // Index of the first line of every page
+    size_t num_pages;
+    size_t pages_capacity;
+    size_t page_size;        // Bytes after which a page ends, a line longer than that has a page of its own
+    size_t num_lines;        // Complete lines indexed so far
+    size_t lines_end;        // File offset just past the last indexed line
+    size_t file_size;        // 0 if the size is not known up front
+
+    // The page cache, only used by the main thread
+    size_t budget;
+    size_t memory;
+    PagerPage* most_recent;
+    PagerPage* least_recent;
+} Pager;
+
+/*
+ *  Purpose: Check whether a file is too large to be loaded within a memory budget and should be paged.
+ *
+ *  Parameters:
+ *    - fp: File pointer to the file, rewound to its start afterwards.
+ *    - budget: The memory budget in bytes.
+ *
+ *  Returns:
+ *    - true if the file is larger than the budget.
+ *    - false otherwise, or if its size is not known.
+ */
+bool pager_should_page(FILE* fp, size_t budget);
+
+/*
+ *  Purpose: Start indexing a file on a worker thread. The pager should be released with 'pager_free'.
+ *
+ *  Parameters:
+ *    - fp: File pointer to the file to page. The pager takes ownership and closes it.
+ *    - budget: The maximum number of bytes the cached pages may use. At least one page is kept
+ *              even if it is larger on its own.
+ *
+ *  Returns:
+ *    - Pointer to the new Pager.
+ */
+Pager* pager_open(FILE* fp, size_t budget);
+
+/*
+ *  Purpose: Get the number of lines indexed so far.
+ *
+ *  Parameters:
+ *    - pager: Pointer to the Pager.
+ *
+ *  Returns: The number of lines that can be read with 'pager_get_line'.
+ */
+size_t pager_num_lines(Pager* pager);
+
+/*
+ *  Purpose: Get a line, reading its page from disk if it is not cached. Call from a single thread.
+ *
+ *  Parameters:
+ *    - pager: Pointer to the Pager.
+ *    - row: The index of the line, below 'pager_num_lines'.
+ *
+ *  Returns:
+ *    - Pointer to the line. It stays valid until the next call, which may evict its page.
+ */
+const Line* pager_get_line(Pager* pager, size_t row);
+
+/*
+ *  Purpose: Check whether the whole file has been indexed.
+ *
+ *  Parameters:
+ *    - pager: Pointer to the Pager.
+ *
+ *  Returns:
+ *    - true if indexing is complete.
+ *    - false otherwise.
+ */
+bool pager_done(Pager* pager);
+
+/*
+ *  Purpose: Get how much of the file has been indexed.
+ *
+ *  Parameters:
+ *    - pager: Pointer to the Pager.
+ *
+ *  Returns:
+ *    - The indexed fraction of the file, between 0 and 1.
+ *    - A negative value if the size of the file is not known.
+ */
+float pager_progress(Pager* pager);
+
+/*
+ *  Purpose: Stop the worker if it is still running and free the Pager and its cached pages.
+ *
+ *  Parameters:
+ *    - pager: Pointer to the Pager to free.
+ *
+ *  Returns: None.
+ */
+void pager_free(Pager* pager);
+
+#endif /* PAGER_H_ */
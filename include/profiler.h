@@ -0,0 +1,176 @@
+/*
+ *  A lightweight frame profiler. Each stage of the main loop is timed with the SDL performance
+ *  counter and the results of the last frames are kept in a ring buffer. The data can be shown
+ *  as an on-screen overlay or exported as Chrome trace JSON (chrome://tracing, Perfetto).
+ *  Frames are profiled by the render thread, the stages run by the main thread are recorded
+ *  into them with 'profiler_record_stage'. Startup marks can be added from any thread.
+ */
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "SDL.h"
+#include "font.h"
+
+// Number of frames kept in the ring buffer (4 seconds at 60 FPS)
+#define PROFILER_HISTORY 240
+
+#define PROFILER_OVERLAY_SCALE 0.5f
+
+#define PROFILER_MAX_STARTUP_MARKS 32
+
+typedef enum {
+    PROFILER_STAGE_EVENTS,
+    PROFILER_STAGE_CAMERA,
+    PROFILER_STAGE_RENDER_EDITOR,
+    PROFILER_STAGE_RENDER_CURSOR,
+    PROFILER_STAGE_PRESENT,
+    PROFILER_STAGE_COUNT,
+} ProfilerStage;
+
+typedef struct {
+    Uint64 start;                              // Performance counter when the frame started
+    Uint64 end;                                // Performance counter when the frame ended
+    Uint64 stage_start[PROFILER_STAGE_COUNT];
+    Uint64 stage_end[PROFILER_STAGE_COUNT];
+    size_t draw_calls;
+    size_t glyphs;
+} ProfilerFrame;
+
+/*
+ *  Time the statement or block that follows as the given stage, e.g.
+ *
+ *      PROFILER_SCOPE(PROFILER_STAGE_PRESENT) {
+ *          SDL_RenderPresent(renderer);
+ *      }
+ *
+ *  Leaving the block with 'break', 'return' or 'goto' skips the end of the timer.
+ */
+#define PROFILER_SCOPE(stage) \
+    for (int profiler_scope_done_ = (profiler_stage_begin(stage), 0); !profiler_scope_done_; profiler_scope_done_ = (profiler_stage_end(stage), 1))
+
+/*
+ *  Purpose: Start recording a new frame, discarding a frame that was started but never ended.
+ *
+ *  Parameters: None.
+ *
+ *  Returns: None.
+ */
+void profiler_begin_frame(void);
+
+/*
+ *  Purpose: Finish the current frame and push it onto the ring buffer.
+ *
+ *  Parameters: None.
+ *
+ *  Returns: None.
+ */
+void profiler_end_frame(void);
+
+/*
+ *  Purpose: Mark the start of a stage in the current frame.
+ *
+ *  Parameters:
+ *    - stage: The stage being timed.
+ *
+ *  Returns: None.
+ */
+void profiler_stage_begin(ProfilerStage stage);
+
+/*
+ *  Purpose: Mark the end of a stage in the current frame.
+ *
+ *  Parameters:
+ *    - stage: The stage being timed.
+ *
+ *  Returns: None.
+ */
+void profiler_stage_end(ProfilerStage stage);
+
+/*
+ *  Purpose: Set the time of a stage of the current frame that ran on another thread, before the frame started.
+ *
+ *  Parameters:
+ *    - stage: The stage.
+ *    - start: Performance counter when the stage started.
+ *    - end: Performance counter when the stage ended.
+ *
+ *  Returns: None.
+ */
+void profiler_record_stage(ProfilerStage stage, Uint64 start, Uint64 end);
+
+/*
+ *  Purpose: Count a draw call issued to the renderer in the current frame.
+ *
+ *  Parameters:
+ *    - glyphs: The number of glyphs drawn by the call (0 for shapes).
+ *
+ *  Returns: None.
+ */
+void profiler_count_draw_call(size_t glyphs);
+
+/*
+ *  Purpose: Show the overlay if it is hidden, hide it otherwise.
+ *
+ *  Parameters: None.
+ *
+ *  Returns: None.
+ */
+void profiler_toggle_overlay(void);
+
+/*
+ *  Purpose: Check whether the overlay is currently shown.
+ *
+ *  Parameters: None.
+ *
+ *  Returns:
+ *    - true if the overlay is shown.
+ *    - false otherwise.
+ */
+bool profiler_overlay_enabled(void);
+
+/*
+ *  Purpose: Draw the per-stage timings, draw calls and glyph counts in the top-left corner of the window.
+ *           Draw calls made by the overlay itself are not counted. Does nothing if the overlay is hidden.
+ *
+ *  Parameters:
+ *    - renderer: Pointer to the SDL renderer to draw the overlay with.
+ *    - font: Pointer to the Font structure used for the text.
+ *
+ *  Returns: None.
+ */
+void profiler_render_overlay(SDL_Renderer* renderer, const Font* font);
+
+/*
+ *  Purpose: Write the frames in the ring buffer to a file in the Chrome trace event JSON format.
+ *
+ *  Parameters:
+ *    - file_path: The path to the file where the trace will be saved.
+ *
+ *  Returns:
+ *    - true if the trace was written.
+ *    - false otherwise (the reason is printed to stderr).
+ */
+bool profiler_export_chrome_trace(const char* file_path);
+
+/*
+ *  Purpose: Record that a startup milestone was reached, timed from the first mark. Can be called from any thread.
+ *
+ *  Parameters:
+ *    - name: Null-terminated name of the milestone, which must outlive the profiler (e.g. a string literal).
+ *
+ *  Returns: None.
+ */
+void profiler_startup_mark(const char* name);
+
+/*
+ *  Purpose: Print the startup milestones recorded so far and not printed yet, in the order they were reached.
+ *
+ *  Parameters: None.
+ *
+ *  Returns: None.
+ */
+void profiler_print_startup_trace(void);
+
+#endif /* PROFILER_H_ */
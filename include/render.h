@@ -9,6 +9,8 @@
 #include "editor.h"
 #include "vec.h"
 #include "camera.h"
+#include "highlight.h"
+#include "decoration.h"
 
 typedef enum {
       CURSOR_BAR,
@@ -65,33 +67,117 @@ void render_text_segment(SDL_Renderer* renderer, const Font* font, const char* t
 void render_text(SDL_Renderer* renderer, const Font* font, const char* text, Vec2f pos, SDL_Color color, float scale);
 
 /*
- *  Purpose: Render text lines in the editor using camera projection.
+ *  Purpose: Find the lines that are on screen, the cost of a frame depends on the window and not the file.
+ *
+ *  Parameters:
+ *    - window: Pointer to the SDL window to determine screen dimensions.
+ *    - camera_pos: The position of the camera.
+ *    - num_lines: The number of lines in the Editor.
+ *    - first: Pointer set to the index of the first line on screen.
+ *    - last: Pointer set to the index after the last line on screen, at most num_lines.
+ *
+ *  Returns: None.
+ */
+void render_visible_rows(SDL_Window* window, Vec2f camera_pos, size_t num_lines, size_t* first, size_t* last);
+
+/*
+ *  Purpose: Find the columns that are on screen, so only that part of a long line is drawn.
+ *
+ *  Parameters:
+ *    - window: Pointer to the SDL window to determine screen dimensions.
+ *    - camera_pos: The position of the camera.
+ *    - first_col: Pointer set to the first column on screen.
+ *    - last_col: Pointer set to the column after the last one on screen, past the end of shorter lines.
+ *
+ *  Returns: None.
+ */
+void render_visible_cols(SDL_Window* window, Vec2f camera_pos, size_t* first_col, size_t* last_col);
+
+/*
+ *  Purpose: Fill the background of a decoration on one visual row of one of its lines.
  *
  *  Parameters:
  *    - renderer: Pointer to the SDL renderer for rendering operations.
- *    - font: Pointer to the Font structure for rendering text.
- *    - editor: Pointer to the Editor structure containing text lines to be rendered.
+ *    - decoration: Pointer to the Decoration.
+ *    - row: The index of the line, from the start to the end row of the decoration.
+ *    - segment_start: The first column of the line on the visual row.
+ *    - segment_end: The column after its last one, one past the end of the line on its last row for the line break.
+ *    - screen_col: The column on screen 'segment_start' is drawn at.
+ *    - visual_row: The visual row, where it is drawn.
+ *    - window: Pointer to the SDL window to determine screen dimensions.
+ *    - camera_pos: The position of the camera.
+ *    - scale: Scaling factor for adjusting the text size.
+ *
+ *  Returns: None.
+ */
+void render_decoration_segment(SDL_Renderer* renderer, const Decoration* decoration, size_t row, size_t segment_start, size_t segment_end, size_t screen_col, size_t visual_row, SDL_Window* window, Vec2f camera_pos, float scale);
+
+/*
+ *  Purpose: Fill the background of a decoration on one of its lines.
+ *
+ *  Parameters:
+ *    - renderer: Pointer to the SDL renderer for rendering operations.
+ *    - decoration: Pointer to the Decoration.
+ *    - row: The index of the line, from the start to the end row of the decoration.
+ *    - line_size: The number of characters on the line.
  *    - window: Pointer to the SDL window to determine screen dimensions.
- *    - camera: Pointer to the Camera structure for camera projection adjustment.
- *    - text_color: SDL_Color specifying the color of the rendered text.
+ *    - camera_pos: The position of the camera.
+ *    - scale: Scaling factor for adjusting the text size.
+ *
+ *  Returns: None.
+ */
+void render_decoration(SDL_Renderer* renderer, const Decoration* decoration, size_t row, size_t line_size, SDL_Window* window, Vec2f camera_pos, float scale);
+
+/*
+ *  Purpose: Render a line of text colored by its highlighting runs.
+ *
+ *  Parameters:
+ *    - renderer: Pointer to the SDL renderer for rendering operations.
+ *    - font: Pointer to the Font structure for rendering text.
+ *    - line: Pointer to the Line.
+ *    - runs: Pointer to the runs of the line, in order and not overlapping (can be NULL if there are none).
+ *    - num_runs: The number of runs.
+ *    - pos: The position (Vec2f) of the start of the line on screen.
+ *    - text_color: The color of the text outside the runs.
  *    - scale: Scaling factor for adjusting the text size.
  *
  *  Returns: None.
  */
-void render_editor(SDL_Renderer* renderer, Font* font, Editor* editor, SDL_Window* window, Camera* camera, SDL_Color text_color, float scale);
+void render_line(SDL_Renderer* renderer, const Font* font, const Line* line, const HighlightRun* runs, size_t num_runs, Vec2f pos, SDL_Color text_color, float scale);
 
 /*
- *  Purpose: Render the cursor at the current cursor position in the text editor using specified colors.
+ *  Purpose: Render the cursor at a position using specified colors.
  *
  *  Parameters:
  *    - renderer: Pointer to the SDL renderer where the cursor is rendered.
  *    - font: Pointer to the Font structure for rendering text beneath the cursor.
- *    - editor: Pointer to the Editor structure containing the text and cursor position.
+ *    - row: The line of the cursor.
+ *    - col: The column of the cursor.
+ *    - beneath: Pointer to the character beneath the cursor (NULL at the end of the line).
+ *    - window: Pointer to the SDL window to determine screen dimensions.
+ *    - camera_pos: The position of the camera.
  *    - cursor_color: The color for rendering the cursor.
  *    - text_beneath_cursor_color: The color for rendering text beneath the cursor.
+ *    - cursor_shape: The CursorShape.
+ *
+ *  Returns: None.
+ */
+void render_cursor_at(SDL_Renderer* renderer, const Font* font, size_t row, size_t col, const char* beneath, SDL_Window* window, Vec2f camera_pos, SDL_Color cursor_color, SDL_Color text_beneath_cursor_color, CursorShape cursor_shape);
+
+/*
+ *  Purpose: Render a line of status text in the bottom-right corner of the window, over a background
+ *           so it stays readable on top of the editor's text.
+ *
+ *  Parameters:
+ *    - renderer: Pointer to the SDL renderer where the text is rendered.
+ *    - font: Pointer to the Font structure used for rendering.
+ *    - window: Pointer to the SDL window to determine screen dimensions.
+ *    - text: Pointer to the null-terminated status text.
+ *    - text_color: The color for the rendered text.
+ *    - background_color: The color of the box behind the text.
  *
  *  Returns: None.
  */
-void render_cursor(SDL_Renderer* renderer, const Font* font, Editor* editor, SDL_Window* window, Vec2f camera_pos, SDL_Color cursor_color, SDL_Color text_beneath_cursor_color, CursorShape cursor_shape);
+void render_status(SDL_Renderer* renderer, const Font* font, SDL_Window* window, const char* text, SDL_Color text_color, SDL_Color background_color);
 
 #endif /* RENDER_H_ */
\ No newline at end of file
@@ -0,0 +1,92 @@
+/*
+ *  Search for every occurrence of a word, run on the job system. The lines are split into chunks
+ *  searched by the workers, the chunk on screen first, and the hits of each chunk are added to the
+ *  decorations on the main thread as it completes. The Editor must not change while a search runs:
+ *  edits cancel it first, which keeps the hits found so far.
+ */
+#ifndef SEARCH_H_
+#define SEARCH_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "editor.h"
+#include "decoration.h"
+#include "jobs.h"
+
+#define SEARCH_CHUNK_LINES 16384
+#define SEARCH_CANCEL_CHECK_LINES 1024
+#define SEARCH_WORD_CAPACITY 256
+
+typedef struct {
+    JobSystem* jobs;
+    JobToken* token;
+    Editor* editor;
+    DecorationStore* decorations;
+    char word[SEARCH_WORD_CAPACITY];
+    size_t word_size;
+    size_t chunks_left;     // Chunks not completed yet
+    size_t count;           // Hits added so far
+} Search;
+
+/*
+ *  Purpose: Get the word under the cursor, made of letters, digits and underscores.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *    - size: Pointer set to the number of characters of the word (0 if the cursor is not on a word).
+ *
+ *  Returns:
+ *    - Pointer to the first character of the word in its line.
+ */
+const char* search_word_under_cursor(Editor* editor, size_t* size);
+
+/*
+ *  Purpose: Start searching the Editor for a word. The search should be released with 'search_free'.
+ *
+ *  Parameters:
+ *    - jobs: Pointer to the JobSystem running the search.
+ *    - editor: Pointer to the Editor, which must not be paged.
+ *    - decorations: Pointer to the DecorationStore the hits are added to, as DECORATION_SEARCH_HIT.
+ *    - word: Pointer to the characters of the word (not null-terminated).
+ *    - size: The number of characters, from 1 to SEARCH_WORD_CAPACITY.
+ *    - first_row: The first line on screen, searched first.
+ *
+ *  Returns:
+ *    - Pointer to the new Search.
+ */
+Search* search_start(JobSystem* jobs, Editor* editor, DecorationStore* decorations, const char* word, size_t size, size_t first_row);
+
+/*
+ *  Purpose: Check whether chunks of a search are still to be completed.
+ *
+ *  Parameters:
+ *    - search: Pointer to the Search.
+ *
+ *  Returns:
+ *    - true while the search runs.
+ *    - false once every chunk was completed, or the search was cancelled.
+ */
+bool search_running(const Search* search);
+
+/*
+ *  Purpose: Stop a search and wait until no worker reads the Editor for it anymore. The chunks not
+ *           completed yet are dropped.
+ *
+ *  Parameters:
+ *    - search: Pointer to the Search.
+ *
+ *  Returns: None.
+ */
+void search_cancel(Search* search);
+
+/*
+ *  Purpose: Cancel a search and free it.
+ *
+ *  Parameters:
+ *    - search: Pointer to the Search to free.
+ *
+ *  Returns: None.
+ */
+void search_free(Search* search);
+
+#endif /* SEARCH_H_ */
@@ -0,0 +1,82 @@
+/*
+ *  Session snapshots. When a large file is closed unmodified, its lines are written to the cache as a
+ *  line index and one blob of text, along with the cursor and camera. The next time the same version of
+ *  the file is opened, the snapshot is mapped and the lines borrow their characters from it, so the file
+ *  is not read or scanned for newlines and opening it costs one pass over the line index.
+ */
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "editor.h"
+#include "vec.h"
+
+// Smaller files load in a few milliseconds, which a snapshot would not improve on
+#define SNAPSHOT_MIN_FILE_SIZE (1024 * 1024)
+#define SNAPSHOT_MAGIC "MEDSNAP1"
+#define SNAPSHOT_PATH_CAPACITY 4096
+
+// Layout of a snapshot: this header, then 'num_lines' + 1 offsets of the lines into the text (uint64_t),
+// then 'text_size' bytes of text with no newlines
+typedef struct {
+    char magic[8];
+    uint64_t file_size;       // The version of the file the snapshot was taken of
+    int64_t file_mtime_s;
+    int64_t file_mtime_ns;
+    uint64_t num_lines;
+    uint64_t text_size;
+    uint64_t cursor_row;
+    uint64_t cursor_col;
+    float camera_x;
+    float camera_y;
+    char file_path[SNAPSHOT_PATH_CAPACITY]; // Absolute path of the file
+} SnapshotHeader;
+
+/*
+ *  Purpose: Fill in the version of a file a snapshot is taken of: its absolute path, size and modification time.
+ *
+ *  Parameters:
+ *    - file_path: Null-terminated path to the file.
+ *    - key: Pointer to the header receiving the version, other fields are zeroed. It is all zeroes if the file
+ *           could not be examined, which is the version of no file.
+ *
+ *  Returns:
+ *    - true if the file could be examined.
+ *    - false otherwise.
+ */
+bool snapshot_key(const char* file_path, SnapshotHeader* key);
+
+/*
+ *  Purpose: Restore a file from its snapshot, if there is one for the version of the file on disk.
+ *
+ *  Parameters:
+ *    - file_path: Null-terminated path to the file.
+ *    - editor: Pointer to an empty Editor structure. Its lines borrow their characters from the snapshot,
+ *              which stays mapped until 'editor_free'.
+ *    - camera_pos: Pointer set to the position of the camera when the snapshot was taken.
+ *
+ *  Returns:
+ *    - true if the file was restored.
+ *    - false otherwise (the Editor and camera are left untouched).
+ */
+bool snapshot_restore(const char* file_path, Editor* editor, Vec2f* camera_pos);
+
+/*
+ *  Purpose: Take a snapshot of a file whose Editor holds exactly the version on disk. If the Editor was
+ *           restored from a snapshot of that version, only the cursor and camera are updated.
+ *
+ *  Parameters:
+ *    - file_path: Null-terminated path to the file.
+ *    - editor: Pointer to the Editor structure, without unsaved edits.
+ *    - version: Pointer to the version of the file the lines of the Editor were last known to be, from
+ *               'snapshot_key'. Nothing is written if the file on disk is no longer that version.
+ *    - camera_pos: The position of the camera.
+ *
+ *  Returns:
+ *    - true if the snapshot was written.
+ *    - false if the file changed, is too small to need one or the snapshot could not be written.
+ */
+bool snapshot_save(const char* file_path, const Editor* editor, const SnapshotHeader* version, Vec2f camera_pos);
+
+#endif /* SNAPSHOT_H_ */
@@ -4,10 +4,14 @@
 #ifndef UTILS_H_
 #define UTILS_H_
 
+#include <stdbool.h>
 #include "SDL.h"
 #include "font.h"
 #include "editor.h"
 
+// Directory under $XDG_CACHE_HOME (or ~/.cache) holding the caches of the editor
+#define UTILS_CACHE_DIR_NAME "med"
+
 /*
  *  Purpose: Handle SDL errors, check the error code, and exit on failure.
  *
@@ -38,6 +42,19 @@ void* utils_scp(void* ptr);
  */
 void* utils_cp(void* ptr);
 
+/*
+ *  Purpose: Get the cache directory of the editor, creating it if needed.
+ *
+ *  Parameters:
+ *    - dir: Buffer receiving the null-terminated path.
+ *    - size: The size of the buffer.
+ *
+ *  Returns:
+ *    - true if the directory exists.
+ *    - false if there is no usable cache directory.
+ */
+bool utils_cache_dir(char* dir, size_t size);
+
 /*
  *  Purpose: Perform cleanup by freeing resources and quitting SDL and related libraries.
  *
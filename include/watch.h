@@ -0,0 +1,74 @@
+/*
+ *  Watching a file for changes made by other processes. On Linux the directory of the file is watched
+ *  with inotify, which also sees the file being replaced by a rename. Elsewhere, or if inotify is not
+ *  available, the file is polled with stat every WATCH_POLL_INTERVAL_MS.
+ */
+#ifndef WATCH_H_
+#define WATCH_H_
+
+#include <stdbool.h>
+#include "SDL.h"
+
+#define WATCH_POLL_INTERVAL_MS 500
+
+// What stat reported the last time the file was looked at
+typedef struct {
+    bool exists;
+    long long size;
+    long long mtime_s;
+    long long mtime_ns;
+    unsigned long long inode;
+} WatchStat;
+
+typedef struct {
+    char* path;
+    const char* name;      // The file name inside 'path'
+    int inotify_fd;        // -1 when polling
+    WatchStat last;
+    Uint32 next_poll_ms;
+} Watch;
+
+/*
+ *  Purpose: Start watching a file, which does not have to exist yet. The watch should be released with 'watch_free'.
+ *
+ *  Parameters:
+ *    - file_path: Null-terminated path to the file.
+ *
+ *  Returns:
+ *    - Pointer to the new Watch.
+ */
+Watch* watch_open(const char* file_path);
+
+/*
+ *  Purpose: Check whether the file changed since the last call, without blocking.
+ *
+ *  Parameters:
+ *    - watch: Pointer to the Watch.
+ *
+ *  Returns:
+ *    - true if the file was written, created, replaced or removed.
+ *    - false otherwise.
+ */
+bool watch_poll(Watch* watch);
+
+/*
+ *  Purpose: Get the size of the file and the identity of the inode it is stored in now.
+ *
+ *  Parameters:
+ *    - watch: Pointer to the Watch.
+ *
+ *  Returns: What stat reports for the file (with 'exists' false if it does not exist).
+ */
+WatchStat watch_stat(const Watch* watch);
+
+/*
+ *  Purpose: Stop watching the file and free the Watch.
+ *
+ *  Parameters:
+ *    - watch: Pointer to the Watch to free.
+ *
+ *  Returns: None.
+ */
+void watch_free(Watch* watch);
+
+#endif /* WATCH_H_ */
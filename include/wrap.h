@@ -0,0 +1,154 @@
+/*
+ *  Soft wrapping. Lines longer than the window are broken into visual rows, after the last space that
+ *  fits or at the edge when there is none. The layout caches how many rows every line takes at the
+ *  current width and keeps their prefix sums in a Fenwick tree, so a visual row is mapped to its line,
+ *  and a line to its first visual row, in O(log n). Edited lines are measured again as the Editor
+ *  reports them; when the width changes, lines keep their old count until they come into view.
+ */
+#ifndef WRAP_H_
+#define WRAP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "editor.h"
+#include "line.h"
+
+#define WRAP_INIT_CAPACITY 1024
+// Characters read at a time when looking back for the space a visual row ends after
+#define WRAP_SCAN_WINDOW 64
+
+typedef struct {
+    size_t rows;            // Visual rows of the line when it was last measured
+    uint32_t generation;    // The width it was measured at, 0 if it never was
+} WrapLine;
+
+typedef struct {
+    Editor* editor;
+    size_t width;           // Columns of a visual row
+    uint32_t generation;    // Counts the widths, lines measured at another one are stale
+
+    // One entry per line of the Editor, and the Fenwick tree of their rows (1-based, 'capacity' + 1 entries)
+    size_t capacity;
+    size_t size;
+    WrapLine* lines;
+    size_t* tree;
+    size_t total_rows;
+
+    // Where the last move up or down left the cursor, and the column it started from
+    size_t goal_row;
+    size_t goal_col;
+    size_t goal_x;
+} WrapLayout;
+
+/*
+ *  Purpose: Create a layout following the changes to an Editor. The lines are measured as they are needed.
+ *           The layout should be released with 'wrap_free'. Main thread only.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *    - width: The number of columns of a visual row, above 0.
+ *
+ *  Returns:
+ *    - Pointer to the new WrapLayout.
+ */
+WrapLayout* wrap_create(Editor* editor, size_t width);
+
+/*
+ *  Purpose: Change the width of the visual rows. The lines are measured again once they come into view.
+ *
+ *  Parameters:
+ *    - layout: Pointer to the WrapLayout.
+ *    - width: The number of columns of a visual row, above 0.
+ *
+ *  Returns: None.
+ */
+void wrap_set_width(WrapLayout* layout, size_t width);
+
+/*
+ *  Purpose: Find where the visual row starting at a column of a line ends.
+ *
+ *  Parameters:
+ *    - line: Pointer to the line, which may be chunked.
+ *    - start: The column the row starts at, below the size of the line unless it is empty.
+ *    - width: The number of columns of a visual row, above 0.
+ *
+ *  Returns:
+ *    - The column after the last one of the row, 'size' for the last row of the line.
+ */
+size_t wrap_segment_end(const Line* line, size_t start, size_t width);
+
+/*
+ *  Purpose: Measure the lines covering a range of visual rows that are stale, until the range is covered by
+ *           lines measured at the current width.
+ *
+ *  Parameters:
+ *    - layout: Pointer to the WrapLayout.
+ *    - first_row: The first visual row of the range.
+ *    - num_rows: The number of visual rows in the range.
+ *    - anchor_row: A line whose place on screen should not change, usually the one of the cursor.
+ *
+ *  Returns:
+ *    - The number of visual rows added before the anchor line (negative if removed), by which the view
+ *      should be moved to keep the anchor in place.
+ */
+ptrdiff_t wrap_update_visible(WrapLayout* layout, size_t first_row, size_t num_rows, size_t anchor_row);
+
+/*
+ *  Purpose: Find the line holding a visual row.
+ *
+ *  Parameters:
+ *    - layout: Pointer to the WrapLayout.
+ *    - visual_row: The visual row, past the last one for the end of the text.
+ *    - sub_row: Pointer set to the row within the line (can be NULL).
+ *
+ *  Returns:
+ *    - The index of the line, 0 for an Editor without lines.
+ */
+size_t wrap_locate(WrapLayout* layout, size_t visual_row, size_t* sub_row);
+
+/*
+ *  Purpose: Find the visual row of a position, measuring its line if it is stale.
+ *
+ *  Parameters:
+ *    - layout: Pointer to the WrapLayout.
+ *    - row: The index of the line.
+ *    - col: The column on the line.
+ *    - segment_start: Pointer set to the column the visual row starts at (can be NULL).
+ *
+ *  Returns:
+ *    - The visual row.
+ */
+size_t wrap_visual_row(WrapLayout* layout, size_t row, size_t col, size_t* segment_start);
+
+/*
+ *  Purpose: Move the cursor one visual row up, keeping its column on screen.
+ *
+ *  Parameters:
+ *    - layout: Pointer to the WrapLayout.
+ *
+ *  Returns: None.
+ */
+void wrap_up_arrow(WrapLayout* layout);
+
+/*
+ *  Purpose: Move the cursor one visual row down, keeping its column on screen.
+ *
+ *  Parameters:
+ *    - layout: Pointer to the WrapLayout.
+ *
+ *  Returns: None.
+ */
+void wrap_down_arrow(WrapLayout* layout);
+
+/*
+ *  Purpose: Stop following the Editor and free the WrapLayout.
+ *
+ *  Parameters:
+ *    - layout: Pointer to the WrapLayout to free.
+ *
+ *  Returns: None.
+ */
+void wrap_free(WrapLayout* layout);
+
+#endif /* WRAP_H_ */
@@ -2,46 +2,65 @@
  *  Aims to enhance text scrolling with a virtual camera for smoother movement.
  *  Unlike traditional scrolling, it provides fluid, dynamic text motion.
  */
+#include <math.h>
+
 #include "camera.h"
 #include "editor.h"
+#include "fold.h"
 #include "font.h"
 #include "SDL.h" // Uint32
 
 /*
- *  Purpose: Update the camera's position to smoothly follow the cursor in a text editor.
+ *  Purpose: Move the camera smoothly towards a target. The remaining distance decays exponentially with the
+ *           measured frame time, so the motion is the same at any FPS.
  *
  *  Parameters:
  *    - camera: Pointer to the Camera structure to be updated.
- *    - editor: Pointer to the Editor structure containing cursor position information.
+ *    - target: The position the camera should end up at.
+ *    - delta_time_s: Time in seconds since the previous update.
  *
- *  Returns: None.
+ *  Returns:
+ *    - true if the camera has converged on the target and no further updates are needed.
+ *    - false otherwise.
  */
-void camera_update(Camera* camera, Editor* editor)
+bool camera_follow(Camera* camera, Vec2f target, float delta_time_s)
 {
-    // Calculate the cursor's position in screen space.
-    Vec2f cursor_pos = vec2f(editor->cursor_col * FONT_WIDTH * FONT_SCALE, editor->cursor_row * FONT_HEIGHT * FONT_SCALE);
+    Vec2f distance = vec2f_sub(target, camera->pos);
+
+    // Close enough to be indistinguishable on screen, so stop moving.
+    if (fabsf(distance.x) < CAMERA_SNAP_DISTANCE && fabsf(distance.y) < CAMERA_SNAP_DISTANCE) {
+        camera->pos = target;
+        return true;
+    }
 
-    // Determine the camera's velocity, which points toward the cursor.
-    camera->vel = vec2f_sub(cursor_pos, camera->pos);
+    // Exact solution of d' = -speed * d over the frame: the fraction of the distance left is
+    // exp(-speed * dt), which never overshoots however long the frame took.
+    float step = 1.0f - expf(-DEFAULT_CAMERA_SPEED * delta_time_s);
+    camera->pos = vec2f_add(camera->pos, vec2f_scale(distance, step));
 
-    // Update the camera's position to approach the cursor smoothly.
-    // The update rate is adjusted for consistent movement regardless of FPS.
-    camera->pos = vec2f_add(camera->pos, vec2f_scale(camera->vel, FRAME_TARGET_TIME_S * DEFAULT_CAMERA_SPEED));
+    return false;
 }
 
 /*
- *  Purpose: Scale the camera's velocity to adjust its movement speed. A larger scale value 
- *           increases the speed, while a smaller scale value decreases it.
+ *  Purpose: Update the camera's position to smoothly follow the cursor in a text editor. The remaining
+ *           distance decays exponentially with the measured frame time, so the motion is the same at any FPS.
  *
  *  Parameters:
- *    - camera: Pointer to the Camera structure to be modified.
- *    - scale: Scaling factor to adjust the camera's speed (1.0 maintains the current speed).
+ *    - camera: Pointer to the Camera structure to be updated.
+ *    - editor: Pointer to the Editor structure containing cursor position information.
+ *    - folds: Pointer to the FoldStore hiding lines, which the cursor is placed without (can be NULL).
+ *    - delta_time_s: Time in seconds since the previous update.
  *
- *  Returns: None.
+ *  Returns:
+ *    - true if the camera has converged on the cursor and no further updates are needed.
+ *    - false otherwise.
  */
-void camera_scale_speed(Camera* camera, float scale)
+bool camera_update(Camera* camera, Editor* editor, FoldStore* folds, float delta_time_s)
 {
-    camera->vel = vec2f_scale(camera->vel, scale);
+    // Calculate the cursor's position in screen space.
+    size_t row = folds != NULL ? fold_row_of(folds, editor->cursor_row) : editor->cursor_row;
+    Vec2f cursor_pos = vec2f(editor->cursor_col * FONT_WIDTH * FONT_SCALE, row * FONT_HEIGHT * FONT_SCALE);
+    return camera_follow(camera, cursor_pos, delta_time_s);
 }
 
 /*
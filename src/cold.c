@@ -0,0 +1,513 @@
+/*
+ *  Compression of the lines far from the camera and the cursor. Runs of lines are packed into blocks of
+ *  about COLD_BLOCK_SIZE characters with the built-in LZ codec and the lines' own characters are freed:
+ *  a cold line keeps its size but has no characters. Blocks are unpacked again when their lines are read,
+ *  into a small cache that evicts the least recently used block first, and are given back to their lines
+ *  for good when one of them is edited.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "cold.h"
+#include "line.h"
+#include "lz.h"
+#include "mem.h"
+#include "SDL.h"
+
+/*
+ *  Purpose: Find the block holding a row, or the first block after it.
+ *
+ *  Parameters:
+ *    - store: Pointer to the ColdStore.
+ *    - row: The index of the line.
+ *
+ *  Returns: The index of the first block that ends after the row ('store->size' if there is none).
+ */
+static size_t cold_find_block(const ColdStore* store, size_t row)
+{
+    size_t low = 0, high = store->size;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        const ColdBlock* block = store->blocks[mid];
+        if (block->first_row + block->num_lines <= row)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+/*
+ *  Purpose: Unpack the characters of a block, exiting if they are corrupt.
+ *
+ *  Parameters:
+ *    - block: Pointer to the ColdBlock.
+ *    - chars: Pointer to room for 'block->raw_size' characters.
+ *
+ *  Returns: None.
+ */
+static void cold_unpack(const ColdBlock* block, char* chars)
+{
+    if (!lz_decompress(block->packed, block->packed_size, chars, block->raw_size)) {
+        fprintf(stderr, "ERROR: the cold lines from line %zu are corrupt\n", block->first_row + 1);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*
+ *  Purpose: Unlink a block from the recently used list.
+ *
+ *  Parameters:
+ *    - store: Pointer to the ColdStore.
+ *    - block: Pointer to the cached block.
+ *
+ *  Returns: None.
+ */
+static void cold_unlink(ColdStore* store, ColdBlock* block)
+{
+    if (block->prev != NULL)
+        block->prev->next = block->next;
+    else
+        store->most_recent = block->next;
+
+    if (block->next != NULL)
+        block->next->prev = block->prev;
+    else
+        store->least_recent = block->prev;
+
+    block->prev = block->next = NULL;
+}
+
+/*
+ *  Purpose: Make a block the most recently used one.
+ *
+ *  Parameters:
+ *    - store: Pointer to the ColdStore.
+ *    - block: Pointer to a block that is not in the list.
+ *
+ *  Returns: None.
+ */
+static void cold_push_front(ColdStore* store, ColdBlock* block)
+{
+    block->next = store->most_recent;
+    if (store->most_recent != NULL)
+        store->most_recent->prev = block;
+    else
+        store->least_recent = block;
+    store->most_recent = block;
+}
+
+/*
+ *  Purpose: Drop the unpacked characters of a cached block.
+ *
+ *  Parameters:
+ *    - store: Pointer to the ColdStore.
+ *    - block: Pointer to the cached block.
+ *
+ *  Returns: None.
+ */
+static void cold_uncache(ColdStore* store, ColdBlock* block)
+{
+    cold_unlink(store, block);
+    mem_free(MEM_COLD, block->chars);
+    mem_free(MEM_COLD, block->lines);
+    block->chars = NULL;
+    block->lines = NULL;
+    store->num_cached--;
+}
+
+/*
+ *  Purpose: Check whether a line can be packed, owned characters are freed while borrowed ones are not worth it.
+ *
+ *  Parameters:
+ *    - line: Pointer to the line.
+ *
+ *  Returns:
+ *    - true if the line is hot and can go into a block.
+ *    - false otherwise.
+ */
+static bool cold_packable(const Line* line)
+{
+    bool borrowed = line->capacity == 0 && line->chars != NULL;
+    return !borrowed && !line_is_chunked(line) && !cold_is_cold(line) && line->size <= COLD_MAX_LINE_SIZE;
+}
+
+/*
+ *  Purpose: Check whether a row is close enough to another one to be kept.
+ *
+ *  Parameters:
+ *    - row: The index of the line.
+ *    - near_row: The index of the line it is measured from.
+ *    - distance: The largest distance that counts as close.
+ *
+ *  Returns:
+ *    - true if the rows are at most 'distance' lines apart.
+ *    - false otherwise.
+ */
+static bool cold_near(size_t row, size_t near_row, size_t distance)
+{
+    return (row > near_row ? row - near_row : near_row - row) <= distance;
+}
+
+/*
+ *  Purpose: Pack a run of lines into a new block and free their characters.
+ *
+ *  Parameters:
+ *    - store: Pointer to the ColdStore.
+ *    - lines: Pointer to the lines.
+ *    - first_row: The index of the first line of the run.
+ *    - num_lines: The number of lines in the run.
+ *    - raw_size: The number of characters in the run.
+ *    - index: Where the block goes in the ordered blocks.
+ *
+ *  Returns: None.
+ */
+static void cold_pack_block(ColdStore* store, Line* lines, size_t first_row, size_t num_lines, size_t raw_size, size_t index)
+{
+    if (raw_size > store->scratch_capacity) {
+        size_t new_capacity = store->scratch_capacity == 0 ? COLD_BLOCK_SIZE : store->scratch_capacity;
+        while (new_capacity < raw_size)
+            new_capacity *= 2;
+        mem_free(MEM_COLD, store->scratch);
+        mem_free(MEM_COLD, store->packed);
+        store->scratch = mem_malloc(MEM_COLD, new_capacity);
+        store->packed = mem_malloc(MEM_COLD, LZ_BOUND(new_capacity));
+        store->scratch_capacity = new_capacity;
+    }
+
+    size_t offset = 0;
+    for (size_t i = first_row; i < first_row + num_lines; i++) {
+        if (lines[i].size > 0)
+            memcpy(store->scratch + offset, lines[i].chars, lines[i].size);
+        offset += lines[i].size;
+    }
+    size_t packed_size = lz_compress(store->scratch, raw_size, store->packed, store->table);
+
+    ColdBlock* block = mem_calloc(MEM_COLD, 1, sizeof(*block));
+    block->first_row = first_row;
+    block->num_lines = num_lines;
+    block->raw_size = raw_size;
+    block->packed_size = packed_size;
+    block->packed = mem_malloc(MEM_COLD, packed_size);
+    memcpy(block->packed, store->packed, packed_size);
+
+    // The sizes stay with the lines, so they can be measured without unpacking them
+    for (size_t i = first_row; i < first_row + num_lines; i++) {
+        if (lines[i].capacity > 0)
+            mem_free(MEM_LINES, lines[i].chars);
+        lines[i].chars = NULL;
+        lines[i].capacity = 0;
+    }
+
+    if (store->size == store->capacity) {
+        store->capacity = store->capacity == 0 ? COLD_INIT_CAPACITY : store->capacity * 2;
+        store->blocks = mem_realloc(MEM_COLD, store->blocks, store->capacity * sizeof(store->blocks[0]));
+    }
+    memmove(store->blocks + index + 1, store->blocks + index, (store->size - index) * sizeof(store->blocks[0]));
+    store->blocks[index] = block;
+    store->size++;
+    store->raw_bytes += raw_size;
+    store->packed_bytes += packed_size;
+}
+
+/*
+ *  Purpose: Create an empty store. It should be released with 'cold_free'.
+ *
+ *  Parameters: None.
+ *
+ *  Returns:
+ *    - Pointer to the new ColdStore.
+ */
+ColdStore* cold_create(void)
+{
+    ColdStore* store = mem_calloc(MEM_COLD, 1, sizeof(*store));
+    store->table = mem_malloc(MEM_COLD, LZ_HASH_SIZE * sizeof(store->table[0]));
+    return store;
+}
+
+/*
+ *  Purpose: Check whether a line is cold, i.e. its characters are only in a block.
+ *
+ *  Parameters:
+ *    - line: Pointer to the line.
+ *
+ *  Returns:
+ *    - true if the line has characters but does not hold them.
+ *    - false otherwise.
+ */
+bool cold_is_cold(const Line* line)
+{
+    return line->chars == NULL && line->size > 0;
+}
+
+/*
+ *  Purpose: Pack runs of lines far from the camera and the cursor into blocks, continuing where the last call
+ *           stopped. The last line is never packed since text is appended to it. Runs next to the kept lines
+ *           or the last line are only packed once they fill a block, as they may still grow.
+ *
+ *  Parameters:
+ *    - store: Pointer to the ColdStore.
+ *    - lines: Pointer to the lines, whose packed characters are freed.
+ *    - num_lines: The number of lines.
+ *    - camera_row: The first line on screen.
+ *    - cursor_row: The line of the cursor.
+ *    - budget_ms: Time in milliseconds the call may take.
+ *
+ *  Returns:
+ *    - true if there may be more to pack.
+ *    - false if a whole sweep over the lines found nothing to pack.
+ */
+bool cold_pack(ColdStore* store, Line* lines, size_t num_lines, size_t camera_row, size_t cursor_row, Uint32 budget_ms)
+{
+    // Lines only leave the kept ones in numbers worth a sweep once the camera or the cursor moved far enough
+    if (store->settled && num_lines == store->settled_num_lines &&
+        cold_near(camera_row, store->settled_camera_row, COLD_KEEP_LINES / 2) &&
+        cold_near(cursor_row, store->settled_cursor_row, COLD_KEEP_LINES / 2))
+        return false;
+    store->settled = false;
+
+    Uint32 start_ms = SDL_GetTicks();
+    size_t last_row = num_lines > 0 ? num_lines - 1 : 0;
+    size_t row = store->scan_row < last_row ? store->scan_row : 0;
+    size_t index = cold_find_block(store, row);
+
+    while (store->swept < last_row) {
+        if (SDL_GetTicks() - start_ms >= budget_ms) {
+            store->scan_row = row;
+            return true;
+        }
+        if (row >= last_row) {
+            row = 0;
+            index = 0;
+        }
+
+        if (index < store->size && store->blocks[index]->first_row <= row) {
+            const ColdBlock* block = store->blocks[index++];
+            store->swept += block->first_row + block->num_lines - row;
+            row = block->first_row + block->num_lines;
+            continue;
+        }
+
+        size_t limit = index < store->size && store->blocks[index]->first_row < last_row ? store->blocks[index]->first_row : last_row;
+        size_t end = row, raw_size = 0;
+        while (end < limit && raw_size < COLD_BLOCK_SIZE && cold_packable(lines + end) &&
+               !cold_near(end, camera_row, COLD_KEEP_LINES) && !cold_near(end, cursor_row, COLD_KEEP_LINES))
+            raw_size += lines[end++].size;
+
+        // Runs cut short by the kept lines or the last line may still grow, they wait until they fill a block
+        bool full = raw_size >= COLD_BLOCK_SIZE;
+        bool open = !full && (end == last_row || (end < limit && cold_packable(lines + end)));
+        if (end == row || open) {
+            end = end > row ? end : row + 1;
+            store->swept += end - row;
+            row = end;
+            continue;
+        }
+
+        cold_pack_block(store, lines, row, end - row, raw_size, index++);
+        store->swept = 0;
+        row = end;
+    }
+
+    store->scan_row = row;
+    store->swept = 0;
+    store->settled = true;
+    store->settled_num_lines = num_lines;
+    store->settled_camera_row = camera_row;
+    store->settled_cursor_row = cursor_row;
+    return false;
+}
+
+/*
+ *  Purpose: Get a cold line, unpacking its block into the cache if it is not there. Main thread only.
+ *
+ *  Parameters:
+ *    - store: Pointer to the ColdStore.
+ *    - lines: Pointer to the lines.
+ *    - row: The index of a cold line.
+ *
+ *  Returns:
+ *    - Pointer to the line. It stays valid until the next call, which may evict its block.
+ */
+const Line* cold_get_line(ColdStore* store, const Line* lines, size_t row)
+{
+    size_t index = cold_find_block(store, row);
+    assert(index < store->size && store->blocks[index]->first_row <= row);
+    ColdBlock* block = store->blocks[index];
+
+    if (block->chars == NULL) {
+        while (store->num_cached >= COLD_CACHE_BLOCKS)
+            cold_uncache(store, store->least_recent);
+
+        block->chars = mem_malloc(MEM_COLD, block->raw_size);
+        block->lines = mem_malloc(MEM_COLD, block->num_lines * sizeof(block->lines[0]));
+        cold_unpack(block, block->chars);
+
+        // The lines borrow the cached characters
+        size_t offset = 0;
+        for (size_t i = 0; i < block->num_lines; i++) {
+            size_t size = lines[block->first_row + i].size;
+            block->lines[i] = (Line) {.capacity = 0, .size = size, .chars = block->chars + offset};
+            offset += size;
+        }
+        cold_push_front(store, block);
+        store->num_cached++;
+    } else if (block != store->most_recent) {
+        cold_unlink(store, block);
+        cold_push_front(store, block);
+    }
+    return block->lines + row - block->first_row;
+}
+
+/*
+ *  Purpose: Get a cold line without the cache, so it can be used by any thread while the lines do not change.
+ *
+ *  Parameters:
+ *    - store: Pointer to the ColdStore.
+ *    - lines: Pointer to the lines.
+ *    - row: The index of a cold line.
+ *    - reader: Pointer to a zero-initialized ColdReader of the calling thread, freed with 'cold_reader_free'.
+ *
+ *  Returns:
+ *    - Pointer to the line. It stays valid until the next call with the same reader.
+ */
+const Line* cold_read_line(const ColdStore* store, const Line* lines, size_t row, ColdReader* reader)
+{
+    size_t index = cold_find_block(store, row);
+    assert(index < store->size && store->blocks[index]->first_row <= row);
+    const ColdBlock* block = store->blocks[index];
+
+    if (reader->block != block) {
+        if (block->raw_size > reader->capacity) {
+            reader->capacity = block->raw_size;
+            reader->chars = mem_realloc(MEM_COLD, reader->chars, reader->capacity);
+        }
+        cold_unpack(block, reader->chars);
+        reader->block = block;
+        reader->row = block->first_row;
+        reader->offset = 0;
+    }
+
+    // Lines are usually read in order, so the offset of the last one read is a good start
+    if (row < reader->row) {
+        reader->row = block->first_row;
+        reader->offset = 0;
+    }
+    for (; reader->row < row; reader->row++)
+        reader->offset += lines[reader->row].size;
+
+    reader->line = (Line) {.capacity = 0, .size = lines[row].size, .chars = reader->chars + reader->offset};
+    return &reader->line;
+}
+
+/*
+ *  Purpose: Free the characters of a ColdReader.
+ *
+ *  Parameters:
+ *    - reader: Pointer to the ColdReader.
+ *
+ *  Returns: None.
+ */
+void cold_reader_free(ColdReader* reader)
+{
+    mem_free(MEM_COLD, reader->chars);
+    *reader = (ColdReader) {0};
+}
+
+/*
+ *  Purpose: Give the lines of the blocks holding lines [first_row, last_row] their characters back, before the
+ *           lines are edited.
+ *
+ *  Parameters:
+ *    - store: Pointer to the ColdStore.
+ *    - lines: Pointer to the lines.
+ *    - first_row: The index of the first line.
+ *    - last_row: The index of the last line.
+ *
+ *  Returns: None.
+ */
+void cold_thaw(ColdStore* store, Line* lines, size_t first_row, size_t last_row)
+{
+    size_t first = cold_find_block(store, first_row);
+    size_t end = first;
+
+    for (; end < store->size && store->blocks[end]->first_row <= last_row; end++) {
+        ColdBlock* block = store->blocks[end];
+        char* chars = block->chars;
+        if (chars == NULL) {
+            chars = mem_malloc(MEM_COLD, block->raw_size);
+            cold_unpack(block, chars);
+        }
+
+        size_t offset = 0;
+        for (size_t i = block->first_row; i < block->first_row + block->num_lines; i++) {
+            Line* line = lines + i;
+            if (line->size > 0) {
+                line->chars = mem_malloc(MEM_LINES, line->size);
+                memcpy(line->chars, chars + offset, line->size);
+                line->capacity = line->size;
+            }
+            offset += line->size;
+        }
+
+        if (block->chars != NULL)
+            cold_uncache(store, block);
+        else
+            mem_free(MEM_COLD, chars);
+        store->raw_bytes -= block->raw_size;
+        store->packed_bytes -= block->packed_size;
+        mem_free(MEM_COLD, block->packed);
+        mem_free(MEM_COLD, block);
+    }
+
+    if (end > first) {
+        memmove(store->blocks + first, store->blocks + end, (store->size - end) * sizeof(store->blocks[0]));
+        store->size -= end - first;
+        store->settled = false;
+        store->swept = 0;
+    }
+}
+
+/*
+ *  Purpose: Move the blocks from a row on, after lines were inserted or removed before them.
+ *
+ *  Parameters:
+ *    - store: Pointer to the ColdStore.
+ *    - row: The first row of the blocks to move. No block may hold both this line and the one before it.
+ *    - delta: The number of lines inserted (removed if negative).
+ *
+ *  Returns: None.
+ */
+void cold_shift(ColdStore* store, size_t row, ptrdiff_t delta)
+{
+    for (size_t i = cold_find_block(store, row); i < store->size; i++) {
+        assert(store->blocks[i]->first_row >= row);
+        store->blocks[i]->first_row += delta;
+    }
+}
+
+/*
+ *  Purpose: Free the blocks and the ColdStore. The cold lines are left without characters.
+ *
+ *  Parameters:
+ *    - store: Pointer to the ColdStore to free.
+ *
+ *  Returns: None.
+ */
+void cold_free(ColdStore* store)
+{
+    for (size_t i = 0; i < store->size; i++) {
+        mem_free(MEM_COLD, store->blocks[i]->packed);
+        mem_free(MEM_COLD, store->blocks[i]->chars);
+        mem_free(MEM_COLD, store->blocks[i]->lines);
+        mem_free(MEM_COLD, store->blocks[i]);
+    }
+    mem_free(MEM_COLD, store->blocks);
+    mem_free(MEM_COLD, store->scratch);
+    mem_free(MEM_COLD, store->packed);
+    mem_free(MEM_COLD, store->table);
+    mem_free(MEM_COLD, store);
+}
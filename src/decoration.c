@@ -0,0 +1,494 @@
+/*
+ *  Decorations are ranges of text drawn with a background, like selections, search hits and
+ *  diagnostics. They are kept in a treap ordered by start position, where every node also holds the
+ *  furthest end in its subtree, so the decorations touching a range of rows are found in
+ *  O(log n + k). The store follows the changes to the Editor: the decorations after an edit that
+ *  added or removed lines are moved with a lazy row offset on a subtree, only those on the edited
+ *  lines are visited one by one.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "decoration.h"
+#include "editor.h"
+#include "mem.h"
+
+/*
+ *  Purpose: Compare two positions.
+ *
+ *  Parameters:
+ *    - row_a, col_a: The first position.
+ *    - row_b, col_b: The second position.
+ *
+ *  Returns: A negative number, 0 or a positive number if the first position is before, at or after the second.
+ */
+static int decoration_compare(size_t row_a, size_t col_a, size_t row_b, size_t col_b)
+{
+    if (row_a != row_b)
+        return row_a < row_b ? -1 : 1;
+    if (col_a != col_b)
+        return col_a < col_b ? -1 : 1;
+    return 0;
+}
+
+/*
+ *  Purpose: Move a position past a change to the Editor. Text inserted at a start pushes it forward, text
+ *           inserted at an end does not, so decorations do not grow when typing right after them.
+ *
+ *  Parameters:
+ *    - row, col: Pointers to the position.
+ *    - change: Pointer to the change.
+ *    - is_end: Whether the position is the end of a decoration.
+ *
+ *  Returns: None.
+ */
+static void decoration_map(size_t* row, size_t* col, const EditorChange* change, bool is_end)
+{
+    int order = decoration_compare(*row, *col, change->row, change->col);
+    if (order < 0 || (order == 0 && is_end))
+        return;
+
+    // Positions in the replaced text end up where it started
+    if (decoration_compare(*row, *col, change->old_end_row, change->old_end_col) < 0) {
+        *row = change->row;
+        *col = change->col;
+        return;
+    }
+
+    if (*row == change->old_end_row)
+        *col = change->new_end_col + (*col - change->old_end_col);
+    *row = *row - change->old_end_row + change->new_end_row;
+}
+
+/*
+ *  Purpose: Move every row of a subtree by an offset, in O(1) by leaving the offset on its root.
+ *
+ *  Parameters:
+ *    - store: Pointer to the DecorationStore.
+ *    - n: The index of the root of the subtree (0 for none).
+ *    - offset: The number of rows to add.
+ *
+ *  Returns: None.
+ */
+static void decoration_shift(DecorationStore* store, uint32_t n, int64_t offset)
+{
+    if (n == 0 || offset == 0)
+        return;
+
+    DecorationNode* node = store->nodes + n;
+    node->decoration.start_row += offset;
+    node->decoration.end_row += offset;
+    node->max_end_row += offset;
+    node->row_offset += offset;
+}
+
+/*
+ *  Purpose: Pass the row offset left on a node down to its children.
+ *
+ *  Parameters:
+ *    - store: Pointer to the DecorationStore.
+ *    - n: The index of the node.
+ *
+ *  Returns: None.
+ */
+static void decoration_push(DecorationStore* store, uint32_t n)
+{
+    DecorationNode* node = store->nodes + n;
+    if (node->row_offset != 0) {
+        decoration_shift(store, node->left, node->row_offset);
+        decoration_shift(store, node->right, node->row_offset);
+        node->row_offset = 0;
+    }
+}
+
+/*
+ *  Purpose: Recompute the furthest end of a subtree from its root and children.
+ *
+ *  Parameters:
+ *    - store: Pointer to the DecorationStore.
+ *    - n: The index of the root of the subtree.
+ *
+ *  Returns: None.
+ */
+static void decoration_update(DecorationStore* store, uint32_t n)
+{
+    DecorationNode* node = store->nodes + n;
+    node->max_end_row = node->decoration.end_row;
+    node->max_end_col = node->decoration.end_col;
+
+    uint32_t children[2] = {node->left, node->right};
+    for (size_t i = 0; i < 2; i++) {
+        const DecorationNode* child = store->nodes + children[i];
+        if (children[i] != 0 && decoration_compare(child->max_end_row, child->max_end_col, node->max_end_row, node->max_end_col) > 0) {
+            node->max_end_row = child->max_end_row;
+            node->max_end_col = child->max_end_col;
+        }
+    }
+}
+
+/*
+ *  Purpose: Split a subtree in two by start position.
+ *
+ *  Parameters:
+ *    - store: Pointer to the DecorationStore.
+ *    - n: The index of the root of the subtree (0 for none).
+ *    - row, col: The position to split at.
+ *    - left: Pointer set to the subtree of the decorations starting before the position.
+ *    - right: Pointer set to the subtree of the others.
+ *
+ *  Returns: None.
+ */
+static void decoration_split(DecorationStore* store, uint32_t n, size_t row, size_t col, uint32_t* left, uint32_t* right)
+{
+    if (n == 0) {
+        *left = 0;
+        *right = 0;
+        return;
+    }
+
+    decoration_push(store, n);
+    DecorationNode* node = store->nodes + n;
+    if (decoration_compare(node->decoration.start_row, node->decoration.start_col, row, col) < 0) {
+        decoration_split(store, node->right, row, col, &node->right, right);
+        *left = n;
+    } else {
+        decoration_split(store, node->left, row, col, left, &node->left);
+        *right = n;
+    }
+    decoration_update(store, n);
+}
+
+/*
+ *  Purpose: Join two subtrees, where no decoration of the first starts after one of the second.
+ *
+ *  Parameters:
+ *    - store: Pointer to the DecorationStore.
+ *    - a: The index of the root of the first subtree (0 for none).
+ *    - b: The index of the root of the second subtree (0 for none).
+ *
+ *  Returns: The index of the root of the joined subtree.
+ */
+static uint32_t decoration_merge(DecorationStore* store, uint32_t a, uint32_t b)
+{
+    if (a == 0)
+        return b;
+    if (b == 0)
+        return a;
+
+    if (store->nodes[a].priority > store->nodes[b].priority) {
+        decoration_push(store, a);
+        store->nodes[a].right = decoration_merge(store, store->nodes[a].right, b);
+        decoration_update(store, a);
+        return a;
+    }
+    decoration_push(store, b);
+    store->nodes[b].left = decoration_merge(store, a, store->nodes[b].left);
+    decoration_update(store, b);
+    return b;
+}
+
+/*
+ *  Purpose: Append the nodes of a subtree to the scratch list in order and detach them from each other.
+ *
+ *  Parameters:
+ *    - store: Pointer to the DecorationStore.
+ *    - n: The index of the root of the subtree (0 for none).
+ *
+ *  Returns: None.
+ */
+static void decoration_collect(DecorationStore* store, uint32_t n)
+{
+    if (n == 0)
+        return;
+
+    decoration_push(store, n);
+    uint32_t left = store->nodes[n].left, right = store->nodes[n].right;
+    decoration_collect(store, left);
+
+    DecorationNodeList* list = &store->scratch;
+    if (list->size == list->capacity) {
+        list->capacity = list->capacity == 0 ? DECORATION_INIT_CAPACITY : list->capacity * 2;
+        list->nodes = mem_realloc(MEM_DECORATIONS, list->nodes, list->capacity * sizeof(list->nodes[0]));
+    }
+    list->nodes[list->size++] = n;
+    store->nodes[n].left = 0;
+    store->nodes[n].right = 0;
+    decoration_update(store, n);
+
+    decoration_collect(store, right);
+}
+
+/*
+ *  Purpose: Return a node to the pool.
+ *
+ *  Parameters:
+ *    - store: Pointer to the DecorationStore.
+ *    - n: The index of the node, detached from the tree.
+ *
+ *  Returns: None.
+ */
+static void decoration_release(DecorationStore* store, uint32_t n)
+{
+    store->nodes[n].left = store->free_list;
+    store->free_list = n;
+    store->count--;
+}
+
+/*
+ *  Purpose: Move the decorations of a subtree past a change, when they all start after it.
+ *
+ *  Parameters:
+ *    - store: Pointer to the DecorationStore.
+ *    - n: The index of the root of the subtree (0 for none).
+ *    - change: Pointer to the change.
+ *
+ *  Returns: None.
+ */
+static void decoration_map_subtree(DecorationStore* store, uint32_t n, const EditorChange* change)
+{
+    if (n == 0)
+        return;
+
+    decoration_push(store, n);
+    Decoration* decoration = &store->nodes[n].decoration;
+    bool empty = decoration->start_row == decoration->end_row && decoration->start_col == decoration->end_col;
+    decoration_map(&decoration->start_row, &decoration->start_col, change, false);
+    if (empty) {
+        decoration->end_row = decoration->start_row;
+        decoration->end_col = decoration->start_col;
+    } else
+        decoration_map(&decoration->end_row, &decoration->end_col, change, true);
+
+    decoration_map_subtree(store, store->nodes[n].left, change);
+    decoration_map_subtree(store, store->nodes[n].right, change);
+    decoration_update(store, n);
+}
+
+/*
+ *  Purpose: Move the ends reaching past the start of a change, in a subtree of decorations starting before it.
+ *
+ *  Parameters:
+ *    - store: Pointer to the DecorationStore.
+ *    - n: The index of the root of the subtree (0 for none).
+ *    - change: Pointer to the change.
+ *
+ *  Returns: None.
+ */
+static void decoration_map_ends(DecorationStore* store, uint32_t n, const EditorChange* change)
+{
+    if (n == 0 || decoration_compare(store->nodes[n].max_end_row, store->nodes[n].max_end_col, change->row, change->col) <= 0)
+        return;
+
+    decoration_push(store, n);
+    Decoration* decoration = &store->nodes[n].decoration;
+    decoration_map(&decoration->end_row, &decoration->end_col, change, true);
+
+    decoration_map_ends(store, store->nodes[n].left, change);
+    decoration_map_ends(store, store->nodes[n].right, change);
+    decoration_update(store, n);
+}
+
+/*
+ *  Purpose: Follow a change to the Editor. Called by the Editor through 'editor_add_listener'.
+ *
+ *  Parameters:
+ *    - data: Pointer to the DecorationStore.
+ *    - change: Pointer to the change.
+ *
+ *  Returns: None.
+ */
+static void decoration_on_change(void* data, const EditorChange* change)
+{
+    DecorationStore* store = data;
+    if (store->root == 0)
+        return;
+
+    // Decorations starting before the change, in the replaced text, on the rest of its last line, and after it
+    uint32_t before, replaced, after_row, after, rest;
+    decoration_split(store, store->root, change->row, change->col, &before, &rest);
+    decoration_split(store, rest, change->old_end_row, change->old_end_col, &replaced, &rest);
+    decoration_split(store, rest, change->old_end_row + 1, 0, &after_row, &after);
+
+    decoration_map_ends(store, before, change);
+    decoration_map_subtree(store, after_row, change);
+    decoration_shift(store, after, (int64_t)change->new_end_row - (int64_t)change->old_end_row);
+
+    // The replaced text was deleted, so are the decorations covering nothing but that text
+    store->scratch.size = 0;
+    decoration_collect(store, replaced);
+    replaced = 0;
+    for (size_t i = 0; i < store->scratch.size; i++) {
+        uint32_t n = store->scratch.nodes[i];
+        Decoration* decoration = &store->nodes[n].decoration;
+        bool empty = decoration->start_row == decoration->end_row && decoration->start_col == decoration->end_col;
+        decoration_map(&decoration->start_row, &decoration->start_col, change, false);
+        decoration_map(&decoration->end_row, &decoration->end_col, change, true);
+
+        if (!empty && decoration->start_row == decoration->end_row && decoration->start_col == decoration->end_col)
+            decoration_release(store, n);
+        else {
+            decoration_update(store, n);
+            replaced = decoration_merge(store, replaced, n);
+        }
+    }
+
+    store->root = decoration_merge(store, before, decoration_merge(store, replaced, decoration_merge(store, after_row, after)));
+}
+
+/*
+ *  Purpose: Create an empty store following the changes to an Editor. The store should be released with
+ *           'decoration_free'.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *
+ *  Returns:
+ *    - Pointer to the new DecorationStore.
+ */
+DecorationStore* decoration_create(Editor* editor)
+{
+    DecorationStore* store = mem_calloc(MEM_DECORATIONS, 1, sizeof(*store));
+    store->editor = editor;
+    store->capacity = DECORATION_INIT_CAPACITY;
+    store->nodes = mem_calloc(MEM_DECORATIONS, store->capacity, sizeof(store->nodes[0]));
+    store->size = 1;
+    store->seed = 2463534242u;
+    editor_add_listener(editor, decoration_on_change, store);
+    return store;
+}
+
+/*
+ *  Purpose: Add a decoration.
+ *
+ *  Parameters:
+ *    - store: Pointer to the DecorationStore.
+ *    - decoration: The decoration, which must not end before it starts.
+ *
+ *  Returns: None.
+ */
+void decoration_add(DecorationStore* store, Decoration decoration)
+{
+    assert(decoration_compare(decoration.start_row, decoration.start_col, decoration.end_row, decoration.end_col) <= 0);
+
+    uint32_t n = store->free_list;
+    if (n != 0)
+        store->free_list = store->nodes[n].left;
+    else {
+        if (store->size == store->capacity) {
+            store->capacity *= 2;
+            store->nodes = mem_realloc(MEM_DECORATIONS, store->nodes, store->capacity * sizeof(store->nodes[0]));
+        }
+        n = store->size++;
+    }
+
+    // Xorshift, the priorities only need to look random to keep the treap balanced
+    store->seed ^= store->seed << 13;
+    store->seed ^= store->seed >> 17;
+    store->seed ^= store->seed << 5;
+    store->nodes[n] = (DecorationNode) {.decoration = decoration, .priority = store->seed};
+    decoration_update(store, n);
+    store->count++;
+
+    uint32_t before, after;
+    decoration_split(store, store->root, decoration.start_row, decoration.start_col, &before, &after);
+    store->root = decoration_merge(store, decoration_merge(store, before, n), after);
+}
+
+/*
+ *  Purpose: Remove every decoration of a kind.
+ *
+ *  Parameters:
+ *    - store: Pointer to the DecorationStore.
+ *    - kind: The DecorationKind to remove.
+ *
+ *  Returns: None.
+ */
+void decoration_clear(DecorationStore* store, DecorationKind kind)
+{
+    store->scratch.size = 0;
+    decoration_collect(store, store->root);
+    store->root = 0;
+
+    for (size_t i = 0; i < store->scratch.size; i++) {
+        uint32_t n = store->scratch.nodes[i];
+        if (store->nodes[n].decoration.kind == kind)
+            decoration_release(store, n);
+        else
+            store->root = decoration_merge(store, store->root, n);
+    }
+}
+
+/*
+ *  Purpose: Add the decorations of a subtree touching a range of rows to the results, in order.
+ *
+ *  Parameters:
+ *    - store: Pointer to the DecorationStore.
+ *    - n: The index of the root of the subtree (0 for none).
+ *    - first_row: The first row.
+ *    - last_row: The last row (included).
+ *
+ *  Returns: None.
+ */
+static void decoration_find(DecorationStore* store, uint32_t n, size_t first_row, size_t last_row)
+{
+    // Nothing in the subtree reaches the range
+    if (n == 0 || store->nodes[n].max_end_row < first_row)
+        return;
+
+    decoration_push(store, n);
+    decoration_find(store, store->nodes[n].left, first_row, last_row);
+
+    const Decoration* decoration = &store->nodes[n].decoration;
+    if (decoration->start_row > last_row)
+        return;
+
+    if (decoration->end_row >= first_row) {
+        DecorationBuffer* results = &store->results;
+        if (results->size == results->capacity) {
+            results->capacity = results->capacity == 0 ? DECORATION_INIT_CAPACITY : results->capacity * 2;
+            results->decorations = mem_realloc(MEM_DECORATIONS, results->decorations, results->capacity * sizeof(results->decorations[0]));
+        }
+        results->decorations[results->size++] = *decoration;
+    }
+    decoration_find(store, store->nodes[n].right, first_row, last_row);
+}
+
+/*
+ *  Purpose: Find the decorations that touch a range of rows.
+ *
+ *  Parameters:
+ *    - store: Pointer to the DecorationStore.
+ *    - first_row: The first row.
+ *    - last_row: The last row (included).
+ *    - count: Pointer set to the number of decorations found.
+ *
+ *  Returns:
+ *    - Pointer to the decorations in order of their start, valid until the next query.
+ */
+const Decoration* decoration_query(DecorationStore* store, size_t first_row, size_t last_row, size_t* count)
+{
+    store->results.size = 0;
+    decoration_find(store, store->root, first_row, last_row);
+    *count = store->results.size;
+    return store->results.decorations;
+}
+
+/*
+ *  Purpose: Stop following the Editor and free the store.
+ *
+ *  Parameters:
+ *    - store: Pointer to the DecorationStore to free.
+ *
+ *  Returns: None.
+ */
+void decoration_free(DecorationStore* store)
+{
+    editor_remove_listener(store->editor, decoration_on_change, store);
+    mem_free(MEM_DECORATIONS, store->nodes);
+    mem_free(MEM_DECORATIONS, store->results.decorations);
+    mem_free(MEM_DECORATIONS, store->scratch.nodes);
+    mem_free(MEM_DECORATIONS, store);
+}
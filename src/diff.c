@@ -0,0 +1,177 @@
+/*
+ *  Line-level diff between two versions of a text. Lines are compared by a 64-bit hash, the common
+ *  prefix and suffix are skipped and the rest is diffed with Myers' O(ND) algorithm, so the cost is
+ *  small when few lines changed however long the text is.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "diff.h"
+#include "mem.h"
+
+// One inserted or deleted line, at a position in both texts
+typedef struct {
+    size_t a;
+    size_t b;
+    bool insert;
+} DiffEdit;
+
+/*
+ *  Purpose: Hash a line for 'diff_lines'.
+ *
+ *  Parameters:
+ *    - chars: Pointer to the characters of the line.
+ *    - size: The number of characters.
+ *
+ *  Returns: The 64-bit FNV-1a hash of the characters.
+ */
+uint64_t diff_hash_line(const char* chars, size_t size)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (unsigned char)chars[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/*
+ *  Purpose: Run Myers' algorithm and backtrack through it to list the edits in order.
+ *
+ *  Parameters:
+ *    - a: Pointer to the hashes of the old lines.
+ *    - n: The number of old lines.
+ *    - b: Pointer to the hashes of the new lines.
+ *    - m: The number of new lines.
+ *    - num_edits: Pointer set to the number of edits.
+ *
+ *  Returns:
+ *    - Pointer to the edits, to be freed by the caller.
+ *    - NULL if more than DIFF_MAX_EDITS are needed.
+ */
+static DiffEdit* diff_myers(const uint64_t* a, size_t n, const uint64_t* b, size_t m, size_t* num_edits)
+{
+    size_t max_d = n + m < DIFF_MAX_EDITS ? n + m : DIFF_MAX_EDITS;
+
+    // v[k] is the furthest x reached on diagonal k = x - y. The v of every round is kept for backtracking,
+    // round d only needs diagonals -d..d, so trace[d] is stored from offsets[d] with k shifted by d. The
+    // trace grows with the rounds, a diff of d edits holds about d * d entries and not those of DIFF_MAX_EDITS.
+    long* v = mem_malloc(MEM_OTHER, (2 * max_d + 3) * sizeof(v[0]));
+    size_t trace_capacity = DIFF_TRACE_INIT_CAPACITY;
+    long* trace = mem_malloc(MEM_OTHER, trace_capacity * sizeof(trace[0]));
+    size_t* offsets = mem_malloc(MEM_OTHER, (max_d + 1) * sizeof(offsets[0]));
+    const long shift = max_d + 1;
+    v[shift + 1] = 0;
+
+    long found_d = -1;
+    for (long d = 0; d <= (long)max_d && found_d < 0; d++) {
+        offsets[d] = d == 0 ? 0 : offsets[d - 1] + 2 * d - 1;
+        if (offsets[d] + 2 * d + 1 > trace_capacity) {
+            while (offsets[d] + 2 * d + 1 > trace_capacity)
+                trace_capacity *= 2;
+            trace = mem_realloc(MEM_OTHER, trace, trace_capacity * sizeof(trace[0]));
+        }
+        for (long k = -d; k <= d; k += 2) {
+            long x = k == -d || (k != d && v[shift + k - 1] < v[shift + k + 1]) ? v[shift + k + 1] : v[shift + k - 1] + 1;
+            long y = x - k;
+            while (x < (long)n && y < (long)m && a[x] == b[y])
+                x++, y++;
+            v[shift + k] = x;
+            trace[offsets[d] + k + d] = x;
+
+            if (x >= (long)n && y >= (long)m) {
+                found_d = d;
+                break;
+            }
+        }
+    }
+
+    DiffEdit* edits = NULL;
+    if (found_d >= 0) {
+        edits = mem_malloc(MEM_OTHER, (found_d + 1) * sizeof(edits[0]));
+        *num_edits = found_d;
+
+        long x = n, y = m;
+        for (long d = found_d; d > 0; d--) {
+            // The previous round's furthest points, which the edit of this round started from
+            const long* prev = trace + offsets[d - 1] + (d - 1);
+            long k = x - y;
+            long prev_k = k == -d || (k != d && prev[k - 1] < prev[k + 1]) ? k + 1 : k - 1;
+            long prev_x = prev[prev_k];
+            long prev_y = prev_x - prev_k;
+
+            edits[d - 1] = (DiffEdit) {.a = prev_x, .b = prev_y, .insert = prev_k == k + 1};
+            x = prev_x;
+            y = prev_y;
+        }
+    }
+
+    mem_free(MEM_OTHER, offsets);
+    mem_free(MEM_OTHER, trace);
+    mem_free(MEM_OTHER, v);
+    return edits;
+}
+
+/*
+ *  Purpose: Find the hunks that turn the old lines into the new ones.
+ *
+ *  Parameters:
+ *    - a: Pointer to the hashes of the old lines.
+ *    - a_size: The number of old lines.
+ *    - b: Pointer to the hashes of the new lines.
+ *    - b_size: The number of new lines.
+ *    - num_hunks: Pointer set to the number of hunks.
+ *
+ *  Returns:
+ *    - Pointer to the hunks, in order and not overlapping, to be freed by the caller (NULL if there are none).
+ */
+DiffHunk* diff_lines(const uint64_t* a, size_t a_size, const uint64_t* b, size_t b_size, size_t* num_hunks)
+{
+    *num_hunks = 0;
+
+    // Most changes touch a few lines in one place, which this alone narrows down
+    size_t prefix = 0;
+    while (prefix < a_size && prefix < b_size && a[prefix] == b[prefix])
+        prefix++;
+
+    size_t suffix = 0;
+    while (suffix < a_size - prefix && suffix < b_size - prefix && a[a_size - 1 - suffix] == b[b_size - 1 - suffix])
+        suffix++;
+
+    size_t n = a_size - prefix - suffix, m = b_size - prefix - suffix;
+    if (n == 0 && m == 0)
+        return NULL;
+
+    size_t num_edits = 0;
+    DiffEdit* edits = n > 0 && m > 0 ? diff_myers(a + prefix, n, b + prefix, m, &num_edits) : NULL;
+    if (edits == NULL) {
+        // Only insertions or deletions, or too many edits to be worth finding the lines in common
+        DiffHunk* hunk = mem_malloc(MEM_OTHER, sizeof(*hunk));
+        *hunk = (DiffHunk) {.a_start = prefix, .a_count = n, .b_start = prefix, .b_count = m};
+        *num_hunks = 1;
+        return hunk;
+    }
+
+    // Edits that follow each other without an unchanged line between them form a hunk
+    DiffHunk* hunks = mem_malloc(MEM_OTHER, num_edits * sizeof(hunks[0]));
+    for (size_t i = 0; i < num_edits; i++) {
+        DiffHunk* last = *num_hunks > 0 ? hunks + *num_hunks - 1 : NULL;
+        if (last == NULL || last->a_start + last->a_count != edits[i].a || last->b_start + last->b_count != edits[i].b)
+            hunks[(*num_hunks)++] = (DiffHunk) {.a_start = edits[i].a, .b_start = edits[i].b};
+
+        last = hunks + *num_hunks - 1;
+        if (edits[i].insert)
+            last->b_count++;
+        else
+            last->a_count++;
+    }
+    mem_free(MEM_OTHER, edits);
+
+    for (size_t i = 0; i < *num_hunks; i++) {
+        hunks[i].a_start += prefix;
+        hunks[i].b_start += prefix;
+    }
+    return hunks;
+}
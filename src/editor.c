@@ -3,16 +3,23 @@
 *  These functions are designed to workd with editors that have been zero-initialized.
 *  The editors should be freed using 'editor_free' when they are no longer needed.
 */
+#define _XOPEN_SOURCE 700 // munmap
+
 #include <assert.h>
 #include <string.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
+#include <stdint.h>
+#include <sys/mman.h>
 
 #include "editor.h"
 #include "line.h"
-#include "utils.h"
+#include "mem.h"
+#include "diff.h"
+#include "cold.h"
+#include "intern.h"
 #include "SDL.h"
 
 static int last_input = SDLK_UNKNOWN;
@@ -38,7 +45,7 @@ static void editor_expand(Editor* editor, size_t n)
             new_capacity *= 2;
 
     if (new_capacity != editor->capacity) {
-        editor->lines = utils_cp(realloc(editor->lines, new_capacity * sizeof(editor->lines[0])));
+        editor->lines = mem_realloc(MEM_EDITOR, editor->lines, new_capacity * sizeof(editor->lines[0]));
 
         size_t old_capacity = editor->capacity;
         memset(editor->lines + old_capacity, 0, (new_capacity - old_capacity) * sizeof(editor->lines[0]));
@@ -71,10 +78,272 @@ static void editor_push_new_line(Editor* editor)
  */
 static void editor_handle_first_line(Editor* editor)
 {
-    if (editor->size == 0)
+    // A paged editor is read-only, its lines only come from the file
+    if (editor->size == 0 && editor->pager == NULL)
         editor_push_new_line(editor);
 }
 
+/*
+ *  Purpose: Get a line of the Editor, whether it is in memory or paged from disk.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *    - row: The index of the line, below the size of the Editor.
+ *
+ *  Returns:
+ *    - Pointer to the line. For a paged Editor, a cold line or a chunked line it stays valid until the next call.
+ */
+const Line* editor_get_line(Editor* editor, size_t row)
+{
+    if (editor->pager != NULL)
+        return pager_get_line(editor->pager, row);
+    if (editor->cold != NULL && cold_is_cold(editor->lines + row))
+        return cold_get_line(editor->cold, editor->lines, row);
+
+    // Readers of the characters get them in one piece, joined again only after the text changes
+    const Line* line = editor->lines + row;
+    if (line_is_chunked(line)) {
+        if (editor->flat.chars == NULL || editor->flat_row != row) {
+            line_free(&editor->flat);
+            editor->flat = (Line) {.capacity = line->size, .size = line->size, .chars = mem_malloc(MEM_LINES, line->size)};
+            line_copy_range(line, 0, line->size, editor->flat.chars);
+            editor->flat_row = row;
+        }
+        return &editor->flat;
+    }
+    return line;
+}
+
+/*
+ *  Purpose: Get a line of the Editor like 'editor_get_line', leaving a chunked line as it is. Its characters
+ *           are then read with 'line_copy_range', which is how a long line is read without joining it.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *    - row: The index of the line, below the size of the Editor.
+ *
+ *  Returns:
+ *    - Pointer to the line. For a paged Editor or a cold line it stays valid until the next call.
+ */
+const Line* editor_peek_line(Editor* editor, size_t row)
+{
+    if (editor->pager == NULL && line_is_chunked(editor->lines + row))
+        return editor->lines + row;
+    return editor_get_line(editor, row);
+}
+
+/*
+ *  Purpose: Get a line of an Editor in memory from any thread, while its lines do not change.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *    - row: The index of the line, below the size of the Editor.
+ *    - reader: Pointer to a zero-initialized ColdReader of the calling thread, freed with 'cold_reader_free'.
+ *
+ *  Returns:
+ *    - Pointer to the line. For a cold or a chunked line it stays valid until the next call with the same reader.
+ */
+const Line* editor_read_line(const Editor* editor, size_t row, ColdReader* reader)
+{
+    if (editor->cold != NULL && cold_is_cold(editor->lines + row))
+        return cold_read_line(editor->cold, editor->lines, row, reader);
+
+    // A chunked line is joined in the characters of the reader, which no longer hold a block then
+    const Line* line = editor->lines + row;
+    if (line_is_chunked(line)) {
+        if (line->size > reader->capacity) {
+            reader->capacity = line->size;
+            reader->chars = mem_realloc(MEM_COLD, reader->chars, reader->capacity);
+        }
+        line_copy_range(line, 0, line->size, reader->chars);
+        reader->block = NULL;
+        reader->line = (Line) {.capacity = 0, .size = line->size, .chars = reader->chars};
+        return &reader->line;
+    }
+    return line;
+}
+
+/*
+ *  Purpose: Pack a share of the lines far from the camera and the cursor into compressed blocks. Their
+ *           characters are unpacked again when they are read or edited. The lines must not be read by other
+ *           threads while this runs.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *    - camera_row: The first line on screen.
+ *    - budget_ms: Time in milliseconds the call may take.
+ *
+ *  Returns:
+ *    - true if there may be more to pack.
+ *    - false if every line that can be packed is.
+ */
+bool editor_pack_cold_lines(Editor* editor, size_t camera_row, Uint32 budget_ms)
+{
+    if (editor->pager != NULL)
+        return false;
+    if (editor->cold == NULL)
+        editor->cold = cold_create();
+    return cold_pack(editor->cold, editor->lines, editor->size, camera_row, editor->cursor_row, budget_ms);
+}
+
+/*
+ *  Purpose: Give the cold lines among lines [first_row, last_row] their characters back before they are edited.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *    - first_row: The index of the first line.
+ *    - last_row: The index of the last line.
+ *
+ *  Returns: None.
+ */
+static void editor_thaw(Editor* editor, size_t first_row, size_t last_row)
+{
+    if (editor->cold != NULL)
+        cold_thaw(editor->cold, editor->lines, first_row, last_row);
+}
+
+/*
+ *  Purpose: Move the packed lines from a row on, after lines were inserted or removed before them.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *    - row: The index of the first line to move, in the lines before the change.
+ *    - delta: The number of lines inserted (removed if negative).
+ *
+ *  Returns: None.
+ */
+static void editor_shift_cold(Editor* editor, size_t row, ptrdiff_t delta)
+{
+    if (editor->cold != NULL)
+        cold_shift(editor->cold, row, delta);
+}
+
+/*
+ *  Purpose: Shrink a share of the lines, and then the array of lines, that have much more room than they use.
+ *           The line of the cursor is left alone as it is likely to grow again. The lines must not be read by
+ *           other threads while this runs.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *    - budget_ms: Time in milliseconds the call may take.
+ *
+ *  Returns:
+ *    - true if there is more to shrink.
+ *    - false if no line was changed since the last full pass.
+ */
+bool editor_compact(Editor* editor, Uint32 budget_ms)
+{
+    if (editor->pager != NULL || editor->compacted)
+        return false;
+
+    const Uint64 deadline = SDL_GetPerformanceCounter() + SDL_GetPerformanceFrequency() * budget_ms / 1000;
+    while (editor->compact_row < editor->size) {
+        size_t end = editor->compact_row + EDITOR_COMPACT_CHECK_LINES;
+        for (; editor->compact_row < end && editor->compact_row < editor->size; editor->compact_row++) {
+            if (editor->compact_row != editor->cursor_row)
+                line_shrink_to_fit(editor->lines + editor->compact_row);
+        }
+        if (SDL_GetPerformanceCounter() >= deadline)
+            return true;
+    }
+
+    // Doubling leaves up to half of the array unused, only the slots past the end are given back
+    if (editor->capacity > EDITOR_INIT_CAPACITY && editor->capacity - editor->size > editor->size / 4) {
+        size_t new_capacity = editor->size > EDITOR_INIT_CAPACITY ? editor->size : EDITOR_INIT_CAPACITY;
+        editor->lines = mem_realloc(MEM_EDITOR, editor->lines, new_capacity * sizeof(editor->lines[0]));
+        editor->capacity = new_capacity;
+    }
+    editor->compact_row = 0;
+    editor->compacted = true;
+    return false;
+}
+
+/*
+ *  Purpose: Fill in the slack of the lines and of the array of lines, which are only known to the Editor.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *    - usage: The usage of each subsystem, from 'mem_get_usage'.
+ *
+ *  Returns: None.
+ */
+void editor_memory_usage(const Editor* editor, MemUsage usage[MEM_NUM_SUBSYSTEMS])
+{
+    if (editor->pager != NULL)
+        return;
+
+    // Borrowed and cold lines have a capacity of 0, their characters are counted elsewhere
+    size_t line_slack = 0;
+    for (size_t i = 0; i < editor->size; i++) {
+        const Line* line = editor->lines + i;
+        if (line_is_chunked(line))
+            line_slack += line->chunks->size * LINE_CHUNK_SIZE - line->size;
+        else if (line->capacity > 0)
+            line_slack += line->capacity - line->size;
+    }
+    usage[MEM_LINES].slack_bytes = line_slack;
+    usage[MEM_LINES].has_slack = true;
+    usage[MEM_EDITOR].slack_bytes = (editor->capacity - editor->size) * sizeof(editor->lines[0]);
+    usage[MEM_EDITOR].has_slack = true;
+}
+
+/*
+ *  Purpose: Have a function called after every change to the text of the Editor.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *    - listener: The function to call.
+ *    - data: Pointer passed to the function.
+ *
+ *  Returns: None.
+ */
+void editor_add_listener(Editor* editor, EditorListener listener, void* data)
+{
+    assert(editor->num_listeners < EDITOR_MAX_LISTENERS);
+    editor->listeners[editor->num_listeners] = listener;
+    editor->listener_data[editor->num_listeners] = data;
+    editor->num_listeners++;
+}
+
+/*
+ *  Purpose: Stop calling a function added with 'editor_add_listener'.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *    - listener: The function.
+ *    - data: The pointer it was added with.
+ *
+ *  Returns: None.
+ */
+void editor_remove_listener(Editor* editor, EditorListener listener, void* data)
+{
+    for (size_t i = 0; i < editor->num_listeners; i++) {
+        if (editor->listeners[i] == listener && editor->listener_data[i] == data) {
+            editor->num_listeners--;
+            editor->listeners[i] = editor->listeners[editor->num_listeners];
+            editor->listener_data[i] = editor->listener_data[editor->num_listeners];
+            return;
+        }
+    }
+}
+
+/*
+ *  Purpose: Tell the listeners of the Editor about a change to its text.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *    - change: The change, already applied.
+ *
+ *  Returns: None.
+ */
+static void editor_notify(Editor* editor, EditorChange change)
+{
+    editor->compacted = false;
+    line_free(&editor->flat);
+    for (size_t i = 0; i < editor->num_listeners; i++)
+        editor->listeners[i](editor->listener_data[i], &change);
+}
+
 /*
  *  Purpose: Insert a null-terminated string before the cursor position in the Editor's current line.
  *
@@ -87,7 +356,10 @@ static void editor_handle_first_line(Editor* editor)
 void editor_insert_text_before_cursor(Editor* editor, char* text)
 {
     editor_handle_first_line(editor);
-    line_insert_text_before_cursor(editor->lines + editor->cursor_row, text, &editor->cursor_col);
+    size_t row = editor->cursor_row, col = editor->cursor_col;
+    editor_thaw(editor, row, row);
+    line_insert_text_before_cursor(editor->lines + row, text, &editor->cursor_col);
+    editor_notify(editor, (EditorChange) {row, col, row, col, row, editor->cursor_col});
     last_input = SDL_TEXTINPUT;
 }
 
@@ -105,21 +377,21 @@ void editor_backspace(Editor* editor)
 
     // If cursor is at the start of a line (not the first line), move text to the previous line.
     if (editor->cursor_col == 0 && editor->cursor_row > 0) {
+        editor_thaw(editor, editor->cursor_row - 1, editor->cursor_row);
         Line* curr_line = editor->lines + editor->cursor_row;
         Line* prev_line = curr_line - 1;
 
         // Copy characters from the current line to the previous line.
         size_t num_copy_chars = curr_line->size;
-        line_expand(prev_line, num_copy_chars);
-        memcpy(prev_line->chars + prev_line->size, curr_line->chars, num_copy_chars);
-        prev_line->size += num_copy_chars;
+        line_append_range(prev_line, curr_line, 0, num_copy_chars);
 
         // Free the char buffer of the current line since its data has been copied.
-        free(curr_line->chars);
+        line_free(curr_line);
 
         // Shift all lines up to fill the gap.
         size_t lines_to_shift = editor->size - editor->cursor_row - 1;
         memmove(curr_line, curr_line + 1, lines_to_shift * sizeof(*curr_line));
+        editor_shift_cold(editor, editor->cursor_row + 1, -1);
 
         // Reset the last line to ensure future operations work correctly.
         memset(editor->lines + editor->size - 1, 0, sizeof(*curr_line));
@@ -128,9 +400,14 @@ void editor_backspace(Editor* editor)
         editor->size--;
         editor->cursor_row--;
         editor->cursor_col = prev_line->size - num_copy_chars;
+        editor_notify(editor, (EditorChange) {editor->cursor_row, editor->cursor_col, editor->cursor_row + 1, 0, editor->cursor_row, editor->cursor_col});
     } else {
         // If not at the start of a line, perform a regular backspace within the line.
+        size_t col = editor->cursor_col;
+        editor_thaw(editor, editor->cursor_row, editor->cursor_row);
         line_backspace(editor->lines + editor->cursor_row, &editor->cursor_col);
+        if (editor->cursor_col != col)
+            editor_notify(editor, (EditorChange) {editor->cursor_row, editor->cursor_col, editor->cursor_row, col, editor->cursor_row, editor->cursor_col});
     }
 
     last_input = SDLK_BACKSPACE; 
@@ -150,30 +427,34 @@ void editor_delete(Editor* editor)
 
     if (editor->cursor_col == editor->lines[editor->cursor_row].size && editor->cursor_row < editor->size - 1) {
         // If cursor is at the end of a line and not the last line in the file, move text from the next line to the current line.
+        editor_thaw(editor, editor->cursor_row, editor->cursor_row + 1);
         Line* curr_line = editor->lines + editor->cursor_row;
         Line* next_line = curr_line + 1;
 
         // Copy characters from the next line to the end of the current line.
-        size_t num_copy_chars = next_line->size;
-        line_expand(curr_line, num_copy_chars);
-        memcpy(curr_line->chars + curr_line->size, next_line->chars, num_copy_chars);
-        curr_line->size += num_copy_chars;
+        line_append_range(curr_line, next_line, 0, next_line->size);
 
         // Free the char buffer of the next line since its data has been copied.
-        free(next_line->chars);
+        line_free(next_line);
 
         // Shift all lines up to fill the gap.
         size_t lines_to_shift = editor->size - editor->cursor_row - 2;
         memmove(next_line, next_line + 1, lines_to_shift * sizeof(*curr_line));
+        editor_shift_cold(editor, editor->cursor_row + 2, -1);
 
         // Reset the last line to ensure future operations work correctly.
         memset(editor->lines + editor->size - 1, 0, sizeof(*curr_line));
 
         // update the changes to lines and editor
         editor->size--;
-    } else {
+        size_t row = editor->cursor_row, col = editor->cursor_col;
+        editor_notify(editor, (EditorChange) {row, col, row + 1, 0, row, col});
+    } else if (editor->cursor_col < editor->lines[editor->cursor_row].size) {
         // If not at the end of a line, perform a regular delete operation within the line.
+        editor_thaw(editor, editor->cursor_row, editor->cursor_row);
         line_delete(editor->lines + editor->cursor_row, &editor->cursor_col);
+        size_t row = editor->cursor_row, col = editor->cursor_col;
+        editor_notify(editor, (EditorChange) {row, col, row, col + 1, row, col});
     }
 
     last_input = SDLK_DELETE;
@@ -190,12 +471,14 @@ void editor_delete(Editor* editor)
 void editor_left_arrow(Editor* editor)
 {
     editor_handle_first_line(editor);
+    if (editor->size == 0)
+        return;
 
     if (editor->cursor_col > 0)
         editor->cursor_col--;
     else if (editor->cursor_row > 0) {
         editor->cursor_row--;
-        editor->cursor_col = editor->lines[editor->cursor_row].size;
+        editor->cursor_col = editor_peek_line(editor, editor->cursor_row)->size;
     }
     last_input = SDLK_LEFT;
 }
@@ -211,8 +494,10 @@ void editor_left_arrow(Editor* editor)
 void editor_right_arrow(Editor* editor)
 {
     editor_handle_first_line(editor);
+    if (editor->size == 0)
+        return;
 
-    if (editor->cursor_col < editor->lines[editor->cursor_row].size) 
+    if (editor->cursor_col < editor_peek_line(editor, editor->cursor_row)->size) 
         editor->cursor_col++;
     else if (editor->cursor_row < editor->size - 1 ) {
         editor->cursor_row++;
@@ -232,13 +517,15 @@ void editor_right_arrow(Editor* editor)
 void editor_up_arrow(Editor* editor)
 {
     editor_handle_first_line(editor);
+    if (editor->size == 0)
+        return;
 
     static size_t start_col = 0;
 
     if (editor->cursor_row == 0)
         editor->cursor_col = 0;
     else {
-        size_t new_line_size = editor->lines[editor->cursor_row - 1].size;
+        size_t new_line_size = editor_peek_line(editor, editor->cursor_row - 1)->size;
         editor->cursor_row--;
 
         if (last_input == SDLK_UP) {
@@ -262,14 +549,16 @@ void editor_up_arrow(Editor* editor)
 void editor_down_arrow(Editor* editor)
 {
     editor_handle_first_line(editor);
+    if (editor->size == 0)
+        return;
 
     static size_t start_col = 0;
 
-    size_t bottom_line_size = editor->lines[editor->size - 1].size;
+    size_t bottom_line_size = editor_peek_line(editor, editor->size - 1)->size;
     if (editor->cursor_row == editor->size - 1)
         editor->cursor_col = bottom_line_size;
     else {
-        size_t new_line_size = editor->lines[editor->cursor_row + 1].size;
+        size_t new_line_size = editor_peek_line(editor, editor->cursor_row + 1)->size;
         editor->cursor_row++;
 
         if (last_input == SDLK_DOWN) {
@@ -292,6 +581,9 @@ void editor_down_arrow(Editor* editor)
  */
 void editor_return(Editor* editor)
 {
+    editor_handle_first_line(editor);
+    editor_thaw(editor, editor->cursor_row, editor->cursor_row);
+
     // Create space for a new line
     editor_push_new_line(editor);
 
@@ -299,36 +591,29 @@ void editor_return(Editor* editor)
     Line* curr_line = editor->lines + editor->cursor_row;
     Line* next_line = curr_line + 1;
 
-    // Move lines down, making space for the new line
-    size_t lines_down = editor->size - editor->cursor_row - 1;
+    // Move lines down, making space for the new line (size already counts the new line)
+    size_t lines_down = editor->size - editor->cursor_row - 2;
     memmove(next_line + 1, next_line, lines_down * sizeof(*curr_line));
+    editor_shift_cold(editor, editor->cursor_row + 1, 1);
 
     // Calculate the number of characters for whitespace indentation
-    size_t indentation = 0;
-    for (size_t i = 0; i < curr_line->size; i++) {
-        char ch = curr_line->chars[i];
-        if (ch == ' ')
-            indentation++;
-        else if (ch == '\t')
-            indentation += TAB_STOP;
-        else
-            break;
-    }
+    size_t indentation = line_indentation(curr_line, NULL);
 
-    // Initialize and reallocate the next line
-    size_t num_copy_chars = curr_line->size - editor->cursor_col;
+    // Initialize the next line with the whitespace
     memset(next_line, 0, sizeof(*next_line));
-    line_expand(next_line, num_copy_chars + indentation);
-
-    // Copy whitespace and characters to the new line
-    memset(next_line->chars, ' ', indentation);
-    memcpy(next_line->chars + indentation, curr_line->chars + editor->cursor_col, num_copy_chars);
+    if (indentation > 0) {
+        line_expand(next_line, indentation);
+        memset(next_line->chars, ' ', indentation);
+        next_line->size = indentation;
+    }
 
-    // Update line sizes and cursor position
-    curr_line->size -= num_copy_chars;
-    next_line->size += num_copy_chars + indentation;
+    // Move the characters after the cursor to the new line
+    line_append_range(next_line, curr_line, editor->cursor_col, curr_line->size);
+    line_truncate(curr_line, editor->cursor_col);
+    size_t row = editor->cursor_row, col = editor->cursor_col;
     editor->cursor_row++;
     editor->cursor_col = indentation;
+    editor_notify(editor, (EditorChange) {row, col, row, col, row + 1, indentation});
 }
 
 /*
@@ -369,16 +654,96 @@ void editor_save_to_file(const Editor* editor, const char* file_path)
         exit(EXIT_FAILURE);
     }
 
+    ColdReader reader = {0};
     for (size_t row = 0; row < editor->size; row++) {
-        size_t bytes_to_write = editor->lines[row].size;
-        if (fwrite(editor->lines[row].chars, 1, bytes_to_write, fp) != bytes_to_write)
+        const Line* line = editor_read_line(editor, row, &reader);
+        if (fwrite(line->chars, 1, line->size, fp) != line->size)
             fputs("Error saving file", fp);
         if (row != editor->size - 1)
             fputc('\n', fp);
     }
+    cold_reader_free(&reader);
     fclose(fp);
 }
 
+/*
+ *  Purpose: Split a chunk of text on newlines and append it to the end of the Editor. Chunks can split lines
+ *           anywhere, the text before the first newline of a chunk continues the last line if the previous
+ *           chunk did not end with one.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure to append to.
+ *    - chunk: Pointer to the text to append (not null-terminated).
+ *    - chunk_size: The number of characters in the chunk.
+ *    - new_line: Pointer to whether the chunk starts a new line. Set to true before the first chunk, it is
+ *                updated to whether the next chunk starts a new line.
+ *
+ *  Returns: None.
+ */
+void editor_append_chunk(Editor* editor, char* chunk, size_t chunk_size, bool* new_line)
+{
+    if (chunk_size == 0)
+        return;
+
+    size_t end_row = editor->size > 0 ? editor->size - 1 : 0;
+    size_t end_col = editor->size > 0 ? editor->lines[end_row].size : 0;
+    editor_thaw(editor, end_row, end_row);
+    size_t bytes_left = chunk_size;
+    char* line_start = chunk;
+    char* line_end = memchr(chunk, '\n', bytes_left); // Similar to strchr but bounded by bytes_left
+
+    while (line_end != NULL) { // A new line to process
+        if (*new_line)
+            editor_push_new_line(editor);
+
+        Line* current_line = editor->lines + editor->size - 1;
+
+        size_t text_size = line_end - line_start;
+        line_append_text_segment(current_line, line_start, text_size);
+
+        bytes_left -= text_size + 1;
+        line_start = line_end + 1;
+        line_end = memchr(line_start, '\n', bytes_left);
+        *new_line = true;
+    }
+
+    // If there are characters remaining on the current line, append them
+    if (bytes_left > 0) {
+        if (*new_line)
+            editor_push_new_line(editor);
+
+        Line* current_line = editor->lines + editor->size - 1;
+        line_append_text_segment(current_line, line_start, bytes_left);
+        *new_line = false;
+    }
+
+    // A chunk that ends with a newline leaves the line after it to the next chunk
+    editor_notify(editor, (EditorChange) {end_row, end_col, end_row, end_col, editor->size - 1, editor->lines[editor->size - 1].size});
+}
+
+/*
+ *  Purpose: Move lines to the end of the Editor. The Editor takes ownership of their characters.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure to append to.
+ *    - lines: Pointer to the lines to move.
+ *    - num_lines: The number of lines to move.
+ *
+ *  Returns: None.
+ */
+void editor_append_lines(Editor* editor, const Line* lines, size_t num_lines)
+{
+    if (num_lines == 0)
+        return;
+
+    size_t end_row = editor->size > 0 ? editor->size - 1 : 0;
+    size_t end_col = editor->size > 0 ? editor->lines[end_row].size : 0;
+    editor_expand(editor, num_lines);
+    memcpy(editor->lines + editor->size, lines, num_lines * sizeof(lines[0]));
+    editor->size += num_lines;
+    editor_notify(editor, (EditorChange) {end_row, end_col, end_row, end_col, editor->size - 1, editor->lines[editor->size - 1].size});
+}
+
 /*
  *  Purpose: Load text data from a file and populate the Editor with its contents.
  *
@@ -398,34 +763,130 @@ void editor_load_from_file(Editor* editor, FILE* fp)
 
     while (!feof(fp)) {
         size_t bytes_read = fread(chunk, 1, sizeof(chunk), fp);
-        char* line_start = chunk;
-        char* line_end = memchr(chunk, '\n', bytes_read); // Similar to strchr but bounded by bytes_read
-
-        while (line_end != NULL) { // A new line to process
-            if (new_line)
-                editor_push_new_line(editor);
+        editor_append_chunk(editor, chunk, bytes_read, &new_line);
+    }
+}
 
-            Line* current_line = editor->lines + editor->size - 1;
+/*
+ *  Purpose: Replace a run of lines with other lines. The Editor takes ownership of the new lines' characters.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *    - row: The index of the first line to replace.
+ *    - num_removed: The number of lines to remove, starting at 'row'.
+ *    - lines: Pointer to the lines to insert in their place.
+ *    - num_inserted: The number of lines to insert.
+ *
+ *  Returns: None.
+ */
+static void editor_replace_lines(Editor* editor, size_t row, size_t num_removed, const Line* lines, size_t num_inserted)
+{
+    // Whole lines are replaced up to the start of the next one, or from the end of the previous one at the end of the file
+    bool at_end = row + num_removed == editor->size;
+    EditorChange change = {.row = row, .old_end_row = row + num_removed, .new_end_row = row + num_inserted};
+    if (at_end && row > 0) {
+        change = (EditorChange) {.row = row - 1, .col = editor->lines[row - 1].size};
+        change.old_end_row = editor->size - 1;
+        change.old_end_col = editor->lines[editor->size - 1].size;
+    } else if (at_end) {
+        change.old_end_row = editor->size > 0 ? editor->size - 1 : 0;
+        change.old_end_col = editor->size > 0 ? editor->lines[editor->size - 1].size : 0;
+    }
 
-            size_t text_size = line_end - line_start;
-            line_append_text_segment(current_line, line_start, text_size);
+    // Blocks of cold lines do not straddle the lines around the change either
+    if (editor->size > 0)
+        editor_thaw(editor, row > 0 ? row - 1 : 0, row + num_removed < editor->size ? row + num_removed : editor->size - 1);
+    for (size_t i = row; i < row + num_removed; i++)
+        line_free(&editor->lines[i]);
+
+    if (num_inserted > num_removed)
+        editor_expand(editor, num_inserted - num_removed);
+
+    size_t tail = editor->size - row - num_removed;
+    memmove(editor->lines + row + num_inserted, editor->lines + row + num_removed, tail * sizeof(editor->lines[0]));
+    memcpy(editor->lines + row, lines, num_inserted * sizeof(lines[0]));
+    editor_shift_cold(editor, row + num_removed, (ptrdiff_t)num_inserted - (ptrdiff_t)num_removed);
+
+    // Slots left past the end are zeroed, new lines are expected to start out that way
+    size_t new_size = editor->size - num_removed + num_inserted;
+    if (new_size < editor->size)
+        memset(editor->lines + new_size, 0, (editor->size - new_size) * sizeof(editor->lines[0]));
+    editor->size = new_size;
+
+    if (at_end) {
+        change.new_end_row = new_size > 0 ? new_size - 1 : 0;
+        change.new_end_col = new_size > 0 ? editor->lines[new_size - 1].size : 0;
+    }
+    editor_notify(editor, change);
+}
 
-            bytes_read -= text_size + 1;
-            line_start = line_end + 1;
-            line_end = memchr(line_start, '\n', bytes_read);
-            new_line = true;
-        }
+/*
+ *  Purpose: Hash every line of an Editor for 'diff_lines'.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *
+ *  Returns: Pointer to one hash per line, to be freed by the caller.
+ */
+static uint64_t* editor_hash_lines(const Editor* editor)
+{
+    uint64_t* hashes = mem_malloc(MEM_EDITOR, (editor->size + 1) * sizeof(hashes[0]));
+    ColdReader reader = {0};
+    for (size_t i = 0; i < editor->size; i++) {
+        const Line* line = editor_read_line(editor, i, &reader);
+        hashes[i] = diff_hash_line(line->chars, line->size);
+    }
+    cold_reader_free(&reader);
+    return hashes;
+}
 
-        // If there are characters remaining on the current line, append them
-        if (bytes_read > 0) {
-            if (new_line)
-                editor_push_new_line(editor);
+/*
+ *  Purpose: Bring the Editor up to date with a new version of its file. Only the lines that differ are
+ *           replaced, the others (and what is attached to them) are kept and the cursor stays on its line.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure holding the old version.
+ *    - fp: File pointer to the file from which to read the new version.
+ *
+ *  Returns: The number of lines that were replaced, inserted or removed.
+ */
+size_t editor_reload_from_file(Editor* editor, FILE* fp)
+{
+    Editor disk = {0};
+    editor_load_from_file(&disk, fp);
+
+    uint64_t* old_hashes = editor_hash_lines(editor);
+    uint64_t* new_hashes = editor_hash_lines(&disk);
+    size_t num_hunks;
+    DiffHunk* hunks = diff_lines(old_hashes, editor->size, new_hashes, disk.size, &num_hunks);
+    mem_free(MEM_EDITOR, old_hashes);
+    mem_free(MEM_EDITOR, new_hashes);
+
+    // Back to front, so the positions of the hunks not applied yet stay valid
+    size_t num_changed = 0;
+    for (size_t i = num_hunks; i-- > 0;) {
+        DiffHunk hunk = hunks[i];
+        editor_replace_lines(editor, hunk.a_start, hunk.a_count, disk.lines + hunk.b_start, hunk.b_count);
+        memset(disk.lines + hunk.b_start, 0, hunk.b_count * sizeof(disk.lines[0]));
+        num_changed += hunk.a_count > hunk.b_count ? hunk.a_count : hunk.b_count;
+
+        if (editor->cursor_row >= hunk.a_start + hunk.a_count)
+            editor->cursor_row = editor->cursor_row - hunk.a_count + hunk.b_count;
+        else if (editor->cursor_row >= hunk.a_start && editor->cursor_row - hunk.a_start >= hunk.b_count)
+            editor->cursor_row = hunk.b_count > 0 ? hunk.a_start + hunk.b_count - 1 : hunk.a_start;
+    }
+    mem_free(MEM_OTHER, hunks);
+    editor_free(&disk); // Only the lines that were not moved
 
-            Line* current_line = editor->lines + editor->size - 1;
-            line_append_text_segment(current_line, line_start, bytes_read);
-            new_line = false;
-        }
+    if (editor->size == 0)
+        editor->cursor_row = editor->cursor_col = 0;
+    else {
+        if (editor->cursor_row >= editor->size)
+            editor->cursor_row = editor->size - 1;
+        if (editor->cursor_col > editor->lines[editor->cursor_row].size)
+            editor->cursor_col = editor->lines[editor->cursor_row].size;
     }
+    return num_changed;
 }
 
 /*
@@ -438,7 +899,19 @@ void editor_load_from_file(Editor* editor, FILE* fp)
  */
 void editor_free(Editor* editor)
 {
+    if (editor->pager != NULL) {
+        pager_free(editor->pager);
+        return;
+    }
+
     for (size_t i = 0; i < editor->size; i++)
-        free(editor->lines[i].chars);
-    free(editor->lines);
+        line_free(&editor->lines[i]);
+    line_free(&editor->flat);
+    mem_free(MEM_EDITOR, editor->lines);
+    if (editor->cold != NULL)
+        cold_free(editor->cold);
+    if (editor->intern != NULL)
+        intern_free(editor->intern);
+    if (editor->mapping != NULL)
+        munmap(editor->mapping, editor->mapping_size);
 }
\ No newline at end of file
@@ -0,0 +1,557 @@
+/*
+ *  Filtered view, showing only the lines that contain a pattern while the whole text stays in the
+ *  Editor. Which lines match is kept in a bitmap with one bit per line, and the number of matches before
+ *  every block of the bitmap, so a row on screen is mapped to its line (select) and a line to its row
+ *  (rank) without copying any line. The bitmap is built on the job system, chunk by chunk with the one on
+ *  screen first, and then follows the changes to the Editor: the lines of a change are matched again and
+ *  the bits after it are moved a word at a time. The Editor must not change while the bitmap is built,
+ *  'filter_finish' waits for it before an edit.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "filter.h"
+#include "editor.h"
+#include "line.h"
+#include "cold.h"
+#include "jobs.h"
+#include "mem.h"
+
+// The lines one job matches, and their bits
+typedef struct {
+    FilterView* view;
+    size_t first_row;
+    size_t end_row;
+    uint64_t bits[FILTER_CHUNK_LINES / 64];
+} FilterChunk;
+
+/*
+ *  Purpose: Count the bits set in a word of the bitmap.
+ *
+ *  Parameters:
+ *    - word: The word.
+ *
+ *  Returns: The number of bits set.
+ */
+static size_t filter_popcount(uint64_t word)
+{
+    // A builtin of GCC and Clang, a single instruction on the CPUs that have one
+    return (size_t)__builtin_popcountll(word);
+}
+
+/*
+ *  Purpose: Check whether characters contain the pattern of a view. Safe to call from any thread.
+ *
+ *  Parameters:
+ *    - view: Pointer to the FilterView.
+ *    - chars: Pointer to the characters.
+ *    - size: The number of characters.
+ *
+ *  Returns:
+ *    - true if the pattern is found.
+ *    - false otherwise.
+ */
+static bool filter_chars_match(const FilterView* view, const char* chars, size_t size)
+{
+    // Candidates are found with 'memchr', which looks at many characters at a time
+    const char* pattern = view->pattern;
+    size_t pattern_size = view->pattern_size;
+    const char* end = chars + size;
+    while ((size_t)(end - chars) >= pattern_size) {
+        const char* hit = memchr(chars, pattern[0], end - chars - pattern_size + 1);
+        if (hit == NULL)
+            return false;
+        if (memcmp(hit, pattern, pattern_size) == 0)
+            return true;
+        chars = hit + 1;
+    }
+    return false;
+}
+
+/*
+ *  Purpose: Check whether a line contains the pattern of a view. Safe to call from any thread.
+ *
+ *  Parameters:
+ *    - view: Pointer to the FilterView.
+ *    - line: Pointer to the line, which may be chunked.
+ *
+ *  Returns:
+ *    - true if the pattern is found.
+ *    - false otherwise.
+ */
+static bool filter_line_matches(const FilterView* view, const Line* line)
+{
+    if (!line_is_chunked(line))
+        return filter_chars_match(view, line->chars, line->size);
+
+    // A chunked line is searched a chunk at a time instead of being joined. The characters on both
+    // sides of the seam after each chunk are copied together, so a match across it is found too.
+    size_t reach = view->pattern_size - 1;
+    char seam[2 * FILTER_PATTERN_CAPACITY];
+    size_t col = 0;
+    for (size_t i = 0; i < line->chunks->size; i++) {
+        const LineChunk* chunk = line->chunks->chunks + i;
+        if (filter_chars_match(view, chunk->chars, chunk->size))
+            return true;
+
+        col += chunk->size;
+        if (reach > 0 && col < line->size) {
+            size_t start = col > reach ? col - reach : 0;
+            size_t end = col + reach < line->size ? col + reach : line->size;
+            line_copy_range(line, start, end, seam);
+            if (filter_chars_match(view, seam, end - start))
+                return true;
+        }
+    }
+    return false;
+}
+
+/*
+ *  Purpose: Make room in the bitmap and the rank directory for a number of lines. The new words are 0.
+ *
+ *  Parameters:
+ *    - view: Pointer to the FilterView.
+ *    - num_lines: The number of lines, above 0.
+ *
+ *  Returns: None.
+ */
+static void filter_reserve(FilterView* view, size_t num_lines)
+{
+    size_t words = (num_lines + 63) / 64;
+    if (words <= view->capacity)
+        return;
+
+    size_t new_capacity = view->capacity == 0 ? FILTER_BLOCK_WORDS : view->capacity;
+    while (new_capacity < words)
+        new_capacity *= 2;
+    view->bits = mem_realloc(MEM_FILTER, view->bits, new_capacity * sizeof(view->bits[0]));
+    memset(view->bits + view->capacity, 0, (new_capacity - view->capacity) * sizeof(view->bits[0]));
+    view->ranks = mem_realloc(MEM_FILTER, view->ranks, (new_capacity / FILTER_BLOCK_WORDS + 1) * sizeof(view->ranks[0]));
+    view->capacity = new_capacity;
+}
+
+/*
+ *  Purpose: Read 64 bits of the bitmap starting at any bit. The bits past its end read as 0.
+ *
+ *  Parameters:
+ *    - view: Pointer to the FilterView.
+ *    - bit: The first bit.
+ *
+ *  Returns: The bits, the first one lowest.
+ */
+static uint64_t filter_read_bits(const FilterView* view, size_t bit)
+{
+    size_t word = bit / 64, shift = bit % 64;
+    if (word >= view->capacity)
+        return 0;
+
+    uint64_t bits = view->bits[word] >> shift;
+    if (shift > 0 && word + 1 < view->capacity)
+        bits |= view->bits[word + 1] << (64 - shift);
+    return bits;
+}
+
+/*
+ *  Purpose: Move the bits of the lines after a change, a word at a time, for the new number of lines.
+ *
+ *  Parameters:
+ *    - view: Pointer to the FilterView.
+ *    - from: The first line that moves, at most the old number of lines.
+ *    - num_lines: The new number of lines. The lines added before 'from' have stale bits until matched.
+ *
+ *  Returns: None.
+ */
+static void filter_move_lines(FilterView* view, size_t from, size_t num_lines)
+{
+    size_t old_num_lines = view->num_lines;
+    if (num_lines > old_num_lines) {
+        filter_reserve(view, num_lines);
+        size_t delta = num_lines - old_num_lines, dest = from + delta;
+
+        // From the end, so no word is read after it was written
+        for (size_t word = (num_lines + 63) / 64; word-- > dest / 64;) {
+            size_t start = word * 64;
+            uint64_t bits = start >= delta ? filter_read_bits(view, start - delta) : filter_read_bits(view, 0) << (delta - start);
+            uint64_t mask = start >= dest ? UINT64_MAX : UINT64_MAX << (dest - start);
+            view->bits[word] = (view->bits[word] & ~mask) | (bits & mask);
+        }
+    } else if (num_lines < old_num_lines) {
+        size_t delta = old_num_lines - num_lines, dest = from - delta;
+
+        // From the start, so no word is read after it was written
+        for (size_t word = dest / 64; word * 64 < num_lines; word++) {
+            size_t start = word * 64;
+            uint64_t bits = filter_read_bits(view, start + delta);
+            uint64_t mask = start >= dest ? UINT64_MAX : UINT64_MAX << (dest - start);
+            view->bits[word] = (view->bits[word] & ~mask) | (bits & mask);
+        }
+
+        // The bits past the last line are kept at 0, the ranks count whole words
+        if (num_lines % 64 != 0)
+            view->bits[num_lines / 64] &= ((uint64_t)1 << (num_lines % 64)) - 1;
+        size_t first_clear = (num_lines + 63) / 64, old_words = (old_num_lines + 63) / 64;
+        memset(view->bits + first_clear, 0, (old_words - first_clear) * sizeof(view->bits[0]));
+    }
+    view->num_lines = num_lines;
+}
+
+/*
+ *  Purpose: Mark the ranks after a line as out of date.
+ *
+ *  Parameters:
+ *    - view: Pointer to the FilterView.
+ *    - row: The first line whose bit changed.
+ *
+ *  Returns: None.
+ */
+static void filter_invalidate(FilterView* view, size_t row)
+{
+    size_t block = row / FILTER_BLOCK_LINES;
+    if (view->ranks_valid > block)
+        view->ranks_valid = block;
+}
+
+/*
+ *  Purpose: Bring the ranks up to date up to a block.
+ *
+ *  Parameters:
+ *    - view: Pointer to the FilterView.
+ *    - block: The index of the block, at most the number of blocks.
+ *
+ *  Returns: The number of matches before the block.
+ */
+static size_t filter_update_ranks(FilterView* view, size_t block)
+{
+    for (; view->ranks_valid < block; view->ranks_valid++) {
+        const uint64_t* words = view->bits + view->ranks_valid * FILTER_BLOCK_WORDS;
+        size_t count = 0;
+        for (size_t i = 0; i < FILTER_BLOCK_WORDS; i++)
+            count += filter_popcount(words[i]);
+        view->ranks[view->ranks_valid + 1] = view->ranks[view->ranks_valid] + count;
+    }
+    return view->ranks[block];
+}
+
+/*
+ *  Purpose: Get the number of blocks holding the lines.
+ *
+ *  Parameters:
+ *    - view: Pointer to the FilterView.
+ *
+ *  Returns: The number of blocks.
+ */
+static size_t filter_num_blocks(const FilterView* view)
+{
+    return (view->num_lines + FILTER_BLOCK_LINES - 1) / FILTER_BLOCK_LINES;
+}
+
+/*
+ *  Purpose: Follow a change to the Editor. Called by the Editor through 'editor_add_listener'.
+ *
+ *  Parameters:
+ *    - data: Pointer to the FilterView.
+ *    - change: Pointer to the change.
+ *
+ *  Returns: None.
+ */
+static void filter_on_change(void* data, const EditorChange* change)
+{
+    FilterView* view = data;
+    Editor* editor = view->editor;
+    assert(view->chunks_left == 0 && "The Editor must not change while the bitmap is built");
+
+    // The lines after the change move with it, the lines it left are matched again
+    size_t from = change->old_end_row + 1 < view->num_lines ? change->old_end_row + 1 : view->num_lines;
+    filter_move_lines(view, from, editor->size);
+    for (size_t row = change->row; row <= change->new_end_row && row < editor->size; row++) {
+        uint64_t bit = (uint64_t)1 << (row % 64);
+        if (filter_line_matches(view, editor_peek_line(editor, row)))
+            view->bits[row / 64] |= bit;
+        else
+            view->bits[row / 64] &= ~bit;
+    }
+    filter_invalidate(view, change->row);
+}
+
+/*
+ *  Purpose: Match the lines of a chunk. Run by a worker.
+ *
+ *  Parameters:
+ *    - data: Pointer to the FilterChunk.
+ *    - token: Pointer to the JobToken of the build.
+ *
+ *  Returns: None.
+ */
+static void filter_chunk_run(void* data, JobToken* token)
+{
+    FilterChunk* chunk = data;
+    FilterView* view = chunk->view;
+
+    ColdReader reader = {0};
+    for (size_t row = chunk->first_row; row < chunk->end_row; row++) {
+        if ((row - chunk->first_row) % FILTER_CANCEL_CHECK_LINES == 0 && jobs_cancelled(token))
+            break;
+
+        const Line* line = editor_read_line(view->editor, row, &reader);
+        if (filter_line_matches(view, line))
+            chunk->bits[(row - chunk->first_row) / 64] |= (uint64_t)1 << (row % 64);
+    }
+    cold_reader_free(&reader);
+}
+
+/*
+ *  Purpose: Copy the bits of a chunk into the bitmap. Run on the main thread.
+ *
+ *  Parameters:
+ *    - data: Pointer to the FilterChunk, freed here.
+ *    - cancelled: Whether the build was cancelled, in which case the FilterView may already be freed.
+ *
+ *  Returns: None.
+ */
+static void filter_chunk_complete(void* data, bool cancelled)
+{
+    FilterChunk* chunk = data;
+    if (!cancelled) {
+        FilterView* view = chunk->view;
+        size_t num_words = (chunk->end_row - chunk->first_row + 63) / 64;
+        memcpy(view->bits + chunk->first_row / 64, chunk->bits, num_words * sizeof(chunk->bits[0]));
+        filter_invalidate(view, chunk->first_row);
+        view->chunks_left--;
+    }
+    mem_free(MEM_FILTER, chunk);
+}
+
+/*
+ *  Purpose: Start filtering the lines of an Editor, which is followed through its changes. The view should be
+ *           released with 'filter_free'. Main thread only.
+ *
+ *  Parameters:
+ *    - jobs: Pointer to the JobSystem building the bitmap.
+ *    - editor: Pointer to the Editor, which must not be paged.
+ *    - pattern: Pointer to the characters a line must contain to be shown (not null-terminated).
+ *    - size: The number of characters, from 1 to FILTER_PATTERN_CAPACITY.
+ *    - first_row: The first line on screen, whose chunk is matched first.
+ *
+ *  Returns:
+ *    - Pointer to the new FilterView.
+ */
+FilterView* filter_create(JobSystem* jobs, Editor* editor, const char* pattern, size_t size, size_t first_row)
+{
+    assert(editor->pager == NULL && size >= 1 && size <= FILTER_PATTERN_CAPACITY);
+
+    FilterView* view = mem_calloc(MEM_FILTER, 1, sizeof(*view));
+    view->editor = editor;
+    view->jobs = jobs;
+    memcpy(view->pattern, pattern, size);
+    view->pattern_size = size;
+    filter_reserve(view, editor->size > 0 ? editor->size : 1);
+    view->num_lines = editor->size;
+    view->ranks[0] = 0;
+
+    // Chunks start on a word, so each fills its own words of the bitmap
+    view->token = jobs_token_create();
+    view->num_chunks = (editor->size + FILTER_CHUNK_LINES - 1) / FILTER_CHUNK_LINES;
+    view->chunks_left = view->num_chunks;
+    for (size_t row = 0; row < editor->size; row += FILTER_CHUNK_LINES) {
+        FilterChunk* chunk = mem_calloc(MEM_FILTER, 1, sizeof(*chunk));
+        chunk->view = view;
+        chunk->first_row = row;
+        chunk->end_row = row + FILTER_CHUNK_LINES < editor->size ? row + FILTER_CHUNK_LINES : editor->size;
+
+        JobPriority priority = first_row >= chunk->first_row && first_row < chunk->end_row ? JOB_PRIORITY_VISIBLE : JOB_PRIORITY_NORMAL;
+        jobs_submit(jobs, priority, filter_chunk_run, filter_chunk_complete, chunk, view->token);
+    }
+
+    editor_add_listener(editor, filter_on_change, view);
+    return view;
+}
+
+/*
+ *  Purpose: Check whether chunks of the bitmap are still to be built. The lines of chunks not completed yet
+ *           are not shown.
+ *
+ *  Parameters:
+ *    - view: Pointer to the FilterView.
+ *
+ *  Returns:
+ *    - true while the bitmap is built.
+ *    - false once every chunk was completed.
+ */
+bool filter_building(const FilterView* view)
+{
+    return view->chunks_left > 0;
+}
+
+/*
+ *  Purpose: Wait until the whole bitmap is built, so the Editor can change.
+ *
+ *  Parameters:
+ *    - view: Pointer to the FilterView.
+ *
+ *  Returns: None.
+ */
+void filter_finish(FilterView* view)
+{
+    if (view->chunks_left == 0)
+        return;
+
+    // The chunks are completed now rather than on the next frame, the lines they were matched on are about to change
+    jobs_wait(view->jobs, view->token);
+    jobs_drain(view->jobs);
+    assert(view->chunks_left == 0);
+}
+
+/*
+ *  Purpose: Check whether a line is shown.
+ *
+ *  Parameters:
+ *    - view: Pointer to the FilterView.
+ *    - row: The index of the line.
+ *
+ *  Returns:
+ *    - true if the line contains the pattern.
+ *    - false otherwise.
+ */
+bool filter_matches(const FilterView* view, size_t row)
+{
+    return row < view->num_lines && (view->bits[row / 64] >> (row % 64) & 1);
+}
+
+/*
+ *  Purpose: Get how many rows the lines shown take on screen.
+ *
+ *  Parameters:
+ *    - view: Pointer to the FilterView.
+ *
+ *  Returns: The number of lines that match.
+ */
+size_t filter_num_rows(FilterView* view)
+{
+    return filter_update_ranks(view, filter_num_blocks(view));
+}
+
+/*
+ *  Purpose: Find the line shown on a row of the screen (select).
+ *
+ *  Parameters:
+ *    - view: Pointer to the FilterView.
+ *    - visible_row: The row, counted over the lines that match.
+ *
+ *  Returns: The index of the line, the size of the Editor for a row past the last match.
+ */
+size_t filter_line_at(FilterView* view, size_t visible_row)
+{
+    size_t num_blocks = filter_num_blocks(view);
+    if (visible_row >= filter_update_ranks(view, num_blocks))
+        return view->num_lines;
+
+    // The last block with fewer matches before it, then the word and the bit within it
+    size_t low = 0, high = num_blocks;
+    while (high - low > 1) {
+        size_t mid = low + (high - low) / 2;
+        if (view->ranks[mid] <= visible_row)
+            low = mid;
+        else
+            high = mid;
+    }
+
+    size_t left = visible_row - view->ranks[low];
+    size_t word = low * FILTER_BLOCK_WORDS;
+    while (left >= filter_popcount(view->bits[word]))
+        left -= filter_popcount(view->bits[word++]);
+
+    uint64_t bits = view->bits[word];
+    for (; left > 0; left--)
+        bits &= bits - 1;
+    return word * 64 + (size_t)__builtin_ctzll(bits);
+}
+
+/*
+ *  Purpose: Find the row of the screen a line is shown on (rank). A line that does not match is on the row
+ *           of the next one that does.
+ *
+ *  Parameters:
+ *    - view: Pointer to the FilterView.
+ *    - row: The index of the line.
+ *
+ *  Returns: The number of lines that match before it.
+ */
+size_t filter_row_of(FilterView* view, size_t row)
+{
+    if (row >= view->num_lines)
+        return filter_num_rows(view);
+
+    size_t block = row / FILTER_BLOCK_LINES;
+    size_t count = filter_update_ranks(view, block);
+    for (size_t word = block * FILTER_BLOCK_WORDS; word < row / 64; word++)
+        count += filter_popcount(view->bits[word]);
+    return count + filter_popcount(view->bits[row / 64] & (((uint64_t)1 << (row % 64)) - 1));
+}
+
+/*
+ *  Purpose: Move the cursor up to the line above that matches, like 'editor_up_arrow'.
+ *
+ *  Parameters:
+ *    - view: Pointer to the FilterView.
+ *
+ *  Returns: None.
+ */
+void filter_up_arrow(FilterView* view)
+{
+    // The cursor is put under the line, so the Editor moves it there and keeps its column as it does
+    Editor* editor = view->editor;
+    size_t visible_row = filter_row_of(view, editor->cursor_row);
+    if (visible_row == 0) {
+        editor->cursor_col = 0;
+        return;
+    }
+    editor->cursor_row = filter_line_at(view, visible_row - 1) + 1;
+    editor_up_arrow(editor);
+}
+
+/*
+ *  Purpose: Move the cursor down to the line below that matches, like 'editor_down_arrow'.
+ *
+ *  Parameters:
+ *    - view: Pointer to the FilterView.
+ *
+ *  Returns: None.
+ */
+void filter_down_arrow(FilterView* view)
+{
+    // The cursor is put above the line, so the Editor moves it there and keeps its column as it does
+    Editor* editor = view->editor;
+    if (editor->size == 0)
+        return;
+
+    size_t next = filter_line_at(view, filter_row_of(view, editor->cursor_row + 1));
+    if (next >= editor->size) {
+        editor->cursor_col = editor_peek_line(editor, editor->cursor_row)->size;
+        return;
+    }
+    editor->cursor_row = next - 1;
+    editor_down_arrow(editor);
+}
+
+/*
+ *  Purpose: Stop the build and following the Editor, and free the view.
+ *
+ *  Parameters:
+ *    - view: Pointer to the FilterView to free.
+ *
+ *  Returns: None.
+ */
+void filter_free(FilterView* view)
+{
+    // The chunks still queued are freed when they are completed as cancelled
+    jobs_cancel(view->token);
+    jobs_wait(view->jobs, view->token);
+    jobs_token_release(view->token);
+    editor_remove_listener(view->editor, filter_on_change, view);
+    mem_free(MEM_FILTER, view->ranks);
+    mem_free(MEM_FILTER, view->bits);
+    mem_free(MEM_FILTER, view);
+}
@@ -0,0 +1,764 @@
+/*
+ *  Code folding. A fold hides the lines of an indented block under the line that opens it. The folds
+ *  are kept in a treap ordered by their first hidden line, where every node also holds how many lines
+ *  its subtree hides, so a row on screen is mapped to its line, and a line to its row on screen, in
+ *  O(log n) however many lines are folded. The store follows the changes to the Editor: the folds after
+ *  an edit that added or removed lines are moved with a lazy row offset on a subtree, and a fold whose
+ *  hidden lines were edited is opened. Blocks are found in a cache of the indentation of every line, kept
+ *  through the same changes, with the least indentation of every FOLD_INDENT_BLOCK_LINES lines, so the
+ *  runs of lines deeper than a block are skipped without reading them.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "fold.h"
+#include "editor.h"
+#include "line.h"
+#include "mem.h"
+
+/*
+ *  Purpose: Move every row of a subtree by an offset, in O(1) by leaving the offset on its root.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *    - n: The index of the root of the subtree (0 for none).
+ *    - offset: The number of rows to add.
+ *
+ *  Returns: None.
+ */
+static void fold_shift(FoldStore* store, uint32_t n, int64_t offset)
+{
+    if (n == 0 || offset == 0)
+        return;
+
+    FoldNode* node = store->nodes + n;
+    node->first_row += offset;
+    node->last_row += offset;
+    node->row_offset += offset;
+}
+
+/*
+ *  Purpose: Pass the row offset left on a node down to its children.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *    - n: The index of the node.
+ *
+ *  Returns: None.
+ */
+static void fold_push(FoldStore* store, uint32_t n)
+{
+    FoldNode* node = store->nodes + n;
+    if (node->row_offset != 0) {
+        fold_shift(store, node->left, node->row_offset);
+        fold_shift(store, node->right, node->row_offset);
+        node->row_offset = 0;
+    }
+}
+
+/*
+ *  Purpose: Recompute the lines hidden by a subtree from its root and children.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *    - n: The index of the root of the subtree.
+ *
+ *  Returns: None.
+ */
+static void fold_update(FoldStore* store, uint32_t n)
+{
+    FoldNode* node = store->nodes + n;
+    node->hidden_rows = node->last_row - node->first_row + 1;
+    node->hidden_rows += store->nodes[node->left].hidden_rows + store->nodes[node->right].hidden_rows;
+}
+
+/*
+ *  Purpose: Split a subtree in two by first hidden line.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *    - n: The index of the root of the subtree (0 for none).
+ *    - row: The line to split at.
+ *    - left: Pointer set to the subtree of the folds starting before the line.
+ *    - right: Pointer set to the subtree of the others.
+ *
+ *  Returns: None.
+ */
+static void fold_split(FoldStore* store, uint32_t n, size_t row, uint32_t* left, uint32_t* right)
+{
+    if (n == 0) {
+        *left = 0;
+        *right = 0;
+        return;
+    }
+
+    fold_push(store, n);
+    FoldNode* node = store->nodes + n;
+    if (node->first_row < row) {
+        fold_split(store, node->right, row, &node->right, right);
+        *left = n;
+    } else {
+        fold_split(store, node->left, row, left, &node->left);
+        *right = n;
+    }
+    fold_update(store, n);
+}
+
+/*
+ *  Purpose: Join two subtrees, where every fold of the first is before those of the second.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *    - a: The index of the root of the first subtree (0 for none).
+ *    - b: The index of the root of the second subtree (0 for none).
+ *
+ *  Returns: The index of the root of the joined subtree.
+ */
+static uint32_t fold_merge(FoldStore* store, uint32_t a, uint32_t b)
+{
+    if (a == 0)
+        return b;
+    if (b == 0)
+        return a;
+
+    if (store->nodes[a].priority > store->nodes[b].priority) {
+        fold_push(store, a);
+        store->nodes[a].right = fold_merge(store, store->nodes[a].right, b);
+        fold_update(store, a);
+        return a;
+    }
+    fold_push(store, b);
+    store->nodes[b].left = fold_merge(store, a, store->nodes[b].left);
+    fold_update(store, b);
+    return b;
+}
+
+/*
+ *  Purpose: Return the nodes of a subtree to the pool.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *    - n: The index of the root of the subtree (0 for none), detached from the tree.
+ *
+ *  Returns: None.
+ */
+static void fold_release(FoldStore* store, uint32_t n)
+{
+    if (n == 0)
+        return;
+
+    uint32_t left = store->nodes[n].left, right = store->nodes[n].right;
+    store->nodes[n].left = store->free_list;
+    store->free_list = n;
+    store->count--;
+    fold_release(store, left);
+    fold_release(store, right);
+}
+
+/*
+ *  Purpose: Take the last fold out of a subtree.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *    - n: Pointer to the index of the root of the subtree, not empty, updated to the rest of it.
+ *
+ *  Returns: The index of the detached node.
+ */
+static uint32_t fold_pop_last(FoldStore* store, uint32_t* n)
+{
+    fold_push(store, *n);
+    FoldNode* node = store->nodes + *n;
+    if (node->right == 0) {
+        uint32_t last = *n;
+        *n = node->left;
+        node->left = 0;
+        fold_update(store, last);
+        return last;
+    }
+
+    uint32_t last = fold_pop_last(store, &node->right);
+    fold_update(store, *n);
+    return last;
+}
+
+/*
+ *  Purpose: Find the fold hiding a line.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *    - row: The index of the line.
+ *
+ *  Returns: The index of the node, 0 if the line is not hidden.
+ */
+static uint32_t fold_find(FoldStore* store, size_t row)
+{
+    uint32_t n = store->root;
+    while (n != 0) {
+        fold_push(store, n);
+        const FoldNode* node = store->nodes + n;
+        if (row < node->first_row)
+            n = node->left;
+        else if (row > node->last_row)
+            n = node->right;
+        else
+            return n;
+    }
+    return 0;
+}
+
+/*
+ *  Purpose: Read the indentation of a line for the cache.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *    - row: The index of the line.
+ *
+ *  Returns: The indentation of the line, at most FOLD_BLANK - 1, or FOLD_BLANK if it is blank.
+ */
+static uint16_t fold_read_indentation(Editor* editor, size_t row)
+{
+    size_t text_col;
+    const Line* line = editor_peek_line(editor, row);
+    size_t indentation = line_indentation(line, &text_col);
+    if (text_col == line->size)
+        return FOLD_BLANK;
+    return indentation < FOLD_BLANK ? indentation : FOLD_BLANK - 1;
+}
+
+/*
+ *  Purpose: Get the indentation of a line, from the cache when it holds the line.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *    - row: The index of the line.
+ *
+ *  Returns: The indentation of the line, at most FOLD_BLANK - 1, or FOLD_BLANK if it is blank.
+ */
+static uint16_t fold_indentation(FoldStore* store, size_t row)
+{
+    if (row < store->num_indents)
+        return store->indents[row];
+    return fold_read_indentation(store->editor, row);
+}
+
+/*
+ *  Purpose: Keep the indentation cache through a change to the Editor: the lines after it are moved and the
+ *           lines of the change read again. The lines of a paged Editor never change and are not cached.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *    - change: Pointer to the change, already applied.
+ *
+ *  Returns: None.
+ */
+static void fold_update_indents(FoldStore* store, const EditorChange* change)
+{
+    Editor* editor = store->editor;
+    if (editor->pager != NULL)
+        return;
+
+    if (editor->size > store->indent_capacity) {
+        while (editor->size > store->indent_capacity)
+            store->indent_capacity *= 2;
+        store->indents = mem_realloc(MEM_FOLDS, store->indents, store->indent_capacity * sizeof(store->indents[0]));
+        store->block_mins = mem_realloc(MEM_FOLDS, store->block_mins,
+                                        (store->indent_capacity / FOLD_INDENT_BLOCK_LINES + 1) * sizeof(store->block_mins[0]));
+    }
+
+    // The lines after the change keep their indentation, the others are read again
+    size_t first_row = change->row < store->num_indents ? change->row : store->num_indents;
+    size_t last_row = editor->size - 1;
+    if (change->old_end_row + 1 < store->num_indents) {
+        size_t tail = store->num_indents - change->old_end_row - 1;
+        memmove(store->indents + change->new_end_row + 1, store->indents + change->old_end_row + 1, tail * sizeof(store->indents[0]));
+        last_row = change->new_end_row;
+    }
+    store->num_indents = editor->size;
+    for (size_t row = first_row; row <= last_row && row < editor->size; row++)
+        store->indents[row] = fold_read_indentation(editor, row);
+
+    if (store->blocks_valid > first_row / FOLD_INDENT_BLOCK_LINES)
+        store->blocks_valid = first_row / FOLD_INDENT_BLOCK_LINES;
+}
+
+/*
+ *  Purpose: Get the least indentation of a whole block of cached lines, computing the blocks before it
+ *           that changed since they were last used.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *    - block: The index of the block, whose lines are all cached.
+ *
+ *  Returns: The least indentation of its lines, FOLD_BLANK if they are all blank.
+ */
+static uint16_t fold_block_min(FoldStore* store, size_t block)
+{
+    for (; store->blocks_valid <= block; store->blocks_valid++) {
+        const uint16_t* indents = store->indents + store->blocks_valid * FOLD_INDENT_BLOCK_LINES;
+        uint16_t min = FOLD_BLANK;
+        for (size_t i = 0; i < FOLD_INDENT_BLOCK_LINES; i++)
+            min = indents[i] < min ? indents[i] : min;
+        store->block_mins[store->blocks_valid] = min;
+    }
+    return store->block_mins[block];
+}
+
+/*
+ *  Purpose: Find the first line from a row on that is indented less than a limit, skipping the blocks
+ *           whose lines are all indented deeper.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *    - row: The index of the first line to check.
+ *    - limit: The indentation to stay below, FOLD_BLANK for any line that is not blank.
+ *
+ *  Returns: The index of the line, the size of the Editor if there is none.
+ */
+static size_t fold_next_below(FoldStore* store, size_t row, uint16_t limit)
+{
+    size_t size = store->editor->size;
+    while (row < size) {
+        if (row % FOLD_INDENT_BLOCK_LINES == 0 && row + FOLD_INDENT_BLOCK_LINES <= store->num_indents &&
+            fold_block_min(store, row / FOLD_INDENT_BLOCK_LINES) >= limit) {
+            row += FOLD_INDENT_BLOCK_LINES;
+            continue;
+        }
+        if (fold_indentation(store, row) < limit)
+            return row;
+        row++;
+    }
+    return size;
+}
+
+/*
+ *  Purpose: Find the last line before a row that is indented less than a limit, skipping the blocks
+ *           whose lines are all indented deeper.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *    - row: The index of the line after the last one to check.
+ *    - limit: The indentation to stay below, FOLD_BLANK for any line that is not blank.
+ *
+ *  Returns: The index of the line, SIZE_MAX if there is none.
+ */
+static size_t fold_prev_below(FoldStore* store, size_t row, uint16_t limit)
+{
+    while (row > 0) {
+        if (row % FOLD_INDENT_BLOCK_LINES == 0 && row <= store->num_indents &&
+            fold_block_min(store, row / FOLD_INDENT_BLOCK_LINES - 1) >= limit) {
+            row -= FOLD_INDENT_BLOCK_LINES;
+            continue;
+        }
+        if (fold_indentation(store, --row) < limit)
+            return row;
+    }
+    return SIZE_MAX;
+}
+
+/*
+ *  Purpose: Follow a change to the Editor. Called by the Editor through 'editor_add_listener'.
+ *
+ *  Parameters:
+ *    - data: Pointer to the FoldStore.
+ *    - change: Pointer to the change.
+ *
+ *  Returns: None.
+ */
+static void fold_on_change(void* data, const EditorChange* change)
+{
+    FoldStore* store = data;
+    fold_update_indents(store, change);
+    if (store->root == 0)
+        return;
+
+    // Folds hiding a line of the change are opened: the ones starting in it, and the one before if it reaches it
+    uint32_t before, edited, after;
+    fold_split(store, store->root, change->old_end_row + 1, &before, &after);
+    fold_split(store, before, change->row + 1, &before, &edited);
+    if (before != 0) {
+        uint32_t last = fold_pop_last(store, &before);
+        if (store->nodes[last].last_row >= change->row)
+            fold_release(store, last);
+        else
+            before = fold_merge(store, before, last);
+    }
+    fold_release(store, edited);
+
+    // The lines opening the folds after the change may be the last one it left, which is not hidden
+    fold_shift(store, after, (int64_t)change->new_end_row - (int64_t)change->old_end_row);
+    store->root = fold_merge(store, before, after);
+}
+
+/*
+ *  Purpose: Create an empty store following the changes to an Editor. The store should be released with
+ *           'fold_free'. Main thread only.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *
+ *  Returns:
+ *    - Pointer to the new FoldStore.
+ */
+FoldStore* fold_create(Editor* editor)
+{
+    FoldStore* store = mem_calloc(MEM_FOLDS, 1, sizeof(*store));
+    store->editor = editor;
+    store->capacity = FOLD_INIT_CAPACITY;
+    store->nodes = mem_calloc(MEM_FOLDS, store->capacity, sizeof(store->nodes[0]));
+    store->size = 1;
+    store->seed = 2463534242u;
+    store->indent_capacity = FOLD_INIT_CAPACITY;
+    store->indents = mem_malloc(MEM_FOLDS, store->indent_capacity * sizeof(store->indents[0]));
+    store->block_mins = mem_malloc(MEM_FOLDS, (store->indent_capacity / FOLD_INDENT_BLOCK_LINES + 1) * sizeof(store->block_mins[0]));
+
+    // The lines already in the Editor are cached as if they had just been added
+    if (editor->size > 0)
+        fold_update_indents(store, &(EditorChange) {.new_end_row = editor->size - 1});
+    editor_add_listener(editor, fold_on_change, store);
+    return store;
+}
+
+/*
+ *  Purpose: Hide a range of lines. Folds it overlaps are merged into it.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *    - first_row: The first line to hide, above 0 since the line above opens the fold.
+ *    - last_row: The last line to hide, below the size of the Editor.
+ *
+ *  Returns: None.
+ */
+void fold_add(FoldStore* store, size_t first_row, size_t last_row)
+{
+    assert(first_row > 0 && first_row <= last_row);
+
+    // The folds starting in the range are taken out, and the one before it if it reaches into it
+    uint32_t before, inside, after;
+    fold_split(store, store->root, last_row + 1, &before, &after);
+    fold_split(store, before, first_row, &before, &inside);
+    if (before != 0) {
+        uint32_t last = fold_pop_last(store, &before);
+        if (store->nodes[last].last_row >= first_row) {
+            first_row = store->nodes[last].first_row;
+            if (store->nodes[last].last_row > last_row)
+                last_row = store->nodes[last].last_row;
+            fold_release(store, last);
+        } else
+            before = fold_merge(store, before, last);
+    }
+    if (inside != 0) {
+        uint32_t last = fold_pop_last(store, &inside);
+        if (store->nodes[last].last_row > last_row)
+            last_row = store->nodes[last].last_row;
+        fold_release(store, last);
+        fold_release(store, inside);
+    }
+
+    uint32_t n = store->free_list;
+    if (n != 0)
+        store->free_list = store->nodes[n].left;
+    else {
+        if (store->size == store->capacity) {
+            store->capacity *= 2;
+            store->nodes = mem_realloc(MEM_FOLDS, store->nodes, store->capacity * sizeof(store->nodes[0]));
+        }
+        n = store->size++;
+    }
+
+    // Xorshift, the priorities only need to look random to keep the treap balanced
+    store->seed ^= store->seed << 13;
+    store->seed ^= store->seed >> 17;
+    store->seed ^= store->seed << 5;
+    store->nodes[n] = (FoldNode) {.first_row = first_row, .last_row = last_row, .priority = store->seed};
+    fold_update(store, n);
+    store->count++;
+    store->root = fold_merge(store, fold_merge(store, before, n), after);
+}
+
+/*
+ *  Purpose: Find the last line of the block a line opens, the lines under it indented deeper. Blank lines
+ *           at the end of the block are left out.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *    - header: The index of the line.
+ *    - indentation: The indentation of the line.
+ *
+ *  Returns: The index of the last line of the block, 'header' if the line opens none.
+ */
+static size_t fold_block_end(FoldStore* store, size_t header, uint16_t indentation)
+{
+    // The line ending the block is the first one not deeper, the block stops at the last line with text before it
+    size_t end = fold_next_below(store, header + 1, indentation + 1);
+    return fold_prev_below(store, end, FOLD_BLANK);
+}
+
+/*
+ *  Purpose: Find the indented block a line opens, or the one it is in.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *    - row: The index of the line.
+ *    - header: Pointer set to the line opening the block.
+ *    - last: Pointer set to the last line of the block.
+ *
+ *  Returns:
+ *    - true if a block was found.
+ *    - false if the line is in no block.
+ */
+static bool fold_find_block(FoldStore* store, size_t row, size_t* header, size_t* last)
+{
+    // A blank line takes the indentation of the next line that is not
+    size_t next = fold_next_below(store, row, FOLD_BLANK);
+    if (next == store->editor->size)
+        return false;
+
+    uint16_t indentation = fold_indentation(store, next);
+    if (next == row) {
+        *last = fold_block_end(store, row, indentation);
+        if (*last > row) {
+            *header = row;
+            return true;
+        }
+    }
+
+    // Otherwise the block is opened by the nearest line above that is not as deep
+    size_t up = fold_prev_below(store, row, indentation);
+    if (up == SIZE_MAX)
+        return false;
+
+    *header = up;
+    *last = fold_block_end(store, up, fold_indentation(store, up));
+    return *last > *header;
+}
+
+/*
+ *  Purpose: Fold the indented block at the cursor, or open the fold under the line of the cursor. The
+ *           block is the lines under the cursor's line indented deeper than it, or the block the cursor is
+ *           in when there are none. Blank lines count as part of a block unless they end it. The cursor
+ *           moves to the line opening the fold if it would be hidden.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *
+ *  Returns:
+ *    - true if a fold was added or opened.
+ *    - false if the cursor is in no block.
+ */
+bool fold_toggle(FoldStore* store)
+{
+    Editor* editor = store->editor;
+    if (editor->size == 0)
+        return false;
+    if (fold_reveal(store, editor->cursor_row + 1))
+        return true;
+
+    size_t header, last;
+    if (!fold_find_block(store, editor->cursor_row, &header, &last))
+        return false;
+    fold_add(store, header + 1, last);
+
+    // The header may be hidden too when lines were indented under an older fold, the cursor goes up to a shown line
+    uint32_t n;
+    bool moved = false;
+    while ((n = fold_find(store, editor->cursor_row)) != 0) {
+        editor->cursor_row = store->nodes[n].first_row - 1;
+        moved = true;
+    }
+    if (moved) {
+        size_t size = editor_peek_line(editor, editor->cursor_row)->size;
+        if (editor->cursor_col > size)
+            editor->cursor_col = size;
+    }
+    return true;
+}
+
+/*
+ *  Purpose: Open the fold hiding a line, if there is one.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *    - row: The index of the line.
+ *
+ *  Returns:
+ *    - true if a fold was opened.
+ *    - false otherwise.
+ */
+bool fold_reveal(FoldStore* store, size_t row)
+{
+    uint32_t n = fold_find(store, row);
+    if (n == 0)
+        return false;
+
+    uint32_t before, fold, after;
+    fold_split(store, store->root, store->nodes[n].first_row, &before, &after);
+    fold_split(store, after, store->nodes[n].first_row + 1, &fold, &after);
+    fold_release(store, fold);
+    store->root = fold_merge(store, before, after);
+    return true;
+}
+
+/*
+ *  Purpose: Open every fold.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *
+ *  Returns: None.
+ */
+void fold_clear(FoldStore* store)
+{
+    store->root = 0;
+    store->free_list = 0;
+    store->size = 1;
+    store->count = 0;
+}
+
+/*
+ *  Purpose: Get how many rows the lines of the Editor take on screen.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *
+ *  Returns: The number of lines that are not hidden.
+ */
+size_t fold_num_rows(const FoldStore* store)
+{
+    return store->editor->size - store->nodes[store->root].hidden_rows;
+}
+
+/*
+ *  Purpose: Find the line shown on a row of the screen.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *    - visible_row: The row, counted without the hidden lines.
+ *
+ *  Returns: The index of the line, past the last one for a row past the end of the text.
+ */
+size_t fold_line_at(FoldStore* store, size_t visible_row)
+{
+    // The lines hidden before a fold are those of its left subtree and of the folds passed on the way down
+    size_t hidden = 0;
+    uint32_t n = store->root;
+    while (n != 0) {
+        fold_push(store, n);
+        const FoldNode* node = store->nodes + n;
+        size_t hidden_before = hidden + store->nodes[node->left].hidden_rows;
+        if (visible_row >= node->first_row - hidden_before) {
+            hidden = hidden_before + node->last_row - node->first_row + 1;
+            n = node->right;
+        } else
+            n = node->left;
+    }
+    return visible_row + hidden;
+}
+
+/*
+ *  Purpose: Find the row of the screen a line is shown on. A hidden line is on the row of the line opening its fold.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *    - row: The index of the line.
+ *
+ *  Returns: The row, counted without the hidden lines.
+ */
+size_t fold_row_of(FoldStore* store, size_t row)
+{
+    size_t hidden = 0;
+    uint32_t n = store->root;
+    while (n != 0) {
+        fold_push(store, n);
+        const FoldNode* node = store->nodes + n;
+        if (row < node->first_row) {
+            n = node->left;
+            continue;
+        }
+
+        size_t hidden_before = hidden + store->nodes[node->left].hidden_rows;
+        if (row <= node->last_row)
+            return node->first_row - 1 - hidden_before;
+        hidden = hidden_before + node->last_row - node->first_row + 1;
+        n = node->right;
+    }
+    return row - hidden;
+}
+
+/*
+ *  Purpose: Get how many lines are folded under a line.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *    - row: The index of the line.
+ *
+ *  Returns: The number of lines hidden right under it, 0 if it opens no fold.
+ */
+size_t fold_hidden_after(FoldStore* store, size_t row)
+{
+    uint32_t n = fold_find(store, row + 1);
+    if (n == 0 || store->nodes[n].first_row != row + 1)
+        return 0;
+    return store->nodes[n].last_row - store->nodes[n].first_row + 1;
+}
+
+/*
+ *  Purpose: Move the cursor up to the line above that is not hidden, like 'editor_up_arrow'.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *
+ *  Returns: None.
+ */
+void fold_up_arrow(FoldStore* store)
+{
+    // The cursor is put on the first hidden line, so the Editor moves it to the line opening the fold
+    Editor* editor = store->editor;
+    uint32_t n = editor->cursor_row > 0 ? fold_find(store, editor->cursor_row - 1) : 0;
+    if (n != 0)
+        editor->cursor_row = store->nodes[n].first_row;
+    editor_up_arrow(editor);
+}
+
+/*
+ *  Purpose: Move the cursor down to the line below that is not hidden, like 'editor_down_arrow'.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore.
+ *
+ *  Returns: None.
+ */
+void fold_down_arrow(FoldStore* store)
+{
+    // The cursor is put on the last hidden line, so the Editor moves it to the line after the fold
+    Editor* editor = store->editor;
+    uint32_t n = fold_find(store, editor->cursor_row + 1);
+    if (n != 0) {
+        // A fold reaching the end of the text leaves the cursor at the end of its line, like the last line does
+        if (store->nodes[n].last_row + 1 >= editor->size) {
+            editor->cursor_col = editor_peek_line(editor, editor->cursor_row)->size;
+            return;
+        }
+        editor->cursor_row = store->nodes[n].last_row;
+    }
+    editor_down_arrow(editor);
+}
+
+/*
+ *  Purpose: Stop following the Editor and free the store.
+ *
+ *  Parameters:
+ *    - store: Pointer to the FoldStore to free.
+ *
+ *  Returns: None.
+ */
+void fold_free(FoldStore* store)
+{
+    editor_remove_listener(store->editor, fold_on_change, store);
+    mem_free(MEM_FOLDS, store->indents);
+    mem_free(MEM_FOLDS, store->block_mins);
+    mem_free(MEM_FOLDS, store->nodes);
+    mem_free(MEM_FOLDS, store);
+}
@@ -0,0 +1,135 @@
+/*
+ *  Follow mode, like 'tail -f'. Bytes appended to the open file by another process are read from the
+ *  offset where the last read stopped and added to the end of the Editor, so an update costs time in
+ *  proportion to the bytes appended and the lines already in the Editor are not touched.
+ */
+#define _XOPEN_SOURCE 700 // pread, fileno
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "follow.h"
+#include "editor.h"
+#include "watch.h"
+#include "mem.h"
+
+/*
+ *  Purpose: Open the file being followed and remember which inode it is.
+ *
+ *  Parameters:
+ *    - follower: Pointer to the Follower, with its watch set.
+ *
+ *  Returns:
+ *    - true if the file was opened.
+ *    - false otherwise (the reason is printed to stderr).
+ */
+static bool follow_open(Follower* follower)
+{
+    follower->fp = fopen(follower->watch->path, "r");
+    if (follower->fp == NULL) {
+        fprintf(stderr, "Error: Unable to follow '%s': %s\n", follower->watch->path, strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    follower->inode = fstat(fileno(follower->fp), &st) == 0 ? st.st_ino : 0;
+    return true;
+}
+
+/*
+ *  Purpose: Start following a file whose first bytes are already in the Editor. The follower should be
+ *           released with 'follow_free'.
+ *
+ *  Parameters:
+ *    - file_path: Null-terminated path to the file.
+ *    - offset: The number of bytes of the file already loaded into the Editor.
+ *
+ *  Returns:
+ *    - Pointer to the new Follower.
+ *    - NULL if the file cannot be opened (the reason is printed to stderr).
+ */
+Follower* follow_start(const char* file_path, size_t offset)
+{
+    Follower* follower = mem_calloc(MEM_OTHER, 1, sizeof(*follower));
+    follower->watch = watch_open(file_path);
+    if (!follow_open(follower)) {
+        watch_free(follower->watch);
+        mem_free(MEM_OTHER, follower);
+        return NULL;
+    }
+
+    // The loaded part may end in the middle of a line, which the appended bytes then continue
+    char last = '\n';
+    if (offset > 0 && pread(fileno(follower->fp), &last, 1, offset - 1) != 1)
+        last = '\n';
+    follower->offset = offset;
+    follower->new_line = last == '\n';
+    return follower;
+}
+
+/*
+ *  Purpose: Append what was written to the file since the last call to the Editor, without blocking on the watch.
+ *           If the file was truncated or replaced, it is followed again from its start.
+ *
+ *  Parameters:
+ *    - follower: Pointer to the Follower.
+ *    - editor: Pointer to the Editor structure the file is loaded into.
+ *
+ *  Returns: The number of bytes appended.
+ */
+size_t follow_poll(Follower* follower, Editor* editor)
+{
+    if (!watch_poll(follower->watch) || !follower->watch->last.exists)
+        return 0;
+
+    // Rotated logs are replaced by a new file, or truncated and written again
+    WatchStat st = follower->watch->last;
+    if (st.inode != follower->inode) {
+        if (follower->fp != NULL)
+            fclose(follower->fp);
+        if (!follow_open(follower)) {
+            // Tried again on the next change
+            follower->fp = NULL;
+            follower->inode = 0;
+            return 0;
+        }
+        printf("'%s' was replaced, following the new file\n", follower->watch->path);
+        follower->offset = 0;
+        follower->new_line = true;
+    } else if ((size_t)st.size < follower->offset) {
+        printf("'%s' was truncated, following it from the start\n", follower->watch->path);
+        follower->offset = 0;
+        follower->new_line = true;
+    }
+
+    char chunk[FOLLOW_CHUNK_SIZE];
+    size_t total = 0;
+    ssize_t bytes_read;
+    while ((bytes_read = pread(fileno(follower->fp), chunk, sizeof(chunk), follower->offset)) > 0) {
+        editor_append_chunk(editor, chunk, bytes_read, &follower->new_line);
+        follower->offset += bytes_read;
+        total += bytes_read;
+    }
+    return total;
+}
+
+/*
+ *  Purpose: Stop following the file and free the Follower.
+ *
+ *  Parameters:
+ *    - follower: Pointer to the Follower to free.
+ *
+ *  Returns: None.
+ */
+void follow_free(Follower* follower)
+{
+    if (follower->fp != NULL)
+        fclose(follower->fp);
+    watch_free(follower->watch);
+    mem_free(MEM_OTHER, follower);
+}
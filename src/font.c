@@ -1,12 +1,42 @@
 /*
  *  Functions for loading and managing fonts from TrueType Font (TTF) files using SDL.
  */
+#define _XOPEN_SOURCE 700 // mmap, realpath, st_mtim
+
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "font.h"
 #include "utils.h"
+#include "diff.h"
+#include "mem.h"
 #include "SDL_ttf.h"
 
+#define FONT_CACHE_PATH_CAPACITY 4096
+
+// Layout of a cache file: this header, then 'height' rows of 'pitch' bytes of BGRA32 pixels
+typedef struct {
+    char magic[8];
+    Uint32 point_size;
+    float scale;
+    Sint64 font_mtime_s;
+    Sint64 font_mtime_ns;
+    Sint64 font_size;
+    Uint32 width;
+    Uint32 height;
+    Uint32 pitch;
+    Uint32 num_glyphs;
+    SDL_Rect glyphs[NUM_GLYPHS];
+    char font_path[FONT_CACHE_PATH_CAPACITY];
+} FontCacheHeader;
+
 /*
  *  Purpose: Create an SDL surface atlas of a font from a TrueType Font (TTF) file.
  *
@@ -40,31 +70,240 @@ static SDL_Surface* create_font_surface(const char* file_path)
 }
 
 /*
- *  Purpose: Load a font from a TrueType Font (TTF) file. The font should be released
- *           with 'font_free_ttf' when no longer needed.
+ *  Purpose: Build the path of the cache file for a font, creating the cache directory if needed.
+ *
+ *  Parameters:
+ *    - key: Pointer to the header holding the cache key of the font.
+ *    - cache_path: Buffer receiving the null-terminated path.
+ *    - size: The size of the buffer.
+ *
+ *  Returns:
+ *    - true if the path was built.
+ *    - false if there is no usable cache directory.
+ */
+static bool font_cache_path(const FontCacheHeader* key, char* cache_path, size_t size)
+{
+    char dir[FONT_CACHE_PATH_CAPACITY];
+    if (!utils_cache_dir(dir, sizeof(dir)))
+        return false;
+
+    // The path, point size and scale select a file, the rest of the key is checked on load
+    uint64_t hash = diff_hash_line(key->font_path, strlen(key->font_path));
+
+    int written = snprintf(cache_path, size, "%s/font-%016llx-%u-%g.atlas", dir, (unsigned long long)hash, key->point_size, key->scale);
+    return written > 0 && (size_t)written < size;
+}
+
+/*
+ *  Purpose: Fill in the cache key of a font file: its absolute path, modification time, size, the point
+ *           size it is rasterized at and the scale it is drawn at.
  *
  *  Parameters:
- *    - renderer: The SDL renderer to create the font texture on.
  *    - file_path: Path to the TrueType Font (TTF) file.
+ *    - key: Pointer to the header receiving the key, other fields are zeroed.
  *
  *  Returns:
- *    - A Font structure containing the font texture and glyphs position.
+ *    - true if the font file could be examined.
+ *    - false otherwise.
  */
-Font* font_load_ttf(SDL_Renderer* renderer, const char* file_path)
+static bool font_cache_key(const char* file_path, FontCacheHeader* key)
+{
+    struct stat st;
+    if (stat(file_path, &st) != 0)
+        return false;
+
+    memset(key, 0, sizeof(*key));
+    memcpy(key->magic, FONT_CACHE_MAGIC, sizeof(key->magic));
+    key->point_size = POINT_SIZE;
+    key->scale = FONT_SCALE;
+    key->font_mtime_s = st.st_mtim.tv_sec;
+    key->font_mtime_ns = st.st_mtim.tv_nsec;
+    key->font_size = st.st_size;
+    key->num_glyphs = NUM_GLYPHS;
+
+    char* absolute_path = realpath(file_path, NULL);
+    snprintf(key->font_path, sizeof(key->font_path), "%s", absolute_path != NULL ? absolute_path : file_path);
+    free(absolute_path);
+
+    return true;
+}
+
+/*
+ *  Purpose: Point an atlas at the pixels of a memory-mapped cache file.
+ *
+ *  Parameters:
+ *    - key: Pointer to the cache key the file has to match.
+ *    - cache_path: Path to the cache file.
+ *    - atlas: Pointer to the FontAtlas structure to fill in.
+ *
+ *  Returns:
+ *    - true if the cache file matched the key and the atlas was loaded from it.
+ *    - false otherwise (the atlas is left untouched).
+ */
+static bool font_cache_read(const FontCacheHeader* key, const char* cache_path, FontAtlas* atlas)
+{
+    int fd = open(cache_path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(FontCacheHeader)) {
+        close(fd);
+        return false;
+    }
+
+    void* mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+        return false;
+
+    const FontCacheHeader* header = mapping;
+    bool valid = memcmp(header->magic, key->magic, sizeof(key->magic)) == 0
+        && header->point_size == key->point_size
+        && header->scale == key->scale
+        && header->font_mtime_s == key->font_mtime_s
+        && header->font_mtime_ns == key->font_mtime_ns
+        && header->font_size == key->font_size
+        && header->num_glyphs == key->num_glyphs
+        && strncmp(header->font_path, key->font_path, sizeof(key->font_path)) == 0
+        && header->pitch >= header->width * 4
+        && (size_t)st.st_size >= sizeof(FontCacheHeader) + (size_t)header->pitch * header->height;
+
+    if (!valid) {
+        munmap(mapping, st.st_size);
+        return false;
+    }
+
+    // The surface only borrows the pixels, which are read when the texture is created
+    void* pixels = (char*)mapping + sizeof(FontCacheHeader);
+    atlas->surface = utils_scp(SDL_CreateRGBSurfaceWithFormatFrom(pixels, header->width, header->height, 32, header->pitch, SDL_PIXELFORMAT_BGRA32));
+    memcpy(atlas->glyphs, header->glyphs, sizeof(atlas->glyphs));
+    atlas->mapping = mapping;
+    atlas->mapping_size = st.st_size;
+    atlas->from_cache = true;
+
+    return true;
+}
+
+/*
+ *  Purpose: Write a rasterized atlas to the cache. The file is written under a temporary name and renamed
+ *           into place, so a concurrent start never maps a partial file. Failures only cost the next start time.
+ *
+ *  Parameters:
+ *    - key: Pointer to the cache key of the font.
+ *    - cache_path: Path to the cache file.
+ *    - atlas: Pointer to the rasterized atlas.
+ *
+ *  Returns: None.
+ */
+static void font_cache_write(const FontCacheHeader* key, const char* cache_path, const FontAtlas* atlas)
 {
-    Font* font = utils_cp(malloc(sizeof(*font)));
-    SDL_Surface* font_surface = create_font_surface(file_path);
-    font->spritesheet = utils_scp(SDL_CreateTextureFromSurface(renderer, font_surface));
-    SDL_FreeSurface(font_surface);
+    char tmp_path[FONT_CACHE_PATH_CAPACITY + 16];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%ld", cache_path, (long)getpid());
 
+    FILE* fp = fopen(tmp_path, "wb");
+    if (fp == NULL)
+        return;
+
+    SDL_Surface* surface = atlas->surface;
+    FontCacheHeader header = *key;
+    header.width = surface->w;
+    header.height = surface->h;
+    header.pitch = surface->pitch;
+    memcpy(header.glyphs, atlas->glyphs, sizeof(header.glyphs));
+
+    utils_scc(SDL_LockSurface(surface));
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1
+        && fwrite(surface->pixels, surface->pitch, surface->h, fp) == (size_t)surface->h;
+    SDL_UnlockSurface(surface);
+
+    if (fclose(fp) != 0 || !ok || rename(tmp_path, cache_path) != 0)
+        remove(tmp_path);
+}
+
+/*
+ *  Purpose: Produce the CPU side of a font: the pixels of its atlas and the glyph positions. This does not touch
+ *           the renderer, so it can run on a worker thread (after 'TTF_Init') while the window is created.
+ *
+ *  Parameters:
+ *    - file_path: Path to the TrueType Font (TTF) file.
+ *    - use_cache: Whether to take the atlas from the on-disk cache when it matches the font file (path,
+ *                 modification time, point size and scale). On a miss the font is rasterized and the cache
+ *                 is written for the next start.
+ *
+ *  Returns:
+ *    - A FontAtlas structure, to be turned into a Font with 'font_create'.
+ */
+FontAtlas* font_atlas_load(const char* file_path, bool use_cache)
+{
+    FontAtlas* atlas = mem_calloc(MEM_OTHER, 1, sizeof(*atlas));
+
+    FontCacheHeader key;
+    char cache_path[FONT_CACHE_PATH_CAPACITY];
+    bool cacheable = use_cache && font_cache_key(file_path, &key) && font_cache_path(&key, cache_path, sizeof(cache_path));
+
+    if (cacheable && font_cache_read(&key, cache_path, atlas))
+        return atlas;
+
+    atlas->surface = create_font_surface(file_path);
     for (size_t ascii = ASCII_DISPLAY_LOW; ascii <= ASCII_DISPLAY_HIGH; ascii++) {
         const size_t index = ascii - ASCII_DISPLAY_LOW;
-        font->glyphs[index] = (SDL_Rect) {.x = index * FONT_WIDTH, .y = 0, .w = FONT_WIDTH, .h = FONT_HEIGHT};
+        atlas->glyphs[index] = (SDL_Rect) {.x = index * FONT_WIDTH, .y = 0, .w = FONT_WIDTH, .h = FONT_HEIGHT};
     }
 
+    if (cacheable)
+        font_cache_write(&key, cache_path, atlas);
+
+    return atlas;
+}
+
+/*
+ *  Purpose: Upload an atlas into a texture on the renderer. The atlas is freed. The font should be released
+ *           with 'font_free_ttf' when no longer needed.
+ *
+ *  Parameters:
+ *    - renderer: The SDL renderer to create the font texture on.
+ *    - atlas: Pointer to the FontAtlas made by 'font_atlas_load'.
+ *
+ *  Returns:
+ *    - A Font structure containing the font texture and glyphs position.
+ */
+Font* font_create(SDL_Renderer* renderer, FontAtlas* atlas)
+{
+    Font* font = mem_malloc(MEM_OTHER, sizeof(*font));
+    SDL_Surface* surface = atlas->surface;
+
+    font->spritesheet = utils_scp(SDL_CreateTexture(renderer, SDL_PIXELFORMAT_BGRA32, SDL_TEXTUREACCESS_STATIC, surface->w, surface->h));
+    utils_scc(SDL_LockSurface(surface));
+    utils_scc(SDL_UpdateTexture(font->spritesheet, NULL, surface->pixels, surface->pitch));
+    SDL_UnlockSurface(surface);
+    utils_scc(SDL_SetTextureBlendMode(font->spritesheet, SDL_BLENDMODE_BLEND));
+    memcpy(font->glyphs, atlas->glyphs, sizeof(font->glyphs));
+
+    SDL_FreeSurface(surface);
+    if (atlas->mapping != NULL)
+        munmap(atlas->mapping, atlas->mapping_size);
+    mem_free(MEM_OTHER, atlas);
+
     return font;
 }
 
+/*
+ *  Purpose: Load a font from a TrueType Font (TTF) file. The font should be released
+ *           with 'font_free_ttf' when no longer needed.
+ *
+ *  Parameters:
+ *    - renderer: The SDL renderer to create the font texture on.
+ *    - file_path: Path to the TrueType Font (TTF) file.
+ *
+ *  Returns:
+ *    - A Font structure containing the font texture and glyphs position.
+ */
+Font* font_load_ttf(SDL_Renderer* renderer, const char* file_path)
+{
+    return font_create(renderer, font_atlas_load(file_path, false));
+}
+
 /*
  *  Purpose: Free resources associated with a loaded TTF font.
  *
@@ -76,5 +315,5 @@ Font* font_load_ttf(SDL_Renderer* renderer, const char* file_path)
 void font_free_ttf(Font* font)
 {
     SDL_DestroyTexture(font->spritesheet);
-    free(font);
+    mem_free(MEM_OTHER, font);
 }
\ No newline at end of file
@@ -0,0 +1,487 @@
+/*
+ *  Render thread. The main thread handles the input and edits, then captures what is on screen (the
+ *  visible lines with their colors and decorations, the cursor and the camera) into an immutable
+ *  snapshot published through a lock-free single-producer single-consumer ring. The render thread owns
+ *  the SDL renderer and draws the newest snapshot, so a slow frame never holds up the edits and the
+ *  edits never hold up a frame. When the ring is full the main thread keeps editing and captures again
+ *  on its next pass, and frames the render thread fell behind on are skipped.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "frame.h"
+#include "editor.h"
+#include "highlight.h"
+#include "decoration.h"
+#include "render.h"
+#include "wrap.h"
+#include "fold.h"
+#include "filter.h"
+#include "line.h"
+#include "camera.h"
+#include "font.h"
+#include "profiler.h"
+#include "utils.h"
+#include "mem.h"
+#include "SDL.h"
+
+static const SDL_Color frame_text_color = {.r = 255, .g = 0, .b = 255, .a = 255};
+static const SDL_Color frame_cursor_color = {.r = 255, .g = 255, .b = 255, .a = 255};
+static const SDL_Color frame_text_beneath_cursor_color = {.r = 0, .g = 0, .b = 0, .a = 255};
+static const SDL_Color frame_status_color = {.r = 255, .g = 255, .b = 255, .a = 255};
+static const SDL_Color frame_status_background_color = {.r = 64, .g = 64, .b = 64, .a = 255};
+static const SDL_Color frame_fold_color = {.r = 128, .g = 128, .b = 128, .a = 255};
+
+/*
+ *  Purpose: Make room in a buffer of a snapshot.
+ *
+ *  Parameters:
+ *    - buffer: Pointer to the buffer (can be NULL).
+ *    - capacity: Pointer to the capacity of the buffer, in items.
+ *    - size: The number of items the buffer must hold.
+ *    - item_size: The size of an item in bytes.
+ *
+ *  Returns:
+ *    - Pointer to the buffer, moved if it grew.
+ */
+static void* frame_reserve(void* buffer, size_t* capacity, size_t size, size_t item_size)
+{
+    if (size <= *capacity)
+        return buffer;
+
+    size_t new_capacity = *capacity == 0 ? FRAME_INIT_CAPACITY : *capacity;
+    while (new_capacity < size)
+        new_capacity *= 2;
+    *capacity = new_capacity;
+    return mem_realloc(MEM_FRAMES, buffer, new_capacity * item_size);
+}
+
+/*
+ *  Purpose: Add a visual row to a snapshot, with the runs of its line cut to it.
+ *
+ *  Parameters:
+ *    - frame: Pointer to the FrameSnapshot.
+ *    - row: The index of the line.
+ *    - line: Pointer to the line.
+ *    - start: The first column of the line on the visual row.
+ *    - end: The column after its last one.
+ *    - screen_col: The column on screen the row is drawn from.
+ *    - runs: Pointer to the runs of the line (can be NULL if there are none).
+ *    - num_runs: The number of runs.
+ *    - next_run: Pointer to the first run that may reach the visual row, updated for the next one.
+ *
+ *  Returns: None.
+ */
+static void frame_push_row(FrameSnapshot* frame, size_t row, const Line* line, size_t start, size_t end, size_t screen_col, const HighlightRun* runs, size_t num_runs, size_t* next_run)
+{
+    frame->rows = frame_reserve(frame->rows, &frame->rows_capacity, frame->num_rows + 1, sizeof(frame->rows[0]));
+    frame->text = frame_reserve(frame->text, &frame->text_capacity, frame->text_size + end - start + 1, sizeof(frame->text[0]));
+    line_copy_range(line, start, end, frame->text + frame->text_size);
+
+    // Runs are in order, the row may start far into a long line. A run going on past the end of the row is
+    // kept for the next one.
+    size_t low = *next_run, high = num_runs;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (runs[mid].start + runs[mid].size <= start)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    size_t r = low;
+    *next_run = r;
+
+    size_t first_run = frame->num_runs;
+    for (; r < num_runs && runs[r].start < end; r++) {
+        size_t run_start = runs[r].start > start ? runs[r].start : start;
+        size_t run_end = runs[r].start + runs[r].size < end ? runs[r].start + runs[r].size : end;
+        frame->runs = frame_reserve(frame->runs, &frame->runs_capacity, frame->num_runs + 1, sizeof(frame->runs[0]));
+        frame->runs[frame->num_runs++] = (HighlightRun) {.start = run_start - start, .size = run_end - run_start, .kind = runs[r].kind};
+    }
+
+    frame->rows[frame->num_rows++] = (FrameRow) {
+        .line = row,
+        .start_col = start,
+        .screen_col = screen_col,
+        .ends_line = end == line->size,
+        .folded = false,
+        .text_offset = frame->text_size,
+        .size = end - start,
+        .first_run = first_run,
+        .num_runs = frame->num_runs - first_run,
+    };
+    frame->text_size += end - start;
+}
+
+/*
+ *  Purpose: Capture the lines on screen and the cursor into a snapshot. The other fields are left as they are.
+ *
+ *  Parameters:
+ *    - frame: Pointer to the FrameSnapshot, whose buffers are reused.
+ *    - editor: Pointer to the Editor structure.
+ *    - highlighter: Pointer to the Highlighter coloring the text (can be NULL).
+ *    - decorations: Pointer to the DecorationStore (can be NULL).
+ *    - wrap: Pointer to the WrapLayout when lines are wrapped, the camera is then placed in visual rows (NULL otherwise).
+ *    - folds: Pointer to the FoldStore hiding lines, the camera is then placed in rows without them (can be
+ *             NULL, and is not used when lines are wrapped or filtered).
+ *    - filter: Pointer to the FilterView when only matching lines are shown, the camera is then placed in rows
+ *              of those (NULL otherwise, and not used when lines are wrapped).
+ *    - window: Pointer to the SDL window to determine screen dimensions.
+ *    - camera: Pointer to the Camera, already updated for this frame.
+ *
+ *  Returns: None.
+ */
+void frame_capture(FrameSnapshot* frame, Editor* editor, Highlighter* highlighter, DecorationStore* decorations, WrapLayout* wrap, FoldStore* folds, FilterView* filter, SDL_Window* window, const Camera* camera)
+{
+    if (wrap != NULL)
+        filter = NULL;
+    if (wrap != NULL || filter != NULL)
+        folds = NULL;
+
+    size_t first, last;
+    size_t num_rows = wrap != NULL ? wrap->total_rows : filter != NULL ? filter_num_rows(filter) : folds != NULL ? fold_num_rows(folds) : editor->size;
+    render_visible_rows(window, camera->pos, num_rows, &first, &last);
+    if (wrap != NULL && first < last) {
+        // Lines that came into view since the last frame are measured, which can change how many rows there are
+        wrap_update_visible(wrap, first, last - first, editor->cursor_row);
+        render_visible_rows(window, camera->pos, wrap->total_rows, &first, &last);
+    }
+    frame->first_row = first;
+    frame->num_rows = 0;
+    frame->text_size = 0;
+    frame->num_runs = 0;
+    frame->num_decorations = 0;
+
+    // Without wrapping only the columns in view are copied, a long line costs no more than a short one
+    size_t first_col = 0, last_col = 0;
+    if (wrap == NULL)
+        render_visible_cols(window, camera->pos, &first_col, &last_col);
+
+    size_t sub_row = 0;
+    size_t row = wrap != NULL ? wrap_locate(wrap, first, &sub_row) : first;
+    for (size_t visual_row = first; visual_row < last && row < editor->size; row++) {
+        // Folded and filtered out lines are stepped over, each row on screen is looked up on its own
+        if (filter != NULL)
+            row = filter_line_at(filter, visual_row);
+        else if (folds != NULL)
+            row = fold_line_at(folds, visual_row);
+
+        const Line* line = editor_peek_line(editor, row);
+        size_t num_runs = 0;
+        const HighlightRun* runs = highlighter != NULL ? highlight_get_runs(highlighter, row, &num_runs) : NULL;
+
+        size_t start = 0, end = line->size, next_run = 0;
+        if (wrap == NULL) {
+            start = first_col < line->size ? first_col : line->size;
+            end = last_col < line->size ? last_col : line->size;
+            frame_push_row(frame, row, line, start, end, start, runs, num_runs, &next_run);
+            frame->rows[frame->num_rows - 1].folded = folds != NULL && fold_hidden_after(folds, row) > 0;
+            visual_row++;
+            continue;
+        }
+
+        // The first line on screen may start above it
+        end = wrap_segment_end(line, 0, wrap->width);
+        for (; sub_row > 0 && end < line->size; sub_row--) {
+            start = end;
+            end = wrap_segment_end(line, start, wrap->width);
+        }
+        sub_row = 0;
+
+        while (visual_row < last) {
+            frame_push_row(frame, row, line, start, end, 0, runs, num_runs, &next_run);
+            visual_row++;
+            if (end >= line->size)
+                break;
+            start = end;
+            end = wrap_segment_end(line, start, wrap->width);
+        }
+    }
+
+    // The lines on screen can be far apart when others are folded or filtered out, so the decorations are
+    // looked up for each run of consecutive lines rather than for all the lines in between
+    size_t run_start = 0;
+    for (size_t i = 1; decorations != NULL && i <= frame->num_rows; i++) {
+        if (i < frame->num_rows && frame->rows[i].line <= frame->rows[i - 1].line + 1)
+            continue;
+
+        size_t count, skip = 0;
+        const Decoration* found = decoration_query(decorations, frame->rows[run_start].line, frame->rows[i - 1].line, &count);
+        // Those starting by the end of the run before were already taken with it, they come first
+        while (run_start > 0 && skip < count && found[skip].start_row <= frame->rows[run_start - 1].line)
+            skip++;
+        if (count > skip) {
+            size_t size = frame->num_decorations + count - skip;
+            frame->decorations = frame_reserve(frame->decorations, &frame->decorations_capacity, size, sizeof(frame->decorations[0]));
+            memcpy(frame->decorations + frame->num_decorations, found + skip, (count - skip) * sizeof(found[0]));
+            frame->num_decorations = size;
+        }
+        run_start = i;
+    }
+
+    if (filter != NULL)
+        frame->cursor_row = filter_row_of(filter, editor->cursor_row);
+    else
+        frame->cursor_row = folds != NULL ? fold_row_of(folds, editor->cursor_row) : editor->cursor_row;
+    frame->cursor_col = editor->cursor_col;
+    if (wrap != NULL) {
+        size_t segment_start;
+        frame->cursor_row = wrap_visual_row(wrap, editor->cursor_row, editor->cursor_col, &segment_start);
+        frame->cursor_col = editor->cursor_col - segment_start;
+    }
+    frame->camera_pos = camera->pos;
+}
+
+/*
+ *  Purpose: Find the first visual row of a snapshot on a line or after it.
+ *
+ *  Parameters:
+ *    - frame: Pointer to the FrameSnapshot.
+ *    - row: The index of the line.
+ *
+ *  Returns:
+ *    - The index of the visual row in the snapshot, its number of rows if there is none.
+ */
+static size_t frame_find_row(const FrameSnapshot* frame, size_t row)
+{
+    size_t low = 0, high = frame->num_rows;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (frame->rows[mid].line < row)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+/*
+ *  Purpose: Draw a snapshot and present it. Called by the thread that owns the renderer, the render thread
+ *           when there is one.
+ *
+ *  Parameters:
+ *    - renderer: Pointer to the SDL renderer.
+ *    - font: Pointer to the Font.
+ *    - window: Pointer to the SDL window.
+ *    - frame: Pointer to the FrameSnapshot.
+ *
+ *  Returns: None.
+ */
+void frame_render(SDL_Renderer* renderer, const Font* font, SDL_Window* window, const FrameSnapshot* frame)
+{
+    utils_scc(SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255));
+    utils_scc(SDL_RenderClear(renderer));
+
+    size_t first = frame->first_row, end = frame->first_row + frame->num_rows;
+    PROFILER_SCOPE(PROFILER_STAGE_RENDER_EDITOR) {
+        for (size_t d = 0; d < frame->num_decorations; d++) {
+            const Decoration* decoration = frame->decorations + d;
+            for (size_t i = frame_find_row(frame, decoration->start_row); i < frame->num_rows && frame->rows[i].line <= decoration->end_row; i++) {
+                // The last row of a line is covered one column past its end, for the line break
+                const FrameRow* row = frame->rows + i;
+                size_t segment_end = row->start_col + row->size + (row->ends_line ? 1 : 0);
+                render_decoration_segment(renderer, decoration, row->line, row->start_col, segment_end, row->screen_col, first + i, window, frame->camera_pos, FONT_SCALE);
+            }
+        }
+
+        for (size_t i = 0; i < frame->num_rows; i++) {
+            const FrameRow* row = frame->rows + i;
+            Line line = {.size = row->size, .chars = frame->text + row->text_offset};
+            Vec2f pos = camera_get_projection_point(vec2f(row->screen_col * FONT_WIDTH * FONT_SCALE, (first + i) * FONT_HEIGHT * FONT_SCALE), frame->camera_pos, window);
+            render_line(renderer, font, &line, frame->runs + row->first_run, row->num_runs, pos, frame_text_color, FONT_SCALE);
+
+            // A marker one column past the end of a line with folded lines under it
+            if (row->folded && row->ends_line)
+                render_text(renderer, font, "...", vec2f(pos.x + (row->size + 1) * FONT_WIDTH * FONT_SCALE, pos.y), frame_fold_color, FONT_SCALE);
+        }
+    }
+
+    PROFILER_SCOPE(PROFILER_STAGE_RENDER_CURSOR) {
+        if (frame->cursor_visible) {
+            const char* beneath = NULL;
+            const FrameRow* row = frame->cursor_row >= first && frame->cursor_row < end ? frame->rows + frame->cursor_row - first : NULL;
+            if (row != NULL && frame->cursor_col >= row->screen_col && frame->cursor_col < row->screen_col + row->size)
+                beneath = frame->text + row->text_offset + frame->cursor_col - row->screen_col;
+            render_cursor_at(renderer, font, frame->cursor_row, frame->cursor_col, beneath, window, frame->camera_pos,
+                             frame_cursor_color, frame_text_beneath_cursor_color, frame->cursor_shape);
+        }
+    }
+
+    if (frame->status[0] != '\0')
+        render_status(renderer, font, window, frame->status, frame_status_color, frame_status_background_color);
+    profiler_render_overlay(renderer, font);
+
+    PROFILER_SCOPE(PROFILER_STAGE_PRESENT)
+        SDL_RenderPresent(renderer);
+}
+
+/*
+ *  Purpose: Free the buffers of a snapshot.
+ *
+ *  Parameters:
+ *    - frame: Pointer to the FrameSnapshot, which can be captured into again afterwards.
+ *
+ *  Returns: None.
+ */
+void frame_free(FrameSnapshot* frame)
+{
+    mem_free(MEM_FRAMES, frame->rows);
+    mem_free(MEM_FRAMES, frame->text);
+    mem_free(MEM_FRAMES, frame->runs);
+    mem_free(MEM_FRAMES, frame->decorations);
+    *frame = (FrameSnapshot) {0};
+}
+
+/*
+ *  Purpose: Render thread drawing the newest published frame until it is stopped.
+ *
+ *  Parameters:
+ *    - data: Pointer to the FrameThread.
+ *
+ *  Returns: 0.
+ */
+static int frame_thread_run(void* data)
+{
+    FrameThread* frames = data;
+
+    // The renderer is only used by the thread that created it
+    SDL_Renderer* renderer = utils_scp(SDL_CreateRenderer(frames->window, -1, SDL_RENDERER_ACCELERATED));
+    profiler_startup_mark("renderer created");
+    SDL_WaitThread(frames->font_loader, NULL);
+    Font* font = font_create(renderer, *frames->atlas);
+    profiler_startup_mark("font uploaded");
+
+    bool first_frame = true;
+    while (true) {
+        SDL_SemWait(frames->published);
+        unsigned read = SDL_AtomicGet(&frames->read);
+        unsigned write = SDL_AtomicGet(&frames->write);
+
+        if (write != read) {
+            SDL_MemoryBarrierAcquire();
+            for (unsigned i = read; i != write; i++)
+                if (frames->slots[i % FRAME_RING_SIZE].toggle_overlay)
+                    profiler_toggle_overlay();
+
+            // Only the newest frame is drawn, the older ones are already out of date
+            const FrameSnapshot* frame = frames->slots + (write - 1) % FRAME_RING_SIZE;
+            profiler_begin_frame();
+            profiler_record_stage(PROFILER_STAGE_EVENTS, frame->events_start, frame->events_end);
+            profiler_record_stage(PROFILER_STAGE_CAMERA, frame->camera_start, frame->camera_end);
+            frame_render(renderer, font, frames->window, frame);
+            profiler_end_frame();
+
+            if (first_frame) {
+                profiler_startup_mark("first frame");
+                first_frame = false;
+            }
+            for (unsigned i = read; i != write; i++) {
+                const FrameSnapshot* done = frames->slots + i % FRAME_RING_SIZE;
+                if (done->trace_path != NULL && profiler_export_chrome_trace(done->trace_path))
+                    printf("Frame trace written to '%s'\n", done->trace_path);
+                if (done->print_startup_trace)
+                    profiler_print_startup_trace();
+            }
+
+            // The slots are given back to the main thread
+            SDL_MemoryBarrierRelease();
+            SDL_AtomicSet(&frames->read, write);
+        }
+
+        // Frames published before the stop are drawn first, each one posted the semaphore
+        if (SDL_AtomicGet(&frames->quit) && (unsigned)SDL_AtomicGet(&frames->write) == write)
+            break;
+    }
+
+    font_free_ttf(font);
+    SDL_DestroyRenderer(renderer);
+    return 0;
+}
+
+/*
+ *  Purpose: Start the render thread, which creates the renderer for the window and uploads the font once it is
+ *           loaded. The thread should be stopped with 'frame_thread_stop'.
+ *
+ *  Parameters:
+ *    - window: Pointer to the SDL window.
+ *    - font_loader: Pointer to the thread loading the font atlas.
+ *    - atlas: Pointer set to the FontAtlas by the font loader before it finishes.
+ *
+ *  Returns:
+ *    - Pointer to the new FrameThread.
+ */
+FrameThread* frame_thread_start(SDL_Window* window, SDL_Thread* font_loader, FontAtlas** atlas)
+{
+    FrameThread* frames = mem_calloc(MEM_FRAMES, 1, sizeof(*frames));
+    frames->window = window;
+    frames->font_loader = font_loader;
+    frames->atlas = atlas;
+    frames->published = utils_scp(SDL_CreateSemaphore(0));
+    frames->thread = utils_scp(SDL_CreateThread(frame_thread_run, "render", frames));
+    return frames;
+}
+
+/*
+ *  Purpose: Get the next free slot of the ring, to be filled and published with 'frame_thread_publish'.
+ *           Called by the main thread only.
+ *
+ *  Parameters:
+ *    - frames: Pointer to the FrameThread.
+ *
+ *  Returns:
+ *    - Pointer to the FrameSnapshot to fill.
+ *    - NULL if the render thread has not caught up with the ring yet.
+ */
+FrameSnapshot* frame_thread_acquire(FrameThread* frames)
+{
+    unsigned write = SDL_AtomicGet(&frames->write);
+    if (write - (unsigned)SDL_AtomicGet(&frames->read) >= FRAME_RING_SIZE)
+        return NULL;
+
+    // The render thread is done with the slot before it moves 'read' past it
+    SDL_MemoryBarrierAcquire();
+    FrameSnapshot* frame = frames->slots + write % FRAME_RING_SIZE;
+    frame->toggle_overlay = false;
+    frame->trace_path = NULL;
+    frame->print_startup_trace = false;
+    frame->status[0] = '\0';
+    return frame;
+}
+
+/*
+ *  Purpose: Hand the slot returned by 'frame_thread_acquire' over to the render thread.
+ *
+ *  Parameters:
+ *    - frames: Pointer to the FrameThread.
+ *
+ *  Returns: None.
+ */
+void frame_thread_publish(FrameThread* frames)
+{
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicAdd(&frames->write, 1);
+    SDL_SemPost(frames->published);
+}
+
+/*
+ *  Purpose: Stop the render thread once it has drawn the published frames, destroy the renderer and free the
+ *           FrameThread.
+ *
+ *  Parameters:
+ *    - frames: Pointer to the FrameThread to stop.
+ *
+ *  Returns: None.
+ */
+void frame_thread_stop(FrameThread* frames)
+{
+    SDL_AtomicSet(&frames->quit, 1);
+    SDL_SemPost(frames->published);
+    SDL_WaitThread(frames->thread, NULL);
+
+    for (size_t i = 0; i < FRAME_RING_SIZE; i++)
+        frame_free(frames->slots + i);
+    SDL_DestroySemaphore(frames->published);
+    mem_free(MEM_FRAMES, frames);
+}
@@ -0,0 +1,750 @@
+/*
+ *  Incremental syntax highlighting for C-like sources. The lexer state at the end of every line is
+ *  kept, so a line can be lexed on its own from the state of the line above. After an edit only the
+ *  changed lines are lexed again, then the lines after them until one ends in the state it ended in
+ *  before the edit. The color runs of a line are cached until its text or incoming state changes.
+ *  The first pass over a large file is split into chunks lexed by worker threads, each from a guessed
+ *  state, and the chunks whose guess was wrong are lexed again from their first line until they agree.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <assert.h>
+
+#include "highlight.h"
+#include "editor.h"
+#include "cold.h"
+#include "line.h"
+#include "utils.h"
+#include "mem.h"
+#include "SDL.h"
+
+#define HIGHLIGHT_RUNS_INIT_CAPACITY 16
+
+static const char* highlight_extensions[] = {".c", ".h", ".cc", ".cpp", ".cxx", ".hh", ".hpp", ".hxx", ".inl"};
+
+static const char* highlight_keywords[] = {
+    "auto", "break", "case", "const", "continue", "default", "do", "else", "enum", "extern", "for", "goto",
+    "if", "inline", "register", "restrict", "return", "sizeof", "static", "struct", "switch", "typedef",
+    "union", "volatile", "while", "_Alignas", "_Alignof", "_Atomic", "_Generic", "_Noreturn", "_Static_assert",
+    "_Thread_local", "catch", "class", "constexpr", "delete", "explicit", "false", "friend", "namespace",
+    "new", "noexcept", "nullptr", "operator", "private", "protected", "public", "template", "this", "throw",
+    "true", "try", "typename", "using", "virtual", "NULL",
+};
+
+static const char* highlight_types[] = {
+    "bool", "char", "double", "float", "int", "long", "short", "signed", "unsigned", "void", "_Bool",
+    "size_t", "ssize_t", "ptrdiff_t", "intptr_t", "uintptr_t", "int8_t", "int16_t", "int32_t", "int64_t",
+    "uint8_t", "uint16_t", "uint32_t", "uint64_t", "FILE",
+};
+
+/*
+ *  Purpose: Check whether a file is a source the highlighter understands, by its extension.
+ *
+ *  Parameters:
+ *    - file_path: Null-terminated path to the file.
+ *
+ *  Returns:
+ *    - true for C and C++ sources and headers.
+ *    - false otherwise.
+ */
+bool highlight_supports(const char* file_path)
+{
+    const char* dot = strrchr(file_path, '.');
+    if (dot == NULL || strchr(dot, '/') != NULL)
+        return false;
+
+    for (size_t i = 0; i < sizeof(highlight_extensions) / sizeof(highlight_extensions[0]); i++)
+        if (strcmp(dot, highlight_extensions[i]) == 0)
+            return true;
+    return false;
+}
+
+/*
+ *  Purpose: Check whether a word is one of a list of words.
+ *
+ *  Parameters:
+ *    - word: Pointer to the characters of the word (not null-terminated).
+ *    - size: The number of characters.
+ *    - list: Pointer to the list of null-terminated words.
+ *    - list_size: The number of words in the list.
+ *
+ *  Returns:
+ *    - true if the word is in the list.
+ *    - false otherwise.
+ */
+static bool highlight_word_in(const char* word, size_t size, const char** list, size_t list_size)
+{
+    for (size_t i = 0; i < list_size; i++)
+        if (strncmp(list[i], word, size) == 0 && list[i][size] == '\0')
+            return true;
+    return false;
+}
+
+/*
+ *  Purpose: Find out what an identifier is colored as.
+ *
+ *  Parameters:
+ *    - word: Pointer to the characters of the identifier (not null-terminated).
+ *    - size: The number of characters.
+ *
+ *  Returns: HIGHLIGHT_KEYWORD, HIGHLIGHT_TYPE or HIGHLIGHT_NORMAL.
+ */
+static HighlightKind highlight_classify(const char* word, size_t size)
+{
+    if (highlight_word_in(word, size, highlight_keywords, sizeof(highlight_keywords) / sizeof(highlight_keywords[0])))
+        return HIGHLIGHT_KEYWORD;
+    if (highlight_word_in(word, size, highlight_types, sizeof(highlight_types) / sizeof(highlight_types[0])))
+        return HIGHLIGHT_TYPE;
+    return HIGHLIGHT_NORMAL;
+}
+
+/*
+ *  Purpose: Add a run to a buffer, merging it into the last run if it continues it.
+ *
+ *  Parameters:
+ *    - buffer: Pointer to the buffer (NULL when only the state is wanted, then nothing is added).
+ *    - start: The index of the first character of the run.
+ *    - size: The number of characters.
+ *    - kind: What the run is colored as.
+ *
+ *  Returns: None.
+ */
+static void highlight_add_run(HighlightRunBuffer* buffer, size_t start, size_t size, HighlightKind kind)
+{
+    if (buffer == NULL || size == 0)
+        return;
+
+    if (buffer->size > 0) {
+        HighlightRun* last = buffer->runs + buffer->size - 1;
+        if (last->kind == kind && last->start + last->size == start) {
+            last->size += size;
+            return;
+        }
+    }
+
+    if (buffer->size == buffer->capacity) {
+        buffer->capacity = buffer->capacity == 0 ? HIGHLIGHT_RUNS_INIT_CAPACITY : buffer->capacity * 2;
+        buffer->runs = mem_realloc(MEM_HIGHLIGHT, buffer->runs, buffer->capacity * sizeof(buffer->runs[0]));
+    }
+    buffer->runs[buffer->size++] = (HighlightRun) {.start = start, .size = size, .kind = kind};
+}
+
+/*
+ *  Purpose: Find the end of a block comment.
+ *
+ *  Parameters:
+ *    - chars: Pointer to the characters of the line.
+ *    - size: The number of characters.
+ *    - i: The index to search from.
+ *
+ *  Returns:
+ *    - The index just past the closing "*" "/".
+ *    - 0 if the comment does not end on this line.
+ */
+static size_t highlight_comment_end(const char* chars, size_t size, size_t i)
+{
+    while (i + 1 < size) {
+        const char* star = memchr(chars + i, '*', size - i - 1);
+        if (star == NULL)
+            return 0;
+        i = star - chars + 1;
+        if (chars[i] == '/')
+            return i + 1;
+    }
+    return 0;
+}
+
+/*
+ *  Purpose: Find the end of a string or character literal.
+ *
+ *  Parameters:
+ *    - chars: Pointer to the characters of the line.
+ *    - size: The number of characters.
+ *    - i: The index just past the opening quote.
+ *    - quote: The quote that closes the literal.
+ *    - closed: Pointer set to whether the literal is closed on this line.
+ *
+ *  Returns: The index just past the closing quote, or the size of the line if there is none.
+ */
+static size_t highlight_literal_end(const char* chars, size_t size, size_t i, char quote, bool* closed)
+{
+    while (i < size) {
+        if (chars[i] == '\\')
+            i += 2;
+        else if (chars[i] == quote) {
+            *closed = true;
+            return i + 1;
+        } else
+            i++;
+    }
+    *closed = false;
+    return size;
+}
+
+/*
+ *  Purpose: Lex a line from the state the line above ended in. Lines over HIGHLIGHT_MAX_LINE_SIZE are skipped.
+ *
+ *  Parameters:
+ *    - state: The state at the start of the line.
+ *    - chars: Pointer to the characters of the line (can be NULL for a skipped line).
+ *    - size: The number of characters.
+ *    - runs: Pointer to the buffer the color runs are added to (NULL when only the state is wanted).
+ *
+ *  Returns: The state at the end of the line.
+ */
+static HighlightState highlight_lex_line(HighlightState state, const char* chars, size_t size, HighlightRunBuffer* runs)
+{
+    if (size > HIGHLIGHT_MAX_LINE_SIZE)
+        return state;
+
+    bool continued = size > 0 && chars[size - 1] == '\\';
+    bool directive = state == HIGHLIGHT_STATE_PREPROCESSOR;
+    bool first_token = state == HIGHLIGHT_STATE_NORMAL;
+    size_t i = 0;
+
+    if (state == HIGHLIGHT_STATE_COMMENT) {
+        i = highlight_comment_end(chars, size, 0);
+        if (i == 0) {
+            highlight_add_run(runs, 0, size, HIGHLIGHT_COMMENT);
+            return HIGHLIGHT_STATE_COMMENT;
+        }
+        highlight_add_run(runs, 0, i, HIGHLIGHT_COMMENT);
+    } else if (state == HIGHLIGHT_STATE_STRING) {
+        bool closed;
+        i = highlight_literal_end(chars, size, 0, '"', &closed);
+        highlight_add_run(runs, 0, i, HIGHLIGHT_STRING);
+        if (!closed)
+            return continued ? HIGHLIGHT_STATE_STRING : HIGHLIGHT_STATE_NORMAL;
+    }
+
+    while (i < size) {
+        char c = chars[i];
+        char next = i + 1 < size ? chars[i + 1] : '\0';
+
+        if (c == ' ' || c == '\t') {
+            i++;
+            continue;
+        }
+
+        if (c == '/' && next == '/') {
+            highlight_add_run(runs, i, size - i, HIGHLIGHT_COMMENT);
+            return HIGHLIGHT_STATE_NORMAL;
+        }
+
+        if (c == '/' && next == '*') {
+            size_t end = highlight_comment_end(chars, size, i + 2);
+            if (end == 0) {
+                highlight_add_run(runs, i, size - i, HIGHLIGHT_COMMENT);
+                return HIGHLIGHT_STATE_COMMENT;
+            }
+            highlight_add_run(runs, i, end - i, HIGHLIGHT_COMMENT);
+            i = end;
+            continue;
+        }
+
+        if (c == '"' || c == '\'') {
+            bool closed;
+            size_t end = highlight_literal_end(chars, size, i + 1, c, &closed);
+            highlight_add_run(runs, i, end - i, HIGHLIGHT_STRING);
+            if (!closed && c == '"' && continued)
+                return HIGHLIGHT_STATE_STRING;
+            i = end;
+            first_token = false;
+            continue;
+        }
+
+        if (c == '#' && first_token)
+            directive = true;
+        first_token = false;
+
+        size_t start = i;
+        HighlightKind kind = HIGHLIGHT_NORMAL;
+        if (isdigit((unsigned char)c) || (c == '.' && isdigit((unsigned char)next))) {
+            // Also takes in suffixes, hex digits and exponents with their sign
+            for (i++; i < size; i++) {
+                char d = chars[i];
+                bool sign = (d == '+' || d == '-') && strchr("eEpP", chars[i - 1]) != NULL;
+                if (!isalnum((unsigned char)d) && d != '.' && d != '_' && d != '\'' && !sign)
+                    break;
+            }
+            kind = HIGHLIGHT_NUMBER;
+        } else if (isalpha((unsigned char)c) || c == '_') {
+            for (i++; i < size && (isalnum((unsigned char)chars[i]) || chars[i] == '_'); i++)
+                ;
+            // Only the state is needed when nothing is drawn, which identifiers never change
+            if (runs != NULL)
+                kind = highlight_classify(chars + start, i - start);
+        } else
+            i++;
+
+        if (directive)
+            kind = HIGHLIGHT_PREPROCESSOR;
+        if (kind != HIGHLIGHT_NORMAL)
+            highlight_add_run(runs, start, i - start, kind);
+    }
+
+    return directive && continued ? HIGHLIGHT_STATE_PREPROCESSOR : HIGHLIGHT_STATE_NORMAL;
+}
+
+/*
+ *  Purpose: Lex a line of the Editor from the state of the line above, which must be up to date.
+ *
+ *  Parameters:
+ *    - highlighter: Pointer to the Highlighter.
+ *    - row: The index of the line.
+ *    - runs: Pointer to the buffer the color runs are added to (NULL when only the state is wanted).
+ *
+ *  Returns: The state at the end of the line.
+ */
+static HighlightState highlight_lex_row(Highlighter* highlighter, size_t row, HighlightRunBuffer* runs)
+{
+    HighlightState state = row == 0 ? HIGHLIGHT_STATE_NORMAL : highlighter->lines[row - 1].state;
+    highlighter->lines_lexed++;
+
+    if (highlighter->editor->size == 0)
+        return highlight_lex_line(state, NULL, 0, runs);
+
+    // A long line is not joined only to be skipped
+    const Line* line = editor_peek_line(highlighter->editor, row);
+    if (line->size > HIGHLIGHT_MAX_LINE_SIZE)
+        return highlight_lex_line(state, NULL, line->size, runs);
+    line = editor_get_line(highlighter->editor, row);
+    return highlight_lex_line(state, line->chars, line->size, runs);
+}
+
+/*
+ *  Purpose: Drop the cached runs of a line.
+ *
+ *  Parameters:
+ *    - line: Pointer to the line.
+ *
+ *  Returns: None.
+ */
+static void highlight_drop_runs(HighlightLine* line)
+{
+    mem_free(MEM_HIGHLIGHT, line->runs);
+    line->runs = NULL;
+    line->num_runs = 0;
+    line->has_runs = false;
+}
+
+/*
+ *  Purpose: Make room for more lines in the Highlighter. New entries are zeroed.
+ *
+ *  Parameters:
+ *    - highlighter: Pointer to the Highlighter.
+ *    - n: The number of lines to make room for.
+ *
+ *  Returns: None.
+ */
+static void highlight_expand(Highlighter* highlighter, size_t n)
+{
+    size_t new_capacity = highlighter->capacity;
+    while (new_capacity - highlighter->size < n)
+        new_capacity = new_capacity == 0 ? EDITOR_INIT_CAPACITY : new_capacity * 2;
+
+    if (new_capacity != highlighter->capacity) {
+        highlighter->lines = mem_realloc(MEM_HIGHLIGHT, highlighter->lines, new_capacity * sizeof(highlighter->lines[0]));
+        memset(highlighter->lines + highlighter->capacity, 0, (new_capacity - highlighter->capacity) * sizeof(highlighter->lines[0]));
+        highlighter->capacity = new_capacity;
+    }
+}
+
+/*
+ *  Purpose: Forget every state and run, and match the number of lines of the Editor.
+ *
+ *  Parameters:
+ *    - highlighter: Pointer to the Highlighter.
+ *
+ *  Returns: None.
+ */
+static void highlight_reset(Highlighter* highlighter)
+{
+    for (size_t i = 0; i < highlighter->size; i++)
+        highlight_drop_runs(highlighter->lines + i);
+
+    size_t num_lines = highlighter->editor->size > 0 ? highlighter->editor->size : 1;
+    if (num_lines > highlighter->size)
+        highlight_expand(highlighter, num_lines - highlighter->size);
+    highlighter->size = num_lines;
+    highlighter->valid_end = 0;
+    highlighter->resume_start = 0;
+    highlighter->resume_end = 0;
+}
+
+/*
+ *  Purpose: Map a line index from before a change to after it. Lines inside the change map to its first line.
+ *
+ *  Parameters:
+ *    - row: The index before the change.
+ *    - change: Pointer to the change.
+ *
+ *  Returns: The index after the change.
+ */
+static size_t highlight_shift_row(size_t row, const EditorChange* change)
+{
+    if (row > change->old_end_row)
+        return row - change->old_end_row + change->new_end_row;
+    return row < change->row ? row : change->row;
+}
+
+/*
+ *  Purpose: Follow a change to the Editor: move the states and runs of the lines after it, forget those of the
+ *           changed lines, and remember which of the states after it may still hold.
+ *
+ *  Parameters:
+ *    - data: Pointer to the Highlighter.
+ *    - change: Pointer to the change.
+ *
+ *  Returns: None.
+ */
+static void highlight_on_change(void* data, const EditorChange* change)
+{
+    Highlighter* highlighter = data;
+    assert(highlighter->pass == NULL && "The lines changed under the first pass");
+    size_t row = change->row, old_end = change->old_end_row, new_end = change->new_end_row;
+
+    if (old_end >= highlighter->size) {
+        highlight_reset(highlighter);
+        return;
+    }
+
+    for (size_t i = row; i <= old_end; i++)
+        highlight_drop_runs(highlighter->lines + i);
+
+    size_t num_removed = old_end - row, num_inserted = new_end - row;
+    if (num_inserted > num_removed)
+        highlight_expand(highlighter, num_inserted - num_removed);
+
+    size_t tail = highlighter->size - old_end - 1;
+    memmove(highlighter->lines + new_end + 1, highlighter->lines + old_end + 1, tail * sizeof(highlighter->lines[0]));
+    memset(highlighter->lines + row, 0, (num_inserted + 1) * sizeof(highlighter->lines[0]));
+    highlighter->size = highlighter->size - num_removed + num_inserted;
+    if (num_removed > num_inserted)
+        memset(highlighter->lines + highlighter->size, 0, (num_removed - num_inserted) * sizeof(highlighter->lines[0]));
+
+    bool resuming = highlighter->resume_start < highlighter->resume_end;
+    if (row < highlighter->valid_end) {
+        // The lines after the change were up to date, they are again once one of them ends as before
+        highlighter->resume_start = new_end + 1;
+        highlighter->resume_end = highlight_shift_row(highlighter->valid_end, change);
+        highlighter->valid_end = row;
+    } else if (resuming && row < highlighter->resume_end) {
+        size_t resume_start = highlight_shift_row(highlighter->resume_start, change);
+        highlighter->resume_start = resume_start > new_end ? resume_start : new_end + 1;
+        highlighter->resume_end = highlight_shift_row(highlighter->resume_end, change);
+    }
+
+    if (highlighter->resume_start >= highlighter->resume_end) {
+        highlighter->resume_start = 0;
+        highlighter->resume_end = 0;
+    }
+}
+
+/*
+ *  Purpose: Bring the states of lines [0, end) up to date, lexing from the first line that is not.
+ *
+ *  Parameters:
+ *    - highlighter: Pointer to the Highlighter.
+ *    - end: The number of lines to bring up to date.
+ *
+ *  Returns: None.
+ */
+static void highlight_advance(Highlighter* highlighter, size_t end)
+{
+    while (highlighter->valid_end < end) {
+        size_t row = highlighter->valid_end;
+        HighlightLine* line = highlighter->lines + row;
+        HighlightState state = highlight_lex_row(highlighter, row, NULL);
+
+        // The state coming in may have changed
+        highlight_drop_runs(line);
+
+        if (row >= highlighter->resume_start && row < highlighter->resume_end && state == line->state) {
+            // Converged, the lines below end as they did before the change
+            highlighter->valid_end = highlighter->resume_end;
+            highlighter->resume_start = 0;
+            highlighter->resume_end = 0;
+        } else {
+            line->state = state;
+            highlighter->valid_end++;
+        }
+    }
+}
+
+/*
+ *  Purpose: Lex the chunks of the first pass as they are taken, in order from the first visible one.
+ *
+ *  Parameters:
+ *    - data: Pointer to the HighlightPass.
+ *
+ *  Returns: 0.
+ */
+static int highlight_pass_thread(void* data)
+{
+    HighlightPass* pass = data;
+    ColdReader reader = {0};
+    int order;
+
+    while ((order = SDL_AtomicAdd(&pass->next, 1)) < (int)pass->num_chunks) {
+        size_t chunk = (pass->first_chunk + order) % pass->num_chunks;
+        size_t start = chunk * pass->chunk_lines;
+        size_t end = start + pass->chunk_lines < pass->num_lines ? start + pass->chunk_lines : pass->num_lines;
+
+        // Most chunks start outside of comments, strings and directives, the others are fixed afterwards
+        HighlightState state = HIGHLIGHT_STATE_NORMAL;
+        for (size_t row = start; row < end; row++) {
+            const Line* line = editor_read_line(pass->editor, row, &reader);
+            state = highlight_lex_line(state, line->chars, line->size, NULL);
+            pass->states[row] = state;
+        }
+
+        SDL_AtomicAdd(&pass->lines_lexed, end - start);
+        SDL_MemoryBarrierRelease();
+        SDL_AtomicSet(&pass->chunk_done[chunk], 1);
+        SDL_AtomicAdd(&pass->chunks_done, 1);
+    }
+    cold_reader_free(&reader);
+    return 0;
+}
+
+/*
+ *  Purpose: Start lexing every line of a large file on worker threads. The lines of the Editor must not change
+ *           until the pass is finished by 'highlight_poll' or 'highlight_finish_pass'. Does nothing for files
+ *           under HIGHLIGHT_PASS_MIN_LINES lines or whose lines are already up to date.
+ *
+ *  Parameters:
+ *    - highlighter: Pointer to the Highlighter.
+ *    - first_row: The first visible line, whose chunk is lexed first.
+ *    - num_threads: The number of worker threads (at most HIGHLIGHT_PASS_MAX_THREADS).
+ *
+ *  Returns: None.
+ */
+void highlight_start_pass(Highlighter* highlighter, size_t first_row, size_t num_threads)
+{
+    const Editor* editor = highlighter->editor;
+    if (highlighter->pass != NULL || editor->size < HIGHLIGHT_PASS_MIN_LINES || highlighter->valid_end >= editor->size)
+        return;
+
+    if (highlighter->size != editor->size)
+        highlight_reset(highlighter);
+    for (size_t row = highlighter->valid_end; row < highlighter->size; row++)
+        highlight_drop_runs(highlighter->lines + row);
+    if (num_threads < 1)
+        num_threads = 1;
+    if (num_threads > HIGHLIGHT_PASS_MAX_THREADS)
+        num_threads = HIGHLIGHT_PASS_MAX_THREADS;
+
+    HighlightPass* pass = mem_calloc(MEM_HIGHLIGHT, 1, sizeof(*pass));
+    pass->editor = editor;
+    pass->num_lines = editor->size;
+    pass->states = mem_malloc(MEM_HIGHLIGHT, pass->num_lines * sizeof(pass->states[0]));
+
+    // Enough chunks for the threads to balance out, big enough that the heads to fix up are few
+    pass->chunk_lines = pass->num_lines / (num_threads * HIGHLIGHT_PASS_CHUNKS_PER_THREAD);
+    if (pass->chunk_lines < HIGHLIGHT_PASS_MIN_CHUNK_LINES)
+        pass->chunk_lines = HIGHLIGHT_PASS_MIN_CHUNK_LINES;
+    pass->num_chunks = (pass->num_lines + pass->chunk_lines - 1) / pass->chunk_lines;
+    pass->first_chunk = (first_row < pass->num_lines ? first_row : pass->num_lines - 1) / pass->chunk_lines;
+    pass->chunk_done = mem_calloc(MEM_HIGHLIGHT, pass->num_chunks, sizeof(pass->chunk_done[0]));
+
+    pass->num_threads = num_threads;
+    for (size_t i = 0; i < num_threads; i++)
+        pass->threads[i] = utils_scp(SDL_CreateThread(highlight_pass_thread, "highlight", pass));
+    highlighter->pass = pass;
+}
+
+/*
+ *  Purpose: Get the color runs of a line while the first pass runs, from the state its chunk reached so far.
+ *           They are not cached since the chunk may have started from the wrong state.
+ *
+ *  Parameters:
+ *    - highlighter: Pointer to the Highlighter, with a pass running.
+ *    - row: The index of the line.
+ *    - num_runs: Pointer set to the number of runs (0 if the chunk is not lexed yet).
+ *
+ *  Returns:
+ *    - Pointer to the runs, valid until the next call.
+ */
+static const HighlightRun* highlight_pass_runs(Highlighter* highlighter, size_t row, size_t* num_runs)
+{
+    HighlightPass* pass = highlighter->pass;
+    size_t chunk = row / pass->chunk_lines;
+
+    *num_runs = 0;
+    if (!SDL_AtomicGet(&pass->chunk_done[chunk]))
+        return NULL;
+    SDL_MemoryBarrierAcquire();
+
+    const Line* line = editor_peek_line(highlighter->editor, row);
+    if (line->size <= HIGHLIGHT_MAX_LINE_SIZE)
+        line = editor_get_line(highlighter->editor, row);
+    HighlightState state = row % pass->chunk_lines == 0 ? HIGHLIGHT_STATE_NORMAL : pass->states[row - 1];
+    highlighter->scratch.size = 0;
+    highlight_lex_line(state, line_is_chunked(line) ? NULL : line->chars, line->size, &highlighter->scratch);
+
+    *num_runs = highlighter->scratch.size;
+    return highlighter->scratch.runs;
+}
+
+/*
+ *  Purpose: Wait for the first pass, if one runs, and correct the chunks lexed from a wrong state.
+ *           Must be called before the lines of the Editor change.
+ *
+ *  Parameters:
+ *    - highlighter: Pointer to the Highlighter.
+ *
+ *  Returns: None.
+ */
+void highlight_finish_pass(Highlighter* highlighter)
+{
+    HighlightPass* pass = highlighter->pass;
+    if (pass == NULL)
+        return;
+
+    for (size_t i = 0; i < pass->num_threads; i++)
+        SDL_WaitThread(pass->threads[i], NULL);
+    highlighter->pass = NULL;
+    highlighter->lines_lexed += SDL_AtomicGet(&pass->lines_lexed);
+
+    for (size_t row = 0; row < pass->num_lines; row++)
+        highlighter->lines[row].state = pass->states[row];
+
+    // A chunk whose line above ends in another state is lexed again from there, until a line ends as it did.
+    // The lines after it only depend on that state, so they were right, and so is everything up to the next head.
+    size_t fixed_end = 0;
+    for (size_t chunk = 1; chunk < pass->num_chunks; chunk++) {
+        size_t head = chunk * pass->chunk_lines;
+        if (fixed_end > head || highlighter->lines[head - 1].state == HIGHLIGHT_STATE_NORMAL)
+            continue;
+
+        size_t row = head;
+        bool converged = false;
+        while (row < pass->num_lines && !converged) {
+            HighlightState state = highlight_lex_row(highlighter, row, NULL);
+            converged = state == highlighter->lines[row].state;
+            highlighter->lines[row].state = state;
+            highlight_drop_runs(highlighter->lines + row);
+            row++;
+        }
+        fixed_end = row;
+    }
+
+    highlighter->valid_end = pass->num_lines;
+    highlighter->resume_start = 0;
+    highlighter->resume_end = 0;
+
+    mem_free(MEM_HIGHLIGHT, pass->chunk_done);
+    mem_free(MEM_HIGHLIGHT, pass->states);
+    mem_free(MEM_HIGHLIGHT, pass);
+}
+
+/*
+ *  Purpose: Check on the first pass without blocking, and finish it once every chunk is lexed.
+ *
+ *  Parameters:
+ *    - highlighter: Pointer to the Highlighter.
+ *
+ *  Returns:
+ *    - true if chunks were lexed since the last call, so the colors on screen may change.
+ *    - false otherwise.
+ */
+bool highlight_poll(Highlighter* highlighter)
+{
+    HighlightPass* pass = highlighter->pass;
+    if (pass == NULL)
+        return false;
+
+    int chunks_done = SDL_AtomicGet(&pass->chunks_done);
+    if (chunks_done == (int)pass->num_chunks) {
+        highlight_finish_pass(highlighter);
+        return true;
+    }
+
+    bool progressed = chunks_done != pass->chunks_seen;
+    pass->chunks_seen = chunks_done;
+    return progressed;
+}
+
+/*
+ *  Purpose: Start highlighting the lines of an Editor, which is followed through its changes. Nothing is lexed
+ *           until runs are asked for. The highlighter should be released with 'highlight_free'.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure, which must not be paged.
+ *
+ *  Returns:
+ *    - Pointer to the new Highlighter.
+ */
+Highlighter* highlight_create(Editor* editor)
+{
+    assert(editor->pager == NULL);
+
+    Highlighter* highlighter = mem_calloc(MEM_HIGHLIGHT, 1, sizeof(*highlighter));
+    highlighter->editor = editor;
+    highlight_reset(highlighter);
+    editor_add_listener(editor, highlight_on_change, highlighter);
+    return highlighter;
+}
+
+/*
+ *  Purpose: Get the color runs of a line, lexing the lines above it whose state is out of date first.
+ *
+ *  Parameters:
+ *    - highlighter: Pointer to the Highlighter.
+ *    - row: The index of the line, below the size of the Editor.
+ *    - num_runs: Pointer set to the number of runs.
+ *
+ *  Returns:
+ *    - Pointer to the runs, in order and not overlapping, valid until the next call or change to the Editor.
+ */
+const HighlightRun* highlight_get_runs(Highlighter* highlighter, size_t row, size_t* num_runs)
+{
+    size_t editor_lines = highlighter->editor->size > 0 ? highlighter->editor->size : 1;
+    if (highlighter->size != editor_lines)
+        highlight_reset(highlighter);
+    assert(row < highlighter->size);
+
+    if (highlighter->pass != NULL && row >= highlighter->valid_end)
+        return highlight_pass_runs(highlighter, row, num_runs);
+
+    highlight_advance(highlighter, row + 1);
+
+    HighlightLine* line = highlighter->lines + row;
+    if (!line->has_runs) {
+        HighlightRunBuffer* scratch = &highlighter->scratch;
+        scratch->size = 0;
+        highlight_lex_row(highlighter, row, scratch);
+
+        line->num_runs = scratch->size;
+        line->runs = scratch->size > 0 ? mem_malloc(MEM_HIGHLIGHT, scratch->size * sizeof(scratch->runs[0])) : NULL;
+        if (scratch->size > 0)
+            memcpy(line->runs, scratch->runs, scratch->size * sizeof(scratch->runs[0]));
+        line->has_runs = true;
+    }
+
+    *num_runs = line->num_runs;
+    return line->runs;
+}
+
+/*
+ *  Purpose: Stop following the Editor and free the Highlighter.
+ *
+ *  Parameters:
+ *    - highlighter: Pointer to the Highlighter to free.
+ *
+ *  Returns: None.
+ */
+void highlight_free(Highlighter* highlighter)
+{
+    highlight_finish_pass(highlighter);
+    editor_remove_listener(highlighter->editor, highlight_on_change, highlighter);
+    for (size_t i = 0; i < highlighter->size; i++)
+        mem_free(MEM_HIGHLIGHT, highlighter->lines[i].runs);
+    mem_free(MEM_HIGHLIGHT, highlighter->lines);
+    mem_free(MEM_HIGHLIGHT, highlighter->scratch.runs);
+    mem_free(MEM_HIGHLIGHT, highlighter);
+}
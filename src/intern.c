@@ -0,0 +1,219 @@
+/*
+ *  Interning of lines, for files with many identical lines such as logs and generated code. Every distinct
+ *  line is stored once in a pool of immutable strings, found again through a hash table, and the lines
+ *  borrow their characters from it. A borrowed line copies its characters before it is edited, so the
+ *  shared string never changes and the lines are read and drawn like any other.
+ */
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "intern.h"
+#include "line.h"
+#include "diff.h"
+#include "mem.h"
+
+/*
+ *  Purpose: Create an empty pool. It should be released with 'intern_free', once no line borrows from it.
+ *           A pool is used by one thread at a time.
+ *
+ *  Parameters: None.
+ *
+ *  Returns:
+ *    - Pointer to the new InternPool.
+ */
+InternPool* intern_create(void)
+{
+    InternPool* pool = mem_calloc(MEM_INTERN, 1, sizeof(*pool));
+    pool->capacity = INTERN_INIT_CAPACITY;
+    pool->entries = mem_calloc(MEM_INTERN, pool->capacity, sizeof(pool->entries[0]));
+    return pool;
+}
+
+/*
+ *  Purpose: Find the slot of a string, or the empty slot where it belongs.
+ *
+ *  Parameters:
+ *    - entries: Pointer to the slots.
+ *    - capacity: The number of slots, a power of two.
+ *    - hash: The hash of the string.
+ *    - chars: Pointer to the characters.
+ *    - size: The number of characters.
+ *
+ *  Returns: Pointer to the slot.
+ */
+static InternEntry* intern_find(InternEntry* entries, size_t capacity, uint64_t hash, const char* chars, size_t size)
+{
+    size_t slot = hash & (capacity - 1);
+    while (entries[slot].chars != NULL) {
+        const InternEntry* entry = entries + slot;
+        if (entry->hash == hash && entry->size == size && memcmp(entry->chars, chars, size) == 0)
+            break;
+        slot = (slot + 1) & (capacity - 1);
+    }
+    return entries + slot;
+}
+
+/*
+ *  Purpose: Double the slots of the hash table and move the strings over.
+ *
+ *  Parameters:
+ *    - pool: Pointer to the InternPool.
+ *
+ *  Returns: None.
+ */
+static void intern_grow(InternPool* pool)
+{
+    size_t new_capacity = pool->capacity * 2;
+    InternEntry* entries = mem_calloc(MEM_INTERN, new_capacity, sizeof(entries[0]));
+    for (size_t i = 0; i < pool->capacity; i++) {
+        const InternEntry* entry = pool->entries + i;
+        if (entry->chars != NULL)
+            *intern_find(entries, new_capacity, entry->hash, entry->chars, entry->size) = *entry;
+    }
+
+    mem_free(MEM_INTERN, pool->entries);
+    pool->entries = entries;
+    pool->capacity = new_capacity;
+}
+
+/*
+ *  Purpose: Keep a block of the pool so it is freed with it.
+ *
+ *  Parameters:
+ *    - pool: Pointer to the InternPool.
+ *    - block: Pointer to the block.
+ *    - size: The number of characters it holds.
+ *
+ *  Returns: None.
+ */
+static void intern_push_block(InternPool* pool, char* block, size_t size)
+{
+    if (pool->num_blocks == pool->blocks_capacity) {
+        pool->blocks_capacity = pool->blocks_capacity == 0 ? INTERN_INIT_BLOCKS : pool->blocks_capacity * 2;
+        pool->blocks = mem_realloc(MEM_INTERN, pool->blocks, pool->blocks_capacity * sizeof(pool->blocks[0]));
+    }
+    pool->blocks[pool->num_blocks++] = block;
+    pool->block_bytes += size;
+}
+
+/*
+ *  Purpose: Copy a string into the blocks of the pool.
+ *
+ *  Parameters:
+ *    - pool: Pointer to the InternPool.
+ *    - chars: Pointer to the characters.
+ *    - size: The number of characters, above 0.
+ *
+ *  Returns: Pointer to the copy.
+ */
+static const char* intern_store(InternPool* pool, const char* chars, size_t size)
+{
+    char* copy;
+    if (size > INTERN_MAX_PACKED_SIZE) {
+        copy = mem_malloc(MEM_INTERN, size);
+        intern_push_block(pool, copy, size);
+    } else {
+        // What is left of the last block is given up, it is less than a quarter of it at worst
+        if (pool->block == NULL || INTERN_BLOCK_SIZE - pool->block_used < size) {
+            pool->block = mem_malloc(MEM_INTERN, INTERN_BLOCK_SIZE);
+            pool->block_used = 0;
+            intern_push_block(pool, pool->block, INTERN_BLOCK_SIZE);
+        }
+        copy = pool->block + pool->block_used;
+        pool->block_used += size;
+    }
+
+    memcpy(copy, chars, size);
+    pool->string_bytes += size;
+    return copy;
+}
+
+/*
+ *  Purpose: Get the shared copy of a string, storing it in the pool the first time it is seen.
+ *
+ *  Parameters:
+ *    - pool: Pointer to the InternPool.
+ *    - chars: Pointer to the characters (not null-terminated).
+ *    - size: The number of characters.
+ *
+ *  Returns:
+ *    - Pointer to the shared characters, which stay valid and unchanged until the pool is freed.
+ */
+const char* intern_string(InternPool* pool, const char* chars, size_t size)
+{
+    // Slots are told apart from empty ones by their characters, which an empty string does not need
+    if (size == 0)
+        return "";
+
+    uint64_t hash = diff_hash_line(chars, size);
+    InternEntry* entry = intern_find(pool->entries, pool->capacity, hash, chars, size);
+    if (entry->chars != NULL)
+        return entry->chars;
+
+    *entry = (InternEntry) {.hash = hash, .size = size, .chars = intern_store(pool, chars, size)};
+    const char* shared = entry->chars;
+    pool->size++;
+    if (pool->size * 2 > pool->capacity)
+        intern_grow(pool);
+    return shared;
+}
+
+/*
+ *  Purpose: Replace the characters of a line with their shared copy. Empty, borrowed, cold and chunked lines
+ *           are left as they are.
+ *
+ *  Parameters:
+ *    - pool: Pointer to the InternPool.
+ *    - line: Pointer to the line, whose own characters are freed.
+ *
+ *  Returns:
+ *    - true if the line now borrows from the pool.
+ *    - false otherwise.
+ */
+bool intern_line(InternPool* pool, Line* line)
+{
+    if (line->size == 0 || line->capacity == 0 || line_is_chunked(line))
+        return false;
+
+    // The pool never changes its strings, the line copies them again before it is edited
+    const char* shared = intern_string(pool, line->chars, line->size);
+    pool->num_lines++;
+    pool->line_bytes += line->size;
+    mem_free(MEM_LINES, line->chars);
+    line->chars = (char*)shared;
+    line->capacity = 0;
+    return true;
+}
+
+/*
+ *  Purpose: Get how many times over the interned lines are held by the pool's strings.
+ *
+ *  Parameters:
+ *    - pool: Pointer to the InternPool.
+ *
+ *  Returns:
+ *    - The characters of the interned lines over those of the distinct strings, 1 for an empty pool.
+ */
+double intern_dedupe_ratio(const InternPool* pool)
+{
+    return pool->string_bytes > 0 ? (double)pool->line_bytes / pool->string_bytes : 1.0;
+}
+
+/*
+ *  Purpose: Free the strings and the InternPool. No line may borrow from it any more.
+ *
+ *  Parameters:
+ *    - pool: Pointer to the InternPool to free.
+ *
+ *  Returns: None.
+ */
+void intern_free(InternPool* pool)
+{
+    for (size_t i = 0; i < pool->num_blocks; i++)
+        mem_free(MEM_INTERN, pool->blocks[i]);
+    mem_free(MEM_INTERN, pool->blocks);
+    mem_free(MEM_INTERN, pool->entries);
+    mem_free(MEM_INTERN, pool);
+}
@@ -0,0 +1,380 @@
+/*
+ *  Job system for background work. Each worker thread has a deque per priority: it takes its newest job
+ *  from the bottom of its own and, when that is empty, steals the oldest one from the top of another
+ *  worker's, so the work spreads over the threads without a shared queue. Every worker drains the higher
+ *  priorities of all deques before the lower ones, so the work for what is on screen goes first.
+ *  Finished jobs are pushed onto a lock-free stack that the main thread drains each frame, which is
+ *  where their results are handed over to the rest of the editor.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "jobs.h"
+#include "utils.h"
+#include "mem.h"
+#include "SDL.h"
+
+/*
+ *  Purpose: Add a job to the bottom of a deque.
+ *
+ *  Parameters:
+ *    - deque: Pointer to the JobDeque.
+ *    - job: Pointer to the Job.
+ *
+ *  Returns: None.
+ */
+static void jobs_push(JobDeque* deque, Job* job)
+{
+    SDL_LockMutex(deque->mutex);
+    if (deque->size == deque->capacity) {
+        // The ring is unrolled into the new buffer, from its head
+        size_t new_capacity = deque->capacity == 0 ? JOBS_DEQUE_INIT_CAPACITY : deque->capacity * 2;
+        Job** jobs = mem_malloc(MEM_JOBS, new_capacity * sizeof(jobs[0]));
+        for (size_t i = 0; i < deque->size; i++)
+            jobs[i] = deque->jobs[(deque->head + i) % deque->capacity];
+        mem_free(MEM_JOBS, deque->jobs);
+        deque->jobs = jobs;
+        deque->capacity = new_capacity;
+        deque->head = 0;
+    }
+    deque->jobs[(deque->head + deque->size) % deque->capacity] = job;
+    deque->size++;
+    SDL_UnlockMutex(deque->mutex);
+}
+
+/*
+ *  Purpose: Take a job from a deque.
+ *
+ *  Parameters:
+ *    - deque: Pointer to the JobDeque.
+ *    - steal: Whether to take the oldest job from the top, instead of the newest from the bottom.
+ *
+ *  Returns:
+ *    - Pointer to the Job.
+ *    - NULL if the deque is empty.
+ */
+static Job* jobs_pop(JobDeque* deque, bool steal)
+{
+    Job* job = NULL;
+    SDL_LockMutex(deque->mutex);
+    if (deque->size > 0) {
+        if (steal) {
+            job = deque->jobs[deque->head];
+            deque->head = (deque->head + 1) % deque->capacity;
+        } else
+            job = deque->jobs[(deque->head + deque->size - 1) % deque->capacity];
+        deque->size--;
+    }
+    SDL_UnlockMutex(deque->mutex);
+    return job;
+}
+
+/*
+ *  Purpose: Find the next job for a worker, from the highest priority any deque has work for.
+ *
+ *  Parameters:
+ *    - system: Pointer to the JobSystem.
+ *    - index: The index of the worker.
+ *
+ *  Returns:
+ *    - Pointer to the Job.
+ *    - NULL if every deque is empty.
+ */
+static Job* jobs_take(JobSystem* system, size_t index)
+{
+    if (SDL_AtomicGet(&system->queued) <= 0)
+        return NULL;
+
+    for (size_t priority = 0; priority < JOB_PRIORITY_COUNT; priority++) {
+        for (size_t i = 0; i < system->num_workers; i++) {
+            size_t victim = (index + i) % system->num_workers;
+            Job* job = jobs_pop(&system->deques[victim][priority], victim != index);
+            if (job != NULL) {
+                SDL_AtomicAdd(&system->queued, -1);
+                return job;
+            }
+        }
+    }
+    return NULL;
+}
+
+/*
+ *  Purpose: Hand a job that is done with over to the main thread, and wake 'jobs_wait' if it was the last
+ *           one of its token.
+ *
+ *  Parameters:
+ *    - system: Pointer to the JobSystem.
+ *    - job: Pointer to the Job, run or skipped.
+ *
+ *  Returns: None.
+ */
+static void jobs_finish(JobSystem* system, Job* job)
+{
+    // The job may be completed and freed by the main thread once it is pushed, the token is kept until
+    // it is no longer pending so 'jobs_wait' only returns when the job can be drained
+    JobToken* token = job->token;
+    if (token != NULL)
+        SDL_AtomicIncRef(&token->refs);
+
+    void* head;
+    do {
+        head = SDL_AtomicGetPtr(&system->finished);
+        job->next = head;
+    } while (!SDL_AtomicCASPtr(&system->finished, head, job));
+
+    if (token != NULL) {
+        if (SDL_AtomicAdd(&token->pending, -1) == 1) {
+            SDL_LockMutex(system->mutex);
+            SDL_CondBroadcast(system->done_cond);
+            SDL_UnlockMutex(system->mutex);
+        }
+        jobs_token_release(token);
+    }
+}
+
+/*
+ *  Purpose: Worker thread running jobs until the system is freed.
+ *
+ *  Parameters:
+ *    - data: Pointer to the JobWorker.
+ *
+ *  Returns: 0.
+ */
+static int jobs_thread(void* data)
+{
+    JobWorker* worker = data;
+    JobSystem* system = worker->system;
+
+    while (true) {
+        Job* job = jobs_take(system, worker->index);
+        if (job == NULL) {
+            // 'jobs_submit' signals under the mutex after counting its job, so no wake-up is lost
+            SDL_LockMutex(system->mutex);
+            while (SDL_AtomicGet(&system->queued) <= 0 && !SDL_AtomicGet(&system->quit))
+                SDL_CondWait(system->work_cond, system->mutex);
+            SDL_UnlockMutex(system->mutex);
+
+            if (SDL_AtomicGet(&system->quit))
+                break;
+            continue;
+        }
+
+        job->skipped = jobs_cancelled(job->token);
+        if (!job->skipped)
+            job->run(job->data, job->token);
+        jobs_finish(system, job);
+    }
+    return 0;
+}
+
+/*
+ *  Purpose: Start the worker threads. The system should be released with 'jobs_free'.
+ *
+ *  Parameters:
+ *    - num_workers: The number of worker threads, from 1 to JOBS_MAX_WORKERS.
+ *
+ *  Returns:
+ *    - Pointer to the new JobSystem.
+ */
+JobSystem* jobs_create(size_t num_workers)
+{
+    assert(num_workers >= 1 && num_workers <= JOBS_MAX_WORKERS);
+
+    JobSystem* system = mem_calloc(MEM_JOBS, 1, sizeof(*system));
+    system->num_workers = num_workers;
+    system->mutex = utils_scp(SDL_CreateMutex());
+    system->work_cond = utils_scp(SDL_CreateCond());
+    system->done_cond = utils_scp(SDL_CreateCond());
+
+    for (size_t i = 0; i < num_workers; i++)
+        for (size_t priority = 0; priority < JOB_PRIORITY_COUNT; priority++)
+            system->deques[i][priority].mutex = utils_scp(SDL_CreateMutex());
+
+    for (size_t i = 0; i < num_workers; i++) {
+        system->workers[i] = (JobWorker) {.system = system, .index = i};
+        system->threads[i] = utils_scp(SDL_CreateThread(jobs_thread, "job worker", &system->workers[i]));
+    }
+    return system;
+}
+
+/*
+ *  Purpose: Create a cancellation token. It should be released with 'jobs_token_release' by its owner, and
+ *           is freed once its jobs are completed too.
+ *
+ *  Parameters: None.
+ *
+ *  Returns:
+ *    - Pointer to the new JobToken.
+ */
+JobToken* jobs_token_create(void)
+{
+    JobToken* token = mem_calloc(MEM_JOBS, 1, sizeof(*token));
+    SDL_AtomicSet(&token->refs, 1);
+    return token;
+}
+
+/*
+ *  Purpose: Give up the owner's reference to a token.
+ *
+ *  Parameters:
+ *    - token: Pointer to the JobToken.
+ *
+ *  Returns: None.
+ */
+void jobs_token_release(JobToken* token)
+{
+    if (SDL_AtomicDecRef(&token->refs))
+        mem_free(MEM_JOBS, token);
+}
+
+/*
+ *  Purpose: Cancel the jobs of a token. Those not started are skipped, running ones see 'jobs_cancelled'.
+ *
+ *  Parameters:
+ *    - token: Pointer to the JobToken.
+ *
+ *  Returns: None.
+ */
+void jobs_cancel(JobToken* token)
+{
+    SDL_AtomicSet(&token->cancelled, 1);
+}
+
+/*
+ *  Purpose: Check whether the jobs of a token were cancelled.
+ *
+ *  Parameters:
+ *    - token: Pointer to the JobToken (NULL for jobs that cannot be cancelled).
+ *
+ *  Returns:
+ *    - true if 'jobs_cancel' was called on the token.
+ *    - false otherwise.
+ */
+bool jobs_cancelled(JobToken* token)
+{
+    return token != NULL && SDL_AtomicGet(&token->cancelled) != 0;
+}
+
+/*
+ *  Purpose: Queue a job for the workers.
+ *
+ *  Parameters:
+ *    - system: Pointer to the JobSystem.
+ *    - priority: The JobPriority of the job.
+ *    - run: The function run on a worker.
+ *    - complete: The function run on the main thread once it finished (can be NULL).
+ *    - data: Pointer passed to both functions.
+ *    - token: Pointer to the JobToken the job belongs to (can be NULL).
+ *
+ *  Returns: None.
+ */
+void jobs_submit(JobSystem* system, JobPriority priority, JobRun run, JobComplete complete, void* data, JobToken* token)
+{
+    Job* job = mem_malloc(MEM_JOBS, sizeof(*job));
+    *job = (Job) {.run = run, .complete = complete, .data = data, .token = token};
+    if (token != NULL) {
+        SDL_AtomicIncRef(&token->refs);
+        SDL_AtomicIncRef(&token->pending);
+    }
+
+    // Counted first, so the count is never below the jobs a worker can find
+    SDL_AtomicIncRef(&system->queued);
+    size_t worker = (size_t)(unsigned)SDL_AtomicAdd(&system->next_worker, 1) % system->num_workers;
+    jobs_push(&system->deques[worker][priority], job);
+
+    SDL_LockMutex(system->mutex);
+    SDL_CondSignal(system->work_cond);
+    SDL_UnlockMutex(system->mutex);
+}
+
+/*
+ *  Purpose: Complete the jobs that finished since the last call, in the order they finished. Called by the
+ *           main thread only.
+ *
+ *  Parameters:
+ *    - system: Pointer to the JobSystem.
+ *
+ *  Returns: The number of jobs completed.
+ */
+size_t jobs_drain(JobSystem* system)
+{
+    // The whole stack is taken at once, so the workers never race the main thread for a node
+    Job* job = SDL_AtomicSetPtr(&system->finished, NULL);
+
+    Job* oldest = NULL;
+    while (job != NULL) {
+        Job* next = job->next;
+        job->next = oldest;
+        oldest = job;
+        job = next;
+    }
+
+    size_t count = 0;
+    for (job = oldest; job != NULL; count++) {
+        Job* next = job->next;
+        if (job->complete != NULL)
+            job->complete(job->data, job->skipped || jobs_cancelled(job->token));
+        if (job->token != NULL)
+            jobs_token_release(job->token);
+        mem_free(MEM_JOBS, job);
+        job = next;
+    }
+    return count;
+}
+
+/*
+ *  Purpose: Wait until no job of a token is queued or running. They are completed by the next 'jobs_drain'.
+ *
+ *  Parameters:
+ *    - system: Pointer to the JobSystem.
+ *    - token: Pointer to the JobToken.
+ *
+ *  Returns: None.
+ */
+void jobs_wait(JobSystem* system, JobToken* token)
+{
+    SDL_LockMutex(system->mutex);
+    while (SDL_AtomicGet(&token->pending) > 0)
+        SDL_CondWait(system->done_cond, system->mutex);
+    SDL_UnlockMutex(system->mutex);
+}
+
+/*
+ *  Purpose: Stop the workers, complete the queued jobs as cancelled and free the system.
+ *
+ *  Parameters:
+ *    - system: Pointer to the JobSystem to free.
+ *
+ *  Returns: None.
+ */
+void jobs_free(JobSystem* system)
+{
+    SDL_LockMutex(system->mutex);
+    SDL_AtomicSet(&system->quit, 1);
+    SDL_CondBroadcast(system->work_cond);
+    SDL_UnlockMutex(system->mutex);
+    for (size_t i = 0; i < system->num_workers; i++)
+        SDL_WaitThread(system->threads[i], NULL);
+
+    // The jobs the workers did not get to are skipped
+    for (size_t i = 0; i < system->num_workers; i++) {
+        for (size_t priority = 0; priority < JOB_PRIORITY_COUNT; priority++) {
+            JobDeque* deque = &system->deques[i][priority];
+            Job* job;
+            while ((job = jobs_pop(deque, true)) != NULL) {
+                job->skipped = true;
+                jobs_finish(system, job);
+            }
+            mem_free(MEM_JOBS, deque->jobs);
+            SDL_DestroyMutex(deque->mutex);
+        }
+    }
+    jobs_drain(system);
+
+    SDL_DestroyCond(system->done_cond);
+    SDL_DestroyCond(system->work_cond);
+    SDL_DestroyMutex(system->mutex);
+    mem_free(MEM_JOBS, system);
+}
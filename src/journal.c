@@ -0,0 +1,365 @@
+/*
+ *  Crash-recovery journal. Every edit is appended as a small binary record to a journal next to the
+ *  file (".NAME.med-journal"), relative to the version of the file that was last loaded or saved.
+ *  Records are collected in memory and written with one fdatasync per JOURNAL_COMMIT_INTERVAL_MS by a
+ *  background thread, so typing never waits on the disk. After a crash the journal is replayed onto the
+ *  file the next time it is opened.
+ */
+#define _XOPEN_SOURCE 700 // fdatasync, ftruncate, st_mtim
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "journal.h"
+#include "editor.h"
+#include "keylog.h"
+#include "utils.h"
+#include "mem.h"
+#include "SDL.h"
+
+/*
+ *  Purpose: Get the path of the journal of a file.
+ *
+ *  Parameters:
+ *    - file_path: Null-terminated path to the file being edited.
+ *
+ *  Returns:
+ *    - Pointer to the null-terminated path, to be freed by the caller.
+ */
+char* journal_path(const char* file_path)
+{
+    const char* slash = strrchr(file_path, '/');
+    size_t dir_size = slash != NULL ? slash - file_path + 1 : 0;
+    const char* name = file_path + dir_size;
+
+    size_t size = dir_size + 1 + strlen(name) + strlen(JOURNAL_SUFFIX) + 1;
+    char* path = mem_malloc(MEM_OTHER, size);
+    snprintf(path, size, "%.*s.%s%s", (int)dir_size, file_path, name, JOURNAL_SUFFIX);
+    return path;
+}
+
+/*
+ *  Purpose: Make the header identifying the current version of a file.
+ *
+ *  Parameters:
+ *    - file_path: Null-terminated path to the file.
+ *
+ *  Returns: The header (with a size and time of 0 if the file does not exist).
+ */
+static JournalHeader journal_header(const char* file_path)
+{
+    JournalHeader header = {0};
+    memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+
+    struct stat st;
+    if (stat(file_path, &st) == 0) {
+        header.base_size = st.st_size;
+        header.base_mtime_s = st.st_mtim.tv_sec;
+        header.base_mtime_ns = st.st_mtim.tv_nsec;
+    }
+    return header;
+}
+
+/*
+ *  Purpose: Check that a journal record can be applied to the Editor and move the cursor to it.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *    - record: Pointer to the record.
+ *
+ *  Returns:
+ *    - true if the record is valid.
+ *    - false otherwise.
+ */
+static bool journal_seek(Editor* editor, const JournalRecord* record)
+{
+    if (record->op >= KEYLOG_OP_COUNT || !keylog_op_is_edit(record->op) || record->text_size >= KEYLOG_TEXT_CAPACITY)
+        return false;
+
+    if (editor->size == 0) {
+        if (record->row != 0 || record->col != 0)
+            return false;
+    } else if (record->row >= editor->size || record->col > editor->lines[record->row].size)
+        return false;
+
+    editor->cursor_row = record->row;
+    editor->cursor_col = record->col;
+    return true;
+}
+
+/*
+ *  Purpose: Replay the journal left behind by a crash onto a freshly loaded file. A journal made for another
+ *           version of the file is not replayed but renamed with JOURNAL_STALE_SUFFIX, so it is not lost.
+ *
+ *  Parameters:
+ *    - file_path: Null-terminated path to the file.
+ *    - editor: Pointer to the Editor structure the file was loaded into.
+ *
+ *  Returns:
+ *    - The number of edits replayed (0 if there was no usable journal).
+ */
+size_t journal_replay(const char* file_path, Editor* editor)
+{
+    char* path = journal_path(file_path);
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL) {
+        mem_free(MEM_OTHER, path);
+        return 0;
+    }
+
+    JournalHeader header, expected = journal_header(file_path);
+    if (fread(&header, sizeof(header), 1, fp) != 1 || memcmp(&header, &expected, sizeof(header)) != 0) {
+        fclose(fp);
+        size_t stale_size = strlen(path) + strlen(JOURNAL_STALE_SUFFIX) + 1;
+        char* stale_path = mem_malloc(MEM_OTHER, stale_size);
+        snprintf(stale_path, stale_size, "%s%s", path, JOURNAL_STALE_SUFFIX);
+
+        if (rename(path, stale_path) == 0)
+            fprintf(stderr, "Warning: '%s' changed since its journal was written, the journal was moved to '%s'\n", file_path, stale_path);
+        mem_free(MEM_OTHER, stale_path);
+        mem_free(MEM_OTHER, path);
+        return 0;
+    }
+
+    size_t num_edits = 0;
+    long valid_end = ftell(fp);
+    JournalRecord record;
+    KeylogEntry entry = {.count = 1};
+
+    // A crash can leave the last record half written, replay stops at the first incomplete or invalid one
+    while (fread(&record, sizeof(record), 1, fp) == 1) {
+        if (record.text_size >= KEYLOG_TEXT_CAPACITY || fread(entry.text, 1, record.text_size, fp) != record.text_size)
+            break;
+        if (!journal_seek(editor, &record))
+            break;
+
+        entry.op = record.op;
+        entry.text[record.text_size] = '\0';
+        keylog_apply(editor, &entry);
+        num_edits++;
+        valid_end = ftell(fp);
+    }
+    fclose(fp);
+
+    // New records are appended after the last good one
+    if (truncate(path, valid_end) != 0)
+        fprintf(stderr, "Warning: Unable to trim the journal '%s': %s\n", path, strerror(errno));
+
+    mem_free(MEM_OTHER, path);
+    return num_edits;
+}
+
+/*
+ *  Purpose: Write records to the journal and flush them to the disk. Called by the thread only.
+ *
+ *  Parameters:
+ *    - journal: Pointer to the Journal.
+ *    - records: Pointer to the records.
+ *    - size: The number of bytes of records.
+ *
+ *  Returns: None.
+ */
+static void journal_write(Journal* journal, const char* records, size_t size)
+{
+    if (journal->fd < 0) {
+        if (journal->append)
+            journal->fd = open(journal->path, O_WRONLY | O_APPEND);
+        else {
+            journal->fd = open(journal->path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0600);
+            JournalHeader header = journal_header(journal->file_path);
+            if (journal->fd >= 0 && write(journal->fd, &header, sizeof(header)) != sizeof(header)) {
+                close(journal->fd);
+                journal->fd = -1;
+            }
+        }
+        journal->append = true;
+
+        if (journal->fd < 0) {
+            fprintf(stderr, "Warning: Unable to write the journal '%s': %s\n", journal->path, strerror(errno));
+            return;
+        }
+    }
+
+    while (size > 0) {
+        ssize_t written = write(journal->fd, records, size);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written < 0) {
+            fprintf(stderr, "Warning: Unable to write the journal '%s': %s\n", journal->path, strerror(errno));
+            return;
+        }
+        records += written;
+        size -= written;
+    }
+    fdatasync(journal->fd);
+}
+
+/*
+ *  Purpose: Thread writing the records collected since the last commit every JOURNAL_COMMIT_INTERVAL_MS.
+ *
+ *  Parameters:
+ *    - data: Pointer to the Journal.
+ *
+ *  Returns: 0.
+ */
+static int journal_thread(void* data)
+{
+    Journal* journal = data;
+    char* writing = NULL;
+    size_t writing_capacity = 0;
+
+    SDL_LockMutex(journal->mutex);
+    bool quit = false;
+    while (!quit) {
+        if (!journal->quit)
+            SDL_CondWaitTimeout(journal->cond, journal->mutex, JOURNAL_COMMIT_INTERVAL_MS);
+        quit = journal->quit;
+
+        // Swap buffers so records can be added while these are written
+        char* records = journal->pending;
+        size_t records_capacity = journal->pending_capacity;
+        size_t size = journal->pending_size;
+        bool reset = journal->reset;
+        journal->pending = writing;
+        journal->pending_capacity = writing_capacity;
+        journal->pending_size = 0;
+        journal->reset = false;
+        writing = records;
+        writing_capacity = records_capacity;
+        SDL_UnlockMutex(journal->mutex);
+
+        if (reset) {
+            if (journal->fd >= 0)
+                close(journal->fd);
+            journal->fd = -1;
+            journal->append = false;
+            unlink(journal->path);
+        }
+        if (size > 0)
+            journal_write(journal, records, size);
+
+        SDL_LockMutex(journal->mutex);
+    }
+    SDL_UnlockMutex(journal->mutex);
+
+    mem_free(MEM_OTHER, writing);
+    return 0;
+}
+
+/*
+ *  Purpose: Start journaling the edits of a file. The journal should be released with 'journal_close'.
+ *
+ *  Parameters:
+ *    - file_path: Null-terminated path to the file being edited.
+ *    - append: Whether to continue the journal on disk, after it was replayed with 'journal_replay'.
+ *
+ *  Returns:
+ *    - Pointer to the new Journal.
+ */
+Journal* journal_open(const char* file_path, bool append)
+{
+    Journal* journal = mem_calloc(MEM_OTHER, 1, sizeof(*journal));
+    journal->path = journal_path(file_path);
+    journal->file_path = mem_strdup(MEM_OTHER, file_path);
+    journal->fd = -1;
+    journal->append = append;
+    journal->mutex = utils_scp(SDL_CreateMutex());
+    journal->cond = utils_scp(SDL_CreateCond());
+    journal->thread = utils_scp(SDL_CreateThread(journal_thread, "journal", journal));
+    return journal;
+}
+
+/*
+ *  Purpose: Record an edit that is about to be applied to the Editor. Does not block on the disk.
+ *
+ *  Parameters:
+ *    - journal: Pointer to the Journal.
+ *    - editor: Pointer to the Editor, with the cursor where the edit happens.
+ *    - op: The edit.
+ *    - text: Null-terminated text for KEYLOG_INSERT (ignored otherwise, can be NULL).
+ *
+ *  Returns: None.
+ */
+void journal_record(Journal* journal, const Editor* editor, KeylogOp op, const char* text)
+{
+    if (!keylog_op_is_edit(op))
+        return;
+
+    size_t text_size = op == KEYLOG_INSERT ? strlen(text) : 0;
+    if (text_size >= KEYLOG_TEXT_CAPACITY)
+        text_size = KEYLOG_TEXT_CAPACITY - 1;
+
+    JournalRecord record = {
+        .op = op,
+        .text_size = text_size,
+        .row = editor->cursor_row,
+        .col = editor->cursor_col,
+    };
+
+    SDL_LockMutex(journal->mutex);
+    size_t size = sizeof(record) + text_size;
+    if (journal->pending_size + size > journal->pending_capacity) {
+        size_t capacity = journal->pending_capacity == 0 ? 4096 : journal->pending_capacity;
+        while (journal->pending_size + size > capacity)
+            capacity *= 2;
+        journal->pending = mem_realloc(MEM_OTHER, journal->pending, capacity);
+        journal->pending_capacity = capacity;
+    }
+    memcpy(journal->pending + journal->pending_size, &record, sizeof(record));
+    memcpy(journal->pending + journal->pending_size + sizeof(record), text, text_size);
+    journal->pending_size += size;
+    SDL_UnlockMutex(journal->mutex);
+}
+
+/*
+ *  Purpose: Start the journal over after the file was saved, which makes the saved version the new base.
+ *
+ *  Parameters:
+ *    - journal: Pointer to the Journal.
+ *
+ *  Returns: None.
+ */
+void journal_reset(Journal* journal)
+{
+    SDL_LockMutex(journal->mutex);
+    journal->pending_size = 0;
+    journal->reset = true;
+    SDL_UnlockMutex(journal->mutex);
+}
+
+/*
+ *  Purpose: Write the remaining records, stop the thread and free the Journal.
+ *
+ *  Parameters:
+ *    - journal: Pointer to the Journal to close.
+ *    - keep: Whether to keep the journal on disk, for edits that were not saved.
+ *
+ *  Returns: None.
+ */
+void journal_close(Journal* journal, bool keep)
+{
+    SDL_LockMutex(journal->mutex);
+    journal->quit = true;
+    SDL_CondSignal(journal->cond);
+    SDL_UnlockMutex(journal->mutex);
+    SDL_WaitThread(journal->thread, NULL);
+
+    if (journal->fd >= 0)
+        close(journal->fd);
+    if (!keep)
+        unlink(journal->path);
+
+    SDL_DestroyCond(journal->cond);
+    SDL_DestroyMutex(journal->mutex);
+    mem_free(MEM_OTHER, journal->pending);
+    mem_free(MEM_OTHER, journal->file_path);
+    mem_free(MEM_OTHER, journal->path);
+    mem_free(MEM_OTHER, journal);
+}
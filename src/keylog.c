@@ -0,0 +1,185 @@
+/*
+ *  Recording and replaying of editor keystroke traces.
+ *
+ *  A trace is a text file with one operation per line: the name of the operation, optionally
+ *  followed by a repeat count ("backspace 20"), or "insert " followed by the inserted text up
+ *  to the end of the line.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "keylog.h"
+#include "editor.h"
+#include "SDL.h"
+
+static const char* op_names[KEYLOG_OP_COUNT] = {
+    [KEYLOG_NONE]      = "none",
+    [KEYLOG_INSERT]    = "insert",
+    [KEYLOG_BACKSPACE] = "backspace",
+    [KEYLOG_DELETE]    = "delete",
+    [KEYLOG_LEFT]      = "left",
+    [KEYLOG_RIGHT]     = "right",
+    [KEYLOG_UP]        = "up",
+    [KEYLOG_DOWN]      = "down",
+    [KEYLOG_RETURN]    = "return",
+    [KEYLOG_TAB]       = "tab",
+};
+
+/*
+ *  Purpose: Map a key to the editing operation main.c dispatches it to.
+ *
+ *  Parameters:
+ *    - key: The SDL keycode of the pressed key.
+ *
+ *  Returns: The matching operation, or KEYLOG_NONE if the key does not edit the buffer or move the cursor.
+ */
+KeylogOp keylog_op_from_key(SDL_Keycode key)
+{
+    switch (key) {
+        case SDLK_BACKSPACE: return KEYLOG_BACKSPACE;
+        case SDLK_DELETE:    return KEYLOG_DELETE;
+        case SDLK_LEFT:      return KEYLOG_LEFT;
+        case SDLK_RIGHT:     return KEYLOG_RIGHT;
+        case SDLK_UP:        return KEYLOG_UP;
+        case SDLK_DOWN:      return KEYLOG_DOWN;
+        case SDLK_RETURN:    return KEYLOG_RETURN;
+        case SDLK_TAB:       return KEYLOG_TAB;
+        default:             return KEYLOG_NONE;
+    }
+}
+
+/*
+ *  Purpose: Get the name an operation is written as in a trace.
+ *
+ *  Parameters:
+ *    - op: The operation.
+ *
+ *  Returns: A null-terminated string naming the operation.
+ */
+const char* keylog_op_name(KeylogOp op)
+{
+    return op < KEYLOG_OP_COUNT ? op_names[op] : op_names[KEYLOG_NONE];
+}
+
+/*
+ *  Purpose: Check whether an operation changes the text, as opposed to moving the cursor.
+ *
+ *  Parameters:
+ *    - op: The operation.
+ *
+ *  Returns:
+ *    - true if the operation edits the buffer.
+ *    - false otherwise.
+ */
+bool keylog_op_is_edit(KeylogOp op)
+{
+    switch (op) {
+        case KEYLOG_INSERT:
+        case KEYLOG_BACKSPACE:
+        case KEYLOG_DELETE:
+        case KEYLOG_RETURN:
+        case KEYLOG_TAB:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/*
+ *  Purpose: Append an operation to a trace.
+ *
+ *  Parameters:
+ *    - fp: File pointer to the trace being recorded.
+ *    - op: The operation to record.
+ *    - text: Null-terminated text for KEYLOG_INSERT (ignored otherwise, can be NULL).
+ *
+ *  Returns: None.
+ */
+void keylog_write(FILE* fp, KeylogOp op, const char* text)
+{
+    if (op == KEYLOG_NONE)
+        return;
+
+    if (op == KEYLOG_INSERT)
+        fprintf(fp, "%s %s\n", op_names[op], text);
+    else
+        fprintf(fp, "%s\n", op_names[op]);
+}
+
+/*
+ *  Purpose: Read the next operation from a trace, skipping blank lines and lines starting with '#'.
+ *
+ *  Parameters:
+ *    - fp: File pointer to the trace being replayed.
+ *    - entry: Pointer to the KeylogEntry to fill in.
+ *
+ *  Returns:
+ *    - true if an operation was read.
+ *    - false at the end of the trace (unknown operations are reported on stderr and skipped).
+ */
+bool keylog_read(FILE* fp, KeylogEntry* entry)
+{
+    char line[KEYLOG_TEXT_CAPACITY + 32];
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#')
+            continue;
+
+        memset(entry, 0, sizeof(*entry));
+        entry->count = 1;
+
+        size_t name_size = strcspn(line, " ");
+        for (KeylogOp op = KEYLOG_INSERT; op < KEYLOG_OP_COUNT; op++)
+            if (strlen(op_names[op]) == name_size && strncmp(line, op_names[op], name_size) == 0)
+                entry->op = op;
+
+        const char* arg = line[name_size] == ' ' ? line + name_size + 1 : "";
+        if (entry->op == KEYLOG_INSERT) {
+            // Everything after the separating space is text, including any further spaces
+            strncpy(entry->text, arg, sizeof(entry->text) - 1);
+        } else if (entry->op != KEYLOG_NONE) {
+            if (*arg != '\0')
+                entry->count = strtoul(arg, NULL, 10);
+        } else {
+            fprintf(stderr, "Warning: skipping unknown trace operation '%s'\n", line);
+            continue;
+        }
+        return true;
+    }
+    return false;
+}
+
+/*
+ *  Purpose: Apply one repetition of an operation to the Editor through the same editor_* function
+ *           main.c calls for the corresponding key.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *    - entry: Pointer to the operation to apply.
+ *
+ *  Returns: None.
+ */
+void keylog_apply(Editor* editor, const KeylogEntry* entry)
+{
+    switch (entry->op) {
+        case KEYLOG_INSERT: {
+            char text[KEYLOG_TEXT_CAPACITY];
+            memcpy(text, entry->text, sizeof(text));
+            editor_insert_text_before_cursor(editor, text);
+        }
+        break;
+
+        case KEYLOG_BACKSPACE: editor_backspace(editor);   break;
+        case KEYLOG_DELETE:    editor_delete(editor);      break;
+        case KEYLOG_LEFT:      editor_left_arrow(editor);  break;
+        case KEYLOG_RIGHT:     editor_right_arrow(editor); break;
+        case KEYLOG_UP:        editor_up_arrow(editor);    break;
+        case KEYLOG_DOWN:      editor_down_arrow(editor);  break;
+        case KEYLOG_RETURN:    editor_return(editor);      break;
+        case KEYLOG_TAB:       editor_tab(editor);         break;
+        default:                                           break;
+    }
+}
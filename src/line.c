@@ -9,10 +9,10 @@
 #include <stdbool.h>
 
 #include "line.h"
-#include "utils.h"
+#include "mem.h"
 
 /*
- *  Purpose: Expand the capacity of a Line structure to accommodate additional characters.
+ *  Purpose: Expand the capacity of a Line structure, which is not chunked, to accommodate additional characters.
  *
  *  Parameters:
  *    - line: Pointer to the Line structure to expand.
@@ -22,7 +22,11 @@
  */
 void line_expand(Line* line, size_t n)
 {
-    size_t new_capacity = line->capacity;
+    assert(!line_is_chunked(line) && "Chunked lines have no room to expand");
+
+    // Borrowed characters are copied on the first edit that needs more room
+    bool borrowed = line->capacity == 0 && line->chars != NULL;
+    size_t new_capacity = borrowed ? line->size : line->capacity;
     assert(new_capacity >= line->size);
 
     while (new_capacity - line->size < n) { // free space is less than text to add
@@ -32,12 +36,312 @@ void line_expand(Line* line, size_t n)
             new_capacity *= 2;
     }
 
-    if (new_capacity != line->capacity) {
-        line->chars = utils_cp(realloc(line->chars, new_capacity * sizeof(line->chars[0])));
+    if (borrowed && new_capacity != line->size) {
+        char* chars = mem_malloc(MEM_LINES, new_capacity * sizeof(line->chars[0]));
+        memcpy(chars, line->chars, line->size);
+        line->chars = chars;
+        line->capacity = new_capacity;
+    } else if (!borrowed && new_capacity != line->capacity) {
+        line->chars = mem_realloc(MEM_LINES, line->chars, new_capacity * sizeof(line->chars[0]));
         line->capacity = new_capacity;
     }
 }
 
+/*
+ *  Purpose: Check whether the characters of a Line structure are stored in chunks.
+ *
+ *  Parameters:
+ *    - line: Pointer to the Line structure.
+ *
+ *  Returns:
+ *    - true if the line is chunked.
+ *    - false if its characters are contiguous.
+ */
+bool line_is_chunked(const Line* line)
+{
+    return line->capacity == LINE_CHUNKED;
+}
+
+/*
+ *  Purpose: Put a chunk into the chunks of a line.
+ *
+ *  Parameters:
+ *    - chunks: Pointer to the LineChunks.
+ *    - index: Where the chunk goes, at most the number of chunks.
+ *    - chars: Pointer to the characters to copy into the chunk.
+ *    - size: The number of characters, at most LINE_CHUNK_SIZE.
+ *
+ *  Returns: None.
+ */
+static void line_chunks_insert_chunk(LineChunks* chunks, size_t index, const char* chars, size_t size)
+{
+    if (chunks->size == chunks->capacity) {
+        chunks->capacity = chunks->capacity == 0 ? LINE_INIT_CHUNKS : chunks->capacity * 2;
+        chunks->chunks = mem_realloc(MEM_LINES, chunks->chunks, chunks->capacity * sizeof(chunks->chunks[0]));
+    }
+    memmove(chunks->chunks + index + 1, chunks->chunks + index, (chunks->size - index) * sizeof(chunks->chunks[0]));
+
+    LineChunk* chunk = chunks->chunks + index;
+    chunk->chars = mem_malloc(MEM_LINES, LINE_CHUNK_SIZE);
+    chunk->size = size;
+    if (size > 0)
+        memcpy(chunk->chars, chars, size);
+    chunks->size++;
+}
+
+/*
+ *  Purpose: Take a chunk out of the chunks of a line and free it.
+ *
+ *  Parameters:
+ *    - chunks: Pointer to the LineChunks.
+ *    - index: The index of the chunk.
+ *
+ *  Returns: None.
+ */
+static void line_chunks_remove_chunk(LineChunks* chunks, size_t index)
+{
+    mem_free(MEM_LINES, chunks->chunks[index].chars);
+    memmove(chunks->chunks + index, chunks->chunks + index + 1, (chunks->size - index - 1) * sizeof(chunks->chunks[0]));
+    chunks->size--;
+}
+
+/*
+ *  Purpose: Find the chunk holding a column, the chunk it ends if it is between two.
+ *
+ *  Parameters:
+ *    - chunks: Pointer to the LineChunks, with at least one chunk.
+ *    - col: The column, at most the size of the line.
+ *    - offset: Pointer set to the column within the chunk.
+ *
+ *  Returns: The index of the chunk.
+ */
+static size_t line_chunks_find(const LineChunks* chunks, size_t col, size_t* offset)
+{
+    size_t index = 0;
+    while (index + 1 < chunks->size && col > chunks->chunks[index].size) {
+        col -= chunks->chunks[index].size;
+        index++;
+    }
+    *offset = col;
+    return index;
+}
+
+/*
+ *  Purpose: Move the characters of a Line structure into chunks.
+ *
+ *  Parameters:
+ *    - line: Pointer to the Line structure, which is not chunked.
+ *
+ *  Returns: None.
+ */
+static void line_chunk(Line* line)
+{
+    LineChunks* chunks = mem_calloc(MEM_LINES, 1, sizeof(*chunks));
+    for (size_t start = 0; start < line->size; start += LINE_CHUNK_SIZE) {
+        size_t size = line->size - start < LINE_CHUNK_SIZE ? line->size - start : LINE_CHUNK_SIZE;
+        line_chunks_insert_chunk(chunks, chunks->size, line->chars + start, size);
+    }
+
+    if (line->capacity > 0)
+        mem_free(MEM_LINES, line->chars);
+    line->chunks = chunks;
+    line->capacity = LINE_CHUNKED;
+}
+
+/*
+ *  Purpose: Insert text into a chunked line. The text goes into the chunk of the column when it fits, otherwise
+ *           the rest of that chunk moves to a chunk of its own and the text fills new chunks between them.
+ *
+ *  Parameters:
+ *    - chunks: Pointer to the LineChunks.
+ *    - col: The column to insert at, at most the size of the line.
+ *    - text: Pointer to the text.
+ *    - text_size: The number of characters.
+ *
+ *  Returns: None.
+ */
+static void line_chunks_insert(LineChunks* chunks, size_t col, const char* text, size_t text_size)
+{
+    if (chunks->size == 0)
+        line_chunks_insert_chunk(chunks, 0, NULL, 0);
+
+    size_t offset;
+    size_t index = line_chunks_find(chunks, col, &offset);
+    LineChunk* chunk = chunks->chunks + index;
+    if (chunk->size + text_size <= LINE_CHUNK_SIZE) {
+        memmove(chunk->chars + offset + text_size, chunk->chars + offset, chunk->size - offset);
+        memcpy(chunk->chars + offset, text, text_size);
+        chunk->size += text_size;
+        return;
+    }
+
+    if (offset < chunk->size) {
+        line_chunks_insert_chunk(chunks, index + 1, chunk->chars + offset, chunk->size - offset);
+        chunk = chunks->chunks + index;
+        chunk->size = offset;
+    }
+
+    size_t fill = LINE_CHUNK_SIZE - chunk->size < text_size ? LINE_CHUNK_SIZE - chunk->size : text_size;
+    memcpy(chunk->chars + chunk->size, text, fill);
+    chunk->size += fill;
+    for (size_t next = index + 1; fill < text_size; next++) {
+        size_t size = text_size - fill < LINE_CHUNK_SIZE ? text_size - fill : LINE_CHUNK_SIZE;
+        line_chunks_insert_chunk(chunks, next, text + fill, size);
+        fill += size;
+    }
+}
+
+/*
+ *  Purpose: Remove characters from a chunked line. Chunks left empty are freed, and a chunk is merged with the
+ *           next one when both fit in one.
+ *
+ *  Parameters:
+ *    - chunks: Pointer to the LineChunks.
+ *    - col: The first column to remove.
+ *    - count: The number of characters to remove, all of them before the end of the line.
+ *
+ *  Returns: None.
+ */
+static void line_chunks_erase(LineChunks* chunks, size_t col, size_t count)
+{
+    while (count > 0) {
+        size_t offset;
+        size_t index = line_chunks_find(chunks, col, &offset);
+        if (offset == chunks->chunks[index].size) {
+            index++;
+            offset = 0;
+        }
+
+        LineChunk* chunk = chunks->chunks + index;
+        size_t n = chunk->size - offset < count ? chunk->size - offset : count;
+        memmove(chunk->chars + offset, chunk->chars + offset + n, chunk->size - offset - n);
+        chunk->size -= n;
+        count -= n;
+
+        if (chunk->size == 0)
+            line_chunks_remove_chunk(chunks, index);
+        else if (index + 1 < chunks->size && chunk->size + chunk[1].size <= LINE_CHUNK_SIZE) {
+            memcpy(chunk->chars + chunk->size, chunk[1].chars, chunk[1].size);
+            chunk->size += chunk[1].size;
+            line_chunks_remove_chunk(chunks, index + 1);
+        }
+    }
+}
+
+/*
+ *  Purpose: Copy a range of the characters of a Line structure, whether it is chunked or not.
+ *
+ *  Parameters:
+ *    - line: Pointer to the Line structure.
+ *    - start: The first column to copy.
+ *    - end: The column after the last one to copy, at most the size of the line.
+ *    - dst: Pointer to room for 'end - start' characters.
+ *
+ *  Returns: None.
+ */
+void line_copy_range(const Line* line, size_t start, size_t end, char* dst)
+{
+    if (end <= start)
+        return;
+    if (!line_is_chunked(line)) {
+        memcpy(dst, line->chars + start, end - start);
+        return;
+    }
+
+    const LineChunks* chunks = line->chunks;
+    size_t offset;
+    for (size_t index = line_chunks_find(chunks, start, &offset); start < end; index++, offset = 0) {
+        const LineChunk* chunk = chunks->chunks + index;
+        size_t n = chunk->size - offset < end - start ? chunk->size - offset : end - start;
+        memcpy(dst, chunk->chars + offset, n);
+        dst += n;
+        start += n;
+    }
+}
+
+/*
+ *  Purpose: Get the character at a column of a Line structure, whether it is chunked or not.
+ *
+ *  Parameters:
+ *    - line: Pointer to the Line structure.
+ *    - col: The column, below the size of the line.
+ *
+ *  Returns: The character.
+ */
+char line_char_at(const Line* line, size_t col)
+{
+    char ch;
+    line_copy_range(line, col, col + 1, &ch);
+    return ch;
+}
+
+/*
+ *  Purpose: Copy the characters of a Line structure if they are borrowed, before they are changed in place.
+ *
+ *  Parameters:
+ *    - line: Pointer to the Line structure.
+ *
+ *  Returns: None.
+ */
+static void line_own(Line* line)
+{
+    // Borrowed characters can be shared with other lines, which must not see the change
+    if (line->capacity == 0 && line->chars != NULL && line->size > 0) {
+        char* chars = mem_malloc(MEM_LINES, line->size * sizeof(line->chars[0]));
+        memcpy(chars, line->chars, line->size);
+        line->chars = chars;
+        line->capacity = line->size;
+    }
+}
+
+/*
+ *  Purpose: Free the characters of a Line structure, unless they are borrowed (capacity of 0).
+ *
+ *  Parameters:
+ *    - line: Pointer to the Line structure to free.
+ *
+ *  Returns: None.
+ */
+void line_free(Line* line)
+{
+    if (line_is_chunked(line)) {
+        for (size_t i = 0; i < line->chunks->size; i++)
+            mem_free(MEM_LINES, line->chunks->chunks[i].chars);
+        mem_free(MEM_LINES, line->chunks->chunks);
+        mem_free(MEM_LINES, line->chunks);
+    } else if (line->capacity > 0)
+        mem_free(MEM_LINES, line->chars);
+    line->chars = NULL;
+    line->capacity = 0;
+    line->size = 0;
+}
+
+/*
+ *  Purpose: Give back the room a Line structure has beyond its characters, if it is at least
+ *           LINE_SHRINK_MIN_SLACK. Borrowed and chunked characters are left as they are.
+ *
+ *  Parameters:
+ *    - line: Pointer to the Line structure to shrink.
+ *
+ *  Returns:
+ *    - true if the line was shrunk.
+ *    - false otherwise.
+ */
+bool line_shrink_to_fit(Line* line)
+{
+    // A capacity of 0 is borrowed (or no) characters, which have no room of their own, and chunks stay full enough
+    if (line->capacity == 0 || line_is_chunked(line) || line->capacity - line->size < LINE_SHRINK_MIN_SLACK)
+        return false;
+
+    if (line->size == 0) {
+        line_free(line);
+        return true;
+    }
+    line->chars = mem_realloc(MEM_LINES, line->chars, line->size * sizeof(line->chars[0]));
+    line->capacity = line->size;
+    return true;
+}
+
 /*
  *  Purpose: Insert a null-terminated string before the cursor position in a Line structure.
  *
@@ -67,6 +371,15 @@ void line_insert_text_before_cursor(Line* line, char* text, size_t* col)
 void line_insert_text_segment_before_cursor(Line* line, char* text, size_t text_size, size_t* col)
 {
     assert(*col <= line->size);
+    if (!line_is_chunked(line) && line->size + text_size > LINE_CHUNK_THRESHOLD)
+        line_chunk(line);
+
+    if (line_is_chunked(line)) {
+        line_chunks_insert(line->chunks, *col, text, text_size);
+        line->size += text_size;
+        *col += text_size;
+        return;
+    }
     line_expand(line, text_size);
 
     char* src = line->chars + *col;
@@ -90,6 +403,20 @@ void line_insert_text_segment_before_cursor(Line* line, char* text, size_t text_
  */
 static bool leading_whitespace(const Line* line, size_t* col)
 {
+    if (line_is_chunked(line)) {
+        size_t checked = 0;
+        for (size_t index = 0; checked < *col; index++) {
+            const LineChunk* chunk = line->chunks->chunks + index;
+            size_t n = chunk->size < *col - checked ? chunk->size : *col - checked;
+            for (size_t i = 0; i < n; i++) {
+                if (chunk->chars[i] != ' ')
+                    return false;
+            }
+            checked += n;
+        }
+        return true;
+    }
+
     for (size_t i = 0; i < *col; i++) {
         if (line->chars[i] != ' ')
             return false;
@@ -113,8 +440,17 @@ void line_backspace(Line* line, size_t* col)
     if (leading_whitespace(line, col))
         backspaces = ((*col) % TAB_STOP == 0) ? TAB_STOP : (*col) % TAB_STOP;
 
-    char* src = line->chars + *col;
-    if (*col > 0) {
+    // Long lines loaded in one piece are chunked on their first edit, not moved whole on every one
+    if (!line_is_chunked(line) && line->size > LINE_CHUNK_THRESHOLD)
+        line_chunk(line);
+
+    if (*col > 0 && line_is_chunked(line)) {
+        line_chunks_erase(line->chunks, *col - backspaces, backspaces);
+        line->size -= backspaces;
+        *col -= backspaces;
+    } else if (*col > 0) {
+        line_own(line);
+        char* src = line->chars + *col;
         memmove(src - backspaces, src, line->size - *col);
         line->size -= backspaces;
         *col -= backspaces;
@@ -132,9 +468,16 @@ void line_backspace(Line* line, size_t* col)
  */
 void line_delete(Line* line, size_t* col)
 {
-    if (*col < line->size) {
+    if (!line_is_chunked(line) && line->size > LINE_CHUNK_THRESHOLD)
+        line_chunk(line);
+
+    if (*col < line->size && line_is_chunked(line)) {
+        line_chunks_erase(line->chunks, *col, 1);
+        line->size--;
+    } else if (*col < line->size) {
+        line_own(line);
         char* src = line->chars + *col + 1;
-        memmove(src - 1, src, line->size - *col);
+        memmove(src - 1, src, line->size - *col - 1);
         line->size--;
     }
 }
@@ -170,4 +513,84 @@ void line_append_text_segment(Line* line, char* text, size_t text_size)
 {
     size_t col = line->size;
     line_insert_text_segment_before_cursor(line, text, text_size, &col);
-}
\ No newline at end of file
+}
+
+/*
+ *  Purpose: Append a range of the characters of another Line structure to the end of a Line structure.
+ *
+ *  Parameters:
+ *    - line: Pointer to the Line structure to append text to.
+ *    - src: Pointer to the other Line structure.
+ *    - start: The first column of 'src' to append.
+ *    - end: The column after the last one to append, at most the size of 'src'.
+ *
+ *  Returns: None.
+ */
+void line_append_range(Line* line, const Line* src, size_t start, size_t end)
+{
+    if (!line_is_chunked(src)) {
+        if (end > start)
+            line_append_text_segment(line, src->chars + start, end - start);
+        return;
+    }
+
+    // A chunk at a time, so a long line is never copied whole
+    size_t offset;
+    for (size_t index = line_chunks_find(src->chunks, start, &offset); start < end; index++, offset = 0) {
+        const LineChunk* chunk = src->chunks->chunks + index;
+        size_t n = chunk->size - offset < end - start ? chunk->size - offset : end - start;
+        line_append_text_segment(line, chunk->chars + offset, n);
+        start += n;
+    }
+}
+
+/*
+ *  Purpose: Drop the characters of a Line structure from a column on.
+ *
+ *  Parameters:
+ *    - line: Pointer to the Line structure.
+ *    - size: The number of characters to keep, at most the size of the line.
+ *
+ *  Returns: None.
+ */
+void line_truncate(Line* line, size_t size)
+{
+    if (line_is_chunked(line) && size < line->size) {
+        LineChunks* chunks = line->chunks;
+        size_t offset;
+        size_t index = line_chunks_find(chunks, size, &offset);
+        chunks->chunks[index].size = offset;
+        while (chunks->size > index + 1)
+            line_chunks_remove_chunk(chunks, chunks->size - 1);
+        if (offset == 0)
+            line_chunks_remove_chunk(chunks, index);
+    }
+    line->size = size;
+}
+
+/*
+ *  Purpose: Measure the whitespace a Line structure starts with, a tab counting as TAB_STOP spaces.
+ *
+ *  Parameters:
+ *    - line: Pointer to the Line structure, chunked or not.
+ *    - text_col: Pointer set to the column of its first other character, its size for a blank line (can be NULL).
+ *
+ *  Returns: The indentation in columns.
+ */
+size_t line_indentation(const Line* line, size_t* text_col)
+{
+    size_t indentation = 0, i = 0;
+    for (; i < line->size; i++) {
+        char ch = line_is_chunked(line) ? line_char_at(line, i) : line->chars[i];
+        if (ch == ' ')
+            indentation++;
+        else if (ch == '\t')
+            indentation += TAB_STOP;
+        else
+            break;
+    }
+
+    if (text_col != NULL)
+        *text_col = i;
+    return indentation;
+}
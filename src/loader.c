@@ -0,0 +1,288 @@
+/*
+ *  Background loading of files and pipes into an Editor. A worker thread reads and splits the input into lines
+ *  and hands complete lines over in batches, which the main thread moves into the Editor between
+ *  frames, so the window is responsive and shows the first lines while the rest is still being read.
+ */
+#define _XOPEN_SOURCE 700 // poll, read, fileno
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "loader.h"
+#include "editor.h"
+#include "line.h"
+#include "intern.h"
+#include "utils.h"
+#include "mem.h"
+#include "SDL.h"
+
+/*
+ *  Purpose: Queue the lines of the worker's staging Editor for the main thread.
+ *
+ *  Parameters:
+ *    - loader: Pointer to the Loader.
+ *    - staging: Pointer to the worker's Editor holding the lines read so far.
+ *    - keep_last_line: Whether the last line is still incomplete and has to stay in the staging Editor.
+ *    - bytes_read: The number of bytes of the file read so far.
+ *
+ *  Returns: None.
+ */
+static void loader_publish(Loader* loader, Editor* staging, bool keep_last_line, size_t bytes_read)
+{
+    size_t num_lines = keep_last_line && staging->size > 0 ? staging->size - 1 : staging->size;
+    if (num_lines == 0)
+        return;
+
+    LoaderBatch* batch = mem_malloc(MEM_LOADER, sizeof(*batch));
+    batch->size = num_lines;
+    batch->lines = mem_malloc(MEM_LOADER, num_lines * sizeof(batch->lines[0]));
+    batch->bytes_read = bytes_read;
+    batch->next = NULL;
+
+    // Complete lines do not change any more, identical ones share their characters from now on
+    if (loader->intern != NULL) {
+        for (size_t i = 0; i < num_lines; i++)
+            intern_line(loader->intern, staging->lines + i);
+    }
+    memcpy(batch->lines, staging->lines, num_lines * sizeof(batch->lines[0]));
+
+    // Keep the staging buffer for the next chunk, with the incomplete line moved to the front.
+    // Vacated slots are zeroed, new lines are expected to start out that way.
+    size_t remaining = staging->size - num_lines;
+    memmove(staging->lines, staging->lines + num_lines, remaining * sizeof(staging->lines[0]));
+    memset(staging->lines + remaining, 0, num_lines * sizeof(staging->lines[0]));
+    staging->size = remaining;
+
+    SDL_LockMutex(loader->mutex);
+    if (loader->tail != NULL)
+        loader->tail->next = batch;
+    else
+        loader->head = batch;
+    loader->tail = batch;
+    SDL_UnlockMutex(loader->mutex);
+}
+
+/*
+ *  Purpose: Free a batch and the lines in it.
+ *
+ *  Parameters:
+ *    - batch: Pointer to the LoaderBatch to free.
+ *
+ *  Returns: None.
+ */
+static void loader_free_batch(LoaderBatch* batch)
+{
+    for (size_t i = 0; i < batch->size; i++)
+        line_free(&batch->lines[i]);
+    mem_free(MEM_LOADER, batch->lines);
+    mem_free(MEM_LOADER, batch);
+}
+
+/*
+ *  Purpose: Read what is available from the file, waiting for data in short steps so a pipe that stays
+ *           open without writing does not keep the worker from noticing it was cancelled.
+ *
+ *  Parameters:
+ *    - loader: Pointer to the Loader.
+ *    - chunk: Pointer to where the bytes are stored.
+ *    - size: The maximum number of bytes to read.
+ *
+ *  Returns:
+ *    - The number of bytes read, possibly less than 'size' for a pipe.
+ *    - 0 at the end of the file, on a read error or when cancelled.
+ */
+static size_t loader_read(Loader* loader, char* chunk, size_t size)
+{
+    struct pollfd pfd = {.fd = fileno(loader->fp), .events = POLLIN};
+
+    while (!SDL_AtomicGet(&loader->cancelled)) {
+        int ready = poll(&pfd, 1, LOADER_WAIT_MS);
+        if (ready == 0 || (ready < 0 && errno == EINTR))
+            continue;
+
+        // Regular files are always ready, pipes and terminals once something was written or they were closed
+        ssize_t bytes_read = read(pfd.fd, chunk, size);
+        if (bytes_read < 0 && (errno == EINTR || errno == EAGAIN))
+            continue;
+        if (bytes_read < 0)
+            fprintf(stderr, "Error: Unable to read the file: %s\n", strerror(errno));
+        return bytes_read > 0 ? bytes_read : 0;
+    }
+    return 0;
+}
+
+/*
+ *  Purpose: Worker thread reading the file chunk by chunk and queueing the complete lines of every chunk.
+ *
+ *  Parameters:
+ *    - data: Pointer to the Loader.
+ *
+ *  Returns: 0.
+ */
+static int loader_thread(void* data)
+{
+    Loader* loader = data;
+    char* chunk = mem_malloc(MEM_LOADER, LOADER_CHUNK_SIZE);
+    Editor staging = {0};
+    bool new_line = true;
+    size_t total_bytes_read = 0;
+
+    while (!SDL_AtomicGet(&loader->cancelled)) {
+        size_t bytes_read = loader_read(loader, chunk, LOADER_CHUNK_SIZE);
+        if (bytes_read == 0)
+            break;
+
+        total_bytes_read += bytes_read;
+        editor_append_chunk(&staging, chunk, bytes_read, &new_line);
+        loader_publish(loader, &staging, !new_line, total_bytes_read);
+    }
+
+    // Whatever is left is the last line of the file
+    loader_publish(loader, &staging, false, total_bytes_read);
+    editor_free(&staging);
+    mem_free(MEM_LOADER, chunk);
+
+    SDL_AtomicSet(&loader->finished, 1);
+    return 0;
+}
+
+/*
+ *  Purpose: Start loading a file on a worker thread. The loader should be released with 'loader_free'.
+ *
+ *  Parameters:
+ *    - fp: File pointer to the file to load, which can also be a pipe or stdin. Lines are handed
+ *          over as soon as they are read. The loader takes ownership and closes it.
+ *    - intern: Pointer to the InternPool the lines share their characters through (NULL to keep every line's
+ *              own). Only the worker uses it until the loader is done.
+ *
+ *  Returns:
+ *    - Pointer to the new Loader.
+ */
+Loader* loader_start(FILE* fp, InternPool* intern)
+{
+    Loader* loader = mem_calloc(MEM_LOADER, 1, sizeof(*loader));
+    loader->fp = fp;
+    loader->intern = intern;
+
+    // Only used for the progress, so a file that cannot seek (a pipe) is fine
+    if (fseek(fp, 0, SEEK_END) == 0) {
+        long size = ftell(fp);
+        loader->file_size = size > 0 ? size : 0;
+        rewind(fp);
+    }
+
+    loader->mutex = utils_scp(SDL_CreateMutex());
+    loader->thread = utils_scp(SDL_CreateThread(loader_thread, "loader", loader));
+    return loader;
+}
+
+/*
+ *  Purpose: Move the lines read so far to the end of the Editor, for up to LOADER_POLL_BUDGET_MS. Call from
+ *           the thread that owns the Editor.
+ *
+ *  Parameters:
+ *    - loader: Pointer to the Loader.
+ *    - editor: Pointer to the Editor structure being loaded into.
+ *
+ *  Returns:
+ *    - true if lines were added to the Editor.
+ *    - false otherwise.
+ */
+bool loader_poll(Loader* loader, Editor* editor)
+{
+    const Uint64 deadline = SDL_GetPerformanceCounter() + SDL_GetPerformanceFrequency() * LOADER_POLL_BUDGET_MS / 1000;
+    bool added = false;
+
+    // Whole batches are moved, the worker only waits for the lock while a batch is unlinked
+    do {
+        SDL_LockMutex(loader->mutex);
+        LoaderBatch* batch = loader->head;
+        if (batch != NULL) {
+            loader->head = batch->next;
+            if (loader->head == NULL)
+                loader->tail = NULL;
+        }
+        SDL_UnlockMutex(loader->mutex);
+
+        if (batch == NULL)
+            break;
+
+        editor_append_lines(editor, batch->lines, batch->size);
+        loader->bytes_loaded = batch->bytes_read;
+        mem_free(MEM_LOADER, batch->lines);
+        mem_free(MEM_LOADER, batch);
+        added = true;
+    } while (SDL_GetPerformanceCounter() < deadline);
+
+    return added;
+}
+
+/*
+ *  Purpose: Check whether the whole file has been read and moved into the Editor.
+ *
+ *  Parameters:
+ *    - loader: Pointer to the Loader.
+ *
+ *  Returns:
+ *    - true if loading is complete.
+ *    - false otherwise.
+ */
+bool loader_done(Loader* loader)
+{
+    if (!SDL_AtomicGet(&loader->finished))
+        return false;
+
+    SDL_LockMutex(loader->mutex);
+    bool empty = loader->head == NULL;
+    SDL_UnlockMutex(loader->mutex);
+    return empty;
+}
+
+/*
+ *  Purpose: Get how much of the file has been moved into the Editor.
+ *
+ *  Parameters:
+ *    - loader: Pointer to the Loader.
+ *
+ *  Returns:
+ *    - The loaded fraction of the file, between 0 and 1.
+ *    - A negative value if the size of the file is not known.
+ */
+float loader_progress(const Loader* loader)
+{
+    if (loader->file_size == 0)
+        return -1.0f;
+
+    // The file can grow while it is read
+    return loader->bytes_loaded >= loader->file_size ? 1.0f : (float)loader->bytes_loaded / loader->file_size;
+}
+
+/*
+ *  Purpose: Stop the worker if it is still running and free the Loader, including lines not yet moved
+ *           into an Editor.
+ *
+ *  Parameters:
+ *    - loader: Pointer to the Loader to free.
+ *
+ *  Returns: None.
+ */
+void loader_free(Loader* loader)
+{
+    SDL_AtomicSet(&loader->cancelled, 1);
+    SDL_WaitThread(loader->thread, NULL);
+
+    while (loader->head != NULL) {
+        LoaderBatch* next = loader->head->next;
+        loader_free_batch(loader->head);
+        loader->head = next;
+    }
+
+    SDL_DestroyMutex(loader->mutex);
+    fclose(loader->fp);
+    mem_free(MEM_LOADER, loader);
+}
@@ -0,0 +1,220 @@
+/*
+ *  A small LZ77 codec for text, in the spirit of LZ4. The input is encoded as sequences of a token byte
+ *  (4 bits of literal length and 4 bits of match length), the literals, and a 2-byte offset back to
+ *  where the match is copied from. Lengths that do not fit in 4 bits continue in extra bytes of up to 255.
+ *  Matches are found with a hash table of the positions of recent 4-byte strings, so compression is fast
+ *  and decompression is a loop of copies.
+ */
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "lz.h"
+
+/*
+ *  Purpose: Read 4 bytes that may not be aligned.
+ *
+ *  Parameters:
+ *    - p: Pointer to the bytes.
+ *
+ *  Returns: The bytes as a 32-bit value.
+ */
+static uint32_t lz_read32(const char* p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+/*
+ *  Purpose: Hash 4 bytes into an index of the table (Knuth's multiplicative hash).
+ *
+ *  Parameters:
+ *    - value: The bytes, as read by 'lz_read32'.
+ *
+ *  Returns: The index, below LZ_HASH_SIZE.
+ */
+static uint32_t lz_hash(uint32_t value)
+{
+    return (value * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/*
+ *  Purpose: Write the extra bytes of a length that does not fit in the 4 bits of a token.
+ *
+ *  Parameters:
+ *    - dst: Pointer to where the bytes are written.
+ *    - length: The length minus 15.
+ *
+ *  Returns: Pointer past the bytes written.
+ */
+static char* lz_write_length(char* dst, size_t length)
+{
+    while (length >= 255) {
+        *dst++ = (char)255;
+        length -= 255;
+    }
+    *dst++ = (char)length;
+    return dst;
+}
+
+/*
+ *  Purpose: Write a sequence of literals followed by a match.
+ *
+ *  Parameters:
+ *    - dst: Pointer to where the sequence is written.
+ *    - literals: Pointer to the literals.
+ *    - num_literals: The number of literals.
+ *    - offset: How far back the match is copied from.
+ *    - match_length: The length of the match (0 for the last sequence, which only has literals).
+ *
+ *  Returns: Pointer past the sequence.
+ */
+static char* lz_write_sequence(char* dst, const char* literals, size_t num_literals, size_t offset, size_t match_length)
+{
+    size_t match_code = match_length > 0 ? match_length - LZ_MIN_MATCH : 0;
+    char* token = dst++;
+    *token = (char)(((num_literals < 15 ? num_literals : 15) << 4) | (match_code < 15 ? match_code : 15));
+
+    if (num_literals >= 15)
+        dst = lz_write_length(dst, num_literals - 15);
+    memcpy(dst, literals, num_literals);
+    dst += num_literals;
+
+    if (match_length > 0) {
+        *dst++ = (char)(offset & 0xff);
+        *dst++ = (char)(offset >> 8);
+        if (match_code >= 15)
+            dst = lz_write_length(dst, match_code - 15);
+    }
+    return dst;
+}
+
+/*
+ *  Purpose: Compress a buffer.
+ *
+ *  Parameters:
+ *    - src: Pointer to the bytes to compress.
+ *    - size: The number of bytes to compress (below 4 GB).
+ *    - dst: Pointer to where the compressed bytes are written, with room for LZ_BOUND(size) bytes.
+ *    - table: Pointer to LZ_HASH_SIZE entries of scratch space, so the codec can be used from any thread.
+ *
+ *  Returns: The number of compressed bytes written.
+ */
+size_t lz_compress(const char* src, size_t size, char* dst, uint32_t* table)
+{
+    char* out = dst;
+    size_t anchor = 0;
+
+    if (size >= LZ_MIN_MATCH) {
+        // Entries are positions plus one, so 0 is an empty slot
+        memset(table, 0, LZ_HASH_SIZE * sizeof(table[0]));
+        size_t pos = 0;
+        while (pos + LZ_MIN_MATCH <= size) {
+            uint32_t sequence = lz_read32(src + pos);
+            uint32_t hash = lz_hash(sequence);
+            size_t candidate = table[hash];
+            table[hash] = (uint32_t)(pos + 1);
+
+            if (candidate == 0 || pos - (candidate - 1) > LZ_MAX_OFFSET || lz_read32(src + candidate - 1) != sequence) {
+                pos++;
+                continue;
+            }
+
+            // Matches may overlap the text they produce, which repeats short patterns
+            size_t match = candidate - 1;
+            size_t length = LZ_MIN_MATCH;
+            while (pos + length < size && src[match + length] == src[pos + length])
+                length++;
+
+            out = lz_write_sequence(out, src + anchor, pos - anchor, pos - match, length);
+            pos += length;
+            anchor = pos;
+        }
+    }
+
+    out = lz_write_sequence(out, src + anchor, size - anchor, 0, 0);
+    return out - dst;
+}
+
+/*
+ *  Purpose: Read the extra bytes of a length and add them to it.
+ *
+ *  Parameters:
+ *    - in: Pointer to the read position, moved past the bytes.
+ *    - in_end: Pointer to the end of the compressed bytes.
+ *    - length: Pointer to the length.
+ *
+ *  Returns:
+ *    - true if the length was complete.
+ *    - false if the compressed bytes ended first.
+ */
+static bool lz_read_length(const unsigned char** in, const unsigned char* in_end, size_t* length)
+{
+    unsigned char byte;
+    do {
+        if (*in == in_end)
+            return false;
+        byte = *(*in)++;
+        *length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+/*
+ *  Purpose: Decompress a buffer made by 'lz_compress'.
+ *
+ *  Parameters:
+ *    - src: Pointer to the compressed bytes.
+ *    - src_size: The number of compressed bytes.
+ *    - dst: Pointer to where the bytes are written.
+ *    - size: The number of bytes that were compressed.
+ *
+ *  Returns:
+ *    - true if exactly 'size' bytes were decompressed.
+ *    - false if the compressed bytes are corrupt, without writing out of bounds.
+ */
+bool lz_decompress(const char* src, size_t src_size, char* dst, size_t size)
+{
+    const unsigned char* in = (const unsigned char*)src;
+    const unsigned char* in_end = in + src_size;
+    size_t out = 0;
+
+    while (in < in_end) {
+        unsigned token = *in++;
+        size_t num_literals = token >> 4;
+        if (num_literals == 15 && !lz_read_length(&in, in_end, &num_literals))
+            return false;
+        if (num_literals > (size_t)(in_end - in) || num_literals > size - out)
+            return false;
+        memcpy(dst + out, in, num_literals);
+        in += num_literals;
+        out += num_literals;
+
+        // Only the last sequence ends after its literals
+        if (in == in_end)
+            break;
+        if (in_end - in < 2)
+            return false;
+        size_t offset = in[0] | (size_t)in[1] << 8;
+        in += 2;
+
+        size_t length = token & 15;
+        if (length == 15 && !lz_read_length(&in, in_end, &length))
+            return false;
+        length += LZ_MIN_MATCH;
+        if (offset == 0 || offset > out || length > size - out)
+            return false;
+
+        char* to = dst + out;
+        const char* from = to - offset;
+        if (offset >= length)
+            memcpy(to, from, length);
+        else {
+            for (size_t i = 0; i < length; i++)
+                to[i] = from[i];
+        }
+        out += length;
+    }
+    return out == size;
+}
@@ -10,6 +10,25 @@
 #include "vec.h"
 #include "editor.h"
 #include "camera.h"
+#include "profiler.h"
+#include "keylog.h"
+#include "loader.h"
+#include "pager.h"
+#include "cold.h"
+#include "intern.h"
+#include "mem.h"
+#include "follow.h"
+#include "watch.h"
+#include "journal.h"
+#include "snapshot.h"
+#include "highlight.h"
+#include "decoration.h"
+#include "jobs.h"
+#include "search.h"
+#include "frame.h"
+#include "wrap.h"
+#include "fold.h"
+#include "filter.h"
 
 
 #include <math.h> // newly added for floor
@@ -21,54 +40,414 @@
 #define SCREEN_WIDTH 800
 #define SCREEN_HEIGHT 600
 
+#define TRACE_FILE_PATH "med-trace.json"
+
+// How long changes to a watched or followed file may wait while the window is idle
+#define WATCH_LATENCY_MS 100
+#define FONT_FILE_PATH "./font/VictorMono-Regular.ttf"
+#define USAGE "Usage: ./med [--record TRACE-PATH] [--no-font-cache] [--startup-trace] [--memory-budget MB] [--follow] [--intern] [--mem-report] [--wrap] [FILE-PATH | -]\n"
+
+// The font atlas is produced on a worker thread while the window and renderer are created
+typedef struct {
+    bool use_cache;
+    FontAtlas* atlas;
+} FontJob;
+
 // TODO: Change how you save a file to ctr + s
 // TODO: Jump forward/backward by a word
 // TODO: Delete a word
 // TODO: Blinking cursor when inactive
 // TODO: Delete line
 
-int main(int argc, const char* argv[])
+/*
+ *  Purpose: Worker thread loading the font atlas from the cache or by rasterizing it.
+ *
+ *  Parameters:
+ *    - data: Pointer to the FontJob, its atlas is set when done.
+ *
+ *  Returns: 0.
+ */
+static int font_thread(void* data)
 {
-    utils_scc(SDL_Init(SDL_INIT_VIDEO));
-    utils_scc((TTF_Init()));
+    FontJob* job = data;
+    job->atlas = font_atlas_load(FONT_FILE_PATH, job->use_cache);
+    profiler_startup_mark(job->atlas->from_cache ? "font atlas ready (cache)" : "font atlas ready (rasterized)");
+    return 0;
+}
 
-    SDL_Window* window =
-        utils_scp(SDL_CreateWindow("Text Editor", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_RESIZABLE));
+/*
+ *  Purpose: Replay the edits a crash left in the journal of a file that was just loaded, and start journaling it.
+ *
+ *  Parameters:
+ *    - file_path: Null-terminated path to the file.
+ *    - editor: Pointer to the Editor structure the file was loaded into.
+ *    - modified: Pointer set to true if edits were recovered, which are not saved yet.
+ *
+ *  Returns:
+ *    - Pointer to the Journal of the file.
+ */
+static Journal* recover_journal(const char* file_path, Editor* editor, bool* modified)
+{
+    size_t num_edits = journal_replay(file_path, editor);
+    if (num_edits > 0) {
+        printf("Recovered %zu unsaved edits to '%s' from its journal, press F2 to save them\n", num_edits, file_path);
+        *modified = true;
+    }
+    return journal_open(file_path, num_edits > 0);
+}
+
+/*
+ *  Purpose: Find the first line at least partly in the window.
+ *
+ *  Parameters:
+ *    - window: Pointer to the SDL window.
+ *    - camera: Pointer to the Camera.
+ *    - wrap: Pointer to the WrapLayout when lines are wrapped (NULL otherwise).
+ *    - folds: Pointer to the FoldStore when lines are not wrapped.
+ *    - filter: Pointer to the FilterView when only matching lines are shown (NULL otherwise).
+ *
+ *  Returns: The index of the line.
+ */
+static size_t first_visible_row(SDL_Window* window, const Camera* camera, WrapLayout* wrap, FoldStore* folds, FilterView* filter)
+{
+    int window_height;
+    SDL_GetWindowSize(window, NULL, &window_height);
+    float top = camera->pos.y - window_height * 0.5f;
+    size_t row = top > 0 ? (size_t)(top / (FONT_HEIGHT * FONT_SCALE)) : 0;
+    if (wrap != NULL)
+        return wrap_locate(wrap, row, NULL);
+    return filter != NULL ? filter_line_at(filter, row) : fold_line_at(folds, row);
+}
 
-    SDL_Renderer* renderer =
-        utils_scp(SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED));
+/*
+ *  Purpose: Get how many columns wrapped lines take in the window.
+ *
+ *  Parameters:
+ *    - window: Pointer to the SDL window.
+ *
+ *  Returns: The number of columns, at least 1.
+ */
+static size_t wrap_columns(SDL_Window* window)
+{
+    int window_width;
+    SDL_GetWindowSize(window, &window_width, NULL);
+    // One column is left for the cursor at the end of a full row
+    size_t columns = window_width / (FONT_WIDTH * FONT_SCALE);
+    return columns > 1 ? columns - 1 : 1;
+}
 
-    Font* font = font_load_ttf(renderer, "./font/VictorMono-Regular.ttf");
+/*
+ *  Purpose: Get where the camera should be to follow the cursor.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *    - wrap: Pointer to the WrapLayout when lines are wrapped (NULL otherwise).
+ *    - folds: Pointer to the FoldStore when lines are not wrapped.
+ *    - filter: Pointer to the FilterView when only matching lines are shown (NULL otherwise).
+ *    - window: Pointer to the SDL window.
+ *
+ *  Returns: The position of the camera.
+ */
+static Vec2f camera_target(Editor* editor, WrapLayout* wrap, FoldStore* folds, FilterView* filter, SDL_Window* window)
+{
+    if (wrap == NULL) {
+        size_t row = filter != NULL ? filter_row_of(filter, editor->cursor_row) : fold_row_of(folds, editor->cursor_row);
+        return vec2f(editor->cursor_col * FONT_WIDTH * FONT_SCALE, row * FONT_HEIGHT * FONT_SCALE);
+    }
 
-    Editor editor = {0};
-    Camera camera = {0};
+    // Wrapped lines always start at the left edge, only the visual row of the cursor is followed
+    int window_width;
+    SDL_GetWindowSize(window, &window_width, NULL);
+    size_t visual_row = wrap_visual_row(wrap, editor->cursor_row, editor->cursor_col, NULL);
+    return vec2f(window_width * 0.5f, visual_row * FONT_HEIGHT * FONT_SCALE);
+}
+
+/*
+ *  Purpose: Print the memory used by every subsystem, and how much the interned lines share.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *    - loading: Whether a file is still being loaded into the Editor.
+ *
+ *  Returns: None.
+ */
+static void print_memory_report(const Editor* editor, bool loading)
+{
+    MemUsage usage[MEM_NUM_SUBSYSTEMS];
+    mem_get_usage(usage);
+    editor_memory_usage(editor, usage);
+    mem_print_report(stdout, usage);
+
+    // The loader's worker fills the pool until the file is loaded
+    if (editor->intern != NULL && !loading)
+        printf("%zu lines share %zu distinct strings, dedupe ratio %.1fx\n",
+               editor->intern->num_lines, editor->intern->size, intern_dedupe_ratio(editor->intern));
+}
+
+int main(int argc, const char* argv[])
+{
+    profiler_startup_mark("start");
 
     // Temporary way to load in files from command line arguments
-    const char* file_path = argc > 1 ? argv[1] : NULL;
+    const char* file_path = NULL;
+    FILE* record_fp = NULL;
+    bool use_font_cache = true;
+    bool print_startup_trace = false;
+    size_t memory_budget = (size_t)PAGER_DEFAULT_BUDGET_MB * 1024 * 1024;
+    bool follow = false;
+    bool intern_lines = false;
+    bool mem_report = false;
+    bool wrap_lines = false;
 
-    if (file_path != NULL) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            // Keystrokes are written to a trace that 'med_bench' can replay
+            record_fp = fopen(argv[++i], "w");
+            if (record_fp == NULL) {
+                fprintf(stderr, "Error: Unable to record to '%s': %s\n", argv[i], strerror(errno));
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--no-font-cache") == 0)
+            use_font_cache = false;
+        else if (strcmp(argv[i], "--startup-trace") == 0)
+            print_startup_trace = true;
+        else if (strcmp(argv[i], "--follow") == 0)
+            follow = true;
+        else if (strcmp(argv[i], "--intern") == 0)
+            intern_lines = true;
+        else if (strcmp(argv[i], "--mem-report") == 0)
+            mem_report = true;
+        else if (strcmp(argv[i], "--wrap") == 0)
+            wrap_lines = true;
+        else if (strcmp(argv[i], "--memory-budget") == 0 && i + 1 < argc)
+            memory_budget = strtoull(argv[++i], NULL, 10) * 1024 * 1024;
+        else
+            file_path = argv[i];
+    }
+
+    Editor editor = {0};
+    Camera camera = {0};
+    Follower* follower = NULL;
+    // The version of the file the lines were last known to equal, a snapshot is only taken of it
+    SnapshotHeader disk_version = {0};
+    bool show_line_count = false; // After a load, until the next keystroke
+
+    // Start reading the file and producing the font before SDL sets up the window, which takes a while.
+    // Files that do not fit in the memory budget are paged from disk read-only instead of loaded.
+    Loader* loader = NULL;
+    bool indexing = false;
+    const char* source_name = file_path;
+    if (file_path != NULL && strcmp(file_path, "-") == 0) {
+        // Streamed from a pipe, there is no file to save to or follow
+        if (intern_lines)
+            editor.intern = intern_create();
+        loader = loader_start(stdin, editor.intern);
+        source_name = "stdin";
+        file_path = NULL;
+    } else if (file_path != NULL) {
         FILE* fp = fopen(file_path, "r");
+        // Taken before the file is read, so a change while it loads leaves no matching version
+        if (fp != NULL)
+            snapshot_key(file_path, &disk_version);
 
-        if (fp != NULL) {
-            editor_load_from_file(&editor, fp);
+        if (fp != NULL && pager_should_page(fp, memory_budget)) {
+            editor.pager = pager_open(fp, memory_budget);
+            indexing = true;
+            printf("'%s' is larger than the memory budget, it is paged from disk and read-only\n", file_path);
+            if (follow)
+                fprintf(stderr, "Error: Paged files cannot be followed\n");
+        } else if (fp != NULL && snapshot_restore(file_path, &editor, &camera.pos)) {
+            // The version on disk was closed last time, its lines and view are taken from the snapshot
+            profiler_startup_mark("snapshot restored");
+            printf("Restored %zu lines of '%s' from its snapshot\n", editor.size, file_path);
+            if (follow) {
+                fseek(fp, 0, SEEK_END);
+                long file_size = ftell(fp);
+                follower = follow_start(file_path, file_size > 0 ? file_size : 0);
+            }
             fclose(fp);
+            show_line_count = true;
+        } else if (fp != NULL) {
+            // Identical lines share their characters, for logs and generated files that repeat a lot
+            if (intern_lines)
+                editor.intern = intern_create();
+            loader = loader_start(fp, editor.intern);
         } else {
             printf("Error: Unable to load file '%s': %s\n", file_path, strerror(errno));
             printf("To create '%s' and save your work, press F2\n", file_path);
         }
     }
 
+    // Changes made to the file by other processes are merged in, unless it is followed or paged instead
+    Watch* watch = file_path != NULL && !follow && editor.pager == NULL ? watch_open(file_path) : NULL;
+    bool modified = false; // Edits not saved yet, which a reload would throw away
+    bool journaled = file_path != NULL && editor.pager == NULL;
+    Journal* journal = NULL;
+
+    // Sources are colored as they are drawn, the highlighter follows the edits and the lines still loading
+    Highlighter* highlighter = file_path != NULL && editor.pager == NULL && highlight_supports(file_path) ? highlight_create(&editor) : NULL;
+    // Search hits and other ranges drawn behind the text, they move with the edits
+    DecorationStore* decorations = editor.pager == NULL ? decoration_create(&editor) : NULL;
+    // Background work finishes on the main thread, when the loop drains the job system
+    int num_cpus = SDL_GetCPUCount();
+    JobSystem* jobs = jobs_create(num_cpus < JOBS_MAX_WORKERS ? num_cpus : JOBS_MAX_WORKERS);
+    Search* search = NULL;
+    // Only the lines containing a word are shown while it is set, F11 turns it on and off
+    FilterView* filter = NULL;
+
+    utils_scc((TTF_Init()));
+    FontJob font_job = {.use_cache = use_font_cache};
+    SDL_Thread* font_loader = utils_scp(SDL_CreateThread(font_thread, "font", &font_job));
+
+    utils_scc(SDL_Init(SDL_INIT_VIDEO));
+    profiler_startup_mark("SDL initialized");
+
+    SDL_Window* window =
+        utils_scp(SDL_CreateWindow("Text Editor", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_RESIZABLE));
+    profiler_startup_mark("window created");
+
+    // Frames are drawn on their own thread, which creates the renderer and takes the font once it is loaded
+    FrameThread* frames = frame_thread_start(window, font_loader, &font_job.atlas);
+    // Lines longer than the window are broken into visual rows, F8 turns it on and off
+    WrapLayout* wrap = wrap_lines ? wrap_create(&editor, wrap_columns(window)) : NULL;
+    // Indented blocks are folded with F9 while lines are not wrapped
+    FoldStore* folds = fold_create(&editor);
+
     CursorShape cursor_shape = 0;
     const float cursor_period_ms = 500; // half a second
     Uint32 last_stroke_time = 0;
     const Uint32 blink_threshold_ms = 500; // an issue here is that sometimew hwen it starts blinking agin it is quick on the first one and sometimes it is long
                                             // thsi is becuase the cursor is always blinking and we may start rendering it again in the middle of a period
+    const Uint64 counter_frequency = SDL_GetPerformanceFrequency();
+    Uint64 last_frame_counter = SDL_GetPerformanceCounter();
+    bool camera_at_rest = false;
+    bool cursor_was_visible = false;
+    bool redraw = true;
+    bool first_frame = true;
+    bool startup_trace_pending = false;
+    bool overlay_enabled = false;
+    bool toggle_overlay = false;  // Requests for the render thread, sent with the next frame
+    bool export_trace = false;
+    bool auto_scroll = true; // Keep the end of a followed file in view
+    bool packing = false;
+    bool compacting = false;
+    bool report_pending = mem_report; // Printed once the file is in
+
+    if (journaled && loader == NULL)
+        journal = recover_journal(file_path, &editor, &modified);
+    if (highlighter != NULL && loader == NULL)
+        highlight_start_pass(highlighter, first_visible_row(window, &camera, wrap, folds, filter), SDL_GetCPUCount());
+
     bool quit = false;
     while (!quit) {
         // start of the frame time
         Uint32 frame_start_time_ms = SDL_GetTicks();
+        Uint64 frame_counter = SDL_GetPerformanceCounter();
+        float delta_time_s = (float)(frame_counter - last_frame_counter) / counter_frequency;
+        last_frame_counter = frame_counter;
+
+        // Move the lines read by the loader into the editor. Editing waits until the whole file is in.
+        if (loader != NULL) {
+            if (loader_poll(loader, &editor))
+                redraw = true;
+
+            if (loader_done(loader)) {
+                // What is appended from now on is read by the follower
+                if (follow && file_path != NULL)
+                    follower = follow_start(file_path, loader->bytes_loaded);
+                loader_free(loader);
+                loader = NULL;
+                if (journaled)
+                    journal = recover_journal(file_path, &editor, &modified);
+                if (highlighter != NULL)
+                    highlight_start_pass(highlighter, first_visible_row(window, &camera, wrap, folds, filter), SDL_GetCPUCount());
+                profiler_startup_mark("file loaded");
+                printf("Loaded %zu lines from '%s'\n", editor.size, source_name);
+                if (editor.intern != NULL)
+                    printf("%zu lines share %zu distinct strings, dedupe ratio %.1fx\n",
+                           editor.intern->num_lines, editor.intern->size, intern_dedupe_ratio(editor.intern));
+                show_line_count = true;
+                redraw = true;
+                startup_trace_pending = print_startup_trace;
+            }
+        }
+
+        // A paged file can be viewed while its lines are being indexed
+        if (indexing) {
+            size_t num_lines = pager_num_lines(editor.pager);
+            if (num_lines != editor.size) {
+                editor.size = num_lines;
+                redraw = true;
+            }
+
+            if (pager_done(editor.pager)) {
+                editor.size = pager_num_lines(editor.pager);
+                indexing = false;
+                profiler_startup_mark("file indexed");
+                printf("Indexed %zu lines from '%s'\n", editor.size, file_path);
+                show_line_count = true;
+                redraw = true;
+                startup_trace_pending = print_startup_trace;
+            }
+        }
+        bool read_only = loader != NULL || editor.pager != NULL;
+
+        if (report_pending && loader == NULL && !indexing) {
+            print_memory_report(&editor, false);
+            report_pending = false;
+        }
+
+        // The first highlighting pass lexes the lines on other threads, they only change once it is finished
+        if (highlighter != NULL && highlight_poll(highlighter))
+            redraw = true;
+        bool highlighting = highlighter != NULL && highlighter->pass != NULL;
+
+        // Jobs hand their results over here, a search adds its hits chunk by chunk
+        if (jobs_drain(jobs) > 0)
+            redraw = true;
+        bool searching = search != NULL && search_running(search);
+        bool filtering = filter != NULL && filter_building(filter);
+
+        // The lines are read by other threads while highlighting, searching or filtering, so they are not changed
+        bool lines_busy = highlighting || searching || filtering;
+        if (follower != NULL && !lines_busy && follow_poll(follower, &editor) > 0) {
+            // The lines appended, or a rotated file's after the old ones, are not a version to snapshot
+            disk_version = (SnapshotHeader) {0};
+            if (auto_scroll) {
+                editor.cursor_row = editor.size - 1;
+                editor.cursor_col = 0;
+            }
+            redraw = true;
+        }
+
+        if (watch != NULL && loader == NULL && !lines_busy && watch_poll(watch) && watch->last.exists) {
+            FILE* fp = fopen(file_path, "r");
+            if (modified)
+                fprintf(stderr, "Warning: '%s' changed on disk, not reloaded over the unsaved changes\n", file_path);
+            else if (fp != NULL) {
+                snapshot_key(file_path, &disk_version);
+                size_t num_changed = editor_reload_from_file(&editor, fp);
+                if (num_changed > 0) {
+                    printf("'%s' changed on disk, reloaded %zu lines\n", file_path, num_changed);
+                    redraw = true;
+                }
+            }
+            if (fp != NULL)
+                fclose(fp);
+        }
+
+        // Lines far from the camera and the cursor are compressed a little at a time, between frames
+        if (editor.pager == NULL && !lines_busy)
+            packing = editor_pack_cold_lines(&editor, first_visible_row(window, &camera, wrap, folds, filter), COLD_PACK_BUDGET_MS);
+
+        // Lines left with more room than they use are shrunk while nothing else is going on
+        if (loader == NULL && !lines_busy && !packing && camera_at_rest)
+            compacting = editor_compact(&editor, EDITOR_COMPACT_BUDGET_MS);
+
         SDL_Event event;
+        Uint64 events_start = SDL_GetPerformanceCounter();
         while (SDL_PollEvent(&event)) {
+            redraw = true; // input, resizes and exposes all change what is on screen
             switch (event.type) {
                 case SDL_QUIT: {
                     quit = true;
@@ -76,12 +455,51 @@ int main(int argc, const char* argv[])
                 break;
 
                 case SDL_TEXTINPUT: {
+                    show_line_count = false;
+                    if (read_only)
+                        break;
+
+                    if (highlighter != NULL)
+                        highlight_finish_pass(highlighter);
+                    if (search != NULL)
+                        search_cancel(search);
+                    if (filter != NULL)
+                        filter_finish(filter);
+                    if (journal != NULL)
+                        journal_record(journal, &editor, KEYLOG_INSERT, event.text.text);
                     editor_insert_text_before_cursor(&editor, event.text.text);
+                    modified = true;
+                    if (record_fp != NULL)
+                        keylog_write(record_fp, KEYLOG_INSERT, event.text.text);
                     last_stroke_time = SDL_GetTicks();
                 }
                 break;
 
                 case SDL_KEYDOWN: {
+                    show_line_count = false;
+
+                    // Only moving around is possible while the file is loading, or at all when it is paged
+                    if (read_only && keylog_op_is_edit(keylog_op_from_key(event.key.keysym.sym)))
+                        break;
+                    if (read_only && event.key.keysym.sym == SDLK_F2) {
+                        fprintf(stderr, "Error: '%s' is %s\n", source_name, loader != NULL ? "still loading" : "paged and read-only");
+                        break;
+                    }
+
+                    if (record_fp != NULL)
+                        keylog_write(record_fp, keylog_op_from_key(event.key.keysym.sym), NULL);
+                    if (keylog_op_is_edit(keylog_op_from_key(event.key.keysym.sym))) {
+                        if (highlighter != NULL)
+                            highlight_finish_pass(highlighter);
+                        if (search != NULL)
+                            search_cancel(search);
+                        if (filter != NULL)
+                            filter_finish(filter);
+                        if (journal != NULL)
+                            journal_record(journal, &editor, keylog_op_from_key(event.key.keysym.sym), NULL);
+                        modified = true;
+                    }
+
                     switch (event.key.keysym.sym) {
                         case SDLK_BACKSPACE: {
                             editor_backspace(&editor);
@@ -103,12 +521,22 @@ int main(int argc, const char* argv[])
                         break;
 
                         case SDLK_UP: {
-                            editor_up_arrow(&editor);
+                            if (wrap != NULL)
+                                wrap_up_arrow(wrap);
+                            else if (filter != NULL)
+                                filter_up_arrow(filter);
+                            else
+                                fold_up_arrow(folds);
                         }
                         break;
 
                         case SDLK_DOWN: {
-                            editor_down_arrow(&editor);
+                            if (wrap != NULL)
+                                wrap_down_arrow(wrap);
+                            else if (filter != NULL)
+                                filter_down_arrow(filter);
+                            else
+                                fold_down_arrow(folds);
                         }
                         break;
                         
@@ -125,9 +553,13 @@ int main(int argc, const char* argv[])
                         case SDLK_F2: {
                             if (file_path != NULL) {
                                 editor_save_to_file(&editor, file_path);
+                                snapshot_key(file_path, &disk_version);
+                                modified = false;
+                                if (journal != NULL)
+                                    journal_reset(journal);
 				                puts("Save successful!");
                             } else
-                                fprintf(stderr, "Usage: ./med [FILE-PATH]\n");
+                                fprintf(stderr, USAGE);
                         }
                         break;
 
@@ -137,33 +569,251 @@ int main(int argc, const char* argv[])
                             else
                                 cursor_shape = 0;
                         }
+                        break;
+
+                        case SDLK_F3: {
+                            overlay_enabled = !overlay_enabled;
+                            toggle_overlay = !toggle_overlay;
+                        }
+                        break;
+
+                        case SDLK_F5: {
+                            auto_scroll = !auto_scroll;
+                            if (follower != NULL)
+                                printf("Auto-scroll %s\n", auto_scroll ? "on" : "off");
+                        }
+                        break;
+
+                        case SDLK_F4: {
+                            export_trace = true;
+                        }
+                        break;
+
+                        case SDLK_F7: {
+                            // Shrinks the lines right away instead of when idle, unless other threads read them
+                            if (loader == NULL && !lines_busy) {
+                                while (editor_compact(&editor, SDL_MAX_UINT32)) {}
+                            }
+                            print_memory_report(&editor, loader != NULL);
+                        }
+                        break;
+
+                        case SDLK_F8: {
+                            // The camera moves with the cursor, so it stays in the same place on screen
+                            Vec2f old_target = camera_target(&editor, wrap, folds, filter, window);
+                            if (wrap != NULL) {
+                                wrap_free(wrap);
+                                wrap = NULL;
+                            } else {
+                                // Wrapped rows are not folded or filtered, every line is shown again
+                                fold_clear(folds);
+                                if (filter != NULL)
+                                    filter_free(filter);
+                                filter = NULL;
+                                wrap = wrap_create(&editor, wrap_columns(window));
+                            }
+                            camera.pos = vec2f_add(camera.pos, vec2f_sub(camera_target(&editor, wrap, folds, filter, window), old_target));
+                        }
+                        break;
+
+                        case SDLK_F9: {
+                            if (wrap != NULL || filter != NULL) {
+                                fprintf(stderr, "Error: Lines cannot be folded while they are %s\n", wrap != NULL ? "wrapped" : "filtered");
+                                break;
+                            }
+                            Vec2f old_target = camera_target(&editor, wrap, folds, filter, window);
+                            fold_toggle(folds);
+                            camera.pos = vec2f_add(camera.pos, vec2f_sub(camera_target(&editor, wrap, folds, filter, window), old_target));
+                        }
+                        break;
+
+                        case SDLK_F10: {
+                            Vec2f old_target = camera_target(&editor, wrap, folds, filter, window);
+                            fold_clear(folds);
+                            camera.pos = vec2f_add(camera.pos, vec2f_sub(camera_target(&editor, wrap, folds, filter, window), old_target));
+                        }
+                        break;
+
+                        case SDLK_F11: {
+                            // Shows only the lines containing the word under the cursor, or every line again
+                            if (filter == NULL && (decorations == NULL || loader != NULL)) {
+                                fprintf(stderr, "Error: '%s' is %s\n", source_name, loader != NULL ? "still loading" : "paged and read-only");
+                                break;
+                            }
+                            if (filter == NULL && wrap != NULL) {
+                                fprintf(stderr, "Error: Lines cannot be filtered while they are wrapped\n");
+                                break;
+                            }
+
+                            Vec2f old_target = camera_target(&editor, wrap, folds, filter, window);
+                            if (filter != NULL) {
+                                filter_free(filter);
+                                filter = NULL;
+                            } else {
+                                size_t word_size;
+                                const char* word = search_word_under_cursor(&editor, &word_size);
+                                if (word_size > FILTER_PATTERN_CAPACITY)
+                                    fprintf(stderr, "Error: Words longer than %d characters cannot be filtered on\n", FILTER_PATTERN_CAPACITY);
+                                else if (word_size > 0)
+                                    filter = filter_create(jobs, &editor, word, word_size, first_visible_row(window, &camera, wrap, folds, filter));
+                            }
+                            camera.pos = vec2f_add(camera.pos, vec2f_sub(camera_target(&editor, wrap, folds, filter, window), old_target));
+                        }
+                        break;
+
+                        case SDLK_F6: {
+                            // Marks every occurrence of the word under the cursor, in place of the last search
+                            if (decorations == NULL || loader != NULL) {
+                                fprintf(stderr, "Error: '%s' is %s\n", source_name, loader != NULL ? "still loading" : "paged and read-only");
+                                break;
+                            }
+                            if (search != NULL)
+                                search_free(search);
+                            search = NULL;
+                            decoration_clear(decorations, DECORATION_SEARCH_HIT);
+
+                            size_t word_size;
+                            const char* word = search_word_under_cursor(&editor, &word_size);
+                            if (word_size > SEARCH_WORD_CAPACITY)
+                                fprintf(stderr, "Error: Words longer than %d characters cannot be searched\n", SEARCH_WORD_CAPACITY);
+                            else if (word_size > 0)
+                                search = search_start(jobs, &editor, decorations, word, word_size, first_visible_row(window, &camera, wrap, folds, filter));
+                        }
+                        break;
                     }
+                    // Moving or typing onto a hidden line opens its fold
+                    fold_reveal(folds, editor.cursor_row);
                     last_stroke_time = SDL_GetTicks();
                 }
                 break;
             }            
         }
-        // clear the screen
-        utils_scc((SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255)));
-        utils_scc((SDL_RenderClear(renderer)));
-        
-        camera_update(&camera, &editor);
-        render_editor(renderer, font, &editor, window, &camera, (SDL_Color) {.r = 255, .g = 0, .b = 255, .a = 255}, FONT_SCALE);
+        Uint64 events_end = SDL_GetPerformanceCounter();
+
+        // The cursor is solid right after a keystroke, then we can generate on/off cycles to simulate blinking
+        Uint32 now_ms = SDL_GetTicks();
+        bool cursor_visible = now_ms - last_stroke_time < blink_threshold_ms || ((int)floor(now_ms / cursor_period_ms) % 2);
+        if (cursor_visible != cursor_was_visible) {
+            cursor_was_visible = cursor_visible;
+            redraw = true;
+        }
+
+        // Keep the overlay's timings live
+        if (overlay_enabled)
+            redraw = true;
+
+        // Nothing moved and nothing changed, so the previous frame is still on screen.
+        // Sleep until the next event or the next cursor blink instead of redrawing it.
+        if (!redraw && camera_at_rest) {
+            Uint32 until_blink_ms = cursor_period_ms - (Uint32)fmodf(now_ms, cursor_period_ms);
+            if (now_ms - last_stroke_time < blink_threshold_ms && last_stroke_time + blink_threshold_ms - now_ms < until_blink_ms)
+                until_blink_ms = last_stroke_time + blink_threshold_ms - now_ms;
+            // Keep picking up lines while the file is loading, colors while it is highlighted and hits while it is searched,
+            // and packing cold lines or shrinking lines
+            if ((loader != NULL || indexing || lines_busy || packing || compacting) && until_blink_ms > FRAME_TARGET_TIME_S * 1000)
+                until_blink_ms = FRAME_TARGET_TIME_S * 1000;
+            if ((follower != NULL || watch != NULL) && until_blink_ms > WATCH_LATENCY_MS)
+                until_blink_ms = WATCH_LATENCY_MS;
+            SDL_WaitEventTimeout(NULL, until_blink_ms);
+
+            // The time spent asleep is not animation time, resume as if one regular frame had passed
+            last_frame_counter = SDL_GetPerformanceCounter() - (Uint64)(FRAME_TARGET_TIME_S * counter_frequency);
+            continue;
+        }
+        redraw = false;
+
+        Uint64 camera_start = SDL_GetPerformanceCounter();
+        if (wrap != NULL) {
+            // Lines measured as they come into view move the ones below them, the camera moves with them
+            size_t first, last;
+            wrap_set_width(wrap, wrap_columns(window));
+            render_visible_rows(window, camera.pos, wrap->total_rows, &first, &last);
+            if (first < last)
+                camera.pos.y += wrap_update_visible(wrap, first, last - first, editor.cursor_row) * FONT_HEIGHT * FONT_SCALE;
+            camera_at_rest = camera_follow(&camera, camera_target(&editor, wrap, folds, filter, window), delta_time_s);
+        } else if (filter != NULL)
+            camera_at_rest = camera_follow(&camera, camera_target(&editor, wrap, folds, filter, window), delta_time_s);
+        else
+            camera_at_rest = camera_update(&camera, &editor, folds, delta_time_s);
+        Uint64 camera_end = SDL_GetPerformanceCounter();
 
+        // The render thread is still busy with the frames before, this one is captured on the next pass
+        FrameSnapshot* frame = frame_thread_acquire(frames);
+        if (frame == NULL) {
+            redraw = true;
+            camera_cap_fps(SDL_GetTicks() - frame_start_time_ms);
+            continue;
+        }
 
-        if (SDL_GetTicks() - last_stroke_time < blink_threshold_ms)
-            render_cursor(renderer, font, &editor, window, camera.pos, (SDL_Color) {255, 255, 255, 255}, (SDL_Color) {0, 0, 0, 255}, cursor_shape);
+        frame_capture(frame, &editor, highlighter, decorations, wrap, folds, filter, window, &camera);
+        frame->cursor_visible = cursor_visible;
+        frame->cursor_shape = cursor_shape;
+        frame->events_start = events_start;
+        frame->events_end = events_end;
+        frame->camera_start = camera_start;
+        frame->camera_end = camera_end;
 
-        // we can generate an on/off cycles for the cursor to simulate the blinking
-         else if (((int)floor(SDL_GetTicks() / cursor_period_ms) % 2))
-            render_cursor(renderer, font, &editor, window, camera.pos, (SDL_Color) {255, 255, 255, 255}, (SDL_Color) {0, 0, 0, 255}, cursor_shape);
+        if (loader == NULL && !indexing && filter != NULL) {
+            size_t num_rows = filter_num_rows(filter);
+            snprintf(frame->status, sizeof(frame->status), " %zu%s of %zu lines contain '%.*s' ", num_rows, filter_building(filter) ? "..." : "",
+                     editor.size, (int)filter->pattern_size, filter->pattern);
+        } else if (loader != NULL || indexing || show_line_count) {
+            const char* action = loader != NULL ? "Loading" : "Indexing";
+            float progress = loader != NULL ? loader_progress(loader) : indexing ? pager_progress(editor.pager) : -1.0f;
+            if (loader == NULL && !indexing)
+                snprintf(frame->status, sizeof(frame->status), " %zu lines%s ", editor.size, read_only ? " (read-only)" : "");
+            else if (progress < 0.0f)
+                snprintf(frame->status, sizeof(frame->status), " %s... %zu lines ", action, editor.size);
+            else
+                snprintf(frame->status, sizeof(frame->status), " %s %3d%% %zu lines ", action, (int)(progress * 100), editor.size);
+        }
+
+        if (first_frame) {
+            first_frame = false;
+            startup_trace_pending = print_startup_trace;
+        }
+        frame->toggle_overlay = toggle_overlay;
+        frame->trace_path = export_trace ? TRACE_FILE_PATH : NULL;
+        frame->print_startup_trace = startup_trace_pending;
+        toggle_overlay = false;
+        export_trace = false;
+        startup_trace_pending = false;
+        frame_thread_publish(frames);
 
-        // update the screen
-        SDL_RenderPresent(renderer);
-        
         camera_cap_fps(SDL_GetTicks() - frame_start_time_ms);
     }
-    utils_clean_up(window, renderer, font, &editor);
+    if (mem_report)
+        print_memory_report(&editor, loader != NULL);
+    if (loader != NULL)
+        loader_free(loader);
+    if (follower != NULL)
+        follow_free(follower);
+    if (watch != NULL)
+        watch_free(watch);
+    // A large file closed without unsaved edits, and still the version on disk, opens from its snapshot next time
+    if (file_path != NULL && loader == NULL && !modified)
+        snapshot_save(file_path, &editor, &disk_version, camera.pos);
+    if (journal != NULL) {
+        if (modified)
+            printf("Unsaved edits are kept in the journal of '%s' and restored on the next start\n", file_path);
+        journal_close(journal, modified);
+    }
+    if (highlighter != NULL)
+        highlight_free(highlighter);
+    if (search != NULL)
+        search_free(search);
+    if (filter != NULL)
+        filter_free(filter);
+    jobs_free(jobs);
+    if (decorations != NULL)
+        decoration_free(decorations);
+    if (wrap != NULL)
+        wrap_free(wrap);
+    fold_free(folds);
+    if (record_fp != NULL)
+        fclose(record_fp);
+    frame_thread_stop(frames);
+    utils_clean_up(window, NULL, NULL, &editor);
     
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,218 @@
+/*
+ *  Memory accounting. Med's own allocations go through these wrappers of 'utils_cp', which count the live
+ *  bytes and the allocations of every subsystem so a report can show where the memory goes. The sizes
+ *  are the ones the allocator reports, rounding included. The counters are atomic since the worker
+ *  threads allocate too. Slack, room that is allocated but not used yet, is only known to the owner of a
+ *  buffer and is filled in by it (see 'editor_memory_usage').
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <malloc.h> // malloc_usable_size
+
+#include "mem.h"
+#include "utils.h"
+
+// SDL's atomics are 32-bit, the byte counts of a large file are not
+typedef struct {
+    atomic_size_t live_bytes;
+    atomic_size_t live_allocs;
+    atomic_size_t total_allocs;
+} MemCounters;
+
+static MemCounters counters[MEM_NUM_SUBSYSTEMS];
+
+static const char* subsystem_names[MEM_NUM_SUBSYSTEMS] = {
+    [MEM_LINES] = "lines",
+    [MEM_EDITOR] = "line arrays",
+    [MEM_COLD] = "cold blocks",
+    [MEM_INTERN] = "interned lines",
+    [MEM_LOADER] = "loader",
+    [MEM_PAGER] = "pager",
+    [MEM_HIGHLIGHT] = "highlighter",
+    [MEM_DECORATIONS] = "decorations",
+    [MEM_SEARCH] = "search",
+    [MEM_JOBS] = "jobs",
+    [MEM_FRAMES] = "frames",
+    [MEM_WRAP] = "wrap layout",
+    [MEM_FOLDS] = "folds",
+    [MEM_FILTER] = "filter",
+    [MEM_OTHER] = "other",
+};
+
+/*
+ *  Purpose: Count a new allocation.
+ *
+ *  Parameters:
+ *    - subsystem: The subsystem the memory is counted for.
+ *    - ptr: Pointer to the memory.
+ *
+ *  Returns: None.
+ */
+static void mem_count_alloc(MemSubsystem subsystem, void* ptr)
+{
+    MemCounters* counter = counters + subsystem;
+    atomic_fetch_add_explicit(&counter->live_bytes, malloc_usable_size(ptr), memory_order_relaxed);
+    atomic_fetch_add_explicit(&counter->live_allocs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&counter->total_allocs, 1, memory_order_relaxed);
+}
+
+/*
+ *  Purpose: Count a freed allocation.
+ *
+ *  Parameters:
+ *    - subsystem: The subsystem the memory was counted for.
+ *    - size: The size of the memory, as the allocator reported it.
+ *
+ *  Returns: None.
+ */
+static void mem_count_free(MemSubsystem subsystem, size_t size)
+{
+    MemCounters* counter = counters + subsystem;
+    atomic_fetch_sub_explicit(&counter->live_bytes, size, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&counter->live_allocs, 1, memory_order_relaxed);
+}
+
+/*
+ *  Purpose: Allocate memory for a subsystem, exiting on failure.
+ *
+ *  Parameters:
+ *    - subsystem: The subsystem the memory is counted for.
+ *    - size: The number of bytes, above 0.
+ *
+ *  Returns:
+ *    - Pointer to the memory, to be freed with 'mem_free'.
+ */
+void* mem_malloc(MemSubsystem subsystem, size_t size)
+{
+    void* ptr = utils_cp(malloc(size));
+    mem_count_alloc(subsystem, ptr);
+    return ptr;
+}
+
+/*
+ *  Purpose: Allocate zeroed memory for a subsystem, exiting on failure.
+ *
+ *  Parameters:
+ *    - subsystem: The subsystem the memory is counted for.
+ *    - n: The number of items, above 0.
+ *    - size: The size of an item, above 0.
+ *
+ *  Returns:
+ *    - Pointer to the memory, to be freed with 'mem_free'.
+ */
+void* mem_calloc(MemSubsystem subsystem, size_t n, size_t size)
+{
+    void* ptr = utils_cp(calloc(n, size));
+    mem_count_alloc(subsystem, ptr);
+    return ptr;
+}
+
+/*
+ *  Purpose: Resize memory of a subsystem, exiting on failure.
+ *
+ *  Parameters:
+ *    - subsystem: The subsystem the memory is counted for.
+ *    - ptr: Pointer to the memory (can be NULL).
+ *    - size: The new number of bytes, above 0.
+ *
+ *  Returns:
+ *    - Pointer to the resized memory, to be freed with 'mem_free'.
+ */
+void* mem_realloc(MemSubsystem subsystem, void* ptr, size_t size)
+{
+    // The old size is only known before the old memory is given back
+    size_t old_size = ptr != NULL ? malloc_usable_size(ptr) : 0;
+    void* new_ptr = utils_cp(realloc(ptr, size));
+    if (ptr != NULL)
+        mem_count_free(subsystem, old_size);
+    mem_count_alloc(subsystem, new_ptr);
+    return new_ptr;
+}
+
+/*
+ *  Purpose: Copy a null-terminated string for a subsystem, exiting on failure.
+ *
+ *  Parameters:
+ *    - subsystem: The subsystem the memory is counted for.
+ *    - string: The null-terminated string.
+ *
+ *  Returns:
+ *    - Pointer to the copy, to be freed with 'mem_free'.
+ */
+char* mem_strdup(MemSubsystem subsystem, const char* string)
+{
+    size_t size = strlen(string) + 1;
+    char* copy = mem_malloc(subsystem, size);
+    memcpy(copy, string, size);
+    return copy;
+}
+
+/*
+ *  Purpose: Free memory of a subsystem.
+ *
+ *  Parameters:
+ *    - subsystem: The subsystem the memory was allocated for.
+ *    - ptr: Pointer to the memory (can be NULL).
+ *
+ *  Returns: None.
+ */
+void mem_free(MemSubsystem subsystem, void* ptr)
+{
+    if (ptr == NULL)
+        return;
+    mem_count_free(subsystem, malloc_usable_size(ptr));
+    free(ptr);
+}
+
+/*
+ *  Purpose: Get the counters of every subsystem. The slack is left unknown.
+ *
+ *  Parameters:
+ *    - usage: Array receiving the usage of each subsystem.
+ *
+ *  Returns: None.
+ */
+void mem_get_usage(MemUsage usage[MEM_NUM_SUBSYSTEMS])
+{
+    for (int i = 0; i < MEM_NUM_SUBSYSTEMS; i++) {
+        usage[i] = (MemUsage) {
+            .live_bytes = atomic_load_explicit(&counters[i].live_bytes, memory_order_relaxed),
+            .live_allocs = atomic_load_explicit(&counters[i].live_allocs, memory_order_relaxed),
+            .total_allocs = atomic_load_explicit(&counters[i].total_allocs, memory_order_relaxed),
+        };
+    }
+}
+
+/*
+ *  Purpose: Print a table of the memory used by every subsystem and the totals.
+ *
+ *  Parameters:
+ *    - fp: File pointer to print to.
+ *    - usage: The usage of each subsystem.
+ *
+ *  Returns: None.
+ */
+void mem_print_report(FILE* fp, const MemUsage usage[MEM_NUM_SUBSYSTEMS])
+{
+    MemUsage total = {0};
+    fprintf(fp, "%-16s %12s %12s %12s %12s\n", "memory", "live KB", "slack KB", "live allocs", "allocs");
+    for (int i = 0; i < MEM_NUM_SUBSYSTEMS; i++) {
+        const MemUsage* subsystem = usage + i;
+        if (subsystem->has_slack)
+            fprintf(fp, "%-16s %12.1f %12.1f %12zu %12zu\n", subsystem_names[i], subsystem->live_bytes / 1024.0,
+                    subsystem->slack_bytes / 1024.0, subsystem->live_allocs, subsystem->total_allocs);
+        else
+            fprintf(fp, "%-16s %12.1f %12s %12zu %12zu\n", subsystem_names[i], subsystem->live_bytes / 1024.0, "-",
+                    subsystem->live_allocs, subsystem->total_allocs);
+
+        total.live_bytes += subsystem->live_bytes;
+        total.slack_bytes += subsystem->has_slack ? subsystem->slack_bytes : 0;
+        total.live_allocs += subsystem->live_allocs;
+        total.total_allocs += subsystem->total_allocs;
+    }
+    fprintf(fp, "%-16s %12.1f %12.1f %12zu %12zu\n", "total", total.live_bytes / 1024.0, total.slack_bytes / 1024.0,
+            total.live_allocs, total.total_allocs);
+}
@@ -0,0 +1,455 @@
+/*
+ *  Read-only paging of files larger than memory. A worker thread scans the file once and splits it into
+ *  pages of PAGER_PAGE_LINES lines, or fewer once they reach a size taken from the memory budget, and
+ *  keeps where every page starts. The lines themselves are read back from disk a page at a time when
+ *  they are needed, and a line longer than a page is shown cut, so no page is larger than twice that
+ *  size. Decoded pages are kept in a cache that is bounded by the budget and evicts the least recently
+ *  used page first.
+ */
+#define _XOPEN_SOURCE 700 // pread
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "pager.h"
+#include "line.h"
+#include "utils.h"
+#include "mem.h"
+#include "SDL.h"
+
+/*
+ *  Purpose: Read exactly 'size' bytes at an offset of a file, exiting on failure.
+ *
+ *  Parameters:
+ *    - fp: File pointer to the file to read from. Its position is not used or changed.
+ *    - buffer: Pointer to where the bytes are stored.
+ *    - size: The number of bytes to read.
+ *    - offset: The offset in the file to read from.
+ *
+ *  Returns:
+ *    - The number of bytes read, less than 'size' only at the end of the file.
+ */
+static size_t pager_read(FILE* fp, char* buffer, size_t size, size_t offset)
+{
+    size_t total = 0;
+    while (total < size) {
+        ssize_t bytes_read = pread(fileno(fp), buffer + total, size - total, offset + total);
+        if (bytes_read < 0 && errno == EINTR)
+            continue;
+        if (bytes_read < 0) {
+            fprintf(stderr, "ERROR: could not read the paged file: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        if (bytes_read == 0)
+            break;
+        total += bytes_read;
+    }
+    return total;
+}
+
+/*
+ *  Purpose: Add the start of a page to the index. The mutex must be held.
+ *
+ *  Parameters:
+ *    - pager: Pointer to the Pager.
+ *    - offset: The file offset where the page starts.
+ *    - first_line: The index of the first line of the page.
+ *
+ *  Returns: None.
+ */
+static void pager_push_page_offset(Pager* pager, size_t offset, size_t first_line)
+{
+    if (pager->num_pages == pager->pages_capacity) {
+        pager->pages_capacity = pager->pages_capacity == 0 ? PAGER_PAGE_LINES : pager->pages_capacity * 2;
+        pager->page_offsets = mem_realloc(MEM_PAGER, pager->page_offsets, pager->pages_capacity * sizeof(pager->page_offsets[0]));
+        pager->page_lines = mem_realloc(MEM_PAGER, pager->page_lines, pager->pages_capacity * sizeof(pager->page_lines[0]));
+    }
+    pager->page_offsets[pager->num_pages] = offset;
+    pager->page_lines[pager->num_pages++] = first_line;
+}
+
+/*
+ *  Purpose: Worker thread scanning the file for newlines and recording where every page starts.
+ *
+ *  Parameters:
+ *    - data: Pointer to the Pager.
+ *
+ *  Returns: 0.
+ */
+static int pager_thread(void* data)
+{
+    Pager* pager = data;
+    char* chunk = mem_malloc(MEM_PAGER, PAGER_SCAN_CHUNK_SIZE);
+    size_t new_capacity = PAGER_SCAN_CHUNK_SIZE / PAGER_PAGE_LINES, num_new_pages = 0;
+    size_t* new_offsets = mem_malloc(MEM_PAGER, new_capacity * sizeof(new_offsets[0]));
+    size_t* new_lines = mem_malloc(MEM_PAGER, new_capacity * sizeof(new_lines[0]));
+    size_t offset = 0, num_lines = 0, lines_end = 0;
+    size_t page_start = 0, page_lines = 0;
+
+    SDL_LockMutex(pager->mutex);
+    pager_push_page_offset(pager, 0, 0);
+    SDL_UnlockMutex(pager->mutex);
+
+    while (!SDL_AtomicGet(&pager->cancelled)) {
+        size_t bytes_read = pager_read(pager->fp, chunk, PAGER_SCAN_CHUNK_SIZE, offset);
+        if (bytes_read == 0)
+            break;
+
+        for (char* c = chunk; (c = memchr(c, '\n', chunk + bytes_read - c)) != NULL; c++) {
+            size_t line_start = lines_end;
+            lines_end = offset + (c - chunk) + 1;
+            num_lines++;
+
+            // A page ends after PAGER_PAGE_LINES lines or once it reaches the page size, and a line longer than
+            // that is a page of its own, so the page before it ends where the line starts
+            bool long_line = lines_end - line_start > pager->page_size;
+            bool split_before = long_line && page_lines > 0;
+            bool split_after = long_line || ++page_lines == PAGER_PAGE_LINES || lines_end - page_start >= pager->page_size;
+
+            if (num_new_pages + 2 > new_capacity) {
+                new_capacity *= 2;
+                new_offsets = mem_realloc(MEM_PAGER, new_offsets, new_capacity * sizeof(new_offsets[0]));
+                new_lines = mem_realloc(MEM_PAGER, new_lines, new_capacity * sizeof(new_lines[0]));
+            }
+            if (split_before) {
+                new_offsets[num_new_pages] = line_start;
+                new_lines[num_new_pages++] = num_lines - 1;
+            }
+            if (split_after) {
+                new_offsets[num_new_pages] = lines_end;
+                new_lines[num_new_pages++] = num_lines;
+                page_start = lines_end;
+                page_lines = 0;
+            }
+        }
+        offset += bytes_read;
+
+        SDL_LockMutex(pager->mutex);
+        for (size_t i = 0; i < num_new_pages; i++)
+            pager_push_page_offset(pager, new_offsets[i], new_lines[i]);
+        pager->num_lines = num_lines;
+        pager->lines_end = lines_end;
+        SDL_UnlockMutex(pager->mutex);
+        num_new_pages = 0;
+    }
+
+    SDL_LockMutex(pager->mutex);
+    // A last line without a newline
+    if (offset > lines_end && !SDL_AtomicGet(&pager->cancelled)) {
+        pager->num_lines++;
+        pager->lines_end = offset;
+    }
+    // A page recorded at the very end of the file has no lines
+    if (pager->num_pages > 0 && pager->page_lines[pager->num_pages - 1] == pager->num_lines)
+        pager->num_pages--;
+    SDL_UnlockMutex(pager->mutex);
+
+    mem_free(MEM_PAGER, new_lines);
+    mem_free(MEM_PAGER, new_offsets);
+    mem_free(MEM_PAGER, chunk);
+    SDL_AtomicSet(&pager->finished, 1);
+    return 0;
+}
+
+/*
+ *  Purpose: Check whether a file is too large to be loaded within a memory budget and should be paged.
+ *
+ *  Parameters:
+ *    - fp: File pointer to the file, rewound to its start afterwards.
+ *    - budget: The memory budget in bytes.
+ *
+ *  Returns:
+ *    - true if the file is larger than the budget.
+ *    - false otherwise, or if its size is not known.
+ */
+bool pager_should_page(FILE* fp, size_t budget)
+{
+    if (fseek(fp, 0, SEEK_END) != 0)
+        return false;
+
+    long size = ftell(fp);
+    rewind(fp);
+    return size > 0 && (size_t)size > budget;
+}
+
+/*
+ *  Purpose: Start indexing a file on a worker thread. The pager should be released with 'pager_free'.
+ *
+ *  Parameters:
+ *    - fp: File pointer to the file to page. The pager takes ownership and closes it.
+ *    - budget: The maximum number of bytes the cached pages may use. At least one page is kept
+ *              even if it is larger on its own.
+ *
+ *  Returns:
+ *    - Pointer to the new Pager.
+ */
+Pager* pager_open(FILE* fp, size_t budget)
+{
+    Pager* pager = mem_calloc(MEM_PAGER, 1, sizeof(*pager));
+    pager->fp = fp;
+    pager->budget = budget;
+    pager->page_size = budget / PAGER_BUDGET_PAGES > PAGER_MIN_PAGE_SIZE ? budget / PAGER_BUDGET_PAGES : PAGER_MIN_PAGE_SIZE;
+
+    if (fseek(fp, 0, SEEK_END) == 0) {
+        long size = ftell(fp);
+        pager->file_size = size > 0 ? size : 0;
+        rewind(fp);
+    }
+
+    pager->mutex = utils_scp(SDL_CreateMutex());
+    pager->thread = utils_scp(SDL_CreateThread(pager_thread, "pager", pager));
+    return pager;
+}
+
+/*
+ *  Purpose: Get the number of lines indexed so far.
+ *
+ *  Parameters:
+ *    - pager: Pointer to the Pager.
+ *
+ *  Returns: The number of lines that can be read with 'pager_get_line'.
+ */
+size_t pager_num_lines(Pager* pager)
+{
+    SDL_LockMutex(pager->mutex);
+    size_t num_lines = pager->num_lines;
+    SDL_UnlockMutex(pager->mutex);
+    return num_lines;
+}
+
+/*
+ *  Purpose: Unlink a page from the recently used list.
+ *
+ *  Parameters:
+ *    - pager: Pointer to the Pager.
+ *    - page: Pointer to the cached page.
+ *
+ *  Returns: None.
+ */
+static void pager_unlink_page(Pager* pager, PagerPage* page)
+{
+    if (page->prev != NULL)
+        page->prev->next = page->next;
+    else
+        pager->most_recent = page->next;
+
+    if (page->next != NULL)
+        page->next->prev = page->prev;
+    else
+        pager->least_recent = page->prev;
+
+    page->prev = page->next = NULL;
+}
+
+/*
+ *  Purpose: Make a page the most recently used one.
+ *
+ *  Parameters:
+ *    - pager: Pointer to the Pager.
+ *    - page: Pointer to a page that is not in the list.
+ *
+ *  Returns: None.
+ */
+static void pager_push_front(Pager* pager, PagerPage* page)
+{
+    page->next = pager->most_recent;
+    if (pager->most_recent != NULL)
+        pager->most_recent->prev = page;
+    else
+        pager->least_recent = page;
+    pager->most_recent = page;
+}
+
+/*
+ *  Purpose: Remove a page from the cache and free it.
+ *
+ *  Parameters:
+ *    - pager: Pointer to the Pager.
+ *    - page: Pointer to the cached page.
+ *
+ *  Returns: None.
+ */
+static void pager_evict_page(Pager* pager, PagerPage* page)
+{
+    pager_unlink_page(pager, page);
+    pager->memory -= page->memory;
+    mem_free(MEM_PAGER, page->lines);
+    mem_free(MEM_PAGER, page->chars);
+    mem_free(MEM_PAGER, page);
+}
+
+/*
+ *  Purpose: Find the page holding a line in the index.
+ *
+ *  Parameters:
+ *    - pager: Pointer to the Pager.
+ *    - row: The index of the line, below 'pager_num_lines'.
+ *
+ *  Returns: The index of the page.
+ */
+static size_t pager_find_page(Pager* pager, size_t row)
+{
+    // The last page starting at or before the line
+    SDL_LockMutex(pager->mutex);
+    size_t low = 0, high = pager->num_pages;
+    while (high - low > 1) {
+        size_t middle = low + (high - low) / 2;
+        if (pager->page_lines[middle] <= row)
+            low = middle;
+        else
+            high = middle;
+    }
+    SDL_UnlockMutex(pager->mutex);
+    return low;
+}
+
+/*
+ *  Purpose: Read a page from disk and split it into lines, evicting pages to stay within the budget.
+ *
+ *  Parameters:
+ *    - pager: Pointer to the Pager.
+ *    - index: The index of the page.
+ *
+ *  Returns:
+ *    - Pointer to the page, which is the most recently used one.
+ */
+static PagerPage* pager_load_page(Pager* pager, size_t index)
+{
+    SDL_LockMutex(pager->mutex);
+    size_t start = pager->page_offsets[index];
+    size_t first_line = pager->page_lines[index];
+    bool complete = index + 1 < pager->num_pages;
+    size_t num_lines = (complete ? pager->page_lines[index + 1] : pager->num_lines) - first_line;
+    size_t end = complete ? pager->page_offsets[index + 1] : pager->lines_end;
+    SDL_UnlockMutex(pager->mutex);
+
+    // Only a line longer than a page, or a last one without a newline, makes it larger, and is cut
+    size_t size = end - start;
+    if (size > 2 * pager->page_size)
+        size = 2 * pager->page_size;
+    size_t memory = sizeof(PagerPage) + num_lines * sizeof(Line) + size;
+    while (pager->least_recent != NULL && pager->memory + memory > pager->budget)
+        pager_evict_page(pager, pager->least_recent);
+
+    PagerPage* page = mem_calloc(MEM_PAGER, 1, sizeof(*page));
+    page->index = index;
+    page->first_line = first_line;
+    page->num_lines = num_lines;
+    page->memory = memory;
+    page->chars = mem_malloc(MEM_PAGER, size + 1);
+    page->lines = mem_calloc(MEM_PAGER, num_lines, sizeof(page->lines[0]));
+    size = pager_read(pager->fp, page->chars, size, start);
+
+    // The lines point into the page, a capacity of 0 marks that they do not own their characters
+    char* line_start = page->chars;
+    char* page_end = page->chars + size;
+    for (size_t i = 0; i < num_lines && line_start <= page_end; i++) {
+        char* newline = memchr(line_start, '\n', page_end - line_start);
+        char* line_end = newline != NULL ? newline : page_end;
+        page->lines[i].chars = line_start;
+        page->lines[i].size = line_end - line_start;
+        line_start = line_end + 1;
+    }
+
+    pager->memory += memory;
+    pager_push_front(pager, page);
+    return page;
+}
+
+/*
+ *  Purpose: Get a line, reading its page from disk if it is not cached. Call from a single thread.
+ *
+ *  Parameters:
+ *    - pager: Pointer to the Pager.
+ *    - row: The index of the line, below 'pager_num_lines'.
+ *
+ *  Returns:
+ *    - Pointer to the line. It stays valid until the next call, which may evict its page.
+ */
+const Line* pager_get_line(Pager* pager, size_t row)
+{
+    // The cached pages are looked at first, which needs no lock
+    PagerPage* page = pager->most_recent;
+    while (page != NULL && (row < page->first_line || row - page->first_line >= page->num_lines))
+        page = page->next;
+
+    if (page == NULL) {
+        size_t index = pager_find_page(pager, row);
+
+        // A page read before the end of it was indexed is missing its newer lines
+        for (PagerPage* stale = pager->most_recent; stale != NULL; stale = stale->next) {
+            if (stale->index == index) {
+                pager_evict_page(pager, stale);
+                break;
+            }
+        }
+        page = pager_load_page(pager, index);
+    } else if (page != pager->most_recent) {
+        pager_unlink_page(pager, page);
+        pager_push_front(pager, page);
+    }
+    return page->lines + (row - page->first_line);
+}
+
+/*
+ *  Purpose: Check whether the whole file has been indexed.
+ *
+ *  Parameters:
+ *    - pager: Pointer to the Pager.
+ *
+ *  Returns:
+ *    - true if indexing is complete.
+ *    - false otherwise.
+ */
+bool pager_done(Pager* pager)
+{
+    return SDL_AtomicGet(&pager->finished);
+}
+
+/*
+ *  Purpose: Get how much of the file has been indexed.
+ *
+ *  Parameters:
+ *    - pager: Pointer to the Pager.
+ *
+ *  Returns:
+ *    - The indexed fraction of the file, between 0 and 1.
+ *    - A negative value if the size of the file is not known.
+ */
+float pager_progress(Pager* pager)
+{
+    if (pager->file_size == 0)
+        return -1.0f;
+
+    SDL_LockMutex(pager->mutex);
+    size_t lines_end = pager->lines_end;
+    SDL_UnlockMutex(pager->mutex);
+    return lines_end >= pager->file_size ? 1.0f : (float)lines_end / pager->file_size;
+}
+
+/*
+ *  Purpose: Stop the worker if it is still running and free the Pager and its cached pages.
+ *
+ *  Parameters:
+ *    - pager: Pointer to the Pager to free.
+ *
+ *  Returns: None.
+ */
+void pager_free(Pager* pager)
+{
+    SDL_AtomicSet(&pager->cancelled, 1);
+    SDL_WaitThread(pager->thread, NULL);
+
+    while (pager->most_recent != NULL)
+        pager_evict_page(pager, pager->most_recent);
+
+    SDL_DestroyMutex(pager->mutex);
+    mem_free(MEM_PAGER, pager->page_offsets);
+    mem_free(MEM_PAGER, pager->page_lines);
+    fclose(pager->fp);
+    mem_free(MEM_PAGER, pager);
+}
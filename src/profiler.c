@@ -0,0 +1,375 @@
+/*
+ *  A lightweight frame profiler. Each stage of the main loop is timed with the SDL performance
+ *  counter and the results of the last frames are kept in a ring buffer. The data can be shown
+ *  as an on-screen overlay or exported as Chrome trace JSON (chrome://tracing, Perfetto).
+ *  Frames are profiled by the render thread, the stages run by the main thread are recorded
+ *  into them with 'profiler_record_stage'. Startup marks can be added from any thread.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "profiler.h"
+#include "render.h"
+#include "utils.h"
+#include "font.h"
+#include "vec.h"
+#include "SDL.h"
+
+static const char* stage_names[PROFILER_STAGE_COUNT] = {
+    [PROFILER_STAGE_EVENTS]        = "events",
+    [PROFILER_STAGE_CAMERA]        = "camera_update",
+    [PROFILER_STAGE_RENDER_EDITOR] = "render_editor",
+    [PROFILER_STAGE_RENDER_CURSOR] = "render_cursor",
+    [PROFILER_STAGE_PRESENT]       = "present",
+};
+
+static ProfilerFrame frames[PROFILER_HISTORY];
+static size_t frames_head = 0;  // Index the next finished frame is written to
+static size_t frames_count = 0;
+
+typedef struct {
+    const char* name;  // Published last, NULL until the mark is complete
+    Uint64 counter;
+} StartupMark;
+
+static StartupMark startup_marks[PROFILER_MAX_STARTUP_MARKS];
+static SDL_atomic_t num_startup_marks;
+static size_t num_startup_marks_printed = 0;
+
+static ProfilerFrame current;
+static bool counting = true;    // false while the overlay draws itself
+static bool overlay_enabled = false;
+
+/*
+ *  Purpose: Convert a performance counter interval to milliseconds.
+ *
+ *  Parameters:
+ *    - start: Performance counter at the start of the interval.
+ *    - end: Performance counter at the end of the interval.
+ *
+ *  Returns: The length of the interval in milliseconds (0 for an interval that was never closed).
+ */
+static double counter_to_ms(Uint64 start, Uint64 end)
+{
+    if (end < start)
+        return 0.0;
+    return (double)(end - start) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+/*
+ *  Purpose: Get a frame from the ring buffer, oldest first.
+ *
+ *  Parameters:
+ *    - i: Index of the frame, 0 being the oldest one kept.
+ *
+ *  Returns: Pointer to the frame.
+ */
+static const ProfilerFrame* frame_at(size_t i)
+{
+    return frames + (frames_head + PROFILER_HISTORY - frames_count + i) % PROFILER_HISTORY;
+}
+
+/*
+ *  Purpose: Start recording a new frame, discarding a frame that was started but never ended.
+ *
+ *  Parameters: None.
+ *
+ *  Returns: None.
+ */
+void profiler_begin_frame(void)
+{
+    memset(&current, 0, sizeof(current));
+    current.start = SDL_GetPerformanceCounter();
+}
+
+/*
+ *  Purpose: Finish the current frame and push it onto the ring buffer.
+ *
+ *  Parameters: None.
+ *
+ *  Returns: None.
+ */
+void profiler_end_frame(void)
+{
+    current.end = SDL_GetPerformanceCounter();
+    frames[frames_head] = current;
+    frames_head = (frames_head + 1) % PROFILER_HISTORY;
+    if (frames_count < PROFILER_HISTORY)
+        frames_count++;
+}
+
+/*
+ *  Purpose: Mark the start of a stage in the current frame.
+ *
+ *  Parameters:
+ *    - stage: The stage being timed.
+ *
+ *  Returns: None.
+ */
+void profiler_stage_begin(ProfilerStage stage)
+{
+    current.stage_start[stage] = SDL_GetPerformanceCounter();
+}
+
+/*
+ *  Purpose: Mark the end of a stage in the current frame.
+ *
+ *  Parameters:
+ *    - stage: The stage being timed.
+ *
+ *  Returns: None.
+ */
+void profiler_stage_end(ProfilerStage stage)
+{
+    current.stage_end[stage] = SDL_GetPerformanceCounter();
+}
+
+/*
+ *  Purpose: Set the time of a stage of the current frame that ran on another thread, before the frame started.
+ *
+ *  Parameters:
+ *    - stage: The stage.
+ *    - start: Performance counter when the stage started.
+ *    - end: Performance counter when the stage ended.
+ *
+ *  Returns: None.
+ */
+void profiler_record_stage(ProfilerStage stage, Uint64 start, Uint64 end)
+{
+    current.stage_start[stage] = start;
+    current.stage_end[stage] = end;
+}
+
+/*
+ *  Purpose: Count a draw call issued to the renderer in the current frame.
+ *
+ *  Parameters:
+ *    - glyphs: The number of glyphs drawn by the call (0 for shapes).
+ *
+ *  Returns: None.
+ */
+void profiler_count_draw_call(size_t glyphs)
+{
+    if (counting) {
+        current.draw_calls++;
+        current.glyphs += glyphs;
+    }
+}
+
+/*
+ *  Purpose: Show the overlay if it is hidden, hide it otherwise.
+ *
+ *  Parameters: None.
+ *
+ *  Returns: None.
+ */
+void profiler_toggle_overlay(void)
+{
+    overlay_enabled = !overlay_enabled;
+}
+
+/*
+ *  Purpose: Check whether the overlay is currently shown.
+ *
+ *  Parameters: None.
+ *
+ *  Returns:
+ *    - true if the overlay is shown.
+ *    - false otherwise.
+ */
+bool profiler_overlay_enabled(void)
+{
+    return overlay_enabled;
+}
+
+/*
+ *  Purpose: Draw the per-stage timings, draw calls and glyph counts in the top-left corner of the window.
+ *           Draw calls made by the overlay itself are not counted. Does nothing if the overlay is hidden.
+ *
+ *  Parameters:
+ *    - renderer: Pointer to the SDL renderer to draw the overlay with.
+ *    - font: Pointer to the Font structure used for the text.
+ *
+ *  Returns: None.
+ */
+void profiler_render_overlay(SDL_Renderer* renderer, const Font* font)
+{
+    if (!overlay_enabled || frames_count == 0)
+        return;
+
+    counting = false;
+
+    // The newest frame plus the average and worst case over the whole history
+    const ProfilerFrame* last = frame_at(frames_count - 1);
+    double avg_ms[PROFILER_STAGE_COUNT + 1] = {0};
+    double max_ms[PROFILER_STAGE_COUNT + 1] = {0};
+    for (size_t i = 0; i < frames_count; i++) {
+        const ProfilerFrame* frame = frame_at(i);
+        for (size_t stage = 0; stage <= PROFILER_STAGE_COUNT; stage++) {
+            double ms = stage < PROFILER_STAGE_COUNT
+                ? counter_to_ms(frame->stage_start[stage], frame->stage_end[stage])
+                : counter_to_ms(frame->start, frame->end);
+            avg_ms[stage] += ms / frames_count;
+            if (ms > max_ms[stage])
+                max_ms[stage] = ms;
+        }
+    }
+
+    char lines[PROFILER_STAGE_COUNT + 3][64];
+    size_t num_lines = 0;
+    snprintf(lines[num_lines++], sizeof(lines[0]), "%-14s %7s %7s %7s", "stage (ms)", "last", "avg", "max");
+    for (size_t stage = 0; stage <= PROFILER_STAGE_COUNT; stage++) {
+        double last_ms = stage < PROFILER_STAGE_COUNT
+            ? counter_to_ms(last->stage_start[stage], last->stage_end[stage])
+            : counter_to_ms(last->start, last->end);
+        snprintf(lines[num_lines++], sizeof(lines[0]), "%-14s %7.3f %7.3f %7.3f",
+                 stage < PROFILER_STAGE_COUNT ? stage_names[stage] : "frame", last_ms, avg_ms[stage], max_ms[stage]);
+    }
+    snprintf(lines[num_lines++], sizeof(lines[0]), "draw calls %zu  glyphs %zu", last->draw_calls, last->glyphs);
+
+    size_t max_line_size = 0;
+    for (size_t i = 0; i < num_lines; i++)
+        if (strlen(lines[i]) > max_line_size)
+            max_line_size = strlen(lines[i]);
+
+    const float line_height = FONT_HEIGHT * PROFILER_OVERLAY_SCALE;
+    SDL_Rect background = {
+        .x = 0,
+        .y = 0,
+        .w = max_line_size * FONT_WIDTH * PROFILER_OVERLAY_SCALE,
+        .h = num_lines * line_height,
+    };
+    utils_scc(SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND));
+    utils_scc(SDL_SetRenderDrawColor(renderer, 0, 0, 0, 200));
+    utils_scc(SDL_RenderFillRect(renderer, &background));
+
+    for (size_t i = 0; i < num_lines; i++)
+        render_text(renderer, font, lines[i], vec2f(0.0f, i * line_height), (SDL_Color) {0, 255, 0, 255}, PROFILER_OVERLAY_SCALE);
+
+    counting = true;
+}
+
+/*
+ *  Purpose: Write the frames in the ring buffer to a file in the Chrome trace event JSON format.
+ *
+ *  Parameters:
+ *    - file_path: The path to the file where the trace will be saved.
+ *
+ *  Returns:
+ *    - true if the trace was written.
+ *    - false otherwise (the reason is printed to stderr).
+ */
+bool profiler_export_chrome_trace(const char* file_path)
+{
+    FILE* fp = fopen(file_path, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "ERROR: could not open file `%s`: %s\n", file_path, strerror(errno));
+        return false;
+    }
+
+    // Timestamps are in microseconds relative to the oldest frame kept
+    const double us_per_count = 1000000.0 / SDL_GetPerformanceFrequency();
+    // Stages recorded with 'profiler_record_stage' start before their frame
+    Uint64 origin = frames_count > 0 ? frame_at(0)->start : 0;
+    for (size_t stage = 0; frames_count > 0 && stage < PROFILER_STAGE_COUNT; stage++)
+        if (frame_at(0)->stage_start[stage] != 0 && frame_at(0)->stage_start[stage] < origin)
+            origin = frame_at(0)->stage_start[stage];
+    bool first_event = true;
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", fp);
+    for (size_t i = 0; i < frames_count; i++) {
+        const ProfilerFrame* frame = frame_at(i);
+
+        fprintf(fp, "%s{\"name\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+                first_event ? "" : ",\n", (frame->start - origin) * us_per_count, (frame->end - frame->start) * us_per_count);
+        first_event = false;
+
+        for (size_t stage = 0; stage < PROFILER_STAGE_COUNT; stage++) {
+            if (frame->stage_end[stage] < frame->stage_start[stage] || frame->stage_start[stage] == 0)
+                continue;
+            fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+                    stage_names[stage], (frame->stage_start[stage] - origin) * us_per_count,
+                    (frame->stage_end[stage] - frame->stage_start[stage]) * us_per_count);
+        }
+
+        fprintf(fp, ",\n{\"name\":\"renderer\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"draw_calls\":%zu,\"glyphs\":%zu}}",
+                (frame->start - origin) * us_per_count, frame->draw_calls, frame->glyphs);
+    }
+    fputs("\n]}\n", fp);
+
+    bool ok = !ferror(fp);
+    if (fclose(fp) != 0 || !ok) {
+        fprintf(stderr, "ERROR: could not write file `%s`\n", file_path);
+        return false;
+    }
+    return true;
+}
+
+/*
+ *  Purpose: Record that a startup milestone was reached, timed from the first mark. Can be called from any thread.
+ *
+ *  Parameters:
+ *    - name: Null-terminated name of the milestone, which must outlive the profiler (e.g. a string literal).
+ *
+ *  Returns: None.
+ */
+void profiler_startup_mark(const char* name)
+{
+    Uint64 counter = SDL_GetPerformanceCounter();
+    int index = SDL_AtomicAdd(&num_startup_marks, 1);
+    if (index >= PROFILER_MAX_STARTUP_MARKS)
+        return;
+
+    startup_marks[index].counter = counter;
+    SDL_AtomicSetPtr((void**)&startup_marks[index].name, (void*)name);
+}
+
+/*
+ *  Purpose: qsort comparison function ordering startup marks by time.
+ *
+ *  Parameters:
+ *    - a: Pointer to the first StartupMark.
+ *    - b: Pointer to the second StartupMark.
+ *
+ *  Returns: A negative, zero or positive value if a was reached before, with or after b.
+ */
+static int compare_startup_marks(const void* a, const void* b)
+{
+    Uint64 x = ((const StartupMark*)a)->counter, y = ((const StartupMark*)b)->counter;
+    return (x > y) - (x < y);
+}
+
+/*
+ *  Purpose: Print the startup milestones recorded so far and not printed yet, in the order they were reached.
+ *
+ *  Parameters: None.
+ *
+ *  Returns: None.
+ */
+void profiler_print_startup_trace(void)
+{
+    size_t count = SDL_AtomicGet(&num_startup_marks);
+    if (count > PROFILER_MAX_STARTUP_MARKS)
+        count = PROFILER_MAX_STARTUP_MARKS;
+
+    // Only marks that are fully written and come after the ones already printed
+    StartupMark marks[PROFILER_MAX_STARTUP_MARKS];
+    size_t num_marks = 0;
+    for (size_t i = 0; i < count; i++) {
+        StartupMark mark = startup_marks[i];
+        mark.name = SDL_AtomicGetPtr((void**)&startup_marks[i].name);
+        if (mark.name != NULL)
+            marks[num_marks++] = mark;
+    }
+    if (num_marks <= num_startup_marks_printed)
+        return;
+
+    qsort(marks, num_marks, sizeof(marks[0]), compare_startup_marks);
+    Uint64 origin = marks[0].counter;
+
+    for (size_t i = num_startup_marks_printed; i < num_marks; i++)
+        printf("startup %9.2f ms  %s\n", counter_to_ms(origin, marks[i].counter), marks[i].name);
+    num_startup_marks_printed = num_marks;
+}
@@ -11,6 +11,26 @@
 #include "vec.h"
 #include "SDL.h"
 #include "camera.h"
+#include "profiler.h"
+#include "highlight.h"
+#include "decoration.h"
+
+// Text color of each HighlightKind, HIGHLIGHT_NORMAL text is drawn in the color passed to 'render_line'
+static const SDL_Color highlight_colors[HIGHLIGHT_KIND_COUNT] = {
+    [HIGHLIGHT_KEYWORD] = {.r = 255, .g = 160, .b = 60, .a = 255},
+    [HIGHLIGHT_TYPE] = {.r = 90, .g = 200, .b = 255, .a = 255},
+    [HIGHLIGHT_STRING] = {.r = 140, .g = 220, .b = 100, .a = 255},
+    [HIGHLIGHT_NUMBER] = {.r = 240, .g = 220, .b = 110, .a = 255},
+    [HIGHLIGHT_COMMENT] = {.r = 130, .g = 130, .b = 140, .a = 255},
+    [HIGHLIGHT_PREPROCESSOR] = {.r = 200, .g = 120, .b = 255, .a = 255},
+};
+
+// Background color of each DecorationKind
+static const SDL_Color decoration_colors[DECORATION_KIND_COUNT] = {
+    [DECORATION_SELECTION] = {.r = 60, .g = 70, .b = 110, .a = 255},
+    [DECORATION_SEARCH_HIT] = {.r = 110, .g = 90, .b = 30, .a = 255},
+    [DECORATION_DIAGNOSTIC] = {.r = 120, .g = 40, .b = 40, .a = 255},
+};
 
 /*
  *  Purpose: Render a single character to the window using a specified font and position.
@@ -38,6 +58,7 @@ void render_char(SDL_Renderer* renderer, const Font* font, char c, Vec2f pos, fl
         index = c - ASCII_DISPLAY_LOW;
 
     utils_scc(SDL_RenderCopy(renderer, font->spritesheet, &font->glyphs[index], &dst));
+    profiler_count_draw_call(1);
 }
 
 /*
@@ -101,63 +122,164 @@ void render_text(SDL_Renderer* renderer, const Font* font, const char* text, Vec
 }
 
 /*
- *  Purpose: Retrieve the character under the cursor in the text editor.
+ *  Purpose: Find the lines that are on screen, the cost of a frame depends on the window and not the file.
  *
  *  Parameters:
- *    - editor: Pointer to the Editor structure containing the text.
+ *    - window: Pointer to the SDL window to determine screen dimensions.
+ *    - camera_pos: The position of the camera.
+ *    - num_lines: The number of lines in the Editor.
+ *    - first: Pointer set to the index of the first line on screen.
+ *    - last: Pointer set to the index after the last line on screen, at most num_lines.
  *
- *  Returns:
- *    - Pointer to the character under the cursor, or NULL if the cursor is outside the text bounds.
+ *  Returns: None.
  */
-static char* text_under_cursor(Editor* editor)
+void render_visible_rows(SDL_Window* window, Vec2f camera_pos, size_t num_lines, size_t* first, size_t* last)
 {
-    if (editor->size == 0)
-        return NULL;
+    int window_height;
+    SDL_GetWindowSize(window, NULL, &window_height);
 
-    Line* line = editor->lines + editor->cursor_row;
-    size_t col = editor->cursor_col;
+    const float line_height = FONT_HEIGHT * FONT_SCALE;
+    float top = camera_pos.y - window_height * 0.5f;
+    *first = top > line_height ? (size_t)(top / line_height) - 1 : 0;
+    *last = *first + window_height / line_height + 3;
+    if (*last > num_lines)
+        *last = num_lines;
+}
+
+/*
+ *  Purpose: Find the columns that are on screen, so only that part of a long line is drawn.
+ *
+ *  Parameters:
+ *    - window: Pointer to the SDL window to determine screen dimensions.
+ *    - camera_pos: The position of the camera.
+ *    - first_col: Pointer set to the first column on screen.
+ *    - last_col: Pointer set to the column after the last one on screen, past the end of shorter lines.
+ *
+ *  Returns: None.
+ */
+void render_visible_cols(SDL_Window* window, Vec2f camera_pos, size_t* first_col, size_t* last_col)
+{
+    int window_width;
+    SDL_GetWindowSize(window, &window_width, NULL);
 
-    return col < line->size ? line->chars + col : NULL;
+    const float col_width = FONT_WIDTH * FONT_SCALE;
+    float left = camera_pos.x - window_width * 0.5f;
+    *first_col = left > col_width ? (size_t)(left / col_width) - 1 : 0;
+    *last_col = *first_col + window_width / col_width + 3;
 }
 
 /*
- *  Purpose: Render text lines in the editor using camera projection.
+ *  Purpose: Fill the background of a decoration on one visual row of one of its lines.
  *
  *  Parameters:
  *    - renderer: Pointer to the SDL renderer for rendering operations.
- *    - font: Pointer to the Font structure for rendering text.
- *    - editor: Pointer to the Editor structure containing text lines to be rendered.
+ *    - decoration: Pointer to the Decoration.
+ *    - row: The index of the line, from the start to the end row of the decoration.
+ *    - segment_start: The first column of the line on the visual row.
+ *    - segment_end: The column after its last one, one past the end of the line on its last row for the line break.
+ *    - screen_col: The column on screen 'segment_start' is drawn at.
+ *    - visual_row: The visual row, where it is drawn.
+ *    - window: Pointer to the SDL window to determine screen dimensions.
+ *    - camera_pos: The position of the camera.
+ *    - scale: Scaling factor for adjusting the text size.
+ *
+ *  Returns: None.
+ */
+void render_decoration_segment(SDL_Renderer* renderer, const Decoration* decoration, size_t row, size_t segment_start, size_t segment_end, size_t screen_col, size_t visual_row, SDL_Window* window, Vec2f camera_pos, float scale)
+{
+    // Lines in the middle of a decoration are covered to the end of the row
+    size_t start_col = row == decoration->start_row ? decoration->start_col : 0;
+    size_t end_col = row == decoration->end_row ? decoration->end_col : segment_end;
+    if (start_col < segment_start)
+        start_col = segment_start;
+    if (end_col > segment_end)
+        end_col = segment_end;
+    if (end_col <= start_col)
+        return;
+
+    Vec2f pos = camera_get_projection_point(vec2f((start_col - segment_start + screen_col) * FONT_WIDTH * scale, visual_row * FONT_HEIGHT * FONT_SCALE), camera_pos, window);
+    SDL_Rect dst = {
+        .x = pos.x,
+        .y = pos.y,
+        .w = (end_col - start_col) * FONT_WIDTH * scale,
+        .h = FONT_HEIGHT * FONT_SCALE,
+    };
+    SDL_Color color = decoration_colors[decoration->kind];
+    utils_scc(SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a));
+    utils_scc(SDL_RenderFillRect(renderer, &dst));
+    profiler_count_draw_call(0);
+}
+
+/*
+ *  Purpose: Fill the background of a decoration on one of its lines.
+ *
+ *  Parameters:
+ *    - renderer: Pointer to the SDL renderer for rendering operations.
+ *    - decoration: Pointer to the Decoration.
+ *    - row: The index of the line, from the start to the end row of the decoration.
+ *    - line_size: The number of characters on the line.
  *    - window: Pointer to the SDL window to determine screen dimensions.
- *    - camera: Pointer to the Camera structure for camera projection adjustment.
- *    - text_color: SDL_Color specifying the color of the rendered text.
+ *    - camera_pos: The position of the camera.
  *    - scale: Scaling factor for adjusting the text size.
  *
  *  Returns: None.
  */
-void render_editor(SDL_Renderer* renderer, Font* font, Editor* editor, SDL_Window* window, Camera* camera, SDL_Color text_color, float scale)
+void render_decoration(SDL_Renderer* renderer, const Decoration* decoration, size_t row, size_t line_size, SDL_Window* window, Vec2f camera_pos, float scale)
 {
-    for (size_t i = 0; i < editor->size; i++) {
-        Vec2f line_pos = camera_get_projection_point(vec2f(0.0f, i * FONT_HEIGHT * FONT_SCALE), camera->pos, window);
-        render_text_segment(renderer, font, editor->lines[i].chars, editor->lines[i].size, line_pos, text_color, scale);
+    // Lines in the middle of a decoration are covered to their end, and one column past it for the line break
+    render_decoration_segment(renderer, decoration, row, 0, line_size + 1, 0, row, window, camera_pos, scale);
+}
+
+/*
+ *  Purpose: Render a line of text colored by its highlighting runs.
+ *
+ *  Parameters:
+ *    - renderer: Pointer to the SDL renderer for rendering operations.
+ *    - font: Pointer to the Font structure for rendering text.
+ *    - line: Pointer to the Line.
+ *    - runs: Pointer to the runs of the line, in order and not overlapping (can be NULL if there are none).
+ *    - num_runs: The number of runs.
+ *    - pos: The position (Vec2f) of the start of the line on screen.
+ *    - text_color: The color of the text outside the runs.
+ *    - scale: Scaling factor for adjusting the text size.
+ *
+ *  Returns: None.
+ */
+void render_line(SDL_Renderer* renderer, const Font* font, const Line* line, const HighlightRun* runs, size_t num_runs, Vec2f pos, SDL_Color text_color, float scale)
+{
+    size_t col = 0;
+    for (size_t r = 0; r <= num_runs; r++) {
+        // The text before each run, and after the last one, is not highlighted
+        size_t run_start = r < num_runs ? runs[r].start : line->size;
+        render_text_segment(renderer, font, line->chars + col, run_start - col, vec2f(pos.x + col * FONT_WIDTH * scale, pos.y), text_color, scale);
+        if (r == num_runs)
+            break;
+
+        render_text_segment(renderer, font, line->chars + run_start, runs[r].size, vec2f(pos.x + run_start * FONT_WIDTH * scale, pos.y), highlight_colors[runs[r].kind], scale);
+        col = run_start + runs[r].size;
     }
 }
 
 /*
- *  Purpose: Render the cursor at the current cursor position in the text editor using specified colors.
+ *  Purpose: Render the cursor at a position using specified colors.
  *
  *  Parameters:
  *    - renderer: Pointer to the SDL renderer where the cursor is rendered.
  *    - font: Pointer to the Font structure for rendering text beneath the cursor.
- *    - editor: Pointer to the Editor structure containing the text and cursor position.
+ *    - row: The line of the cursor.
+ *    - col: The column of the cursor.
+ *    - beneath: Pointer to the character beneath the cursor (NULL at the end of the line).
+ *    - window: Pointer to the SDL window to determine screen dimensions.
+ *    - camera_pos: The position of the camera.
  *    - cursor_color: The color for rendering the cursor.
  *    - text_beneath_cursor_color: The color for rendering text beneath the cursor.
+ *    - cursor_shape: The CursorShape.
  *
  *  Returns: None.
  */
-void render_cursor(SDL_Renderer* renderer, const Font* font, Editor* editor, SDL_Window* window, Vec2f camera_pos, SDL_Color cursor_color, SDL_Color text_beneath_cursor_color, CursorShape cursor_shape)
+void render_cursor_at(SDL_Renderer* renderer, const Font* font, size_t row, size_t col, const char* beneath, SDL_Window* window, Vec2f camera_pos, SDL_Color cursor_color, SDL_Color text_beneath_cursor_color, CursorShape cursor_shape)
 {
-
-    Vec2f pos = camera_get_projection_point(vec2f(editor->cursor_col * FONT_WIDTH * FONT_SCALE, editor->cursor_row * FONT_HEIGHT * FONT_SCALE), camera_pos, window);
+    Vec2f pos = camera_get_projection_point(vec2f(col * FONT_WIDTH * FONT_SCALE, row * FONT_HEIGHT * FONT_SCALE), camera_pos, window);
 
     switch (cursor_shape) {
         case CURSOR_BOX: {
@@ -170,11 +292,11 @@ void render_cursor(SDL_Renderer* renderer, const Font* font, Editor* editor, SDL
 
             utils_scc(SDL_SetRenderDrawColor(renderer, cursor_color.r, cursor_color.g, cursor_color.b, cursor_color.a));
             utils_scc(SDL_RenderFillRect(renderer, &dst));
+            profiler_count_draw_call(0);
 
-            const char* c = text_under_cursor(editor);
-            if (c != NULL) {
+            if (beneath != NULL) {
                 set_texture_color(font->spritesheet, text_beneath_cursor_color);
-                render_char(renderer, font, *c, vec2f(dst.x, dst.y), FONT_SCALE);
+                render_char(renderer, font, *beneath, vec2f(dst.x, dst.y), FONT_SCALE);
             }
         }
         break;
@@ -191,6 +313,7 @@ void render_cursor(SDL_Renderer* renderer, const Font* font, Editor* editor, SDL
 
             utils_scc(SDL_SetRenderDrawColor(renderer, cursor_color.r, cursor_color.g, cursor_color.b, cursor_color.a));
             utils_scc(SDL_RenderFillRect(renderer, &dst));
+            profiler_count_draw_call(0);
         }
         break;
 
@@ -206,7 +329,42 @@ void render_cursor(SDL_Renderer* renderer, const Font* font, Editor* editor, SDL
 
             utils_scc(SDL_SetRenderDrawColor(renderer, cursor_color.r, cursor_color.g, cursor_color.b, cursor_color.a));
             utils_scc(SDL_RenderFillRect(renderer, &dst));
+            profiler_count_draw_call(0);
         }
         break;
     }
 }
+
+/*
+ *  Purpose: Render a line of status text in the bottom-right corner of the window, over a background
+ *           so it stays readable on top of the editor's text.
+ *
+ *  Parameters:
+ *    - renderer: Pointer to the SDL renderer where the text is rendered.
+ *    - font: Pointer to the Font structure used for rendering.
+ *    - window: Pointer to the SDL window to determine screen dimensions.
+ *    - text: Pointer to the null-terminated status text.
+ *    - text_color: The color for the rendered text.
+ *    - background_color: The color of the box behind the text.
+ *
+ *  Returns: None.
+ */
+void render_status(SDL_Renderer* renderer, const Font* font, SDL_Window* window, const char* text, SDL_Color text_color, SDL_Color background_color)
+{
+    int window_width, window_height;
+    SDL_GetWindowSize(window, &window_width, &window_height);
+
+    size_t text_size = strlen(text);
+    SDL_Rect background = {
+        .w = text_size * FONT_WIDTH * FONT_SCALE,
+        .h = FONT_HEIGHT * FONT_SCALE,
+    };
+    background.x = window_width - background.w;
+    background.y = window_height - background.h;
+
+    utils_scc(SDL_SetRenderDrawColor(renderer, background_color.r, background_color.g, background_color.b, background_color.a));
+    utils_scc(SDL_RenderFillRect(renderer, &background));
+    profiler_count_draw_call(0);
+
+    render_text_segment(renderer, font, text, text_size, vec2f(background.x, background.y), text_color, FONT_SCALE);
+}
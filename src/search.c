@@ -0,0 +1,221 @@
+/*
+ *  Search for every occurrence of a word, run on the job system. The lines are split into chunks
+ *  searched by the workers, the chunk on screen first, and the hits of each chunk are added to the
+ *  decorations on the main thread as it completes. The Editor must not change while a search runs:
+ *  edits cancel it first, which keeps the hits found so far.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <assert.h>
+
+#include "search.h"
+#include "editor.h"
+#include "cold.h"
+#include "decoration.h"
+#include "jobs.h"
+#include "mem.h"
+
+// The lines one job searches, and the hits it found
+typedef struct {
+    Search* search;
+    size_t first_row;
+    size_t end_row;
+    DecorationBuffer hits;
+} SearchChunk;
+
+/*
+ *  Purpose: Check whether a character can be part of a word.
+ *
+ *  Parameters:
+ *    - c: The character.
+ *
+ *  Returns:
+ *    - true for letters, digits and underscores.
+ *    - false otherwise.
+ */
+static bool search_is_word_char(char c)
+{
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+/*
+ *  Purpose: Get the word under the cursor, made of letters, digits and underscores.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *    - size: Pointer set to the number of characters of the word (0 if the cursor is not on a word).
+ *
+ *  Returns:
+ *    - Pointer to the first character of the word in its line.
+ */
+const char* search_word_under_cursor(Editor* editor, size_t* size)
+{
+    *size = 0;
+    if (editor->size == 0)
+        return NULL;
+
+    const Line* line = editor_get_line(editor, editor->cursor_row);
+    size_t start = editor->cursor_col, end = editor->cursor_col;
+    while (start > 0 && search_is_word_char(line->chars[start - 1]))
+        start--;
+    while (end < line->size && search_is_word_char(line->chars[end]))
+        end++;
+
+    *size = end - start;
+    return line->chars + start;
+}
+
+/*
+ *  Purpose: Search the lines of a chunk. Run by a worker.
+ *
+ *  Parameters:
+ *    - data: Pointer to the SearchChunk.
+ *    - token: Pointer to the JobToken of the search.
+ *
+ *  Returns: None.
+ */
+static void search_chunk_run(void* data, JobToken* token)
+{
+    SearchChunk* chunk = data;
+    Search* search = chunk->search;
+    const char* word = search->word;
+    size_t size = search->word_size;
+
+    ColdReader reader = {0};
+    for (size_t row = chunk->first_row; row < chunk->end_row; row++) {
+        if ((row - chunk->first_row) % SEARCH_CANCEL_CHECK_LINES == 0 && jobs_cancelled(token))
+            break;
+
+        const Line* line = editor_read_line(search->editor, row, &reader);
+        for (size_t col = 0; col + size <= line->size; col++) {
+            if (line->chars[col] != word[0] || memcmp(line->chars + col, word, size) != 0)
+                continue;
+
+            DecorationBuffer* hits = &chunk->hits;
+            if (hits->size == hits->capacity) {
+                hits->capacity = hits->capacity == 0 ? DECORATION_INIT_CAPACITY : hits->capacity * 2;
+                hits->decorations = mem_realloc(MEM_SEARCH, hits->decorations, hits->capacity * sizeof(hits->decorations[0]));
+            }
+            hits->decorations[hits->size++] = (Decoration) {row, col, row, col + size, DECORATION_SEARCH_HIT};
+            col += size - 1;
+        }
+    }
+    cold_reader_free(&reader);
+}
+
+/*
+ *  Purpose: Add the hits of a chunk to the decorations. Run on the main thread.
+ *
+ *  Parameters:
+ *    - data: Pointer to the SearchChunk, freed here.
+ *    - cancelled: Whether the search was cancelled, in which case the Search may already be freed.
+ *
+ *  Returns: None.
+ */
+static void search_chunk_complete(void* data, bool cancelled)
+{
+    SearchChunk* chunk = data;
+    if (!cancelled) {
+        Search* search = chunk->search;
+        for (size_t i = 0; i < chunk->hits.size; i++)
+            decoration_add(search->decorations, chunk->hits.decorations[i]);
+        search->count += chunk->hits.size;
+
+        if (--search->chunks_left == 0)
+            printf("%zu matches of '%.*s'\n", search->count, (int)search->word_size, search->word);
+    }
+    mem_free(MEM_SEARCH, chunk->hits.decorations);
+    mem_free(MEM_SEARCH, chunk);
+}
+
+/*
+ *  Purpose: Start searching the Editor for a word. The search should be released with 'search_free'.
+ *
+ *  Parameters:
+ *    - jobs: Pointer to the JobSystem running the search.
+ *    - editor: Pointer to the Editor, which must not be paged.
+ *    - decorations: Pointer to the DecorationStore the hits are added to, as DECORATION_SEARCH_HIT.
+ *    - word: Pointer to the characters of the word (not null-terminated).
+ *    - size: The number of characters, from 1 to SEARCH_WORD_CAPACITY.
+ *    - first_row: The first line on screen, searched first.
+ *
+ *  Returns:
+ *    - Pointer to the new Search.
+ */
+Search* search_start(JobSystem* jobs, Editor* editor, DecorationStore* decorations, const char* word, size_t size, size_t first_row)
+{
+    assert(editor->pager == NULL && size >= 1 && size <= SEARCH_WORD_CAPACITY);
+
+    Search* search = mem_calloc(MEM_SEARCH, 1, sizeof(*search));
+    search->jobs = jobs;
+    search->token = jobs_token_create();
+    search->editor = editor;
+    search->decorations = decorations;
+    memcpy(search->word, word, size);
+    search->word_size = size;
+    search->chunks_left = (editor->size + SEARCH_CHUNK_LINES - 1) / SEARCH_CHUNK_LINES;
+
+    for (size_t row = 0; row < editor->size; row += SEARCH_CHUNK_LINES) {
+        SearchChunk* chunk = mem_calloc(MEM_SEARCH, 1, sizeof(*chunk));
+        chunk->search = search;
+        chunk->first_row = row;
+        chunk->end_row = row + SEARCH_CHUNK_LINES < editor->size ? row + SEARCH_CHUNK_LINES : editor->size;
+
+        JobPriority priority = first_row >= chunk->first_row && first_row < chunk->end_row ? JOB_PRIORITY_VISIBLE : JOB_PRIORITY_NORMAL;
+        jobs_submit(jobs, priority, search_chunk_run, search_chunk_complete, chunk, search->token);
+    }
+    return search;
+}
+
+/*
+ *  Purpose: Check whether chunks of a search are still to be completed.
+ *
+ *  Parameters:
+ *    - search: Pointer to the Search.
+ *
+ *  Returns:
+ *    - true while the search runs.
+ *    - false once every chunk was completed, or the search was cancelled.
+ */
+bool search_running(const Search* search)
+{
+    return search->chunks_left > 0;
+}
+
+/*
+ *  Purpose: Stop a search and wait until no worker reads the Editor for it anymore. The chunks not
+ *           completed yet are dropped.
+ *
+ *  Parameters:
+ *    - search: Pointer to the Search.
+ *
+ *  Returns: None.
+ */
+void search_cancel(Search* search)
+{
+    if (search->chunks_left == 0)
+        return;
+
+    jobs_cancel(search->token);
+    jobs_wait(search->jobs, search->token);
+    search->chunks_left = 0;
+    printf("Search for '%.*s' stopped after %zu matches\n", (int)search->word_size, search->word, search->count);
+}
+
+/*
+ *  Purpose: Cancel a search and free it.
+ *
+ *  Parameters:
+ *    - search: Pointer to the Search to free.
+ *
+ *  Returns: None.
+ */
+void search_free(Search* search)
+{
+    search_cancel(search);
+    jobs_token_release(search->token);
+    mem_free(MEM_SEARCH, search);
+}
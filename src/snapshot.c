@@ -0,0 +1,271 @@
+/*
+ *  Session snapshots. When a large file is closed unmodified, its lines are written to the cache as a
+ *  line index and one blob of text, along with the cursor and camera. The next time the same version of
+ *  the file is opened, the snapshot is mapped and the lines borrow their characters from it, so the file
+ *  is not read or scanned for newlines and opening it costs one pass over the line index.
+ */
+#define _XOPEN_SOURCE 700 // mmap, pwrite, realpath, st_mtim
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "snapshot.h"
+#include "editor.h"
+#include "cold.h"
+#include "diff.h"
+#include "utils.h"
+#include "mem.h"
+
+/*
+ *  Purpose: Fill in the version of a file a snapshot is taken of: its absolute path, size and modification time.
+ *
+ *  Parameters:
+ *    - file_path: Null-terminated path to the file.
+ *    - key: Pointer to the header receiving the version, other fields are zeroed. It is all zeroes if the file
+ *           could not be examined, which is the version of no file.
+ *
+ *  Returns:
+ *    - true if the file could be examined.
+ *    - false otherwise.
+ */
+bool snapshot_key(const char* file_path, SnapshotHeader* key)
+{
+    struct stat st;
+    memset(key, 0, sizeof(*key));
+    if (stat(file_path, &st) != 0)
+        return false;
+
+    memcpy(key->magic, SNAPSHOT_MAGIC, sizeof(key->magic));
+    key->file_size = st.st_size;
+    key->file_mtime_s = st.st_mtim.tv_sec;
+    key->file_mtime_ns = st.st_mtim.tv_nsec;
+
+    char* absolute_path = realpath(file_path, NULL);
+    snprintf(key->file_path, sizeof(key->file_path), "%s", absolute_path != NULL ? absolute_path : file_path);
+    free(absolute_path);
+    return true;
+}
+
+/*
+ *  Purpose: Build the path of the snapshot of a file, creating the cache directory if needed.
+ *
+ *  Parameters:
+ *    - key: Pointer to the header holding the version of the file.
+ *    - path: Buffer receiving the null-terminated path.
+ *    - size: The size of the buffer.
+ *
+ *  Returns:
+ *    - true if the path was built.
+ *    - false if there is no usable cache directory.
+ */
+static bool snapshot_path(const SnapshotHeader* key, char* path, size_t size)
+{
+    char dir[SNAPSHOT_PATH_CAPACITY];
+    if (!utils_cache_dir(dir, sizeof(dir)))
+        return false;
+
+    // One snapshot per file, the version is checked on restore
+    uint64_t hash = diff_hash_line(key->file_path, strlen(key->file_path));
+
+    int written = snprintf(path, size, "%s/session-%016llx.snap", dir, (unsigned long long)hash);
+    return written > 0 && (size_t)written < size;
+}
+
+/*
+ *  Purpose: Check whether two snapshot headers were made for the same version of the same file.
+ *
+ *  Parameters:
+ *    - a: Pointer to the first header.
+ *    - b: Pointer to the second header.
+ *
+ *  Returns:
+ *    - true if they were.
+ *    - false otherwise.
+ */
+static bool snapshot_same_version(const SnapshotHeader* a, const SnapshotHeader* b)
+{
+    return memcmp(a->magic, b->magic, sizeof(a->magic)) == 0
+        && a->file_size == b->file_size
+        && a->file_mtime_s == b->file_mtime_s
+        && a->file_mtime_ns == b->file_mtime_ns
+        && strncmp(a->file_path, b->file_path, sizeof(a->file_path)) == 0;
+}
+
+/*
+ *  Purpose: Restore a file from its snapshot, if there is one for the version of the file on disk.
+ *
+ *  Parameters:
+ *    - file_path: Null-terminated path to the file.
+ *    - editor: Pointer to an empty Editor structure. Its lines borrow their characters from the snapshot,
+ *              which stays mapped until 'editor_free'.
+ *    - camera_pos: Pointer set to the position of the camera when the snapshot was taken.
+ *
+ *  Returns:
+ *    - true if the file was restored.
+ *    - false otherwise (the Editor and camera are left untouched).
+ */
+bool snapshot_restore(const char* file_path, Editor* editor, Vec2f* camera_pos)
+{
+    assert(editor->lines == NULL && "Can only restore into an empty editor");
+
+    SnapshotHeader key;
+    char path[SNAPSHOT_PATH_CAPACITY];
+    if (!snapshot_key(file_path, &key) || key.file_size < SNAPSHOT_MIN_FILE_SIZE || !snapshot_path(&key, path, sizeof(path)))
+        return false;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SnapshotHeader)) {
+        close(fd);
+        return false;
+    }
+
+    // Read-only: the lines borrow their characters from the mapping, an edit copies a line before changing it
+    size_t mapping_size = st.st_size;
+    void* mapping = mmap(NULL, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+        return false;
+
+    const SnapshotHeader* header = mapping;
+    size_t index_capacity = (mapping_size - sizeof(SnapshotHeader)) / sizeof(uint64_t);
+    bool valid = snapshot_same_version(header, &key)
+        && header->num_lines > 0
+        && header->num_lines < index_capacity
+        && mapping_size == sizeof(SnapshotHeader) + (header->num_lines + 1) * sizeof(uint64_t) + header->text_size;
+
+    const uint64_t* offsets = (const uint64_t*)(header + 1);
+    char* text = (char*)(offsets + header->num_lines + 1);
+    Line* lines = NULL;
+
+    if (valid) {
+        lines = mem_malloc(MEM_EDITOR, header->num_lines * sizeof(lines[0]));
+        for (size_t i = 0; i < header->num_lines && valid; i++) {
+            valid = offsets[i] <= offsets[i + 1] && offsets[i + 1] <= header->text_size;
+            lines[i] = (Line) {.capacity = 0, .size = offsets[i + 1] - offsets[i], .chars = text + offsets[i]};
+        }
+    }
+
+    if (!valid) {
+        mem_free(MEM_EDITOR, lines);
+        munmap(mapping, mapping_size);
+        return false;
+    }
+
+    editor->lines = lines;
+    editor->capacity = header->num_lines;
+    editor->size = header->num_lines;
+    editor->mapping = mapping;
+    editor->mapping_size = mapping_size;
+
+    editor->cursor_row = header->cursor_row < editor->size ? header->cursor_row : editor->size - 1;
+    size_t line_size = editor->lines[editor->cursor_row].size;
+    editor->cursor_col = header->cursor_col < line_size ? header->cursor_col : line_size;
+    camera_pos->x = header->camera_x;
+    camera_pos->y = header->camera_y;
+    return true;
+}
+
+/*
+ *  Purpose: Write the snapshot of the lines of an Editor. The file is written under a temporary name and
+ *           renamed into place, so a concurrent start never maps a partial file.
+ *
+ *  Parameters:
+ *    - path: Path to the snapshot.
+ *    - header: Pointer to the header, with the version of the file, the cursor and the camera.
+ *    - editor: Pointer to the Editor structure.
+ *
+ *  Returns:
+ *    - true if the snapshot was written.
+ *    - false otherwise.
+ */
+static bool snapshot_write(const char* path, SnapshotHeader* header, const Editor* editor)
+{
+    char tmp_path[SNAPSHOT_PATH_CAPACITY + 16];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%ld", path, (long)getpid());
+
+    FILE* fp = fopen(tmp_path, "wb");
+    if (fp == NULL)
+        return false;
+
+    header->num_lines = editor->size;
+    header->text_size = 0;
+    for (size_t i = 0; i < editor->size; i++)
+        header->text_size += editor->lines[i].size;
+
+    bool ok = fwrite(header, sizeof(*header), 1, fp) == 1;
+
+    uint64_t offset = 0;
+    ok = ok && fwrite(&offset, sizeof(offset), 1, fp) == 1;
+    for (size_t i = 0; i < editor->size && ok; i++) {
+        offset += editor->lines[i].size;
+        ok = fwrite(&offset, sizeof(offset), 1, fp) == 1;
+    }
+
+    ColdReader reader = {0};
+    for (size_t i = 0; i < editor->size && ok; i++) {
+        const Line* line = editor_read_line(editor, i, &reader);
+        ok = fwrite(line->chars, 1, line->size, fp) == line->size;
+    }
+    cold_reader_free(&reader);
+
+    if (fclose(fp) != 0 || !ok || rename(tmp_path, path) != 0) {
+        remove(tmp_path);
+        return false;
+    }
+    return true;
+}
+
+/*
+ *  Purpose: Take a snapshot of a file whose Editor holds exactly the version on disk. If the Editor was
+ *           restored from a snapshot of that version, only the cursor and camera are updated.
+ *
+ *  Parameters:
+ *    - file_path: Null-terminated path to the file.
+ *    - editor: Pointer to the Editor structure, without unsaved edits.
+ *    - version: Pointer to the version of the file the lines of the Editor were last known to be, from
+ *               'snapshot_key'. Nothing is written if the file on disk is no longer that version.
+ *    - camera_pos: The position of the camera.
+ *
+ *  Returns:
+ *    - true if the snapshot was written.
+ *    - false if the file changed, is too small to need one or the snapshot could not be written.
+ */
+bool snapshot_save(const char* file_path, const Editor* editor, const SnapshotHeader* version, Vec2f camera_pos)
+{
+    SnapshotHeader header;
+    char path[SNAPSHOT_PATH_CAPACITY];
+    if (editor->pager != NULL || editor->size == 0 || !snapshot_key(file_path, &header) || !snapshot_same_version(version, &header)
+        || header.file_size < SNAPSHOT_MIN_FILE_SIZE || !snapshot_path(&header, path, sizeof(path)))
+        return false;
+
+    header.cursor_row = editor->cursor_row;
+    header.cursor_col = editor->cursor_col;
+    header.camera_x = camera_pos.x;
+    header.camera_y = camera_pos.y;
+
+    const SnapshotHeader* mapped = editor->mapping;
+    if (mapped == NULL || !snapshot_same_version(mapped, &header))
+        return snapshot_write(path, &header, editor);
+
+    // The text is already in the snapshot
+    header.num_lines = mapped->num_lines;
+    header.text_size = mapped->text_size;
+    int fd = open(path, O_WRONLY);
+    if (fd < 0)
+        return false;
+    bool ok = pwrite(fd, &header, sizeof(header), 0) == sizeof(header);
+    close(fd);
+    return ok;
+}
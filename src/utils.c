@@ -1,10 +1,14 @@
 /*
  *  Utility functions for error handling and resource cleanup in an SDL-based application.
  */
+#define _XOPEN_SOURCE 700 // mkdir
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
 #include <errno.h>
+#include <sys/stat.h>
 
 #include "utils.h"
 #include "font.h"
@@ -62,6 +66,37 @@ void* utils_cp(void* ptr)
     return ptr;   
 }
 
+/*
+ *  Purpose: Get the cache directory of the editor, creating it if needed.
+ *
+ *  Parameters:
+ *    - dir: Buffer receiving the null-terminated path.
+ *    - size: The size of the buffer.
+ *
+ *  Returns:
+ *    - true if the directory exists.
+ *    - false if there is no usable cache directory.
+ */
+bool utils_cache_dir(char* dir, size_t size)
+{
+    const char* xdg_cache = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+
+    if (xdg_cache != NULL && xdg_cache[0] != '\0')
+        snprintf(dir, size, "%s", xdg_cache);
+    else if (home != NULL)
+        snprintf(dir, size, "%s/.cache", home);
+    else
+        return false;
+
+    mkdir(dir, 0755);
+    size_t dir_size = strlen(dir);
+    int written = snprintf(dir + dir_size, size - dir_size, "/%s", UTILS_CACHE_DIR_NAME);
+    if (written < 0 || (size_t)written >= size - dir_size)
+        return false;
+    return mkdir(dir, 0755) == 0 || errno == EEXIST;
+}
+
 /*
  *  Purpose: Perform cleanup by freeing resources and quitting SDL and related libraries.
  *
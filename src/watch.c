@@ -0,0 +1,186 @@
+/*
+ *  Watching a file for changes made by other processes. On Linux the directory of the file is watched
+ *  with inotify, which also sees the file being replaced by a rename. Elsewhere, or if inotify is not
+ *  available, the file is polled with stat every WATCH_POLL_INTERVAL_MS.
+ */
+#define _XOPEN_SOURCE 700 // st_mtim
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#include "watch.h"
+#include "mem.h"
+#include "SDL.h"
+
+/*
+ *  Purpose: Start watching the directory of the file with inotify.
+ *
+ *  Parameters:
+ *    - watch: Pointer to the Watch, with its path set.
+ *
+ *  Returns:
+ *    - The inotify file descriptor.
+ *    - -1 if inotify is not available and the file has to be polled.
+ */
+static int watch_start_inotify(Watch* watch)
+{
+#ifdef __linux__
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    // Editors save by writing a new file and renaming it over the old one, which only the directory sees
+    char* dir = mem_strdup(MEM_OTHER, watch->path);
+    char* slash = strrchr(dir, '/');
+    if (slash == NULL)
+        strcpy(dir, ".");
+    else if (slash == dir)
+        slash[1] = '\0';
+    else
+        *slash = '\0';
+
+    int wd = inotify_add_watch(fd, dir, IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO);
+    mem_free(MEM_OTHER, dir);
+    if (wd < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+#else
+    (void)watch;
+    return -1;
+#endif
+}
+
+/*
+ *  Purpose: Get the size of the file and the identity of the inode it is stored in now.
+ *
+ *  Parameters:
+ *    - watch: Pointer to the Watch.
+ *
+ *  Returns: What stat reports for the file (with 'exists' false if it does not exist).
+ */
+WatchStat watch_stat(const Watch* watch)
+{
+    struct stat st;
+    if (stat(watch->path, &st) != 0)
+        return (WatchStat) {0};
+
+    return (WatchStat) {
+        .exists = true,
+        .size = st.st_size,
+        .mtime_s = st.st_mtim.tv_sec,
+        .mtime_ns = st.st_mtim.tv_nsec,
+        .inode = st.st_ino,
+    };
+}
+
+/*
+ *  Purpose: Start watching a file, which does not have to exist yet. The watch should be released with 'watch_free'.
+ *
+ *  Parameters:
+ *    - file_path: Null-terminated path to the file.
+ *
+ *  Returns:
+ *    - Pointer to the new Watch.
+ */
+Watch* watch_open(const char* file_path)
+{
+    Watch* watch = mem_calloc(MEM_OTHER, 1, sizeof(*watch));
+    watch->path = mem_strdup(MEM_OTHER, file_path);
+
+    const char* slash = strrchr(watch->path, '/');
+    watch->name = slash != NULL ? slash + 1 : watch->path;
+
+    watch->inotify_fd = watch_start_inotify(watch);
+    watch->last = watch_stat(watch);
+    watch->next_poll_ms = SDL_GetTicks() + WATCH_POLL_INTERVAL_MS;
+    return watch;
+}
+
+/*
+ *  Purpose: Drain the pending inotify events and check whether one of them is about the watched file.
+ *
+ *  Parameters:
+ *    - watch: Pointer to the Watch.
+ *
+ *  Returns:
+ *    - true if the file was touched.
+ *    - false otherwise.
+ */
+static bool watch_read_events(Watch* watch)
+{
+    bool changed = false;
+#ifdef __linux__
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t size;
+
+    while ((size = read(watch->inotify_fd, buffer, sizeof(buffer))) > 0) {
+        for (char* p = buffer; p < buffer + size; p += sizeof(struct inotify_event) + ((struct inotify_event*)p)->len) {
+            const struct inotify_event* event = (const struct inotify_event*)p;
+            if (event->len > 0 && strcmp(event->name, watch->name) == 0)
+                changed = true;
+            if (event->mask & IN_Q_OVERFLOW)
+                changed = true;
+        }
+    }
+#else
+    (void)watch;
+#endif
+    return changed;
+}
+
+/*
+ *  Purpose: Check whether the file changed since the last call, without blocking.
+ *
+ *  Parameters:
+ *    - watch: Pointer to the Watch.
+ *
+ *  Returns:
+ *    - true if the file was written, created, replaced or removed.
+ *    - false otherwise.
+ */
+bool watch_poll(Watch* watch)
+{
+    if (watch->inotify_fd >= 0) {
+        if (!watch_read_events(watch))
+            return false;
+        watch->last = watch_stat(watch);
+        return true;
+    }
+
+    Uint32 now_ms = SDL_GetTicks();
+    if ((Sint32)(now_ms - watch->next_poll_ms) < 0)
+        return false;
+    watch->next_poll_ms = now_ms + WATCH_POLL_INTERVAL_MS;
+
+    WatchStat current = watch_stat(watch);
+    bool changed = current.exists != watch->last.exists || current.size != watch->last.size || current.inode != watch->last.inode
+        || current.mtime_s != watch->last.mtime_s || current.mtime_ns != watch->last.mtime_ns;
+    watch->last = current;
+    return changed;
+}
+
+/*
+ *  Purpose: Stop watching the file and free the Watch.
+ *
+ *  Parameters:
+ *    - watch: Pointer to the Watch to free.
+ *
+ *  Returns: None.
+ */
+void watch_free(Watch* watch)
+{
+    if (watch->inotify_fd >= 0)
+        close(watch->inotify_fd);
+    mem_free(MEM_OTHER, watch->path);
+    mem_free(MEM_OTHER, watch);
+}
@@ -0,0 +1,577 @@
+/*
+ *  Soft wrapping. Lines longer than the window are broken into visual rows, after the last space that
+ *  fits or at the edge when there is none. The layout caches how many rows every line takes at the
+ *  current width and keeps their prefix sums in a Fenwick tree, so a visual row is mapped to its line,
+ *  and a line to its first visual row, in O(log n). Edited lines are measured again as the Editor
+ *  reports them; when the width changes, lines keep their old count until they come into view.
+ */
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "wrap.h"
+#include "editor.h"
+#include "line.h"
+#include "mem.h"
+
+/*
+ *  Purpose: Make room for a number of lines in the layout.
+ *
+ *  Parameters:
+ *    - layout: Pointer to the WrapLayout.
+ *    - size: The number of lines it must hold.
+ *
+ *  Returns: None.
+ */
+static void wrap_reserve(WrapLayout* layout, size_t size)
+{
+    if (size <= layout->capacity)
+        return;
+
+    size_t new_capacity = layout->capacity == 0 ? WRAP_INIT_CAPACITY : layout->capacity;
+    while (new_capacity < size)
+        new_capacity *= 2;
+    layout->capacity = new_capacity;
+    layout->lines = mem_realloc(MEM_WRAP, layout->lines, new_capacity * sizeof(layout->lines[0]));
+    layout->tree = mem_realloc(MEM_WRAP, layout->tree, (new_capacity + 1) * sizeof(layout->tree[0]));
+}
+
+/*
+ *  Purpose: Sum the visual rows of the first lines.
+ *
+ *  Parameters:
+ *    - layout: Pointer to the WrapLayout.
+ *    - num_lines: The number of lines to sum, at most the size of the layout.
+ *
+ *  Returns:
+ *    - The visual rows of lines [0, num_lines).
+ */
+static size_t wrap_prefix(const WrapLayout* layout, size_t num_lines)
+{
+    size_t sum = 0;
+    for (size_t i = num_lines; i > 0; i -= i & -i)
+        sum += layout->tree[i];
+    return sum;
+}
+
+/*
+ *  Purpose: Add to the visual rows of a line in the tree.
+ *
+ *  Parameters:
+ *    - layout: Pointer to the WrapLayout.
+ *    - row: The index of the line.
+ *    - delta: The number of rows to add (remove if negative).
+ *
+ *  Returns: None.
+ */
+static void wrap_add(WrapLayout* layout, size_t row, ptrdiff_t delta)
+{
+    // Unsigned arithmetic wraps around, so adding the converted delta also subtracts
+    for (size_t i = row + 1; i <= layout->size; i += i & -i)
+        layout->tree[i] += (size_t)delta;
+    layout->total_rows += (size_t)delta;
+}
+
+/*
+ *  Purpose: Add a line at the end of the layout in O(log n). The tree entries of the lines before it do not
+ *           depend on how many lines follow them.
+ *
+ *  Parameters:
+ *    - layout: Pointer to the WrapLayout, with room for the line.
+ *    - line: The line.
+ *
+ *  Returns: None.
+ */
+static void wrap_push(WrapLayout* layout, WrapLine line)
+{
+    size_t i = ++layout->size;
+    layout->lines[i - 1] = line;
+    layout->tree[i] = line.rows + wrap_prefix(layout, i - 1) - wrap_prefix(layout, i - (i & -i));
+    layout->total_rows += line.rows;
+}
+
+/*
+ *  Purpose: Build the tree from the rows of the lines in O(n).
+ *
+ *  Parameters:
+ *    - layout: Pointer to the WrapLayout.
+ *
+ *  Returns: None.
+ */
+static void wrap_rebuild(WrapLayout* layout)
+{
+    layout->total_rows = 0;
+    for (size_t i = 1; i <= layout->size; i++) {
+        layout->tree[i] = layout->lines[i - 1].rows;
+        layout->total_rows += layout->lines[i - 1].rows;
+    }
+
+    // Each entry is complete once the entries below it were added, and passes its sum to its parent
+    for (size_t i = 1; i <= layout->size; i++) {
+        size_t parent = i + (i & -i);
+        if (parent <= layout->size)
+            layout->tree[parent] += layout->tree[i];
+    }
+}
+
+/*
+ *  Purpose: Find where the visual row starting at a column of a line ends.
+ *
+ *  Parameters:
+ *    - line: Pointer to the line, which may be chunked.
+ *    - start: The column the row starts at, below the size of the line unless it is empty.
+ *    - width: The number of columns of a visual row, above 0.
+ *
+ *  Returns:
+ *    - The column after the last one of the row, 'size' for the last row of the line.
+ */
+size_t wrap_segment_end(const Line* line, size_t start, size_t width)
+{
+    if (line->size - start <= width)
+        return line->size;
+
+    // The row ends after the last space that fits, a word longer than the row is cut at its edge. The
+    // characters are read a window at a time from the end of the row, so a chunked line is not joined.
+    char window[WRAP_SCAN_WINDOW];
+    for (size_t end = start + width; end > start + 1;) {
+        size_t begin = end - (start + 1) > WRAP_SCAN_WINDOW ? end - WRAP_SCAN_WINDOW : start + 1;
+        line_copy_range(line, begin, end, window);
+        for (size_t i = end; i > begin; i--)
+            if (window[i - 1 - begin] == ' ')
+                return i;
+        end = begin;
+    }
+    return start + width;
+}
+
+/*
+ *  Purpose: Find the visual row of a line holding a column.
+ *
+ *  Parameters:
+ *    - line: Pointer to the line.
+ *    - width: The number of columns of a visual row.
+ *    - col: The column, at most the size of the line.
+ *    - start: Pointer set to the column the row starts at.
+ *
+ *  Returns:
+ *    - The row within the line.
+ */
+static size_t wrap_segment_of(const Line* line, size_t width, size_t col, size_t* start)
+{
+    size_t sub_row = 0, segment_start = 0;
+    size_t segment_end = wrap_segment_end(line, 0, width);
+    while (segment_end < line->size && col >= segment_end) {
+        segment_start = segment_end;
+        segment_end = wrap_segment_end(line, segment_start, width);
+        sub_row++;
+    }
+    *start = segment_start;
+    return sub_row;
+}
+
+/*
+ *  Purpose: Find a visual row of a line.
+ *
+ *  Parameters:
+ *    - line: Pointer to the line.
+ *    - width: The number of columns of a visual row.
+ *    - sub_row: The row within the line, its last row if it has fewer.
+ *    - start: Pointer set to the column the row starts at.
+ *
+ *  Returns:
+ *    - The column after the last one of the row.
+ */
+static size_t wrap_segment_at(const Line* line, size_t width, size_t sub_row, size_t* start)
+{
+    size_t segment_start = 0;
+    size_t segment_end = wrap_segment_end(line, 0, width);
+    for (; sub_row > 0 && segment_end < line->size; sub_row--) {
+        segment_start = segment_end;
+        segment_end = wrap_segment_end(line, segment_start, width);
+    }
+    *start = segment_start;
+    return segment_end;
+}
+
+/*
+ *  Purpose: Count the visual rows of a line of the Editor at the current width.
+ *
+ *  Parameters:
+ *    - layout: Pointer to the WrapLayout.
+ *    - row: The index of the line.
+ *
+ *  Returns:
+ *    - The number of rows, at least 1.
+ */
+static size_t wrap_count_rows(const WrapLayout* layout, size_t row)
+{
+    const Line* line = editor_peek_line(layout->editor, row);
+    size_t rows = 0, start = 0;
+    do {
+        start = wrap_segment_end(line, start, layout->width);
+        rows++;
+    } while (start < line->size);
+    return rows;
+}
+
+/*
+ *  Purpose: Measure a line if it is stale.
+ *
+ *  Parameters:
+ *    - layout: Pointer to the WrapLayout.
+ *    - row: The index of the line.
+ *
+ *  Returns:
+ *    - The number of visual rows it gained (negative if it lost some).
+ */
+static ptrdiff_t wrap_measure(WrapLayout* layout, size_t row)
+{
+    WrapLine* line = layout->lines + row;
+    if (line->generation == layout->generation)
+        return 0;
+
+    size_t rows = wrap_count_rows(layout, row);
+    ptrdiff_t delta = (ptrdiff_t)rows - (ptrdiff_t)line->rows;
+    *line = (WrapLine) {.rows = rows, .generation = layout->generation};
+    if (delta != 0)
+        wrap_add(layout, row, delta);
+    return delta;
+}
+
+/*
+ *  Purpose: Make the layout hold the lines of the Editor again, none of them measured.
+ *
+ *  Parameters:
+ *    - layout: Pointer to the WrapLayout.
+ *
+ *  Returns: None.
+ */
+static void wrap_reset(WrapLayout* layout)
+{
+    layout->size = layout->editor->size;
+    wrap_reserve(layout, layout->size);
+    for (size_t i = 0; i < layout->size; i++)
+        layout->lines[i] = (WrapLine) {.rows = 1, .generation = 0};
+    wrap_rebuild(layout);
+}
+
+/*
+ *  Purpose: Follow lines the Editor got or lost without a change, the first line of an empty Editor and the
+ *           lines of a file that is being paged.
+ *
+ *  Parameters:
+ *    - layout: Pointer to the WrapLayout.
+ *
+ *  Returns: None.
+ */
+static void wrap_sync(WrapLayout* layout)
+{
+    size_t size = layout->editor->size;
+    if (size < layout->size) {
+        layout->total_rows = wrap_prefix(layout, size);
+        layout->size = size;
+    } else if (size > layout->size) {
+        wrap_reserve(layout, size);
+        while (layout->size < size)
+            wrap_push(layout, (WrapLine) {.rows = 1, .generation = 0});
+    }
+}
+
+/*
+ *  Purpose: Follow a change to the Editor, measuring the lines it replaced. Called by the Editor through
+ *           'editor_add_listener'.
+ *
+ *  Parameters:
+ *    - data: Pointer to the WrapLayout.
+ *    - change: Pointer to the change.
+ *
+ *  Returns: None.
+ */
+static void wrap_on_change(void* data, const EditorChange* change)
+{
+    WrapLayout* layout = data;
+    size_t row = change->row;
+    size_t removed = change->old_end_row - row + 1;
+    size_t inserted = change->new_end_row - row + 1;
+
+    // The Editor got lines without a change before this one, so the layout starts over
+    if (layout->size + inserted != layout->editor->size + removed) {
+        wrap_reset(layout);
+        return;
+    }
+
+    if (inserted == removed) {
+        for (size_t i = row; i < row + inserted; i++) {
+            layout->lines[i].generation = 0;
+            wrap_measure(layout, i);
+        }
+    } else if (row + removed == layout->size) {
+        // The lines at the end are dropped and the new ones pushed, in O(log n) each
+        layout->total_rows = wrap_prefix(layout, row);
+        layout->size = row;
+        wrap_reserve(layout, row + inserted);
+        for (size_t i = row; i < row + inserted; i++)
+            wrap_push(layout, (WrapLine) {.rows = wrap_count_rows(layout, i), .generation = layout->generation});
+    } else {
+        // The lines after the change move as they did in the Editor, and the tree is built again around them
+        size_t tail = layout->size - row - removed;
+        wrap_reserve(layout, layout->size - removed + inserted);
+        memmove(layout->lines + row + inserted, layout->lines + row + removed, tail * sizeof(layout->lines[0]));
+        layout->size = layout->size - removed + inserted;
+        for (size_t i = row; i < row + inserted; i++)
+            layout->lines[i] = (WrapLine) {.rows = wrap_count_rows(layout, i), .generation = layout->generation};
+        wrap_rebuild(layout);
+    }
+}
+
+/*
+ *  Purpose: Create a layout following the changes to an Editor. The lines are measured as they are needed.
+ *           The layout should be released with 'wrap_free'. Main thread only.
+ *
+ *  Parameters:
+ *    - editor: Pointer to the Editor structure.
+ *    - width: The number of columns of a visual row, above 0.
+ *
+ *  Returns:
+ *    - Pointer to the new WrapLayout.
+ */
+WrapLayout* wrap_create(Editor* editor, size_t width)
+{
+    WrapLayout* layout = mem_calloc(MEM_WRAP, 1, sizeof(*layout));
+    layout->editor = editor;
+    layout->width = width;
+    layout->generation = 1;
+    layout->goal_row = SIZE_MAX;
+    wrap_reserve(layout, WRAP_INIT_CAPACITY);
+    wrap_reset(layout);
+    editor_add_listener(editor, wrap_on_change, layout);
+    return layout;
+}
+
+/*
+ *  Purpose: Change the width of the visual rows. The lines are measured again once they come into view.
+ *
+ *  Parameters:
+ *    - layout: Pointer to the WrapLayout.
+ *    - width: The number of columns of a visual row, above 0.
+ *
+ *  Returns: None.
+ */
+void wrap_set_width(WrapLayout* layout, size_t width)
+{
+    if (width == layout->width)
+        return;
+
+    // Every line becomes stale at once, without visiting any of them
+    layout->width = width;
+    layout->generation++;
+    if (layout->generation == 0)
+        layout->generation = 1;
+}
+
+/*
+ *  Purpose: Measure the lines covering a range of visual rows that are stale, until the range is covered by
+ *           lines measured at the current width.
+ *
+ *  Parameters:
+ *    - layout: Pointer to the WrapLayout.
+ *    - first_row: The first visual row of the range.
+ *    - num_rows: The number of visual rows in the range.
+ *    - anchor_row: A line whose place on screen should not change, usually the one of the cursor.
+ *
+ *  Returns:
+ *    - The number of visual rows added before the anchor line (negative if removed), by which the view
+ *      should be moved to keep the anchor in place.
+ */
+ptrdiff_t wrap_update_visible(WrapLayout* layout, size_t first_row, size_t num_rows, size_t anchor_row)
+{
+    wrap_sync(layout);
+    ptrdiff_t shift = 0;
+    bool changed = true;
+
+    // Measuring a line moves the lines after it, so the range is looked up again until nothing changes
+    while (changed) {
+        changed = false;
+        size_t sub_row;
+        size_t row = wrap_locate(layout, first_row, &sub_row);
+        for (size_t covered = 0; row < layout->size && covered < sub_row + num_rows; row++) {
+            ptrdiff_t delta = wrap_measure(layout, row);
+            if (delta != 0) {
+                changed = true;
+                if (row < anchor_row) {
+                    shift += delta;
+                    first_row = (ptrdiff_t)first_row + delta > 0 ? first_row + delta : 0;
+                }
+            }
+            covered += layout->lines[row].rows;
+        }
+    }
+    return shift;
+}
+
+/*
+ *  Purpose: Find the line holding a visual row.
+ *
+ *  Parameters:
+ *    - layout: Pointer to the WrapLayout.
+ *    - visual_row: The visual row, past the last one for the end of the text.
+ *    - sub_row: Pointer set to the row within the line (can be NULL).
+ *
+ *  Returns:
+ *    - The index of the line, 0 for an Editor without lines.
+ */
+size_t wrap_locate(WrapLayout* layout, size_t visual_row, size_t* sub_row)
+{
+    wrap_sync(layout);
+    size_t row = 0, rest = 0;
+    if (layout->size == 0) {
+        row = 0;
+        rest = 0;
+    } else if (visual_row >= layout->total_rows) {
+        row = layout->size - 1;
+        rest = layout->lines[row].rows - 1;
+    } else {
+        // Descend the tree, skipping every block of lines that ends at or before the row
+        size_t step = 1;
+        while (step * 2 <= layout->size)
+            step *= 2;
+        rest = visual_row;
+        for (; step > 0; step /= 2) {
+            if (row + step <= layout->size && layout->tree[row + step] <= rest) {
+                row += step;
+                rest -= layout->tree[row];
+            }
+        }
+    }
+
+    if (sub_row != NULL)
+        *sub_row = rest;
+    return row;
+}
+
+/*
+ *  Purpose: Find the visual row of a position, measuring its line if it is stale.
+ *
+ *  Parameters:
+ *    - layout: Pointer to the WrapLayout.
+ *    - row: The index of the line.
+ *    - col: The column on the line.
+ *    - segment_start: Pointer set to the column the visual row starts at (can be NULL).
+ *
+ *  Returns:
+ *    - The visual row.
+ */
+size_t wrap_visual_row(WrapLayout* layout, size_t row, size_t col, size_t* segment_start)
+{
+    wrap_sync(layout);
+    size_t start = 0, sub_row = 0;
+    if (row < layout->size) {
+        wrap_measure(layout, row);
+        sub_row = wrap_segment_of(editor_peek_line(layout->editor, row), layout->width, col, &start);
+    }
+
+    if (segment_start != NULL)
+        *segment_start = start;
+    return wrap_prefix(layout, row < layout->size ? row : layout->size) + sub_row;
+}
+
+/*
+ *  Purpose: Move the cursor one visual row up or down, keeping its column on screen.
+ *
+ *  Parameters:
+ *    - layout: Pointer to the WrapLayout.
+ *    - down: Whether to move down.
+ *
+ *  Returns: None.
+ */
+static void wrap_move_cursor(WrapLayout* layout, bool down)
+{
+    Editor* editor = layout->editor;
+    wrap_sync(layout);
+    if (editor->size == 0) {
+        // The Editor makes its first line
+        if (down)
+            editor_down_arrow(editor);
+        else
+            editor_up_arrow(editor);
+        return;
+    }
+
+    size_t row = editor->cursor_row;
+    wrap_measure(layout, row);
+    const Line* line = editor_peek_line(editor, row);
+    size_t start;
+    size_t sub_row = wrap_segment_of(line, layout->width, editor->cursor_col, &start);
+
+    // Moving on from where the last move left the cursor goes back to the column it started from
+    if (row != layout->goal_row || editor->cursor_col != layout->goal_col)
+        layout->goal_x = editor->cursor_col - start;
+
+    if (down && sub_row + 1 < layout->lines[row].rows)
+        sub_row++;
+    else if (down && row + 1 < editor->size) {
+        row++;
+        sub_row = 0;
+    } else if (!down && sub_row > 0)
+        sub_row--;
+    else if (!down && row > 0) {
+        row--;
+        wrap_measure(layout, row);
+        sub_row = layout->lines[row].rows - 1;
+    } else {
+        // Past the first or the last row the cursor goes to the start or the end of the text
+        editor->cursor_col = down ? line->size : 0;
+        return;
+    }
+
+    line = editor_peek_line(editor, row);
+    size_t end = wrap_segment_at(line, layout->width, sub_row, &start);
+    // The end of a row that goes on below is the start of the next one, so the cursor stops before it
+    size_t last_col = end == line->size ? end : end - 1;
+    editor->cursor_row = row;
+    editor->cursor_col = start + layout->goal_x < last_col ? start + layout->goal_x : last_col;
+    layout->goal_row = row;
+    layout->goal_col = editor->cursor_col;
+}
+
+/*
+ *  Purpose: Move the cursor one visual row up, keeping its column on screen.
+ *
+ *  Parameters:
+ *    - layout: Pointer to the WrapLayout.
+ *
+ *  Returns: None.
+ */
+void wrap_up_arrow(WrapLayout* layout)
+{
+    wrap_move_cursor(layout, false);
+}
+
+/*
+ *  Purpose: Move the cursor one visual row down, keeping its column on screen.
+ *
+ *  Parameters:
+ *    - layout: Pointer to the WrapLayout.
+ *
+ *  Returns: None.
+ */
+void wrap_down_arrow(WrapLayout* layout)
+{
+    wrap_move_cursor(layout, true);
+}
+
+/*
+ *  Purpose: Stop following the Editor and free the WrapLayout.
+ *
+ *  Parameters:
+ *    - layout: Pointer to the WrapLayout to free.
+ *
+ *  Returns: None.
+ */
+void wrap_free(WrapLayout* layout)
+{
+    editor_remove_listener(layout->editor, wrap_on_change, layout);
+    mem_free(MEM_WRAP, layout->lines);
+    mem_free(MEM_WRAP, layout->tree);
+    mem_free(MEM_WRAP, layout);
+}